@@ -14,6 +14,8 @@
 //===----------------------------------------------------------------------===//
 #pragma once
 
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 //===-- Compiler macros ---------------------------------------------------===//
@@ -34,6 +36,15 @@
 
 #endif // ndef __clang__
 
+// Platform API selection. Win32 API is also declared when building against
+//    the fake OS layer of the tests, which provides its own windows.h.
+#if defined(_WIN32) || defined(TEK_INJ_FAKE_OS)
+#define TEK_INJ_WIN32
+#elif defined(__linux__)
+#define TEK_INJ_LINUX
+#endif
+
+#ifdef TEK_INJ_WIN32
 #ifdef TEK_INJ_IMPL
 // Reduce windows.h API set reduced as much as possible
 #ifdef _WIN32_WINNT
@@ -74,11 +85,16 @@
 #define NOMCX
 #endif // def TEK_INJ_IMPL
 #include <windows.h>
+#endif // def TEK_INJ_WIN32
+
+#ifdef TEK_INJ_LINUX
+#include <uchar.h>
+#endif // def TEK_INJ_LINUX
 
 // Public API attribute.
-#ifdef TEK_INJ_STATIC
+#if defined(TEK_INJ_STATIC) || !defined(_WIN32)
 #define TEK_INJ_API visibility("default")
-#else // def TEK_INJ_STATIC
+#else // defined(TEK_INJ_STATIC) || !defined(_WIN32)
 
 // Use DLL exports/imports.
 #ifdef TEK_INJ_EXPORT
@@ -87,7 +103,57 @@
 #define TEK_INJ_API dllimport
 #endif // def TEK_INJ_EXPORT else
 
-#endif // def TEK_INJ_STATIC else
+#endif // defined(TEK_INJ_STATIC) || !defined(_WIN32) else
+
+//===-- Constants ---------------------------------------------------------===//
+
+#ifdef TEK_INJ_WIN32
+
+/// Prefix of the name of the file mapping that TEK Game Runtime receives its
+///    input from. The full name is this prefix followed by game process ID in
+///    decimal (e.g. "tek-game-runtime-1234"), so the runtime can find its own
+///    mapping via `GetCurrentProcessId()`, and concurrent launches never
+///    collide. Requires a runtime version that looks up the mapping by this
+///    name, older ones only know @ref TEK_INJ_LEGACY_MAPPING_NAME.
+#define TEK_INJ_MAPPING_NAME_PREFIX L"tek-game-runtime-"
+
+/// Name of the file mapping that runtime versions released before
+///    @ref TEK_INJ_MAPPING_NAME_PREFIX was introduced receive their input
+///    from, used with @ref TEK_INJ_FLAG_legacy_mapping_name.
+#define TEK_INJ_LEGACY_MAPPING_NAME L"tek-game-runtime"
+
+#endif // def TEK_INJ_WIN32
+
+#ifdef TEK_INJ_LINUX
+
+/// Name of the environment variable that tells TEK Game Runtime started by
+///    @ref tek_inj_linux_run_game the number of the file descriptor of its
+///    settings payload, in decimal. The descriptor refers to a memfd sealed
+///    against resizing, which holds the same payload as the file mapping does
+///    on Windows. The runtime should remove this variable and itself from
+///    `LD_PRELOAD` upon loading, so processes started by the game don't
+///    inherit them.
+#define TEK_INJ_PAYLOAD_FD_ENV "TEK_GR_PAYLOAD_FD"
+
+/// Prefix of the name of the POSIX shared memory object that TEK Game Runtime
+///    injected by @ref tek_inj_linux_attach receives its payload from, when
+///    @ref TEK_INJ_PAYLOAD_FD_ENV is not set. The full name is this prefix
+///    followed by the process ID in decimal (e.g. "/tek-game-runtime-1234"),
+///    the same way as the file mapping is named on Windows. The object is
+///    read-only for the runtime, and is removed once the runtime has loaded.
+#define TEK_INJ_SHM_NAME_PREFIX "/tek-game-runtime-"
+
+/// Prefix of the name of the cgroup that @ref tek_inj_linux_run_game creates
+///    for game process in @ref tek_inj_linux_game_args::cgroup_parent. The
+///    full name is this prefix followed by the process ID in decimal (e.g.
+///    "tek-injector-1234"). The cgroup is not removed when the process exits,
+///    the caller may remove it with `rmdir` after reaping the process.
+#define TEK_INJ_CGROUP_NAME_PREFIX "tek-injector-"
+
+#endif // def TEK_INJ_LINUX
+
+/// Number of buckets in @ref tek_inj_histogram.
+#define TEK_INJ_HISTOGRAM_NUM_BUCKETS 16
 
 //===-- Types -------------------------------------------------------------===//
 
@@ -97,24 +163,116 @@ enum tek_gr_load_type {
   ///    that file.
   TEK_GR_LOAD_TYPE_file_path,
   /// Settings JSON content is received from the file mapping directly.
-  TEK_GR_LOAD_TYPE_data
+  TEK_GR_LOAD_TYPE_data,
+  /// Settings are received from the file mapping directly, in compact binary
+  ///    encoding produced by @ref tek_inj_encode_settings, optionally
+  ///    compressed by @ref tek_inj_compress_settings. Requires a runtime
+  ///    version that supports the encoding, a portable decoder for it is
+  ///    provided in src/settings.hpp.
+  TEK_GR_LOAD_TYPE_bin
 };
 /// @copydoc tek_gr_load_type
 typedef enum tek_gr_load_type tek_gr_load_type;
 
+#ifdef TEK_INJ_WIN32
+
+/// Techniques for loading TEK Game Runtime DLLs in game process.
+enum tek_inj_strategy {
+  /// Create a thread in game process that loads the DLLs, and resume game's
+  ///    main thread after that thread exits.
+  TEK_INJ_STRATEGY_remote_thread,
+  /// Queue an APC to game's suspended main thread that loads the DLLs. The APC
+  ///    runs once the thread is resumed, at the end of loader initialization
+  ///    of the process, before the entry point of the executable, without
+  ///    creating an extra thread in game process.
+  TEK_INJ_STRATEGY_apc,
+  /// Redirect the start address of game's suspended main thread to a
+  ///    trampoline that loads the DLLs and then jumps to the entry point of
+  ///    the executable. Neither an extra thread nor an APC is used, and
+  ///    executable's code is not modified.
+  TEK_INJ_STRATEGY_entry_trampoline
+};
+/// @copydoc tek_inj_strategy
+typedef enum tek_inj_strategy tek_inj_strategy;
+
+#endif // def TEK_INJ_WIN32
+
 /// Injection flags.
+/// On Linux, only @ref TEK_INJ_FLAG_wait_ready and @ref TEK_INJ_FLAG_prefetch
+///    are supported, other flags are ignored.
 enum [[clang::flag_enum]] tek_inj_flag {
   TEK_INJ_FLAG_none,
   /// Set game process priority to high.
   TEK_INJ_FLAG_high_proc_prio = 1 << 0,
   /// Run game process elevated if the calling process is elevated as well. By
   ///    default, game process is always started without admin privileges.
-  TEK_INJ_FLAG_run_as_admin = 1 << 1
+  TEK_INJ_FLAG_run_as_admin = 1 << 1,
+  /// Return game process handle in @ref tek_inj_game_args::process upon
+  ///    success, so the caller can wait for the game to exit.
+  TEK_INJ_FLAG_keep_process = 1 << 2,
+  /// Wait for TEK Game Runtime to report that its initialization is complete
+  ///    via a status block in the file mapping, rather than only for the DLL
+  ///    to load, so initialization failures are reported with
+  ///    @ref TEK_INJ_RES_runtime_init and their reason. Requires a runtime
+  ///    version that supports the status block, older ones never report
+  ///    readiness, so the launch times out.
+  TEK_INJ_FLAG_wait_ready = 1 << 3,
+  /// Set preferred NUMA node of game process to
+  ///    @ref tek_inj_game_args::numa_node.
+  TEK_INJ_FLAG_numa_node = 1 << 4,
+  /// Validate game executable and DLLs to inject before starting game
+  ///    process: they must be valid PE images of the architecture supported by
+  ///    the injector, and libtek-game-runtime.dll must export all functions
+  ///    listed in @ref tek_inj_game_args::required_exports. DLLs specified by
+  ///    relative paths are checked only if they're found in game's current
+  ///    directory. Results are cached in @ref tek_inj_game_args::ctx, if it's
+  ///    provided, keyed on path, size and last write time of the files.
+  TEK_INJ_FLAG_check_images = 1 << 5,
+  /// Read game executable, DLLs to inject, the settings file if @ref
+  ///    tek_inj_game_args::type is @ref TEK_GR_LOAD_TYPE_file_path, and
+  ///    @ref tek_inj_game_args::prefetch_paths into the file system cache on
+  ///    thread pool threads, concurrently with game process creation and
+  ///    injection, so game's main thread doesn't block on disk reads of them
+  ///    on a cold start. The launch waits for reading to complete before
+  ///    resuming game's main thread. Files that fail to be read are skipped.
+  ///    Ignored for processes started by a pool in advance. On Linux, reads
+  ///    are started with `posix_fadvise` on worker threads, and the files
+  ///    are @ref tek_inj_linux_game_args::exe_path,
+  ///    @ref tek_inj_linux_game_args::runtime_path, extra shared objects, the
+  ///    settings file, and @ref tek_inj_linux_game_args::prefetch_paths.
+  TEK_INJ_FLAG_prefetch = 1 << 6,
+  /// Pass settings data via a read-only file mapping shared by all launches
+  ///    with byte-identical data that use the same
+  ///    @ref tek_inj_game_args::ctx and are in progress at the same time,
+  ///    instead of copying it into every launch's own mapping. Shared
+  ///    mappings are keyed on a hash of the data and never writable by game
+  ///    processes. The context drops its reference to a mapping once the last
+  ///    launch using it has injected TEK Game Runtime, game processes keep
+  ///    their own. Ignored by @ref tek_inj_game_begin and for empty data.
+  ///    Requires a runtime version that supports shared payloads.
+  TEK_INJ_FLAG_shared_payload = 1 << 7,
+  /// Name the file mapping @ref TEK_INJ_LEGACY_MAPPING_NAME instead of
+  ///    deriving the name from game process ID, for runtime versions that
+  ///    don't support per-process names. As there is only one such name,
+  ///    launches with this flag made by the calling process are serialized:
+  ///    each one waits for the previous one to complete, so a thread must not
+  ///    start one while it holds an uncommitted @ref tek_inj_game_begin
+  ///    launch with this flag. An existing mapping with this name, e.g. kept
+  ///    open by a runtime loaded earlier, is reused, and the launch fails
+  ///    with @ref TEK_INJ_RES_map_view if it's too small for the payload.
+  ///    The mapping is created with size rounded up to 64 KiB to make that
+  ///    unlikely. Launches made by other processes are not serialized with.
+  ///    Not supported by @ref tek_inj_attach.
+  TEK_INJ_FLAG_legacy_mapping_name = 1 << 8
 };
 /// @copydoc tek_inj_flag
 typedef enum tek_inj_flag tek_inj_flag;
 
 /// Injection result codes.
+/// On Linux, error codes that accompany them are `errno` values rather than
+///    Win32 ones, and codes that name Windows-specific objects are reused for
+///    their closest equivalents, as documented by the functions that report
+///    them.
 enum tek_inj_res {
   /// (0) Injection performed successfully.
   TEK_INJ_RES_ok,
@@ -140,17 +298,225 @@ enum tek_inj_res {
   TEK_INJ_RES_map_view,
   /// (11) Failed to create injection thread.
   TEK_INJ_RES_create_thread,
-  /// (12) Failed to wait for injection thread to finish.
+  /// (12) Failed to wait for injection thread or the DLL loading routine on
+  ///    game's main thread to finish, or to get its outcome.
   TEK_INJ_RES_thread_wait,
   /// (13) DLL failed to load.
   TEK_INJ_RES_dll_load,
   /// (14) Failed to resume game's main thread.
-  TEK_INJ_RES_resume_thread
+  TEK_INJ_RES_resume_thread,
+  /// (15) Failed to open the process to attach to.
+  TEK_INJ_RES_open_process,
+  /// (16) Failed to change protection of game process memory.
+  TEK_INJ_RES_mem_protect,
+  /// (17) Arena supplied via @ref tek_inj_game_args::arena is too small.
+  TEK_INJ_RES_arena_size,
+  /// (18) Failed to create or duplicate the event for TEK Game Runtime status
+  ///    reports.
+  TEK_INJ_RES_status_event,
+  /// (19) TEK Game Runtime failed to initialize, or didn't report readiness in
+  ///    time, in which case Win32 error code is `ERROR_TIMEOUT`. Otherwise,
+  ///    Win32 error code is the one reported by the runtime.
+  TEK_INJ_RES_runtime_init,
+  /// (20) Failed to apply processor affinity, NUMA node, memory or I/O
+  ///    priority to game process.
+  TEK_INJ_RES_placement,
+  /// (21) Failed to create job object or cgroup for game process, set its
+  ///    limits, or assign the process to it.
+  TEK_INJ_RES_job,
+  /// (22) Failed to open or read game executable or a DLL for validation.
+  TEK_INJ_RES_image_open,
+  /// (23) Game executable or a DLL is not a valid PE image of the expected
+  ///    kind.
+  TEK_INJ_RES_image_invalid,
+  /// (24) Game executable or a DLL is built for an architecture other than
+  ///    the one supported by the injector.
+  TEK_INJ_RES_image_machine,
+  /// (25) libtek-game-runtime.dll doesn't export a required function.
+  TEK_INJ_RES_image_export,
+  /// (26) Failed to create the shared settings file mapping or duplicate its
+  ///    handle into game process.
+  TEK_INJ_RES_shared_payload,
+  /// (27) Failed to set up loading DLLs on game's main thread: create the
+  ///    event that signals completion, queue the APC, or redirect thread's
+  ///    start address.
+  TEK_INJ_RES_main_thread,
+  /// Number of result codes.
+  TEK_INJ_RES_count
 };
 /// @copydoc tek_inj_res
 typedef enum tek_inj_res tek_inj_res;
 
+/// Phases of a game launch, recorded in @ref tek_inj_timings.
+enum tek_inj_phase {
+  /// Validating game executable and DLLs, only with
+  ///    @ref TEK_INJ_FLAG_check_images.
+  TEK_INJ_PHASE_image_check,
+  /// Reading files into the file system cache, only with
+  ///    @ref TEK_INJ_FLAG_prefetch. It runs on thread pool threads, or worker
+  ///    threads on Linux, so it overlaps the phases up to
+  ///    @ref TEK_INJ_PHASE_resume.
+  TEK_INJ_PHASE_prefetch,
+  /// Checking current process elevation and preparing medium integrity level
+  ///    token if needed.
+  TEK_INJ_PHASE_token,
+  /// Building command line and creating suspended game process.
+  TEK_INJ_PHASE_create_process,
+  /// Creating the file mapping and writing settings payload to it.
+  TEK_INJ_PHASE_mapping,
+  /// Allocating memory for DLL path in game process and writing it there.
+  TEK_INJ_PHASE_remote_write,
+  /// Starting the DLL loading routine as selected by
+  ///    @ref tek_inj_game_args::strategy and waiting for the DLL to load. With
+  ///    strategies that load it on game's main thread, it overlaps
+  ///    @ref TEK_INJ_PHASE_resume.
+  TEK_INJ_PHASE_inject,
+  /// TEK Game Runtime initialization, from the DLL being loaded to it
+  ///    reporting readiness. Recorded only with @ref TEK_INJ_FLAG_wait_ready,
+  ///    using timestamps reported by the runtime, so it overlaps
+  ///    @ref TEK_INJ_PHASE_inject.
+  TEK_INJ_PHASE_runtime_init,
+  /// Resuming game's main thread.
+  TEK_INJ_PHASE_resume,
+  /// Number of phases.
+  TEK_INJ_PHASE_count
+};
+/// @copydoc tek_inj_phase
+typedef enum tek_inj_phase tek_inj_phase;
+
+/// High-resolution timestamps of game launch phases.
+typedef struct tek_inj_timings tek_inj_timings;
+/// @copydoc tek_inj_timings
+struct tek_inj_timings {
+  /// [Out] Frequency of timestamps, in counts per second, as reported by
+  ///    `QueryPerformanceFrequency`. On Linux, timestamps are
+  ///    `CLOCK_MONOTONIC` values in nanoseconds, and the frequency is
+  ///    1000000000.
+  int64_t frequency;
+  /// [Out] `QueryPerformanceCounter` values at the start of each phase,
+  ///    indexed by @ref tek_inj_phase. Zero for phases that haven't been
+  ///    reached.
+  int64_t start[TEK_INJ_PHASE_count];
+  /// [Out] `QueryPerformanceCounter` values at the end of each phase, indexed
+  ///    by @ref tek_inj_phase. Zero for phases that haven't been completed.
+  int64_t end[TEK_INJ_PHASE_count];
+};
+
+/// Histogram of durations with exponentially growing buckets.
+typedef struct tek_inj_histogram tek_inj_histogram;
+/// @copydoc tek_inj_histogram
+struct tek_inj_histogram {
+  /// [Out] Number of durations in each bucket. Bucket N counts durations
+  ///    longer than the upper bound of the previous bucket and at most
+  ///    `100 << N` microseconds. The last bucket has no upper bound.
+  uint64_t buckets[TEK_INJ_HISTOGRAM_NUM_BUCKETS];
+  /// [Out] Sum of all durations, in microseconds.
+  uint64_t sum;
+};
+
+/// Cumulative statistics of game launches made by the calling process,
+///    returned by @ref tek_inj_metrics_snapshot.
+typedef struct tek_inj_metrics tek_inj_metrics;
+/// @copydoc tek_inj_metrics
+struct tek_inj_metrics {
+  /// [Out] Number of completed game launches, successful or not.
+  uint64_t launches;
+  /// [Out] Number of launches completed with each result code, indexed by
+  ///    @ref tek_inj_res.
+  uint64_t results[TEK_INJ_RES_count];
+  /// [Out] Number of launches that failed because TEK Game Runtime DLL
+  ///    didn't load, or the runtime didn't report readiness, in time.
+  uint64_t timeouts;
+  /// [Out] Histograms of durations of launch phases, indexed by
+  ///    @ref tek_inj_phase. Only phases that have been completed are
+  ///    recorded, so counts differ between phases.
+  tek_inj_histogram phases[TEK_INJ_PHASE_count];
+  /// [Out] Histogram of total launch durations, from the start of the first
+  ///    phase to completion of the launch.
+  tek_inj_histogram total;
+};
+
+/// I/O priority of game process.
+enum tek_inj_io_priority {
+  /// Keep the default I/O priority.
+  TEK_INJ_IO_PRIORITY_default,
+  /// Lowest priority, for I/O that may wait for all other one:
+  ///    `IoPriorityVeryLow` on Windows, idle class on Linux.
+  TEK_INJ_IO_PRIORITY_very_low,
+  /// Low priority: `IoPriorityLow` on Windows, the lowest level of
+  ///    best-effort class on Linux.
+  TEK_INJ_IO_PRIORITY_low,
+  /// Normal priority: `IoPriorityNormal` on Windows, the middle level of
+  ///    best-effort class on Linux.
+  TEK_INJ_IO_PRIORITY_normal
+};
+/// @copydoc tek_inj_io_priority
+typedef enum tek_inj_io_priority tek_inj_io_priority;
+
+/// Resource limits of the job object, or cgroup v2 on Linux, that game
+///    process is placed into.
+typedef struct tek_inj_job_limits tek_inj_job_limits;
+/// @copydoc tek_inj_job_limits
+struct tek_inj_job_limits {
+  /// [In, optional] Maximum amount of memory that game process and its child
+  ///    processes may commit in total, in bytes. On Linux, it's written to
+  ///    `memory.max`, which limits memory charged to the cgroup, including
+  ///    page cache, rather than committed one. If 0, it's not limited.
+  uint64_t memory_limit;
+  /// [In, optional] Maximum share of CPU time of all CPUs that game process
+  ///    and its child processes may use, in 1/100 of a percent, from 1 to
+  ///    10000. The limit is hard, threads are not scheduled once it's reached
+  ///    until the next interval. On Linux, it's written to `cpu.max` as a
+  ///    quota per 100 ms period. If 0, it's not limited.
+  uint32_t cpu_rate;
+  /// [In, optional] Maximum number of processes that may run in the job at
+  ///    once, including game process itself. On Linux, it's written to
+  ///    `pids.max`, which counts threads as well. If 0, it's not limited.
+  uint32_t max_processes;
+};
+
+/// Accounting counters of a job object, returned by @ref tek_inj_job_query,
+///    or of a cgroup, returned by @ref tek_inj_linux_job_query. Counters that
+///    a cgroup doesn't provide, or whose controllers aren't enabled for it,
+///    are 0.
+typedef struct tek_inj_job_stats tek_inj_job_stats;
+/// @copydoc tek_inj_job_stats
+struct tek_inj_job_stats {
+  /// [Out] Total user-mode CPU time of all processes ever in the job, in
+  ///    100-nanosecond units.
+  int64_t user_time;
+  /// [Out] Total kernel-mode CPU time of all processes ever in the job, in
+  ///    100-nanosecond units.
+  int64_t kernel_time;
+  /// [Out] Peak amount of memory committed by the job, in bytes.
+  uint64_t peak_job_memory;
+  /// [Out] Peak amount of memory committed by any single process in the job,
+  ///    in bytes. Not provided by cgroups.
+  uint64_t peak_process_memory;
+  /// [Out] Total number of bytes read by all processes in the job.
+  uint64_t read_bytes;
+  /// [Out] Total number of bytes written by all processes in the job.
+  uint64_t write_bytes;
+  /// [Out] Total number of page faults in the job.
+  uint32_t page_faults;
+  /// [Out] Number of processes currently in the job.
+  uint32_t active_processes;
+  /// [Out] Total number of processes ever in the job. Not provided by
+  ///    cgroups.
+  uint32_t total_processes;
+};
+
+#ifdef TEK_INJ_WIN32
+
+/// Opaque state cached for multiple launches, created by
+///    @ref tek_inj_ctx_create.
+typedef struct tek_inj_ctx tek_inj_ctx;
+
 /// Input/output arguments for @ref tek_inj_run_game.
+/// Fields up to @ref tek_inj_game_args::win32_error keep the layout of
+///    version 2, fields added in version 3 are appended after them. The
+///    structure is larger than in version 2, so callers must be rebuilt
+///    against this header.
 typedef struct tek_inj_game_args tek_inj_game_args;
 /// @copydoc tek_inj_game_args
 struct tek_inj_game_args {
@@ -181,21 +547,732 @@ struct tek_inj_game_args {
   tek_inj_res result;
   /// [Out] If an error occurs, Win32 error code for it.
   DWORD win32_error;
+  /// [In, optional] Context to use cached state from. If `nullptr`, the state
+  ///    is computed for this launch only.
+  const tek_inj_ctx *_Nullable ctx;
+  /// [In, optional] Array of paths to additional DLLs to inject after
+  ///    @ref dll_path, in order. Relative paths are resolved the same way as
+  ///    @ref dll_path. All DLLs are loaded by a single routine, as selected by
+  ///    @ref strategy.
+  const LPCWSTR _Nonnull *_Nullable extra_dll_paths;
+  /// [In] Number of elements in @ref extra_dll_paths.
+  uint32_t num_extra_dlls;
+  /// [In, optional] Array of names of functions that @ref dll_path must
+  ///    export, checked only with @ref TEK_INJ_FLAG_check_images.
+  const char *_Nonnull const *_Nullable required_exports;
+  /// [In] Number of elements in @ref required_exports.
+  uint32_t num_required_exports;
+  /// [In, optional] Array of paths to additional files, e.g. large game
+  ///    assets, to read into the file system cache with
+  ///    @ref TEK_INJ_FLAG_prefetch. Relative paths are resolved against
+  ///    @ref current_dir.
+  const LPCWSTR _Nonnull *_Nullable prefetch_paths;
+  /// [In] Number of elements in @ref prefetch_paths.
+  uint32_t num_prefetch_paths;
+  /// [In, optional] Full command line for game process, used as is instead of
+  ///    building one from @ref exe_path and @ref argv, in which case
+  ///    @ref argc and @ref argv are ignored.
+  LPCWSTR _Nullable command_line;
+  /// [In, optional] Mask of processors that game process may run on, relative
+  ///    to @ref processor_group. Applied before game's main thread starts
+  ///    executing. If 0 and @ref TEK_INJ_FLAG_numa_node is set, processors of
+  ///    @ref numa_node are used, otherwise affinity is not changed.
+  uint64_t affinity_mask;
+  /// [In, optional] Processor group that @ref affinity_mask refers to.
+  uint16_t processor_group;
+  /// [In, optional] If @ref TEK_INJ_FLAG_numa_node is set, number of the NUMA
+  ///    node to prefer for game process memory allocations.
+  uint16_t numa_node;
+  /// [In, optional] Memory priority of game process, one of
+  ///    `MEMORY_PRIORITY_*` values from `MEMORY_PRIORITY_VERY_LOW` to
+  ///    `MEMORY_PRIORITY_NORMAL`. If 0, the default one is kept.
+  uint32_t memory_priority;
+  /// [In, optional] I/O priority of game process, applied before game's main
+  ///    thread starts executing.
+  tek_inj_io_priority io_priority;
+  /// [In, optional] Pointer to the limits of the job object to place game
+  ///    process into. The process is assigned to the job while it's still
+  ///    suspended, before injection, so it doesn't execute any code outside
+  ///    of it. If `nullptr`, the process is not placed into a new job.
+  const tek_inj_job_limits *_Nullable job_limits;
+  /// [In, optional] Technique for loading TEK Game Runtime DLLs in game
+  ///    process. With strategies other than
+  ///    @ref TEK_INJ_STRATEGY_remote_thread, game's main thread is resumed
+  ///    before the DLLs are loaded, and the process is terminated if loading
+  ///    fails.
+  tek_inj_strategy strategy;
+  /// [In, optional] Maximum time to wait for TEK Game Runtime DLL to load, in
+  ///    milliseconds. If 0, 3000 is used. When it's exceeded with
+  ///    @ref TEK_INJ_STRATEGY_remote_thread, the injection thread is
+  ///    terminated.
+  uint32_t inject_timeout;
+  /// [In, optional] Pointer to the buffer for all transient state of the
+  ///    launch, so it doesn't allocate heap memory. The buffer must stay valid
+  ///    until the launch completes. If `nullptr`, a single heap allocation is
+  ///    made instead.
+  void *_Nullable arena;
+  /// [In, out] Size of @ref arena, in bytes. If it's too small, the launch
+  ///    fails with @ref TEK_INJ_RES_arena_size before game process is
+  ///    created, and this field is set to the required size, so it may be
+  ///    queried by passing a non-null @ref arena with zero size.
+  size_t arena_size;
+  /// [Out, optional] Pointer to the structure that receives timestamps of
+  ///    launch phases, regardless of the result.
+  tek_inj_timings *_Nullable timings;
+  /// [Out] If @ref TEK_INJ_FLAG_prefetch is set, total size of files read
+  ///    into the file system cache, in bytes. Set before game's main thread
+  ///    is resumed, 0 if the launch fails earlier.
+  uint64_t prefetched_bytes;
+  /// [Out] ID of game process, set once it's created, 0 if the launch fails
+  ///    earlier. The process is terminated if the launch fails later.
+  DWORD pid;
+  /// [Out] ID of game's main thread, set along with @ref pid.
+  DWORD tid;
+  /// [Out] If @ref result is @ref TEK_INJ_RES_dll_load, index of the DLL that
+  ///    failed to load: 0 for @ref dll_path, N for
+  ///    `extra_dll_paths[N - 1]`. DLLs following it are not loaded. If
+  ///    @ref result is one of `TEK_INJ_RES_image_*` codes, index of the DLL
+  ///    that failed validation in the same format, or `UINT32_MAX` for
+  ///    @ref exe_path.
+  uint32_t failed_dll;
+  /// [Out] If @ref result is @ref TEK_INJ_RES_runtime_init and the runtime
+  ///    has reported a failure, null-terminated description of it.
+  WCHAR runtime_message[256];
+  /// [Out] If @ref TEK_INJ_FLAG_keep_process is set and the launch succeeded,
+  ///    handle to the game process with all access rights, which the caller
+  ///    must close. Otherwise, not modified.
+  HANDLE _Nullable process;
+  /// [Out] If @ref job_limits is not `nullptr` and the launch succeeded,
+  ///    handle to the job object with game process, which the caller must
+  ///    close. Closing it doesn't terminate the process. Otherwise, not
+  ///    modified.
+  HANDLE _Nullable job;
+};
+
+/// Opaque state of a game launch started by @ref tek_inj_game_begin.
+typedef struct tek_inj_launch tek_inj_launch;
+
+/// Input/output arguments for @ref tek_inj_attach.
+typedef struct tek_inj_attach_args tek_inj_attach_args;
+/// @copydoc tek_inj_attach_args
+struct tek_inj_attach_args {
+  /// [In, optional] Context to use cached state from. If `nullptr`, the state
+  ///    is computed for this injection only.
+  const tek_inj_ctx *_Nullable ctx;
+  /// [In] ID of the running process to inject TEK Game Runtime into.
+  DWORD pid;
+  /// [In] Path to libtek-game-runtime.dll to inject. If it's a relative path,
+  ///    it must be relative to current directory of the target process.
+  LPCWSTR _Nonnull dll_path;
+  /// [In, optional] Array of paths to additional DLLs to inject after
+  ///    @ref dll_path, in order. Relative paths are resolved the same way as
+  ///    @ref dll_path. All DLLs are loaded by a single remote thread.
+  const LPCWSTR _Nonnull *_Nullable extra_dll_paths;
+  /// [In] Number of elements in @ref extra_dll_paths.
+  uint32_t num_extra_dlls;
+  /// [In] Settings loading type for TEK Game Runtime.
+  tek_gr_load_type type;
+  /// [In] Size of the buffer passed as @ref data, in bytes.
+  uint32_t data_size;
+  /// [In] Pointer to the data to pass to TEK Game Runtime. Type of data depends
+  ///    on @ref type.
+  const char *_Nullable data;
+  /// [In, optional] Maximum time to wait for TEK Game Runtime DLL to load, in
+  ///    milliseconds. If 0, 3000 is used. When it's exceeded, the function
+  ///    fails with @ref TEK_INJ_RES_thread_wait, but the injection thread is
+  ///    not terminated, as it may hold the loader lock of the process. It's
+  ///    left to finish loading, and the memory it uses in the process is
+  ///    leaked.
+  uint32_t inject_timeout;
+  /// [Out] Injection result code.
+  tek_inj_res result;
+  /// [Out] If an error occurs, Win32 error code for it.
+  DWORD win32_error;
+  /// [Out] If @ref result is @ref TEK_INJ_RES_dll_load, index of the DLL that
+  ///    failed to load: 0 for @ref dll_path, N for
+  ///    `extra_dll_paths[N - 1]`. DLLs following it are not loaded.
+  uint32_t failed_dll;
+};
+
+/// Function called upon completion of an asynchronous launch.
+/// It's called from a thread pool thread after the function that started the
+///    launch has returned, even if the launch failed before the injection
+///    thread has been created. Only if a thread pool callback can't be
+///    submitted for such failure, it's called from the thread that started
+///    the launch. It must not free the launch.
+///
+/// @param [in] launch
+///    The completed launch. Result fields of its arguments are already set.
+/// @param [in, out] user_data
+///    Value passed to the function that started the launch.
+typedef void tek_inj_launch_cb(tek_inj_launch *_Nonnull launch,
+                               void *_Nullable user_data);
+
+/// Policies for replacing claimed processes of a @ref tek_inj_pool.
+enum tek_inj_pool_refill {
+  /// Claimed processes are not replaced, the pool shrinks until it's empty.
+  TEK_INJ_POOL_REFILL_none,
+  /// A replacement process is started by the claiming thread after the
+  ///    claimed one is resumed.
+  TEK_INJ_POOL_REFILL_on_claim,
+  /// A replacement process is started on a thread pool thread, so claims
+  ///    don't pay for it.
+  TEK_INJ_POOL_REFILL_background
+};
+/// @copydoc tek_inj_pool_refill
+typedef enum tek_inj_pool_refill tek_inj_pool_refill;
+
+/// Opaque pool of suspended game processes created by
+///    @ref tek_inj_pool_create.
+typedef struct tek_inj_pool tek_inj_pool;
+
+/// Input/output arguments for @ref tek_inj_pool_create.
+typedef struct tek_inj_pool_args tek_inj_pool_args;
+/// @copydoc tek_inj_pool_args
+struct tek_inj_pool_args {
+  /// [In] Arguments for starting pooled game processes. Only
+  ///    @ref tek_inj_game_args::ctx, @ref tek_inj_game_args::exe_path,
+  ///    @ref tek_inj_game_args::current_dir, @ref tek_inj_game_args::dll_path,
+  ///    @ref tek_inj_game_args::extra_dll_paths,
+  ///    @ref tek_inj_game_args::num_extra_dlls,
+  ///    @ref tek_inj_game_args::required_exports,
+  ///    @ref tek_inj_game_args::num_required_exports,
+  ///    @ref tek_inj_game_args::prefetch_paths,
+  ///    @ref tek_inj_game_args::num_prefetch_paths,
+  ///    @ref tek_inj_game_args::argc,
+  ///    @ref tek_inj_game_args::argv, @ref tek_inj_game_args::command_line,
+  ///    @ref tek_inj_game_args::flags, @ref tek_inj_game_args::affinity_mask,
+  ///    @ref tek_inj_game_args::processor_group,
+  ///    @ref tek_inj_game_args::numa_node,
+  ///    @ref tek_inj_game_args::memory_priority,
+  ///    @ref tek_inj_game_args::io_priority,
+  ///    @ref tek_inj_game_args::job_limits and
+  ///    @ref tek_inj_game_args::strategy are used. The structure is
+  ///    copied, but memory it points to must stay valid until the pool is
+  ///    destroyed.
+  const tek_inj_game_args *_Nonnull game_args;
+  /// [In] Number of suspended processes to keep in the pool.
+  uint32_t size;
+  /// [In] Policy for replacing claimed processes.
+  tek_inj_pool_refill refill;
+  /// [Out] Result code of starting the initial processes.
+  tek_inj_res result;
+  /// [Out] If an error occurs, Win32 error code for it.
+  DWORD win32_error;
+};
+
+#endif // def TEK_INJ_WIN32
+
+#ifdef TEK_INJ_LINUX
+
+/// Input/output arguments for @ref tek_inj_linux_run_game.
+typedef struct tek_inj_linux_game_args tek_inj_linux_game_args;
+/// @copydoc tek_inj_linux_game_args
+struct tek_inj_linux_game_args {
+  /// [In] Path to the game executable to run. It's not searched for in
+  ///    `PATH`.
+  const char *_Nonnull exe_path;
+  /// [In, optional] Path to the current directory to set for game process. If
+  ///    `nullptr`, current directory of the calling process is used.
+  const char *_Nullable current_dir;
+  /// [In] Path to libtek-game-runtime.so to load. If it's a relative path,
+  ///    it must be relative to @ref current_dir. It must not contain spaces
+  ///    or colons, which separate `LD_PRELOAD` entries.
+  const char *_Nonnull runtime_path;
+  /// [In, optional] Array of paths to additional shared objects to load after
+  ///    @ref runtime_path, in order, with the same requirements.
+  const char *_Nonnull const *_Nullable extra_paths;
+  /// [In] Number of elements in @ref extra_paths.
+  uint32_t num_extra_paths;
+  /// [In] Settings loading type for TEK Game Runtime.
+  tek_gr_load_type type;
+  /// [In] Number of elements in @ref argv.
+  int argc;
+  /// [In] Array of command-line arguments to pass to the game process.
+  ///    Executable path is prepended to it automatically.
+  const char *_Nonnull const *_Nullable argv;
+  /// [In, optional] Null-terminated array of "NAME=value" strings to use as
+  ///    environment of game process. If `nullptr`, environment of the calling
+  ///    process is used. Existing `LD_PRELOAD` entries are kept after the
+  ///    ones for TEK Game Runtime.
+  const char *_Nonnull const *_Nullable envp;
+  /// [In] Injection flags.
+  tek_inj_flag flags;
+  /// [In] Size of the buffer passed as @ref data, in bytes.
+  uint64_t data_size;
+  /// [In] Pointer to the data to pass to TEK Game Runtime. Type of data depends
+  ///    on @ref type.
+  const char *_Nullable data;
+  /// [In, optional] Maximum time to wait for TEK Game Runtime to report
+  ///    readiness with @ref TEK_INJ_FLAG_wait_ready, in milliseconds. If 0,
+  ///    3000 is used.
+  uint32_t inject_timeout;
+  /// [In, optional] Mask of CPUs 0 to 63 that game process may run on,
+  ///    applied before the executable runs. If 0, affinity is not changed.
+  uint64_t affinity_mask;
+  /// [In, optional] I/O priority of game process, applied before the
+  ///    executable runs.
+  tek_inj_io_priority io_priority;
+  /// [In, optional] Resource limits of the cgroup to place game process into
+  ///    before the executable runs. If `nullptr`, the process stays in the
+  ///    cgroup of the calling process.
+  const tek_inj_job_limits *_Nullable job_limits;
+  /// [In] If @ref job_limits is not `nullptr`, path to the cgroup v2
+  ///    directory to create the cgroup of game process in, named by
+  ///    @ref TEK_INJ_CGROUP_NAME_PREFIX. The calling process must be allowed
+  ///    to create cgroups in it and to move the process there, and
+  ///    controllers of non-zero limits must be enabled in its
+  ///    `cgroup.subtree_control`.
+  const char *_Nullable cgroup_parent;
+  /// [In, optional] Array of paths to additional files, e.g. large game
+  ///    assets, to read into the file system cache with
+  ///    @ref TEK_INJ_FLAG_prefetch. Relative paths are resolved against
+  ///    @ref current_dir.
+  const char *_Nonnull const *_Nullable prefetch_paths;
+  /// [In] Number of elements in @ref prefetch_paths.
+  uint32_t num_prefetch_paths;
+  /// [Out, optional] Pointer to the structure that receives timestamps of
+  ///    launch phases, regardless of the result.
+  tek_inj_timings *_Nullable timings;
+  /// [Out] Injection result code.
+  tek_inj_res result;
+  /// [Out] If an error occurs, `errno` value for it.
+  int sys_error;
+  /// [Out] ID of game process, set once it's created, 0 if the launch fails
+  ///    earlier. The process is terminated if the launch fails later.
+  int32_t pid;
+  /// [Out] If @ref result is @ref TEK_INJ_RES_dll_load, index of the shared
+  ///    object that can't be loaded: 0 for @ref runtime_path, N for
+  ///    `extra_paths[N - 1]`.
+  uint32_t failed_dll;
+  /// [Out] If @ref result is @ref TEK_INJ_RES_runtime_init and the runtime
+  ///    has reported a failure, null-terminated description of it.
+  char16_t runtime_message[256];
+  /// [Out] If @ref job_limits is not `nullptr` and the launch succeeded,
+  ///    descriptor of the cgroup directory of game process, which the caller
+  ///    must close. Otherwise, not modified.
+  int cgroup_fd;
+  /// [Out] If @ref TEK_INJ_FLAG_prefetch is set, total size of files whose
+  ///    reading into the file system cache has been started, in bytes. Set
+  ///    before game process is released, 0 if the launch fails earlier.
+  uint64_t prefetched_bytes;
+};
+
+/// Input/output arguments for @ref tek_inj_linux_attach.
+typedef struct tek_inj_linux_attach_args tek_inj_linux_attach_args;
+/// @copydoc tek_inj_linux_attach_args
+struct tek_inj_linux_attach_args {
+  /// [In] ID of the running process to inject TEK Game Runtime into. The
+  ///    runtime is loaded on its main thread.
+  int32_t pid;
+  /// [In] Path to libtek-game-runtime.so to load. If it's a relative path,
+  ///    it must be relative to current directory of the target process.
+  const char *_Nonnull runtime_path;
+  /// [In, optional] Array of paths to additional shared objects to load after
+  ///    @ref runtime_path, in order. Relative paths are resolved the same way
+  ///    as @ref runtime_path.
+  const char *_Nonnull const *_Nullable extra_paths;
+  /// [In] Number of elements in @ref extra_paths.
+  uint32_t num_extra_paths;
+  /// [In] Settings loading type for TEK Game Runtime.
+  tek_gr_load_type type;
+  /// [In] Size of the buffer passed as @ref data, in bytes.
+  uint32_t data_size;
+  /// [In] Pointer to the data to pass to TEK Game Runtime. Type of data depends
+  ///    on @ref type.
+  const char *_Nullable data;
+  /// [In, optional] Maximum time to wait for the shared objects to load, in
+  ///    milliseconds. If 0, 3000 is used. When it's exceeded, the function
+  ///    fails with @ref TEK_INJ_RES_thread_wait and `ETIMEDOUT`, but the main
+  ///    thread is left to finish loading, as it may hold the dynamic linker's
+  ///    lock, and the memory it uses in the process is leaked.
+  uint32_t inject_timeout;
+  /// [Out] Injection result code.
+  tek_inj_res result;
+  /// [Out] If an error occurs, `errno` value for it.
+  int sys_error;
+  /// [Out] If @ref result is @ref TEK_INJ_RES_dll_load, index of the shared
+  ///    object that failed to load: 0 for @ref runtime_path, N for
+  ///    `extra_paths[N - 1]`. Shared objects following it are not loaded.
+  uint32_t failed_dll;
 };
 
-//===-- Function ----------------------------------------------------------===//
+#endif // def TEK_INJ_LINUX
+
+//===-- Functions ---------------------------------------------------------===//
 
 #ifdef __cplusplus
 extern "C" {
 #endif // def __cplusplus
 
+#ifdef TEK_INJ_WIN32
+
 /// Start game process and inject TEK Game Runtime into it.
+/// The function doesn't use any global state other than cumulative launch
+///    statistics, and may be called from multiple threads concurrently.
 ///
 /// @param [in, out] args
 ///    Input/output arguments for the function.
 [[gnu::TEK_INJ_API]]
 void tek_inj_run_game(tek_inj_game_args *_Nonnull args);
 
+/// Start game process and reserve its settings payload region, so the caller
+///    can write settings directly into the file mapping instead of copying
+///    them from its own buffer. Injection is performed by
+///    @ref tek_inj_game_commit afterwards.
+/// @ref tek_inj_game_args::data_size and @ref tek_inj_game_args::data are
+///    ignored.
+///
+/// @param [in, out] args
+///    Input/output arguments for the launch. Must stay valid until the launch
+///    is committed or aborted, result fields are set upon failure of this
+///    function or upon completion of @ref tek_inj_game_commit.
+/// @param data_size
+///    Size of the settings data to reserve, in bytes. Unlike
+///    @ref tek_inj_game_args::data_size, it's not limited to 32 bits.
+/// @param [out] data
+///    Address of a variable that receives pointer to the writable buffer of
+///    @p data_size bytes for settings data. The buffer is valid until the
+///    launch is committed or aborted.
+/// @return Launch state that must be passed to either @ref tek_inj_game_commit
+///    or @ref tek_inj_game_abort, or `nullptr` on failure.
+[[gnu::TEK_INJ_API]]
+tek_inj_launch *_Nullable tek_inj_game_begin(tek_inj_game_args *_Nonnull args,
+                                             uint64_t data_size,
+                                             void *_Nullable *_Nonnull data);
+
+/// Inject TEK Game Runtime into game process started by
+///    @ref tek_inj_game_begin and resume it, then free the launch state.
+///    Result is written to the arguments that were passed to
+///    @ref tek_inj_game_begin.
+///
+/// @param [in] launch
+///    State of the launch to commit.
+[[gnu::TEK_INJ_API]]
+void tek_inj_game_commit(tek_inj_launch *_Nonnull launch);
+
+/// Terminate game process started by @ref tek_inj_game_begin and free the
+///    launch state.
+///
+/// @param [in] launch
+///    State of the launch to abort.
+[[gnu::TEK_INJ_API]]
+void tek_inj_game_abort(tek_inj_launch *_Nonnull launch);
+
+/// Start game process and begin injecting TEK Game Runtime into it without
+///    waiting for the DLL to load. The wait and resuming game's main thread
+///    happen on a thread pool thread, so a single thread may drive many
+///    launches at once.
+///
+/// @param [in, out] args
+///    Input/output arguments for the launch. Must stay valid until the launch
+///    is freed, result fields are set upon failure of this function or upon
+///    completion of the launch.
+/// @param [in] cb
+///    Optional function to call upon completion of the launch.
+/// @param [in, out] user_data
+///    Value to pass to @p cb.
+/// @return Launch state that must be freed with @ref tek_inj_launch_free, or
+///    `nullptr` if the game process couldn't be started, in which case
+///    @p cb is not called.
+[[gnu::TEK_INJ_API]]
+tek_inj_launch *_Nullable tek_inj_run_game_async(
+    tek_inj_game_args *_Nonnull args, tek_inj_launch_cb *_Nullable cb,
+    void *_Nullable user_data);
+
+/// Like @ref tek_inj_game_commit, but doesn't wait for the DLL to load, see
+///    @ref tek_inj_run_game_async. Unlike @ref tek_inj_game_commit, the launch
+///    state is not freed, and must be freed with @ref tek_inj_launch_free.
+///
+/// @param [in, out] launch
+///    State of the launch to commit.
+/// @param [in] cb
+///    Optional function to call upon completion of the launch.
+/// @param [in, out] user_data
+///    Value to pass to @p cb.
+[[gnu::TEK_INJ_API]]
+void tek_inj_game_commit_async(tek_inj_launch *_Nonnull launch,
+                               tek_inj_launch_cb *_Nullable cb,
+                               void *_Nullable user_data);
+
+/// Get the event that is signaled upon completion of an asynchronous launch,
+///    after the completion function returns.
+///
+/// @param [in] launch
+///    State of the asynchronous launch.
+/// @return Manual-reset event handle owned by the launch, valid until it's
+///    freed, or `nullptr` if the event couldn't be created, in which case the
+///    launch fails with @ref TEK_INJ_RES_thread_wait and its completion may
+///    only be observed via the completion function or
+///    @ref tek_inj_launch_done.
+[[gnu::TEK_INJ_API]]
+HANDLE _Nullable tek_inj_launch_event(const tek_inj_launch *_Nonnull launch);
+
+/// Check whether an asynchronous launch has completed.
+///
+/// @param [in] launch
+///    State of the asynchronous launch.
+/// @return Value indicating whether the launch has completed and result
+///    fields of its arguments are set.
+[[gnu::TEK_INJ_API]]
+bool tek_inj_launch_done(const tek_inj_launch *_Nonnull launch);
+
+/// Free the state of an asynchronous launch. If the launch hasn't completed
+///    yet, it's cancelled: the completion function is not called, and game
+///    process is terminated. If the completion function is running, waits for
+///    it to return.
+///
+/// @param [in] launch
+///    State of the launch to free.
+[[gnu::TEK_INJ_API]]
+void tek_inj_launch_free(tek_inj_launch *_Nonnull launch);
+
+/// Create a pool of game processes that are started suspended in advance, so
+///    claiming one skips token setup and process creation, including mapping
+///    of the executable image.
+/// TEK Game Runtime reads its settings when its DLL is loaded, so injection is
+///    still performed at claim time, after the settings are delivered.
+///
+/// @param [in, out] args
+///    Input/output arguments for the function.
+/// @return Pool that must be destroyed with @ref tek_inj_pool_destroy, or
+///    `nullptr` if any of the initial processes couldn't be started, in which
+///    case @p args result fields are set.
+[[gnu::TEK_INJ_API]]
+tek_inj_pool *_Nullable tek_inj_pool_create(tek_inj_pool_args *_Nonnull args);
+
+/// Take a suspended process from the pool, deliver settings to it, inject
+///    TEK Game Runtime and resume it. If the pool is empty, a new process is
+///    started the same way as @ref tek_inj_run_game does.
+/// May be called from multiple threads concurrently.
+///
+/// @param [in, out] pool
+///    The pool to claim a process from.
+/// @param [in, out] args
+///    Input/output arguments for the launch. Only
+///    @ref tek_inj_game_args::type, @ref tek_inj_game_args::data_size,
+///    @ref tek_inj_game_args::data, @ref tek_inj_game_args::inject_timeout,
+///    @ref tek_inj_game_args::timings and output fields are used, the rest
+///    is taken from the pool's arguments. Token and process creation phases
+///    are not recorded in timings when a pooled process is used.
+[[gnu::TEK_INJ_API]]
+void tek_inj_pool_claim(tek_inj_pool *_Nonnull pool,
+                        tek_inj_game_args *_Nonnull args);
+
+/// Get the number of suspended processes currently available in the pool.
+///
+/// @param [in] pool
+///    The pool to query.
+/// @return Number of processes that can be claimed without starting a new one.
+[[gnu::TEK_INJ_API]]
+uint32_t tek_inj_pool_available(tek_inj_pool *_Nonnull pool);
+
+/// Destroy the pool, waiting for pending background refills and terminating
+///    all unclaimed processes. Must not be called concurrently with
+///    @ref tek_inj_pool_claim.
+///
+/// @param [in] pool
+///    The pool to destroy.
+[[gnu::TEK_INJ_API]]
+void tek_inj_pool_destroy(tek_inj_pool *_Nonnull pool);
+
+/// Create a context that caches state of the calling process used by every
+///    launch: elevation state, and, if the process is elevated, the token
+///    for starting game processes without elevation and security attributes
+///    for their file mappings. Results of image validation requested with
+///    @ref TEK_INJ_FLAG_check_images are cached in it as well, and it tracks
+///    settings mappings shared via @ref TEK_INJ_FLAG_shared_payload. The
+///    context may be used by multiple launches from multiple threads
+///    concurrently.
+///    Changes to the calling process token made after the context is created
+///    are not picked up.
+///
+/// @param [out] result
+///    Address of a variable that receives the result code.
+/// @param [out] win32_error
+///    Address of a variable that receives Win32 error code if an error
+///    occurs.
+/// @return Context that must be destroyed with @ref tek_inj_ctx_destroy after
+///    all launches that use it complete, or `nullptr` on failure.
+[[gnu::TEK_INJ_API]]
+tek_inj_ctx *_Nullable tek_inj_ctx_create(tek_inj_res *_Nonnull result,
+                                          DWORD *_Nonnull win32_error);
+
+/// Destroy a context created by @ref tek_inj_ctx_create.
+///
+/// @param [in] ctx
+///    The context to destroy.
+[[gnu::TEK_INJ_API]]
+void tek_inj_ctx_destroy(tek_inj_ctx *_Nonnull ctx);
+
+#endif // def TEK_INJ_WIN32
+
+/// Validate TEK Game Runtime settings JSON and convert it into compact binary
+///    encoding for @ref TEK_GR_LOAD_TYPE_bin, which the runtime can load
+///    without parsing JSON. The encoding is described in src/settings.hpp.
+///
+/// @param [in] json
+///    Pointer to settings JSON text.
+/// @param json_size
+///    Size of @p json, in bytes.
+/// @param [out] buf
+///    Pointer to the buffer that receives encoded settings. May be `nullptr`
+///    if @p buf_size is 0.
+/// @param buf_size
+///    Size of @p buf, in bytes. If it's smaller than encoded settings size,
+///    only the first @p buf_size bytes are written.
+/// @param [out] size
+///    Address of a variable that receives the size of encoded settings in
+///    bytes if JSON is valid, or offset of the first invalid byte in @p json
+///    otherwise.
+/// @return Value indicating whether @p json is valid.
+[[gnu::TEK_INJ_API]]
+bool tek_inj_encode_settings(const char *_Nonnull json, size_t json_size,
+                             char *_Nullable buf, size_t buf_size,
+                             size_t *_Nonnull size);
+
+/// Compress settings encoded by @ref tek_inj_encode_settings with LZ4, so
+///    large settings take less memory in every game process. The runtime
+///    detects compressed encoding by its first 4 bytes.
+///
+/// @param [in] data
+///    Pointer to encoded settings.
+/// @param size
+///    Size of @p data, in bytes.
+/// @param [out] buf
+///    Pointer to the buffer that receives compressed settings, must have
+///    space for at least @p size bytes.
+/// @return Size of compressed settings in bytes, or 0 if compression doesn't
+///    make them smaller, in which case @p data should be passed as is.
+[[gnu::TEK_INJ_API]]
+size_t tek_inj_compress_settings(const char *_Nonnull data, size_t size,
+                                 char *_Nonnull buf);
+
+#ifdef TEK_INJ_WIN32
+
+/// Get accounting counters of a job object returned via
+///    @ref tek_inj_game_args::job.
+///
+/// @param [in] job
+///    Handle to the job object, with `JOB_OBJECT_QUERY` access right.
+/// @param [out] stats
+///    Address of a variable that receives the counters.
+/// @return Value indicating whether the counters have been retrieved. If they
+///    haven't, call `GetLastError` for the reason.
+[[gnu::TEK_INJ_API]]
+bool tek_inj_job_query(HANDLE _Nonnull job, tek_inj_job_stats *_Nonnull stats);
+
+/// Inject TEK Game Runtime into an already running process.
+/// Unlike @ref tek_inj_run_game, the process keeps running during injection,
+///    and it's not terminated if injection fails.
+/// The function doesn't use any global state and may be called from multiple
+///    threads concurrently.
+///
+/// @param [in, out] args
+///    Input/output arguments for the function.
+[[gnu::TEK_INJ_API]]
+void tek_inj_attach(tek_inj_attach_args *_Nonnull args);
+
+#endif // def TEK_INJ_WIN32
+
+#ifdef TEK_INJ_LINUX
+
+/// Start game process and load TEK Game Runtime into it.
+/// Game process is started as a child of the calling process, with the
+///    runtime preloaded by the dynamic linker via `LD_PRELOAD`, so it's
+///    loaded before the first instruction of the executable runs. The
+///    settings payload is passed via the descriptor named by
+///    @ref TEK_INJ_PAYLOAD_FD_ENV. The process is held between `fork` and
+///    `execve` until it's placed, so the executable never runs outside of its
+///    placement.
+/// Result codes have the following meaning: @ref TEK_INJ_RES_create_mapping
+///    and @ref TEK_INJ_RES_map_view for failures to create or map the memfd,
+///    @ref TEK_INJ_RES_create_process for failures to fork or execute the
+///    executable, @ref TEK_INJ_RES_placement for failures to apply CPU
+///    affinity or I/O priority, @ref TEK_INJ_RES_job for failures to create
+///    the cgroup, set its limits or move the process into it, in which case
+///    the cgroup is removed, @ref TEK_INJ_RES_resume_thread for failures
+///    to release the process, and @ref TEK_INJ_RES_dll_load for shared
+///    objects that can't be read or can't be put into `LD_PRELOAD`.
+/// Upon success, the caller must reap the process with `waitpid`. The function
+///    doesn't use any global state other than cumulative launch statistics,
+///    and may be called from multiple threads concurrently.
+///
+/// @param [in, out] args
+///    Input/output arguments for the function.
+[[gnu::TEK_INJ_API]]
+void tek_inj_linux_run_game(tek_inj_linux_game_args *_Nonnull args);
+
+/// Get accounting counters of a cgroup returned via
+///    @ref tek_inj_linux_game_args::cgroup_fd.
+/// CPU times are read from `cpu.stat`, peak memory from `memory.peak`, I/O
+///    byte counts from `io.stat`, page faults from `memory.stat`, and the
+///    number of active processes from `cgroup.procs`.
+///
+/// @param cgroup_fd
+///    Descriptor of the cgroup directory.
+/// @param [out] stats
+///    Address of a variable that receives the counters.
+/// @return Value indicating whether the counters have been retrieved. If they
+///    haven't, `errno` is set to the reason.
+[[gnu::TEK_INJ_API]]
+bool tek_inj_linux_job_query(int cgroup_fd,
+                             tek_inj_job_stats *_Nonnull stats);
+
+/// Inject TEK Game Runtime into an already running process via ptrace.
+/// The main thread of the process is stopped only to allocate memory for a
+///    loader routine and to redirect the thread to it, then it's detached and
+///    calls `dlopen` for each shared object, restoring all of its registers
+///    and resuming where it was interrupted afterwards. The payload is passed
+///    via the shared memory object named by @ref TEK_INJ_SHM_NAME_PREFIX.
+///    Only x86-64 is supported, and the process must use the same libc file
+///    as the calling process, glibc 2.34 or newer, where `dlopen` is a part
+///    of libc.
+/// Result codes have the following meaning: @ref TEK_INJ_RES_open_process for
+///    failures to find or stop the process, @ref TEK_INJ_RES_dll_load for
+///    shared objects that can't be read or fail to load,
+///    @ref TEK_INJ_RES_create_mapping and @ref TEK_INJ_RES_map_view for
+///    failures to create or map the shared memory object,
+///    @ref TEK_INJ_RES_create_thread for failures to find `dlopen` in the
+///    process or to redirect its main thread, @ref TEK_INJ_RES_mem_alloc,
+///    @ref TEK_INJ_RES_mem_write and @ref TEK_INJ_RES_mem_protect for failures
+///    to set up the routine in process memory, and
+///    @ref TEK_INJ_RES_thread_wait for failures to wait for the routine to
+///    finish.
+/// Like @ref tek_inj_attach, the process is not terminated if injection
+///    fails. The calling process must be allowed to trace it, and nothing
+///    else may be tracing it. The function doesn't use any global state and
+///    may be called from multiple threads concurrently.
+///
+/// @param [in, out] args
+///    Input/output arguments for the function.
+[[gnu::TEK_INJ_API]]
+void tek_inj_linux_attach(tek_inj_linux_attach_args *_Nonnull args);
+
+#endif // def TEK_INJ_LINUX
+
+/// Get cumulative statistics of game launches made by the calling process via
+///    @ref tek_inj_run_game, @ref tek_inj_game_commit,
+///    @ref tek_inj_run_game_async, @ref tek_inj_game_commit_async and
+///    @ref tek_inj_pool_claim, or @ref tek_inj_linux_run_game on Linux,
+///    including ones that failed before injection.
+///    Injections via @ref tek_inj_attach and @ref tek_inj_linux_attach are
+///    not counted.
+/// Statistics are recorded upon completion of every launch with atomic
+///    counter updates, without locks. Counters are read individually, so a
+///    snapshot taken while launches complete may include a launch in some of
+///    them only.
+/// May be called from multiple threads concurrently.
+///
+/// @param [out] metrics
+///    Address of a variable that receives the statistics.
+/// @param reset
+///    Value indicating whether to reset the statistics to zero. Every counter
+///    is read and reset atomically, so launches completing concurrently are
+///    counted either in this snapshot or after it, never lost.
+[[gnu::TEK_INJ_API]]
+void tek_inj_metrics_snapshot(tek_inj_metrics *_Nonnull metrics, bool reset);
+
 #ifdef __cplusplus
 } // extern "C"
 #endif // def __cplusplus
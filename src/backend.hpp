@@ -0,0 +1,245 @@
+//===-- backend.hpp - Platform backend interface --------------------------===//
+//
+// Copyright (c) 2025 Nuclearist <nuclearist@teknology-hub.com>
+// Part of tek-injector, under the GNU General Public License v3.0 or later
+// See https://github.com/teknology-hub/tek-injector/blob/main/COPYING for
+//    license information.
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+//===----------------------------------------------------------------------===//
+///
+/// @file
+///  Declarations of the interface between the portable launch pipeline and
+///    platform backends, and implementation of the pipeline: payload
+///    construction, sequencing of backend operations, waiting for TEK Game
+///    Runtime readiness, timings and result reporting.
+///  A backend implements only the operations that need OS-specific code:
+///    creating payload storage that game process can read, starting the
+///    process held before its first instruction, placing it, releasing it
+///    with the runtime loaded, and waiting for status updates of the runtime.
+///
+//===----------------------------------------------------------------------===//
+#pragma once
+
+#include "tek-injector.h"
+
+#include "metrics.hpp"
+#include "payload.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <type_traits>
+
+namespace tek_inj::backend {
+
+/// Requirements for a platform backend driven by @ref run. A backend object
+///    is created for a single launch and owns its payload storage and game
+///    process. Operations that return `bool` report failures via
+///    @p Backend::report.
+///
+/// Members:
+///  - `args_type`: type of input/output arguments of the launch, with
+///    `flags`, `type`, `data`, `data_size`, `inject_timeout`, `timings`,
+///    `result`, `pid`, `runtime_message` and `prefetched_bytes` fields.
+///  - `frequency`: frequency of timestamps returned by `now()`, in counts per
+///    second.
+///  - `timeout_error`: error code to report for timeouts.
+///  - `now()`: get current timestamp of the clock that TEK Game Runtime uses
+///    for @ref payload::status_block::times.
+///  - `report(args, result, error)`: set result fields of the arguments.
+///  - `start_prefetch(args)`: start reading files of the launch into the file
+///    system cache on worker threads. Failures are ignored.
+///  - `finish_prefetch(args)`: wait for reading started by `start_prefetch`
+///    to complete, and set `args.prefetched_bytes`. Returns the timestamp
+///    when reading completed.
+///  - `create_payload(size, args)`: create writable storage for the payload
+///    of @p size bytes, aligned for its header. Returns `nullptr` on failure.
+///  - `spawn(args)`: make the payload, which is fully written by then,
+///    available to a new game process, and start the process held before the
+///    first instruction of its executable. Sets `args.pid`.
+///  - `place(args)`: apply placement of the held process.
+///  - `resume(args)`: release the process, so it runs with TEK Game Runtime
+///    loaded before the first instruction of its executable.
+///  - `wait_status(word, value, deadline)`: wait until @p word, which is in
+///    payload storage, may have changed from @p value, or until @p deadline
+///    timestamp. Returns `false` if the deadline has passed.
+///  - `terminate()`: terminate game process, if it has been started.
+template <typename Backend>
+concept platform = requires(Backend &backend,
+                            typename Backend::args_type &args,
+                            std::uint64_t size, const std::uint32_t &word,
+                            std::uint32_t value, std::int64_t deadline) {
+  { Backend::frequency } -> std::convertible_to<std::int64_t>;
+  { Backend::timeout_error } -> std::convertible_to<int>;
+  { Backend::now() } noexcept -> std::same_as<std::int64_t>;
+  { Backend::report(args, TEK_INJ_RES_ok, 0) } noexcept;
+  { backend.start_prefetch(args) };
+  { backend.finish_prefetch(args) } noexcept -> std::same_as<std::int64_t>;
+  { backend.create_payload(size, args) } -> std::same_as<void *>;
+  { backend.spawn(args) } -> std::same_as<bool>;
+  { backend.place(args) } -> std::same_as<bool>;
+  { backend.resume(args) } -> std::same_as<bool>;
+  { backend.wait_status(word, value, deadline) } -> std::same_as<bool>;
+  { backend.terminate() } noexcept;
+};
+
+/// Wait for TEK Game Runtime to report readiness via the status block.
+///
+/// @param [in, out] backend
+///    Backend of the launch.
+/// @param [in, out] args
+///    Input/output arguments of the launch.
+/// @param [in, out] timings
+///    Timestamps of launch phases, @ref TEK_INJ_PHASE_inject and
+///    @ref TEK_INJ_PHASE_runtime_init are recorded.
+/// @param [in, out] status
+///    The status block in payload storage.
+/// @param [out] timed_out
+///    Variable that is set to `true` if the runtime didn't report readiness
+///    in time.
+/// @return Value indicating whether the runtime is ready. If it isn't,
+///    @p args result fields are set.
+template <platform Backend>
+[[gnu::visibility("internal")]]
+bool wait_ready(Backend &backend, typename Backend::args_type &args,
+                tek_inj_timings &timings, payload::status_block &status,
+                bool &timed_out) {
+  using payload::state;
+  const std::atomic_ref status_state{status.state};
+  const std::int64_t timeout{args.inject_timeout ? args.inject_timeout : 3000};
+  const auto deadline{timings.start[TEK_INJ_PHASE_inject] +
+                      timeout * Backend::frequency / 1000};
+  for (;;) {
+    const auto cur{status_state.load(std::memory_order::acquire)};
+    switch (static_cast<state>(cur)) {
+    case state::ready: {
+      // The runtime's own timestamps exclude the time it took to notice its
+      //    status updates
+      const auto now{Backend::now()};
+      const auto &times{status.times};
+      const auto loaded_time{times[static_cast<int>(state::loaded)]};
+      const auto ready_time{times[static_cast<int>(state::ready)]};
+      timings.end[TEK_INJ_PHASE_inject] = loaded_time ? loaded_time : now;
+      timings.start[TEK_INJ_PHASE_runtime_init] =
+          loaded_time ? loaded_time : timings.start[TEK_INJ_PHASE_inject];
+      timings.end[TEK_INJ_PHASE_runtime_init] = ready_time ? ready_time : now;
+      return true;
+    }
+    case state::failed: {
+      Backend::report(args, TEK_INJ_RES_runtime_init,
+                      static_cast<int>(status.error));
+      // The message is written by another process, so don't rely on it being
+      //    null-terminated
+      static_assert(std::extent_v<decltype(args.runtime_message)> ==
+                    payload::max_message_len);
+      const auto len{std::min<std::size_t>(
+          std::ranges::find(status.message, u'\0') - status.message,
+          payload::max_message_len - 1)};
+      *std::copy_n(status.message, len, args.runtime_message) = u'\0';
+      return false;
+    }
+    default:
+      break;
+    }
+    if (!backend.wait_status(status.state, cur, deadline)) {
+      Backend::report(args, TEK_INJ_RES_runtime_init, Backend::timeout_error);
+      timed_out = true;
+      return false;
+    }
+  }
+}
+
+/// Run the launch pipeline: write the payload, start game process held,
+///    place it, release it with TEK Game Runtime loaded, and optionally wait
+///    for the runtime to report readiness.
+///
+/// @param [in, out] backend
+///    Backend of the launch.
+/// @param [in, out] args
+///    Input/output arguments of the launch.
+/// @param [in, out] timings
+///    Zero-initialized timestamps of launch phases.
+/// @param [out] timed_out
+///    Variable that is set to `true` if the launch failed because of a
+///    timeout.
+/// @return Value indicating whether the launch succeeded. If it didn't,
+///    @p args result fields are set.
+template <platform Backend>
+[[gnu::visibility("internal")]]
+bool run_phases(Backend &backend, typename Backend::args_type &args,
+                tek_inj_timings &timings, bool &timed_out) {
+  const std::string_view data{args.data ? args.data : "",
+                              args.data ? args.data_size : 0};
+  const std::uint32_t flags{
+      (args.flags & TEK_INJ_FLAG_wait_ready) ? payload::flag_status : 0};
+  const bool prefetch{(args.flags & TEK_INJ_FLAG_prefetch) != 0};
+  if (prefetch) {
+    // Reading overlaps payload setup and process creation
+    timings.start[TEK_INJ_PHASE_prefetch] = Backend::now();
+    backend.start_prefetch(args);
+  }
+  timings.start[TEK_INJ_PHASE_mapping] = Backend::now();
+  const auto buf{backend.create_payload(payload::size(data.size(), flags),
+                                        args)};
+  if (!buf) {
+    return false;
+  }
+  std::ranges::copy(data,
+                    payload::write_header(buf, args.type, data.size(), flags));
+  timings.end[TEK_INJ_PHASE_mapping] = Backend::now();
+  timings.start[TEK_INJ_PHASE_create_process] = Backend::now();
+  if (!backend.spawn(args) || !backend.place(args)) {
+    return false;
+  }
+  timings.end[TEK_INJ_PHASE_create_process] = Backend::now();
+  if (prefetch) {
+    // The runtime and the game would otherwise block on reading the same
+    //    files
+    timings.end[TEK_INJ_PHASE_prefetch] = backend.finish_prefetch(args);
+  }
+  timings.start[TEK_INJ_PHASE_resume] = Backend::now();
+  if (!backend.resume(args)) {
+    return false;
+  }
+  timings.end[TEK_INJ_PHASE_resume] = Backend::now();
+  if (!flags) {
+    return true;
+  }
+  // The runtime is loaded while the process is released, so injection starts
+  //    along with the resume phase
+  timings.start[TEK_INJ_PHASE_inject] = timings.start[TEK_INJ_PHASE_resume];
+  return wait_ready(backend, args, timings, *payload::get_status(buf),
+                    timed_out);
+}
+
+/// Launch game process via a backend and record the outcome.
+///
+/// @param [in, out] backend
+///    Backend of the launch.
+/// @param [in, out] args
+///    Input/output arguments of the launch. Result fields are set upon
+///    return.
+/// @param [in, out] reg
+///    Registry to record the outcome of the launch in.
+template <platform Backend>
+[[gnu::visibility("internal")]]
+void run(Backend &backend, typename Backend::args_type &args,
+         metrics::registry &reg) {
+  tek_inj_timings local_timings;
+  auto &timings{args.timings ? *args.timings : local_timings};
+  timings = {.frequency = Backend::frequency, .start{}, .end{}};
+  args.pid = 0;
+  args.prefetched_bytes = 0;
+  Backend::report(args, TEK_INJ_RES_ok, 0);
+  bool timed_out{};
+  if (!run_phases(backend, args, timings, timed_out)) {
+    backend.terminate();
+  }
+  metrics::record(reg, timings, args.result, timed_out, Backend::now());
+}
+
+} // namespace tek_inj::backend
@@ -0,0 +1,204 @@
+//===-- cmd_line.hpp - Command line quoting -------------------------------===//
+//
+// Copyright (c) 2025 Nuclearist <nuclearist@teknology-hub.com>
+// Part of tek-injector, under the GNU General Public License v3.0 or later
+// See https://github.com/teknology-hub/tek-injector/blob/main/COPYING for
+//    license information.
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+//===----------------------------------------------------------------------===//
+///
+/// @file
+///  Declarations and implementation of portable functions for building
+///    Windows command lines that `CommandLineToArgvW` splits back into the
+///    original arguments.
+///  The line is built in two passes over the arguments: the first one
+///    computes exact output length, the second one writes into a buffer of
+///    that length, so building it takes a single allocation.
+///
+//===----------------------------------------------------------------------===//
+#pragma once
+
+#include <cstddef>
+#include <span>
+#include <string_view>
+
+namespace tek_inj::cmd_line {
+
+/// Check whether an argument must be wrapped in quotes.
+///
+/// @param arg
+///    The argument to check.
+/// @return Value indicating whether @p arg is empty or contains whitespace or
+///    quote characters.
+template <typename Char>
+[[gnu::visibility("internal")]]
+constexpr bool needs_quotes(std::basic_string_view<Char> arg) noexcept {
+  if (arg.empty()) {
+    return true;
+  }
+  for (const auto ch : arg) {
+    switch (ch) {
+    case Char{' '}:
+    case Char{'\t'}:
+    case Char{'\n'}:
+    case Char{'\v'}:
+    case Char{'"'}:
+      return true;
+    default:
+      continue;
+    }
+  }
+  return false;
+}
+
+/// Get the number of characters that @ref write_arg will write for an
+///    argument.
+///
+/// @param arg
+///    The argument to measure.
+/// @return Length of quoted @p arg, in characters.
+template <typename Char>
+[[gnu::visibility("internal")]]
+constexpr std::size_t arg_len(std::basic_string_view<Char> arg) noexcept {
+  if (!needs_quotes(arg)) {
+    return arg.length();
+  }
+  // Every quote is preceded by a backslash, and every run of backslashes
+  //    before a quote (including the closing one) is doubled
+  std::size_t len{arg.length() + 2};
+  std::size_t num_backslashes{};
+  for (const auto ch : arg) {
+    if (ch == Char{'\\'}) {
+      ++num_backslashes;
+    } else {
+      if (ch == Char{'"'}) {
+        len += num_backslashes + 1;
+      }
+      num_backslashes = 0;
+    }
+  }
+  return len + num_backslashes;
+}
+
+/// Write an argument, quoting and escaping it if necessary.
+///
+/// @param arg
+///    The argument to write.
+/// @param [out] out
+///    Pointer to the buffer that receives the argument. Must have space for at
+///    least @ref arg_len characters.
+/// @return Pointer to the character past the last written one.
+template <typename Char>
+[[gnu::visibility("internal")]]
+constexpr Char *write_arg(std::basic_string_view<Char> arg,
+                          Char *out) noexcept {
+  if (!needs_quotes(arg)) {
+    return arg.copy(out, arg.length()) + out;
+  }
+  *out++ = Char{'"'};
+  std::size_t num_backslashes{};
+  for (const auto ch : arg) {
+    if (ch == Char{'\\'}) {
+      ++num_backslashes;
+    } else {
+      if (ch == Char{'"'}) {
+        // Escape the preceding backslashes and the quote itself
+        for (++num_backslashes; num_backslashes; --num_backslashes) {
+          *out++ = Char{'\\'};
+        }
+      }
+      num_backslashes = 0;
+    }
+    *out++ = ch;
+  }
+  // Escape trailing backslashes so they don't escape the closing quote
+  for (; num_backslashes; --num_backslashes) {
+    *out++ = Char{'\\'};
+  }
+  *out++ = Char{'"'};
+  return out;
+}
+
+/// Get the number of characters that @ref write_program will write for a
+///    program path.
+///
+/// @param path
+///    Path to the program executable.
+/// @return Length of quoted @p path, in characters.
+template <typename Char>
+[[gnu::visibility("internal")]]
+constexpr std::size_t program_len(std::basic_string_view<Char> path) noexcept {
+  return (path.empty() || path.find(Char{' '}) != path.npos ||
+          path.find(Char{'\t'}) != path.npos)
+             ? path.length() + 2
+             : path.length();
+}
+
+/// Write a program path as the first token of a command line.
+/// `CommandLineToArgvW` doesn't process escape sequences in the first token,
+///    and quotes can't appear in Windows paths anyway, so the path is only
+///    wrapped in quotes if it contains whitespace.
+///
+/// @param path
+///    Path to the program executable.
+/// @param [out] out
+///    Pointer to the buffer that receives the path. Must have space for at
+///    least @ref program_len characters.
+/// @return Pointer to the character past the last written one.
+template <typename Char>
+[[gnu::visibility("internal")]]
+constexpr Char *write_program(std::basic_string_view<Char> path,
+                              Char *out) noexcept {
+  if (program_len(path) == path.length()) {
+    return path.copy(out, path.length()) + out;
+  }
+  *out++ = Char{'"'};
+  out += path.copy(out, path.length());
+  *out++ = Char{'"'};
+  return out;
+}
+
+/// Get the length of full command line.
+///
+/// @param program
+///    Path to the program executable.
+/// @param args
+///    Null-terminated command-line arguments to pass to the program.
+/// @return Length of the command line, in characters, not including the null
+///    terminator.
+template <typename Char>
+[[gnu::visibility("internal")]]
+constexpr std::size_t length(std::basic_string_view<Char> program,
+                             std::span<const Char *const> args) noexcept {
+  auto len{program_len(program) + args.size()};
+  for (const auto arg : args) {
+    len += arg_len(std::basic_string_view<Char>{arg});
+  }
+  return len;
+}
+
+/// Write full command line.
+///
+/// @param program
+///    Path to the program executable.
+/// @param args
+///    Null-terminated command-line arguments to pass to the program.
+/// @param [out] out
+///    Pointer to the buffer that receives the command line. Must have space
+///    for at least @ref length characters.
+/// @return Pointer to the character past the last written one. The line is
+///    not null-terminated.
+template <typename Char>
+[[gnu::visibility("internal")]]
+constexpr Char *write(std::basic_string_view<Char> program,
+                      std::span<const Char *const> args, Char *out) noexcept {
+  out = write_program(program, out);
+  for (const auto arg : args) {
+    *out++ = Char{' '};
+    out = write_arg(std::basic_string_view<Char>{arg}, out);
+  }
+  return out;
+}
+
+} // namespace tek_inj::cmd_line
@@ -0,0 +1,132 @@
+//===-- cpu_set.hpp - CPU set parsing -------------------------------------===//
+//
+// Copyright (c) 2025 Nuclearist <nuclearist@teknology-hub.com>
+// Part of tek-injector, under the GNU General Public License v3.0 or later
+// See https://github.com/teknology-hub/tek-injector/blob/main/COPYING for
+//    license information.
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+//===----------------------------------------------------------------------===//
+///
+/// @file
+///  Declarations and implementation of portable functions for parsing CPU set
+///    specifications into processor group number and group-relative affinity
+///    mask.
+///  A specification is an optional processor group number followed by a
+///    colon, and either a hexadecimal mask with "0x" prefix, or a
+///    comma-separated list of CPU numbers and inclusive ranges of them, e.g.
+///    "0x0F", "0-3,8" or "1:0-15".
+///
+//===----------------------------------------------------------------------===//
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace tek_inj::cpu_set {
+
+/// Maximum number of CPUs in a processor group.
+inline constexpr unsigned max_cpus{64};
+
+/// Parsed CPU set.
+struct result {
+  /// Processor group number.
+  std::uint16_t group;
+  /// Affinity mask relative to @ref group.
+  std::uint64_t mask;
+};
+
+/// Parse an unsigned number from the beginning of a string.
+///
+/// @param [in, out] str
+///    The string to parse, the number is removed from its beginning.
+/// @param base
+///    Base of the number, 10 or 16.
+/// @param max
+///    Maximum allowed value.
+/// @param [out] value
+///    Variable that receives the number.
+/// @return Value indicating whether @p str starts with a valid number not
+///    exceeding @p max.
+template <typename Char>
+[[gnu::visibility("internal")]]
+constexpr bool parse_num(std::basic_string_view<Char> &str, unsigned base,
+                         std::uint64_t max, std::uint64_t &value) noexcept {
+  value = 0;
+  std::size_t i{};
+  for (; i < str.length(); ++i) {
+    const auto ch{str[i]};
+    unsigned digit;
+    if (ch >= Char{'0'} && ch <= Char{'9'}) {
+      digit = static_cast<unsigned>(ch - Char{'0'});
+    } else if (base == 16 && ch >= Char{'a'} && ch <= Char{'f'}) {
+      digit = static_cast<unsigned>(ch - Char{'a'} + 10);
+    } else if (base == 16 && ch >= Char{'A'} && ch <= Char{'F'}) {
+      digit = static_cast<unsigned>(ch - Char{'A'} + 10);
+    } else {
+      break;
+    }
+    if (value > (max - digit) / base) {
+      return false;
+    }
+    value = value * base + digit;
+  }
+  str.remove_prefix(i);
+  return i > 0;
+}
+
+/// Parse a CPU set specification.
+///
+/// @param str
+///    The specification to parse.
+/// @param [out] res
+///    Variable that receives the parsed CPU set.
+/// @return Value indicating whether @p str is a valid specification of a
+///    non-empty CPU set.
+template <typename Char>
+[[gnu::visibility("internal")]]
+constexpr bool parse(std::basic_string_view<Char> str, result &res) noexcept {
+  res = {};
+  if (const auto colon{str.find(Char{':'})};
+      colon != std::basic_string_view<Char>::npos) {
+    auto group_str{str.substr(0, colon)};
+    std::uint64_t group;
+    if (!parse_num(group_str, 10, UINT16_MAX, group) || !group_str.empty()) {
+      return false;
+    }
+    res.group = static_cast<std::uint16_t>(group);
+    str.remove_prefix(colon + 1);
+  }
+  if (str.length() > 2 && str[0] == Char{'0'} &&
+      (str[1] == Char{'x'} || str[1] == Char{'X'})) {
+    str.remove_prefix(2);
+    return parse_num(str, 16, UINT64_MAX, res.mask) && str.empty() &&
+           res.mask;
+  }
+  for (;;) {
+    std::uint64_t first;
+    if (!parse_num(str, 10, max_cpus - 1, first)) {
+      return false;
+    }
+    auto last{first};
+    if (!str.empty() && str[0] == Char{'-'}) {
+      str.remove_prefix(1);
+      if (!parse_num(str, 10, max_cpus - 1, last) || last < first) {
+        return false;
+      }
+    }
+    for (auto cpu{first}; cpu <= last; ++cpu) {
+      res.mask |= std::uint64_t{1} << cpu;
+    }
+    if (str.empty()) {
+      return true;
+    }
+    if (str[0] != Char{','}) {
+      return false;
+    }
+    str.remove_prefix(1);
+  }
+}
+
+} // namespace tek_inj::cpu_set
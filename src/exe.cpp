@@ -14,17 +14,28 @@
 //===----------------------------------------------------------------------===//
 #include "tek-injector.h"
 
+#include "cmd_line.hpp"
+#include "cpu_set.hpp"
+#include "profile.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <comdef.h>
 #include <concepts>
 #include <cstddef>
+#include <cstdint>
 #include <cstdlib>
 #include <filesystem>
 #include <format>
+#include <fstream>
 #include <memory>
+#include <mutex>
 #include <shobjidl.h>
 #include <span>
 #include <string>
 #include <string_view>
+#include <thread>
 #include <utility>
 #include <vector>
 
@@ -69,10 +80,6 @@ static constexpr tek_inj_flag &operator|=(tek_inj_flag &left,
                                           static_cast<int>(right));
 }
 
-static inline void display_error(LPCWSTR msg) {
-  MessageBoxW(nullptr, msg, L"TEK Injector", MB_OK | MB_ICONERROR);
-}
-
 static inline std::unique_ptr<WCHAR, decltype(&LocalFree)>
 get_os_err_msg(DWORD err) {
   LPWSTR msg{nullptr};
@@ -82,50 +89,1577 @@ get_os_err_msg(DWORD err) {
   return {msg, LocalFree};
 }
 
-} // namespace
+/// Convert a UTF-16 string to UTF-8.
+static std::string to_utf8(std::wstring_view str) {
+  std::string res(WideCharToMultiByte(CP_UTF8, 0, str.data(), str.length(),
+                                      nullptr, 0, nullptr, nullptr),
+                  '\0');
+  WideCharToMultiByte(CP_UTF8, 0, str.data(), str.length(), res.data(),
+                      res.size(), nullptr, nullptr);
+  return res;
+}
 
-int wmain(int argc, wchar_t *argv[]) {
+/// How the program reports its results.
+struct [[gnu::visibility("internal")]] output_opts {
+  /// Value indicating whether the program must never show any UI.
+  bool headless;
+  /// Value indicating whether results should be written to standard output
+  ///    as JSON.
+  bool json_stdout;
+  /// Path to the file to write results to as JSON, empty if none.
+  std::wstring json_path;
+  /// Value indicating whether JSON documents are appended to
+  ///    @ref json_path instead of replacing its content.
+  bool json_append;
+  /// Path to the file to write cumulative launch statistics to in Prometheus
+  ///    text format, empty if none.
+  std::wstring metrics_path;
+
+  /// Check whether results are written as JSON anywhere.
+  constexpr bool json() const noexcept {
+    return json_stdout || !json_path.empty();
+  }
+};
+
+/// Output options, set from the command line before anything is reported.
+output_opts output;
+
+/// Restart counters of @ref supervise, reported in metrics and JSON output.
+struct [[gnu::visibility("internal")]] restart_counters {
+  /// Value indicating whether the game is supervised, so the counters are
+  ///    reported.
+  bool supervised;
+  /// Number of times the game has been relaunched after exiting abnormally,
+  ///    including failed relaunches.
+  std::uint64_t restarts;
+  /// Number of relaunches that failed.
+  std::uint64_t failed_restarts;
+};
+
+/// Restart counters, updated by @ref supervise.
+restart_counters supervision;
+
+/// Output handle of parent's console, opened on first use and closed at
+///    exit.
+struct [[gnu::visibility("internal")]] console_output {
+  HANDLE handle;
+  console_output() noexcept {
+    AttachConsole(ATTACH_PARENT_PROCESS);
+    handle = CreateFileW(L"CONOUT$", GENERIC_WRITE, FILE_SHARE_WRITE, nullptr,
+                         OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  }
+  ~console_output() noexcept {
+    if (handle != INVALID_HANDLE_VALUE) {
+      CloseHandle(handle);
+    }
+  }
+};
+
+/// Get a standard handle of the program. tek-injector.exe is a GUI program,
+///    so it has them only if the parent process provides them, e.g. as pipes.
+///    Otherwise, parent's console is attached to, if it has one, and its
+///    output handle is shared by both standard handles.
+///
+/// @param std_handle
+///    `STD_OUTPUT_HANDLE` or `STD_ERROR_HANDLE`.
+/// @return The handle, or `INVALID_HANDLE_VALUE` if there is none.
+static HANDLE get_std_handle(DWORD std_handle) {
+  const auto handle{GetStdHandle(std_handle)};
+  if (handle && handle != INVALID_HANDLE_VALUE) {
+    return handle;
+  }
+  static const console_output console;
+  return console.handle;
+}
+
+/// Write text to a standard handle of the program.
+///
+/// @param std_handle
+///    `STD_OUTPUT_HANDLE` or `STD_ERROR_HANDLE`.
+/// @param text
+///    UTF-8 text to write.
+static void write_std(DWORD std_handle, std::string_view text) {
+  const auto handle{get_std_handle(std_handle)};
+  if (handle == INVALID_HANDLE_VALUE) {
+    return;
+  }
+  while (!text.empty()) {
+    DWORD written;
+    if (!WriteFile(handle, text.data(), static_cast<DWORD>(text.length()),
+                   &written, nullptr)) {
+      return;
+    }
+    text.remove_prefix(written);
+  }
+}
+
+/// Append a UTF-8 string to JSON text as a JSON string literal.
+///
+/// @param [in, out] json
+///    The JSON text to append to.
+/// @param str
+///    The string to append.
+static void append_json_string(std::string &json, std::string_view str) {
+  json += '"';
+  for (const auto ch : str) {
+    switch (ch) {
+    case '"':
+      json += R"(\")";
+      break;
+    case '\\':
+      json += R"(\\)";
+      break;
+    default:
+      if (static_cast<unsigned char>(ch) < 0x20) {
+        json += std::format(R"(\u{:04x})", static_cast<unsigned>(ch));
+      } else {
+        json += ch;
+      }
+    }
+  }
+  json += '"';
+}
+
+/// Append a UTF-16 string to JSON text as a JSON string literal.
+///
+/// @param [in, out] json
+///    The JSON text to append to.
+/// @param str
+///    The string to append, or `nullptr` to append JSON null.
+static void append_json_string(std::string &json, LPCWSTR _Nullable str) {
+  if (str) {
+    append_json_string(json, to_utf8(str));
+  } else {
+    json += "null";
+  }
+}
+
+/// Write a JSON document to the destinations requested on the command line,
+///    followed by a newline, so every document is a single line.
+///
+/// @param json
+///    The JSON document to write.
+static void write_json(std::string json) {
+  json += '\n';
+  if (output.json_stdout) {
+    write_std(STD_OUTPUT_HANDLE, json);
+  }
+  if (!output.json_path.empty()) {
+    std::ofstream{std::filesystem::path{output.json_path},
+                  output.json_append ? std::ios::binary | std::ios::app
+                                     : std::ios::binary}
+        << json;
+  }
+}
+
+/// Report an error that is not a launch result. In headless mode, it's
+///    written as JSON if requested, or to standard error otherwise, instead
+///    of being displayed in a message box.
+///
+/// @param msg
+///    The message to report.
+static void display_error(LPCWSTR msg) {
+  if (!output.headless) {
+    MessageBoxW(nullptr, msg, L"TEK Injector", MB_OK | MB_ICONERROR);
+  } else if (output.json()) {
+    std::string json{R"({"result":null,"message":)"};
+    append_json_string(json, msg);
+    json += '}';
+    write_json(std::move(json));
+  } else {
+    write_std(STD_ERROR_HANDLE, to_utf8(msg) + '\n');
+  }
+}
+
+/// Build settings data to pass to TEK Game Runtime.
+///
+/// @param settings_path
+///    Path to the settings file specified on the command line, may be empty.
+/// @param current_dir
+///    Current directory of the game process, relative settings paths are
+///    resolved against it.
+/// @param binary
+///    Value indicating whether settings file should be validated and passed
+///    in binary encoding instead of passing its path.
+/// @param compress
+///    Value indicating whether binary encoding should be compressed if that
+///    makes it smaller.
+/// @param [out] type
+///    Variable that receives settings loading type.
+/// @param [out] data
+///    Variable that receives settings data.
+/// @return Value indicating whether the operation succeeded. If it didn't,
+///    the error is displayed.
+static bool prepare_settings(const std::wstring &settings_path,
+                             const std::wstring &current_dir, bool binary,
+                             bool compress, tek_gr_load_type &type,
+                             std::string &data) {
+  if (!binary) {
+    type = TEK_GR_LOAD_TYPE_file_path;
+    data = to_utf8(settings_path);
+    return true;
+  }
+  const auto path{std::filesystem::path{current_dir} /
+                  (settings_path.empty() ? L"tek-gr-settings.json"
+                                         : settings_path)};
+  std::ifstream file{path, std::ios::binary | std::ios::ate};
+  if (!file) {
+    display_error(
+        std::format(L"Failed to open settings file {}", path.wstring())
+            .data());
+    return false;
+  }
+  std::string json(static_cast<std::size_t>(file.tellg()), '\0');
+  file.seekg(0);
+  if (!file.read(json.data(), json.size())) {
+    display_error(
+        std::format(L"Failed to read settings file {}", path.wstring())
+            .data());
+    return false;
+  }
+  // Validate and encode settings before any game process is created
+  std::size_t size;
+  if (!tek_inj_encode_settings(json.data(), json.size(), nullptr, 0, &size)) {
+    display_error(std::format(L"Settings file {} is not valid JSON, error at "
+                              L"byte offset {}",
+                              path.wstring(), size)
+                      .data());
+    return false;
+  }
+  data.resize(size);
+  tek_inj_encode_settings(json.data(), json.size(), data.data(), size, &size);
+  if (compress) {
+    std::string compressed(size, '\0');
+    compressed.resize(
+        tek_inj_compress_settings(data.data(), size, compressed.data()));
+    if (!compressed.empty()) {
+      data = std::move(compressed);
+    }
+  }
+  type = TEK_GR_LOAD_TYPE_bin;
+  return true;
+}
+
+/// Functions that libtek-game-runtime.dll must export, checked with
+///    `--ti-check-images`.
+constexpr std::array<const char *, 1> required_exports{"tek_gr_init"};
+
+/// Names of launch phases, indexed by @ref tek_inj_phase.
+constexpr std::array<std::string_view, TEK_INJ_PHASE_count> phase_names{
+    "image_check", "prefetch", "token",        "create_process", "mapping",
+    "remote_write", "inject",  "runtime_init", "resume"};
+
+/// Get the timestamp that launch phase times are reported relative to, which
+///    is the start of the first phase of the launch.
+///
+/// @param timings
+///    Timings of the launch.
+/// @return The timestamp.
+static std::int64_t timings_origin(const tek_inj_timings &timings) {
+  std::int64_t origin{};
+  for (const auto start : timings.start) {
+    if (start && (!origin || start < origin)) {
+      origin = start;
+    }
+  }
+  return origin;
+}
+
+/// Write launch phase timings to a file in Chrome trace event format.
+///
+/// @param path
+///    Path to the file to write.
+/// @param args
+///    Arguments of the launch, with timings set.
+static void write_trace(const std::wstring &path,
+                        const tek_inj_game_args &args) {
+  const auto &timings{*args.timings};
+  std::ofstream file{std::filesystem::path{path}};
+  if (!file) {
+    display_error(std::format(L"Failed to open trace file {}", path).data());
+    return;
+  }
+  // Timestamps are written in microseconds since the start of the launch
+  const auto origin{timings_origin(timings)};
+  const auto to_us{[&timings, origin](std::int64_t counter) {
+    return static_cast<double>(counter - origin) * 1'000'000 /
+           static_cast<double>(timings.frequency);
+  }};
+  const auto pid{GetCurrentProcessId()};
+  const auto tid{GetCurrentThreadId()};
+  file << R"({"displayTimeUnit":"ms","traceEvents":[)";
+  bool first{true};
+  for (int i{}; i < TEK_INJ_PHASE_count; ++i) {
+    const auto start{timings.start[i]};
+    if (!start) {
+      continue;
+    }
+    // A phase that has been started but not completed is the one that failed
+    const auto end{timings.end[i]};
+    // Prefetch runs on thread pool threads concurrently with other phases,
+    //    so it's put on a separate track
+    const bool prefetch{i == TEK_INJ_PHASE_prefetch};
+    file << std::format(
+        R"({}{{"name":"{}","cat":"launch","ph":"X","pid":{},"tid":{},)"
+        R"("ts":{:.3f},"dur":{:.3f},"args":{{"completed":{}{}}}}})",
+        first ? "" : ",", phase_names[i], pid, prefetch ? 0 : tid, to_us(start),
+        end ? to_us(end) - to_us(start) : 0.0, end ? "true" : "false",
+        prefetch ? std::format(R"(,"bytes":{})", args.prefetched_bytes)
+                 : std::string{});
+    first = false;
+  }
+  file << "]}\n";
+}
+
+/// Display an error message followed by the description of last Win32 error.
+///
+/// @param msg
+///    The message to display.
+static void display_last_error(std::wstring_view msg) {
+  const auto err{GetLastError()};
+  display_error(
+      std::format(L"{}: ({}) {}", msg, err, get_os_err_msg(err).get()).data());
+}
+
+/// Append a histogram in Prometheus text format.
+///
+/// @param [in, out] text
+///    The text to append to.
+/// @param name
+///    Name of the metric.
+/// @param labels
+///    Labels of the histogram, or empty.
+/// @param hist
+///    The histogram to append.
+static void append_histogram(std::string &text, std::string_view name,
+                             std::string_view labels,
+                             const tek_inj_histogram &hist) {
+  const auto bucket_labels{labels.empty() ? std::string{}
+                                          : std::format("{},", labels)};
+  const auto sum_labels{labels.empty() ? std::string{}
+                                       : std::format("{{{}}}", labels)};
+  std::uint64_t count{};
+  for (int i{}; i < TEK_INJ_HISTOGRAM_NUM_BUCKETS; ++i) {
+    count += hist.buckets[i];
+    // Upper bound of bucket N is 100 << N microseconds, the last one has none
+    const auto bound{i < TEK_INJ_HISTOGRAM_NUM_BUCKETS - 1
+                         ? std::format("{}", (100ull << i) / 1'000'000.0)
+                         : std::string{"+Inf"}};
+    text += std::format("{}_bucket{{{}le=\"{}\"}} {}\n", name, bucket_labels,
+                        bound, count);
+  }
+  text += std::format("{}_sum{} {}\n{}_count{} {}\n", name, sum_labels,
+                      static_cast<double>(hist.sum) / 1'000'000, name,
+                      sum_labels, count);
+}
+
+/// Write cumulative statistics of launches made by the program to
+///    @ref output_opts::metrics_path in Prometheus text format, if requested.
+///    The file is replaced atomically, so collectors never read a partially
+///    written one.
+static void write_metrics() {
+  if (output.metrics_path.empty()) {
+    return;
+  }
+  tek_inj_metrics metrics;
+  tek_inj_metrics_snapshot(&metrics, false);
+  std::string text{
+      "# HELP tek_inj_launches_total Game launches completed.\n"
+      "# TYPE tek_inj_launches_total counter\n"};
+  text += std::format("tek_inj_launches_total {}\n", metrics.launches);
+  text += "# HELP tek_inj_launch_results_total Game launches completed with "
+          "each result code.\n"
+          "# TYPE tek_inj_launch_results_total counter\n";
+  for (int i{}; i < TEK_INJ_RES_count; ++i) {
+    text += std::format("tek_inj_launch_results_total{{code=\"{}\"}} {}\n", i,
+                        metrics.results[i]);
+  }
+  text += "# HELP tek_inj_launch_timeouts_total Game launches that failed "
+          "because of a timeout.\n"
+          "# TYPE tek_inj_launch_timeouts_total counter\n";
+  text += std::format("tek_inj_launch_timeouts_total {}\n", metrics.timeouts);
+  text += "# HELP tek_inj_phase_duration_seconds Durations of game launch "
+          "phases.\n"
+          "# TYPE tek_inj_phase_duration_seconds histogram\n";
+  for (int i{}; i < TEK_INJ_PHASE_count; ++i) {
+    append_histogram(text, "tek_inj_phase_duration_seconds",
+                     std::format("phase=\"{}\"", phase_names[i]),
+                     metrics.phases[i]);
+  }
+  text += "# HELP tek_inj_launch_duration_seconds Total durations of game "
+          "launches.\n"
+          "# TYPE tek_inj_launch_duration_seconds histogram\n";
+  append_histogram(text, "tek_inj_launch_duration_seconds", {},
+                   metrics.total);
+  if (supervision.supervised) {
+    text += "# HELP tek_inj_restarts_total Relaunches of the supervised game "
+            "after abnormal exits.\n"
+            "# TYPE tek_inj_restarts_total counter\n";
+    text += std::format("tek_inj_restarts_total {}\n", supervision.restarts);
+    text += "# HELP tek_inj_failed_restarts_total Relaunches of the "
+            "supervised game that failed.\n"
+            "# TYPE tek_inj_failed_restarts_total counter\n";
+    text += std::format("tek_inj_failed_restarts_total {}\n",
+                        supervision.failed_restarts);
+  }
+  const auto tmp_path{output.metrics_path + L".tmp"};
+  {
+    std::ofstream file{std::filesystem::path{tmp_path}, std::ios::binary};
+    if (!file) {
+      display_error(
+          std::format(L"Failed to open metrics file {}", tmp_path).data());
+      return;
+    }
+    file << text;
+  }
+  if (!MoveFileExW(tmp_path.data(), output.metrics_path.data(),
+                   MOVEFILE_REPLACE_EXISTING)) {
+    display_last_error(std::format(L"Failed to replace metrics file {}",
+                                   output.metrics_path));
+  }
+}
+
+/// Compile prepared launch arguments into a profile file.
+///
+/// @param path
+///    Path to the profile file to write.
+/// @param args
+///    Prepared launch arguments.
+/// @return Value indicating whether the operation succeeded. If it didn't,
+///    the error is displayed.
+static bool save_profile(const std::wstring &path,
+                         const tek_inj_game_args &args) {
+  const std::span argv{args.argv, static_cast<std::size_t>(args.argc)};
+  std::wstring command_line(
+      tek_inj::cmd_line::length<WCHAR>(args.exe_path, argv), L'\0');
+  tek_inj::cmd_line::write<WCHAR>(args.exe_path, argv, command_line.data());
+  const tek_inj::profile::contents contents{
+      .flags = static_cast<std::uint32_t>(args.flags),
+      .type = args.type,
+      .inject_timeout = args.inject_timeout,
+      .strategy = static_cast<std::uint32_t>(args.strategy),
+      .processor_group = args.processor_group,
+      .numa_node = args.numa_node,
+      .affinity_mask = args.affinity_mask,
+      .job_memory_limit =
+          args.job_limits ? args.job_limits->memory_limit : 0,
+      .job_cpu_rate = args.job_limits ? args.job_limits->cpu_rate : 0,
+      .job_max_processes =
+          args.job_limits ? args.job_limits->max_processes : 0,
+      .memory_priority = static_cast<std::uint16_t>(args.memory_priority),
+      .io_priority = static_cast<std::uint16_t>(args.io_priority),
+      .exe_path = args.exe_path,
+      .current_dir = args.current_dir,
+      .dll_path = args.dll_path,
+      .command_line = command_line,
+      .extra_dll_paths = {args.extra_dll_paths, args.num_extra_dlls},
+      .prefetch_paths = {args.prefetch_paths, args.num_prefetch_paths},
+      .data = {args.data, args.data_size}};
+  const auto size{tek_inj::profile::size(contents)};
+  const auto buf{std::make_unique_for_overwrite<char[]>(size)};
+  tek_inj::profile::write(buf.get(), contents);
+  std::ofstream file{std::filesystem::path{path}, std::ios::binary};
+  if (!file || !file.write(buf.get(), size)) {
+    display_error(std::format(L"Failed to write profile {}", path).data());
+    return false;
+  }
+  return true;
+}
+
+/// Check whether any job object limit is set.
+///
+/// @param job_limits
+///    The limits to check.
+/// @return Value indicating whether the game should be placed into a job.
+static constexpr bool has_job_limits(const tek_inj_job_limits &job_limits) {
+  return job_limits.memory_limit || job_limits.cpu_rate ||
+         job_limits.max_processes;
+}
+
+/// Load launch arguments from a profile file.
+///
+/// @param path
+///    Path to the profile file.
+/// @param [out] args
+///    Variable that receives launch arguments. They point into the mapped
+///    profile, which stays mapped until the program exits.
+/// @param [out] extra_dll_paths
+///    Variable that receives the array of extra DLL paths pointed to by
+///    @p args.
+/// @param [out] prefetch_paths
+///    Variable that receives the array of prefetch paths pointed to by
+///    @p args.
+/// @param [out] job_limits
+///    Variable that receives job object limits, pointed to by @p args if any
+///    of them is set.
+/// @return Value indicating whether the operation succeeded. If it didn't,
+///    the error is displayed.
+static bool load_profile(const std::wstring &path, tek_inj_game_args &args,
+                         std::vector<LPCWSTR> &extra_dll_paths,
+                         std::vector<LPCWSTR> &prefetch_paths,
+                         tek_inj_job_limits &job_limits) {
+  const auto file{CreateFileW(path.data(), GENERIC_READ, FILE_SHARE_READ,
+                              nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL,
+                              nullptr)};
+  if (file == INVALID_HANDLE_VALUE) {
+    display_last_error(std::format(L"Failed to open profile {}", path));
+    return false;
+  }
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(file, &size)) {
+    display_last_error(std::format(L"Failed to get size of profile {}", path));
+    CloseHandle(file);
+    return false;
+  }
+  const auto mapping{
+      CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr)};
+  CloseHandle(file);
+  if (!mapping) {
+    display_last_error(std::format(L"Failed to map profile {}", path));
+    return false;
+  }
+  // The view is never unmapped, since launch arguments point into it
+  const auto view{MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0)};
+  CloseHandle(mapping);
+  if (!view) {
+    display_last_error(std::format(L"Failed to map profile {}", path));
+    return false;
+  }
+  const auto hdr{tek_inj::profile::validate(
+      {static_cast<const char *>(view),
+       static_cast<std::size_t>(size.QuadPart)})};
+  if (!hdr) {
+    display_error(
+        std::format(L"{} is not a valid launch profile", path).data());
+    return false;
+  }
+  const auto str{[hdr](tek_inj::profile::string_ref ref) {
+    return tek_inj::profile::string(*hdr, ref);
+  }};
+  for (const auto ref : tek_inj::profile::extra_dlls(*hdr)) {
+    extra_dll_paths.emplace_back(str(ref));
+  }
+  for (const auto ref : tek_inj::profile::prefetch_paths(*hdr)) {
+    prefetch_paths.emplace_back(str(ref));
+  }
+  const auto data{tek_inj::profile::data(*hdr)};
+  job_limits = {.memory_limit = hdr->job_memory_limit,
+                .cpu_rate = hdr->job_cpu_rate,
+                .max_processes = hdr->job_max_processes};
+  args = {.exe_path = str(hdr->exe_path),
+          .current_dir = str(hdr->current_dir),
+          .dll_path = str(hdr->dll_path),
+          .type = static_cast<tek_gr_load_type>(hdr->type),
+          .argc = 0,
+          .argv = nullptr,
+          .flags = static_cast<tek_inj_flag>(hdr->flags),
+          .data_size = static_cast<std::uint32_t>(data.size()),
+          .data = data.data(),
+          .result = TEK_INJ_RES_ok,
+          .win32_error = 0,
+          .ctx = nullptr,
+          .extra_dll_paths = extra_dll_paths.data(),
+          .num_extra_dlls = hdr->num_extra_dlls,
+          .required_exports = required_exports.data(),
+          .num_required_exports =
+              static_cast<std::uint32_t>(required_exports.size()),
+          .prefetch_paths = prefetch_paths.data(),
+          .num_prefetch_paths = hdr->num_prefetch_paths,
+          .command_line = str(hdr->command_line),
+          .affinity_mask = hdr->affinity_mask,
+          .processor_group = hdr->processor_group,
+          .numa_node = hdr->numa_node,
+          .memory_priority = hdr->memory_priority,
+          .io_priority = static_cast<tek_inj_io_priority>(hdr->io_priority),
+          .job_limits = has_job_limits(job_limits) ? &job_limits : nullptr,
+          .strategy = static_cast<tek_inj_strategy>(hdr->strategy),
+          .inject_timeout = hdr->inject_timeout,
+          .arena = nullptr,
+          .arena_size = 0,
+          .timings = nullptr,
+          .prefetched_bytes = 0,
+          .pid = 0,
+          .tid = 0,
+          .failed_dll = 0,
+          .runtime_message = {},
+          .process = nullptr,
+          .job = nullptr};
+  return true;
+}
+
+/// Get the message for injection result.
+///
+/// @param args
+///    Arguments of the injection function, with result fields set.
+/// @return The message, empty if the injection succeeded.
+template <typename Args>
+static std::wstring result_message(const Args &args) {
+  const auto result{args.result};
+  const auto win32_error{args.win32_error};
+  std::wstring msg;
+  switch (result) {
+  case TEK_INJ_RES_ok:
+    return {};
+  case TEK_INJ_RES_get_token_info:
+    msg = L"Failed to get process token information";
+    break;
+  case TEK_INJ_RES_open_token:
+    msg = L"Failed to open current process token";
+    break;
+  case TEK_INJ_RES_duplicate_token:
+    msg = L"Failed to duplicate process token";
+    break;
+  case TEK_INJ_RES_set_token_info:
+    msg = L"Failed to set token information";
+    break;
+  case TEK_INJ_RES_create_process:
+    msg = L"Failed to create game process";
+    break;
+  case TEK_INJ_RES_mem_alloc:
+    msg = L"Failed to allocate memory in game process";
+    break;
+  case TEK_INJ_RES_mem_write:
+    msg = L"Failed to write to game process memory";
+    break;
+  case TEK_INJ_RES_sec_desc:
+    msg = L"Failed to setup security descriptor for the pipe";
+    break;
+  case TEK_INJ_RES_create_mapping:
+    msg = L"Failed to create file mapping";
+    break;
+  case TEK_INJ_RES_map_view:
+    msg = L"Failed to map view of the file mapping";
+    break;
+  case TEK_INJ_RES_create_thread:
+    msg = L"Failed to create injection thread";
+    break;
+  case TEK_INJ_RES_thread_wait:
+    if constexpr (std::same_as<Args, tek_inj_game_args>) {
+      if (args.strategy != TEK_INJ_STRATEGY_remote_thread) {
+        msg = L"Failed to wait for game's main thread to load the DLLs";
+        break;
+      }
+    }
+    msg = L"Failed to wait for injection thread to finish";
+    break;
+  case TEK_INJ_RES_dll_load:
+    msg = args.failed_dll
+              ? std::format(L"{} failed to load",
+                            args.extra_dll_paths[args.failed_dll - 1])
+              : L"TEK Game Runtime failed to load";
+    break;
+  case TEK_INJ_RES_resume_thread:
+    msg = L"Failed to resume game's main thread";
+    break;
+  case TEK_INJ_RES_open_process:
+    msg = L"Failed to open the process to attach to";
+    break;
+  case TEK_INJ_RES_mem_protect:
+    msg = L"Failed to change protection of game process memory";
+    break;
+  case TEK_INJ_RES_arena_size:
+    msg = L"Arena buffer is too small";
+    break;
+  case TEK_INJ_RES_status_event:
+    msg = L"Failed to create event for TEK Game Runtime status reports";
+    break;
+  case TEK_INJ_RES_runtime_init:
+    msg = L"TEK Game Runtime failed to initialize";
+    if constexpr (requires { args.runtime_message; }) {
+      if (args.runtime_message[0]) {
+        msg = std::format(L"{}: {}", msg, args.runtime_message);
+      }
+    }
+    break;
+  case TEK_INJ_RES_placement:
+    msg = L"Failed to apply processor affinity, NUMA node, memory or I/O "
+          L"priority to game process";
+    break;
+  case TEK_INJ_RES_job:
+    msg = L"Failed to place game process into a job object";
+    break;
+  case TEK_INJ_RES_image_open:
+  case TEK_INJ_RES_image_invalid:
+  case TEK_INJ_RES_image_machine:
+  case TEK_INJ_RES_image_export: {
+    const std::wstring_view image{
+        args.failed_dll == UINT32_MAX ? std::wstring_view{L"Game executable"}
+        : args.failed_dll ? args.extra_dll_paths[args.failed_dll - 1]
+                          : args.dll_path};
+    switch (result) {
+    case TEK_INJ_RES_image_open:
+      msg = std::format(L"Failed to read {}", image);
+      break;
+    case TEK_INJ_RES_image_invalid:
+      msg = std::format(L"{} is not a valid image", image);
+      break;
+    case TEK_INJ_RES_image_machine:
+      msg = std::format(L"{} is not a 64-bit image", image);
+      break;
+    default:
+      msg = std::format(L"{} doesn't export required functions", image);
+    }
+    break;
+  }
+  case TEK_INJ_RES_shared_payload:
+    msg = L"Failed to share settings data with game process";
+    break;
+  case TEK_INJ_RES_main_thread:
+    msg = L"Failed to set up loading DLLs on game's main thread";
+    break;
+  default:
+    msg = std::format(L"Unknown result code {}", static_cast<int>(result));
+    break;
+  }
+  if (win32_error) {
+    msg = std::format(L"{}: ({}) {}", msg, win32_error,
+                      get_os_err_msg(win32_error).get());
+  }
+  return msg;
+}
+
+/// Build the JSON document describing injection result.
+///
+/// @param args
+///    Arguments of the injection function, with result fields set.
+/// @param msg
+///    Message for the result, from @ref result_message.
+/// @return The JSON document.
+template <typename Args>
+static std::string result_json(const Args &args, std::wstring_view msg) {
+  std::string json{std::format(R"({{"result":{},"win32_error":{},"message":)",
+                               static_cast<int>(args.result),
+                               args.win32_error)};
+  append_json_string(json, to_utf8(msg));
+  json += std::format(R"(,"failed_dll":{},"pid":{})", args.failed_dll,
+                      args.pid);
+  if constexpr (std::same_as<Args, tek_inj_game_args>) {
+    json += std::format(R"(,"tid":{},"exe_path":)", args.tid);
+    append_json_string(json, args.exe_path);
+    json += R"(,"current_dir":)";
+    append_json_string(json, args.current_dir);
+  }
+  json += R"(,"dll_path":)";
+  append_json_string(json, args.dll_path);
+  json += R"(,"extra_dll_paths":[)";
+  for (std::uint32_t i{}; i < args.num_extra_dlls; ++i) {
+    if (i) {
+      json += ',';
+    }
+    append_json_string(json, args.extra_dll_paths[i]);
+  }
+  json += ']';
+  if (args.type == TEK_GR_LOAD_TYPE_file_path) {
+    // The path is already UTF-8
+    json += R"(,"settings_path":)";
+    append_json_string(json, std::string_view{args.data, args.data_size});
+  }
+  if constexpr (std::same_as<Args, tek_inj_game_args>) {
+    json += std::format(R"(,"prefetched_bytes":{},"runtime_message":)",
+                        args.prefetched_bytes);
+    append_json_string(json, args.runtime_message);
+    if (supervision.supervised) {
+      json += std::format(R"(,"restarts":{},"failed_restarts":{})",
+                          supervision.restarts, supervision.failed_restarts);
+    }
+    if (args.timings) {
+      // Times are in microseconds since the start of the launch
+      const auto &timings{*args.timings};
+      const auto origin{timings_origin(timings)};
+      const auto to_us{[&timings, origin](std::int64_t counter) {
+        return static_cast<double>(counter - origin) * 1'000'000 /
+               static_cast<double>(timings.frequency);
+      }};
+      json += R"(,"phases":[)";
+      bool first{true};
+      for (int i{}; i < TEK_INJ_PHASE_count; ++i) {
+        const auto start{timings.start[i]};
+        if (!start) {
+          continue;
+        }
+        const auto end{timings.end[i]};
+        json += std::format(
+            R"({}{{"name":"{}","start_us":{:.3f},"duration_us":{:.3f},)"
+            R"("completed":{}}})",
+            first ? "" : ",", phase_names[i], to_us(start),
+            end ? to_us(end) - to_us(start) : 0.0, end ? "true" : "false");
+        first = false;
+      }
+      json += ']';
+    }
+  }
+  json += '}';
+  return json;
+}
+
+/// Report injection result: write it as JSON if requested, and display the
+///    message if it's an error.
+///
+/// @param args
+///    Arguments of the injection function, with result fields set.
+/// @return Exit code for the program.
+template <typename Args>
+static int report_result(const Args &args) {
+  const auto msg{result_message(args)};
+  if (output.json()) {
+    write_json(result_json(args, msg));
+  } else if (!msg.empty()) {
+    display_error(msg.data());
+  }
+  return args.result == TEK_INJ_RES_ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/// Minimum run time of the game, in milliseconds, for an abnormal exit not to
+///    be considered a part of a crash loop.
+constexpr ULONGLONG crash_loop_window{30000};
+/// Delay before the second consecutive restart in a crash loop, in
+///    milliseconds. It's doubled for every next one.
+constexpr DWORD base_restart_delay{500};
+/// Maximum delay between restarts in a crash loop, in milliseconds.
+constexpr DWORD max_restart_delay{30000};
+
+/// Launch context that is destroyed with @ref tek_inj_ctx_destroy.
+using unique_ctx = std::unique_ptr<tek_inj_ctx, decltype(&tek_inj_ctx_destroy)>;
+
+/// Create a launch context for multiple launches.
+///
+/// @return The context, or `nullptr` on failure, in which case the error is
+///    displayed.
+static unique_ctx create_ctx() {
+  tek_inj_res res;
+  DWORD error;
+  unique_ctx ctx{tek_inj_ctx_create(&res, &error), tek_inj_ctx_destroy};
+  if (!ctx) {
+    display_error(std::format(L"Failed to create launch context, result code "
+                              L"{}: ({}) {}",
+                              static_cast<int>(res), error,
+                              get_os_err_msg(error).get())
+                      .data());
+  }
+  return ctx;
+}
+
+/// Run the game and restart it whenever it exits abnormally. All arguments are
+///    prepared once, including the launch context and the command line, so a
+///    restart costs only process creation and injection.
+/// A failed relaunch is retried the same way as an abnormal exit, as it may
+///    be caused by the previous game process still holding resources. Only a
+///    failure of the first launch is reported right away.
+///
+/// @param [in, out] args
+///    Prepared launch arguments, with @ref TEK_INJ_FLAG_keep_process set.
+/// @param max_restarts
+///    Maximum number of consecutive restarts in a crash loop, 0 for no limit.
+/// @param trace_path
+///    Path to the file to write launch timings to after every launch, may be
+///    empty.
+/// @return Exit code for the program.
+static int supervise(tek_inj_game_args &args, unsigned max_restarts,
+                     const std::wstring &trace_path) {
+  // Elevation state and image validation results are reused by restarts
+  const auto ctx{create_ctx()};
+  if (!ctx) {
+    return EXIT_FAILURE;
+  }
+  args.ctx = ctx.get();
+  std::wstring command_line;
+  if (!args.command_line) {
+    const std::span argv{args.argv, static_cast<std::size_t>(args.argc)};
+    command_line.resize(tek_inj::cmd_line::length<WCHAR>(args.exe_path, argv));
+    tek_inj::cmd_line::write<WCHAR>(args.exe_path, argv, command_line.data());
+    args.command_line = command_line.data();
+  }
+  supervision.supervised = true;
+  unsigned num_loop_restarts{};
+  for (;;) {
+    tek_inj_run_game(&args);
+    if (!trace_path.empty()) {
+      write_trace(trace_path, args);
+    }
+    const bool launched{args.result == TEK_INJ_RES_ok};
+    if (!launched && supervision.restarts) {
+      ++supervision.failed_restarts;
+    }
+    write_metrics();
+    ULONGLONG run_time{};
+    DWORD exit_code{};
+    if (!launched) {
+      if (!supervision.restarts) {
+        return report_result(args);
+      }
+      // The failure is reported only when giving up, unless results are
+      //    written as JSON, so no message box blocks the restarts
+      if (output.json()) {
+        write_json(result_json(args, result_message(args)));
+      }
+    } else {
+      const auto start_time{GetTickCount64()};
+      WaitForSingleObject(args.process, INFINITE);
+      if (!GetExitCodeProcess(args.process, &exit_code)) {
+        exit_code = EXIT_FAILURE;
+      }
+      CloseHandle(args.process);
+      if (args.job_limits) {
+        CloseHandle(args.job);
+      }
+      if (exit_code == EXIT_SUCCESS) {
+        return EXIT_SUCCESS;
+      }
+      run_time = GetTickCount64() - start_time;
+    }
+    if (run_time >= crash_loop_window) {
+      num_loop_restarts = 0;
+    } else if (++num_loop_restarts > max_restarts && max_restarts) {
+      if (!launched) {
+        return report_result(args);
+      }
+      display_error(std::format(L"Game exited abnormally {} times in a row "
+                                L"(last exit code {:#x}), giving up after {} "
+                                L"restarts",
+                                num_loop_restarts, exit_code,
+                                supervision.restarts)
+                        .data());
+      return EXIT_FAILURE;
+    }
+    if (num_loop_restarts > 1) {
+      // Back off exponentially in a crash loop, the first restart is always
+      //    immediate
+      Sleep(std::min(base_restart_delay << std::min(num_loop_restarts - 2, 16u),
+                     max_restart_delay));
+    }
+    ++supervision.restarts;
+  } // for (;;)
+}
+
+/// Run the game with prepared launch arguments.
+///
+/// @param [in, out] args
+///    Prepared launch arguments.
+/// @param supervise_game
+///    Value indicating whether the game should be restarted when it exits
+///    abnormally, see @ref supervise.
+/// @param max_restarts
+///    Maximum number of consecutive restarts in a crash loop, 0 for no limit.
+/// @param trace_path
+///    Path to the file to write launch timings to, may be empty.
+/// @return Exit code for the program.
+static int run(tek_inj_game_args &args, bool supervise_game,
+               unsigned max_restarts, const std::wstring &trace_path) {
+  tek_inj_timings timings;
+  if (!trace_path.empty() || output.json()) {
+    args.timings = &timings;
+  }
+  if (supervise_game) {
+    args.flags |= TEK_INJ_FLAG_keep_process;
+    return supervise(args, max_restarts, trace_path);
+  }
+  tek_inj_run_game(&args);
+  if (!trace_path.empty()) {
+    write_trace(trace_path, args);
+  }
+  write_metrics();
+  return report_result(args);
+}
+
+/// Options of a single game launch, from the command line or a line of a
+///    manifest.
+struct [[gnu::visibility("internal")]] launch_opts {
+  /// Path to the game executable, empty to select it via a dialog.
   std::wstring exe_path;
+  /// Current directory for game process, empty for executable's parent
+  ///    directory.
   std::wstring current_dir;
+  /// Path to libtek-game-runtime.dll.
   std::wstring dll_path{L"libtek-game-runtime.dll"};
+  /// Command-line arguments for the game.
   std::vector<LPCWSTR> game_argv;
-  tek_inj_flag flags = TEK_INJ_FLAG_none;
-  std::string settings_path;
+  /// Paths to extra DLLs to inject.
+  std::vector<LPCWSTR> extra_dll_paths;
+  /// Paths to additional files to prefetch.
+  std::vector<LPCWSTR> prefetch_paths;
+  /// Injection flags.
+  tek_inj_flag flags{TEK_INJ_FLAG_none};
+  /// Path to the settings file, empty for the default one.
+  std::wstring settings_path;
+  /// Value indicating whether settings should be passed in binary encoding.
+  bool binary_settings{};
+  /// Value indicating whether binary encoding of settings should be
+  ///    compressed.
+  bool compress_settings{};
+  /// Time to wait for TEK Game Runtime DLL to load, in milliseconds.
+  std::uint32_t inject_timeout{};
+  /// Name of the technique for loading TEK Game Runtime DLLs in game process,
+  ///    empty for the default one.
+  std::wstring_view strategy_spec;
+  /// Technique for loading TEK Game Runtime DLLs in game process, set by
+  ///    @ref prepare_launch.
+  tek_inj_strategy strategy{TEK_INJ_STRATEGY_remote_thread};
+  /// CPU set specification for game process, empty for no restriction.
+  std::wstring_view affinity_spec;
+  /// Preferred NUMA node, used if @ref TEK_INJ_FLAG_numa_node is set.
+  std::uint16_t numa_node{};
+  /// Name of memory priority of game process, empty for the default one.
+  std::wstring_view memory_priority_spec;
+  /// Name of I/O priority of game process, empty for the default one.
+  std::wstring_view io_priority_spec;
+  /// Job object limits for game process.
+  tek_inj_job_limits job_limits{};
+  /// Parsed @ref affinity_spec, set by @ref prepare_launch.
+  tek_inj::cpu_set::result affinity{};
+  /// Memory priority of game process, set by @ref prepare_launch.
+  std::uint32_t memory_priority{};
+  /// I/O priority of game process, set by @ref prepare_launch.
+  tek_inj_io_priority io_priority{};
+  /// Settings loading type, set by @ref prepare_launch.
+  tek_gr_load_type type{};
+  /// Settings data, set by @ref prepare_launch.
+  std::string settings_data;
+};
+
+/// Parse a command-line option that applies to a single game launch.
+///
+/// @param [in, out] it
+///    Iterator pointing to the option, advanced to its value if it has one.
+/// @param end
+///    End iterator of the arguments.
+/// @param [in, out] opts
+///    Launch options to apply the option to.
+/// @return Value indicating whether the argument is a launch option.
+static bool parse_launch_option(std::span<wchar_t *const>::iterator &it,
+                                std::span<wchar_t *const>::iterator end,
+                                launch_opts &opts) {
+  const std::wstring_view view{*it};
+  if (view == L"--ti-exe-path") {
+    if (++it < end) {
+      opts.exe_path = *it;
+    }
+  } else if (view == L"--ti-current-dir") {
+    if (++it < end) {
+      opts.current_dir = *it;
+    }
+  } else if (view == L"--ti-dll-path") {
+    if (++it < end) {
+      opts.dll_path = *it;
+    }
+  } else if (view == L"--ti-extra-dll") {
+    if (++it < end) {
+      opts.extra_dll_paths.emplace_back(*it);
+    }
+  } else if (view == L"--ti-inject-timeout") {
+    if (++it < end) {
+      opts.inject_timeout = std::wcstoul(*it, nullptr, 10);
+    }
+  } else if (view == L"--ti-inject-strategy") {
+    if (++it < end) {
+      opts.strategy_spec = *it;
+    }
+  } else if (view == L"--ti-high-priority") {
+    opts.flags |= TEK_INJ_FLAG_high_proc_prio;
+  } else if (view == L"--ti-run-as-admin") {
+    opts.flags |= TEK_INJ_FLAG_run_as_admin;
+  } else if (view == L"--ti-check-images") {
+    opts.flags |= TEK_INJ_FLAG_check_images;
+  } else if (view == L"--ti-prefetch") {
+    opts.flags |= TEK_INJ_FLAG_prefetch;
+  } else if (view == L"--ti-prefetch-file") {
+    if (++it < end) {
+      opts.prefetch_paths.emplace_back(*it);
+      opts.flags |= TEK_INJ_FLAG_prefetch;
+    }
+  } else if (view == L"--ti-wait-ready") {
+    opts.flags |= TEK_INJ_FLAG_wait_ready;
+  } else if (view == L"--ti-affinity") {
+    if (++it < end) {
+      opts.affinity_spec = *it;
+    }
+  } else if (view == L"--ti-memory-limit") {
+    if (++it < end) {
+      opts.job_limits.memory_limit = std::wcstoull(*it, nullptr, 10) << 20;
+    }
+  } else if (view == L"--ti-cpu-rate") {
+    if (++it < end) {
+      opts.job_limits.cpu_rate = static_cast<std::uint32_t>(
+          std::clamp(std::wcstod(*it, nullptr), 0.0, 100.0) * 100);
+    }
+  } else if (view == L"--ti-max-processes") {
+    if (++it < end) {
+      opts.job_limits.max_processes = std::wcstoul(*it, nullptr, 10);
+    }
+  } else if (view == L"--ti-numa-node") {
+    if (++it < end) {
+      opts.numa_node =
+          static_cast<std::uint16_t>(std::wcstoul(*it, nullptr, 10));
+      opts.flags |= TEK_INJ_FLAG_numa_node;
+    }
+  } else if (view == L"--ti-memory-priority") {
+    if (++it < end) {
+      opts.memory_priority_spec = *it;
+    }
+  } else if (view == L"--ti-io-priority") {
+    if (++it < end) {
+      opts.io_priority_spec = *it;
+    }
+  } else if (view == L"--ti-settings-path") {
+    if (++it < end) {
+      opts.settings_path = *it;
+    }
+  } else if (view == L"--ti-binary-settings") {
+    opts.binary_settings = true;
+  } else if (view == L"--ti-compress-settings") {
+    opts.binary_settings = true;
+    opts.compress_settings = true;
+  } else if (view == L"--ti-shared-settings") {
+    opts.flags |= TEK_INJ_FLAG_shared_payload;
+  } else if (view == L"--ti-legacy-mapping-name") {
+    opts.flags |= TEK_INJ_FLAG_legacy_mapping_name;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+/// Resolve paths and prepare settings of a game launch, and build its
+///    arguments.
+///
+/// @param [in, out] opts
+///    Options of the launch, with non-empty @ref launch_opts::exe_path. The
+///    arguments point into them.
+/// @param [out] args
+///    Variable that receives launch arguments.
+/// @return Value indicating whether the operation succeeded. If it didn't,
+///    the error is displayed.
+static bool prepare_launch(launch_opts &opts, tek_inj_game_args &args) {
+  if (!opts.affinity_spec.empty() &&
+      !tek_inj::cpu_set::parse(opts.affinity_spec, opts.affinity)) {
+    display_error(
+        std::format(L"Invalid CPU set specification {}", opts.affinity_spec)
+            .data());
+    return false;
+  }
+  if (opts.strategy_spec.empty() || opts.strategy_spec == L"thread") {
+    opts.strategy = TEK_INJ_STRATEGY_remote_thread;
+  } else if (opts.strategy_spec == L"apc") {
+    opts.strategy = TEK_INJ_STRATEGY_apc;
+  } else if (opts.strategy_spec == L"entry") {
+    opts.strategy = TEK_INJ_STRATEGY_entry_trampoline;
+  } else {
+    display_error(std::format(L"Invalid injection strategy {}, expected "
+                              L"thread, apc or entry",
+                              opts.strategy_spec)
+                      .data());
+    return false;
+  }
+  if (opts.memory_priority_spec.empty()) {
+    opts.memory_priority = 0;
+  } else if (opts.memory_priority_spec == L"very-low") {
+    opts.memory_priority = MEMORY_PRIORITY_VERY_LOW;
+  } else if (opts.memory_priority_spec == L"low") {
+    opts.memory_priority = MEMORY_PRIORITY_LOW;
+  } else if (opts.memory_priority_spec == L"medium") {
+    opts.memory_priority = MEMORY_PRIORITY_MEDIUM;
+  } else if (opts.memory_priority_spec == L"below-normal") {
+    opts.memory_priority = MEMORY_PRIORITY_BELOW_NORMAL;
+  } else if (opts.memory_priority_spec == L"normal") {
+    opts.memory_priority = MEMORY_PRIORITY_NORMAL;
+  } else {
+    display_error(std::format(L"Invalid memory priority {}, expected "
+                              L"very-low, low, medium, below-normal or normal",
+                              opts.memory_priority_spec)
+                      .data());
+    return false;
+  }
+  if (opts.io_priority_spec.empty()) {
+    opts.io_priority = TEK_INJ_IO_PRIORITY_default;
+  } else if (opts.io_priority_spec == L"very-low") {
+    opts.io_priority = TEK_INJ_IO_PRIORITY_very_low;
+  } else if (opts.io_priority_spec == L"low") {
+    opts.io_priority = TEK_INJ_IO_PRIORITY_low;
+  } else if (opts.io_priority_spec == L"normal") {
+    opts.io_priority = TEK_INJ_IO_PRIORITY_normal;
+  } else {
+    display_error(std::format(L"Invalid I/O priority {}, expected very-low, "
+                              L"low or normal",
+                              opts.io_priority_spec)
+                      .data());
+    return false;
+  }
+  // Convert the executable path to absolute
+  const auto abs_path_len{
+      GetFullPathNameW(opts.exe_path.data(), 0, nullptr, nullptr)};
+  if (!abs_path_len) {
+    display_error(std::format(L"Failed to get full executable path: {}",
+                              get_os_err_msg(GetLastError()).get())
+                      .data());
+    return false;
+  }
+  std::wstring abs_path(abs_path_len - 1, L'\0');
+  GetFullPathNameW(opts.exe_path.data(), abs_path_len, abs_path.data(),
+                   nullptr);
+  opts.exe_path = std::move(abs_path);
+  if (opts.current_dir.empty()) {
+    // Set executable's parent directory as current
+    opts.current_dir = std::filesystem::path{opts.exe_path}.parent_path();
+  }
+  if (!prepare_settings(opts.settings_path, opts.current_dir,
+                        opts.binary_settings, opts.compress_settings,
+                        opts.type, opts.settings_data)) {
+    return false;
+  }
+  args = {.exe_path = opts.exe_path.data(),
+          .current_dir = opts.current_dir.data(),
+          .dll_path = opts.dll_path.data(),
+          .type = opts.type,
+          .argc = static_cast<int>(opts.game_argv.size()),
+          .argv = opts.game_argv.data(),
+          .flags = opts.flags,
+          .data_size = static_cast<std::uint32_t>(opts.settings_data.length()),
+          .data = opts.settings_data.data(),
+          .result = TEK_INJ_RES_ok,
+          .win32_error = 0,
+          .ctx = nullptr,
+          .extra_dll_paths = opts.extra_dll_paths.data(),
+          .num_extra_dlls =
+              static_cast<std::uint32_t>(opts.extra_dll_paths.size()),
+          .required_exports = required_exports.data(),
+          .num_required_exports =
+              static_cast<std::uint32_t>(required_exports.size()),
+          .prefetch_paths = opts.prefetch_paths.data(),
+          .num_prefetch_paths =
+              static_cast<std::uint32_t>(opts.prefetch_paths.size()),
+          .command_line = nullptr,
+          .affinity_mask = opts.affinity.mask,
+          .processor_group = opts.affinity.group,
+          .numa_node = opts.numa_node,
+          .memory_priority = opts.memory_priority,
+          .io_priority = opts.io_priority,
+          .job_limits =
+              has_job_limits(opts.job_limits) ? &opts.job_limits : nullptr,
+          .strategy = opts.strategy,
+          .inject_timeout = opts.inject_timeout,
+          .arena = nullptr,
+          .arena_size = 0,
+          .timings = nullptr,
+          .prefetched_bytes = 0,
+          .pid = 0,
+          .tid = 0,
+          .failed_dll = 0,
+          .runtime_message = {},
+          .process = nullptr,
+          .job = nullptr};
+  return true;
+}
+
+/// A game instance listed in a manifest.
+struct [[gnu::visibility("internal")]] manifest_instance {
+  /// Options of the instance.
+  launch_opts opts;
+  /// Arguments of the instance's launch.
+  tek_inj_game_args args;
+  /// Timings of the instance's launch, used only for JSON output.
+  tek_inj_timings timings;
+};
+
+/// Launch game instances listed in a manifest file with bounded parallelism.
+///    Every non-empty line of the manifest, except for ones starting with
+///    '#', lists launch options of an instance in command-line syntax, which
+///    are applied on top of the ones from the command line.
+///
+/// @param path
+///    Path to the manifest file.
+/// @param base
+///    Launch options from the command line.
+/// @param concurrency
+///    Maximum number of instances being launched at once, 0 for the number of
+///    logical processors.
+/// @param stagger
+///    Minimum interval between starts of consecutive launches, in
+///    milliseconds.
+/// @return Exit code for the program.
+static int run_manifest(const std::wstring &path, const launch_opts &base,
+                        unsigned concurrency, DWORD stagger) {
+  std::ifstream file{std::filesystem::path{path}, std::ios::binary};
+  if (!file) {
+    display_error(std::format(L"Failed to open manifest {}", path).data());
+    return EXIT_FAILURE;
+  }
+  // Argument arrays are kept alive, since launch options point into them
+  std::vector<std::unique_ptr<LPWSTR, decltype(&LocalFree)>> line_args;
+  std::vector<std::unique_ptr<manifest_instance>> instances;
+  std::string line;
+  for (unsigned line_num{1}; std::getline(file, line); ++line_num) {
+    if (line.ends_with('\r')) {
+      line.pop_back();
+    }
+    const auto first{line.find_first_not_of(" \t")};
+    if (first == std::string::npos || line[first] == '#') {
+      continue;
+    }
+    // CommandLineToArgvW parses the first argument as program name, which
+    //    has different quoting rules, so a placeholder one is prepended
+    const auto line_len{MultiByteToWideChar(CP_UTF8, 0, line.data(),
+                                            static_cast<int>(line.length()),
+                                            nullptr, 0)};
+    std::wstring wline(2 + line_len, L'\0');
+    wline[0] = L'x';
+    wline[1] = L' ';
+    MultiByteToWideChar(CP_UTF8, 0, line.data(),
+                        static_cast<int>(line.length()), wline.data() + 2,
+                        line_len);
+    int num_args;
+    auto &args{line_args.emplace_back(
+        CommandLineToArgvW(wline.data(), &num_args), LocalFree)};
+    if (!args) {
+      display_last_error(
+          std::format(L"Failed to parse line {} of manifest {}", line_num,
+                      path));
+      return EXIT_FAILURE;
+    }
+    auto &instance{
+        *instances.emplace_back(std::make_unique<manifest_instance>())};
+    instance.opts = base;
+    const std::span<wchar_t *const> arg_span{
+        args.get(), static_cast<std::size_t>(num_args)};
+    for (auto it{arg_span.begin() + 1}; it < arg_span.end(); ++it) {
+      if (parse_launch_option(it, arg_span.end(), instance.opts)) {
+        continue;
+      }
+      if (std::wstring_view{*it}.starts_with(L"--ti-")) {
+        display_error(std::format(L"Option {} is not supported in line {} of "
+                                  L"manifest {}",
+                                  *it, line_num, path)
+                          .data());
+        return EXIT_FAILURE;
+      }
+      instance.opts.game_argv.emplace_back(*it);
+    }
+    if (instance.opts.exe_path.empty()) {
+      display_error(std::format(L"Line {} of manifest {} doesn't specify "
+                                L"--ti-exe-path",
+                                line_num, path)
+                        .data());
+      return EXIT_FAILURE;
+    }
+    if (!prepare_launch(instance.opts, instance.args)) {
+      return EXIT_FAILURE;
+    }
+  }
+  if (instances.empty()) {
+    display_error(std::format(L"Manifest {} has no instances", path).data());
+    return EXIT_FAILURE;
+  }
+  // Elevation state and image validation results are shared by all launches
+  const auto ctx{create_ctx()};
+  if (!ctx) {
+    return EXIT_FAILURE;
+  }
+  for (auto &instance : instances) {
+    instance->args.ctx = ctx.get();
+    if (output.json()) {
+      instance->args.timings = &instance->timings;
+    }
+  }
+  if (!concurrency) {
+    concurrency = std::max(std::thread::hardware_concurrency(), 1u);
+  }
+  // Every worker takes the next instance, and waits for its start slot so
+  //    consecutive launches are at least stagger apart
+  std::atomic_size_t next{};
+  std::mutex report_mutex;
+  std::wstring failures;
+  unsigned num_failures{};
+  const auto start_time{GetTickCount64()};
+  const auto worker{[&] {
+    for (;;) {
+      const auto i{next.fetch_add(1, std::memory_order::relaxed)};
+      if (i >= instances.size()) {
+        return;
+      }
+      if (stagger) {
+        const auto slot{start_time + ULONGLONG{stagger} * i};
+        if (const auto now{GetTickCount64()}; now < slot) {
+          Sleep(static_cast<DWORD>(slot - now));
+        }
+      }
+      auto &args{instances[i]->args};
+      tek_inj_run_game(&args);
+      const auto msg{result_message(args)};
+      const std::scoped_lock lock{report_mutex};
+      if (output.json()) {
+        auto json{result_json(args, msg)};
+        json.insert(1, std::format(R"("instance":{},)", i));
+        write_json(std::move(json));
+      }
+      if (!msg.empty()) {
+        failures += std::format(L"\n#{} {}: {}", i, args.exe_path, msg);
+        ++num_failures;
+      }
+    }
+  }};
+  {
+    std::vector<std::jthread> workers;
+    const auto num_workers{
+        std::min<std::size_t>(concurrency, instances.size())};
+    workers.reserve(num_workers - 1);
+    for (std::size_t i{1}; i < num_workers; ++i) {
+      workers.emplace_back(worker);
+    }
+    worker();
+  }
+  write_metrics();
+  if (!num_failures) {
+    return EXIT_SUCCESS;
+  }
+  if (!output.json()) {
+    display_error(std::format(L"{} of {} instances failed to launch:{}",
+                              num_failures, instances.size(), failures)
+                      .data());
+  }
+  return EXIT_FAILURE;
+}
+
+} // namespace
+
+int wmain(int argc, wchar_t *argv[]) {
+  launch_opts opts;
+  DWORD attach_pid{};
+  bool supervise_game{};
+  unsigned max_restarts{10};
+  std::wstring trace_path;
+  std::wstring profile_path;
+  std::wstring save_profile_path;
+  std::wstring manifest_path;
+  unsigned concurrency{};
+  DWORD stagger{};
+  // First option or game argument that can't be combined with --ti-profile
+  std::wstring_view profile_conflict;
   // Scan command line
-  const std::span arg_span{argv, static_cast<std::size_t>(argc)};
+  const std::span<wchar_t *const> arg_span{argv,
+                                           static_cast<std::size_t>(argc)};
   for (auto it{arg_span.begin() + 1}; it < arg_span.end(); ++it) {
     const std::wstring_view view{*it};
-    if (view == L"--ti-exe-path") {
+    if (parse_launch_option(it, arg_span.end(), opts)) {
+      if (profile_conflict.empty()) {
+        profile_conflict = view;
+      }
+      continue;
+    }
+    if (profile_conflict.empty() &&
+        (view == L"--ti-attach-pid" || view == L"--ti-save-profile" ||
+         view == L"--ti-manifest" || view == L"--ti-concurrency" ||
+         view == L"--ti-stagger")) {
+      profile_conflict = view;
+    }
+    if (view == L"--ti-attach-pid") {
+      if (++it < arg_span.end()) {
+        attach_pid = std::wcstoul(*it, nullptr, 10);
+      }
+    } else if (view == L"--ti-trace") {
+      if (++it < arg_span.end()) {
+        trace_path = *it;
+      }
+    } else if (view == L"--ti-supervise") {
+      supervise_game = true;
+    } else if (view == L"--ti-max-restarts") {
+      if (++it < arg_span.end()) {
+        max_restarts = std::wcstoul(*it, nullptr, 10);
+      }
+    } else if (view == L"--ti-profile") {
       if (++it < arg_span.end()) {
-        exe_path = *it;
+        profile_path = *it;
       }
-    } else if (view == L"--ti-current-dir") {
+    } else if (view == L"--ti-save-profile") {
       if (++it < arg_span.end()) {
-        current_dir = *it;
+        save_profile_path = *it;
       }
-    } else if (view == L"--ti-dll-path") {
+    } else if (view == L"--ti-manifest") {
       if (++it < arg_span.end()) {
-        dll_path = *it;
+        manifest_path = *it;
       }
-    } else if (view == L"--ti-high-priority") {
-      flags |= TEK_INJ_FLAG_high_proc_prio;
-    } else if (view == L"--ti-run-as-admin") {
-      flags |= TEK_INJ_FLAG_run_as_admin;
-    } else if (view == L"--ti-settings-path") {
+    } else if (view == L"--ti-concurrency") {
       if (++it < arg_span.end()) {
-        const std::wstring_view path_view{*it};
-        settings_path.resize(WideCharToMultiByte(CP_UTF8, 0, path_view.data(),
-                                                 path_view.length(), nullptr, 0,
-                                                 nullptr, nullptr));
-        WideCharToMultiByte(CP_UTF8, 0, path_view.data(), path_view.length(),
-                            settings_path.data(), settings_path.size(), nullptr,
-                            nullptr);
+        concurrency = std::wcstoul(*it, nullptr, 10);
+      }
+    } else if (view == L"--ti-stagger") {
+      if (++it < arg_span.end()) {
+        stagger = std::wcstoul(*it, nullptr, 10);
+      }
+    } else if (view == L"--ti-headless") {
+      output.headless = true;
+    } else if (view == L"--ti-json") {
+      output.headless = true;
+      output.json_stdout = true;
+    } else if (view == L"--ti-json-file") {
+      if (++it < arg_span.end()) {
+        output.headless = true;
+        output.json_path = *it;
+      }
+    } else if (view == L"--ti-metrics-file") {
+      if (++it < arg_span.end()) {
+        output.metrics_path = *it;
       }
     } else {
-      game_argv.emplace_back(*it);
+      if (profile_conflict.empty()) {
+        profile_conflict = view;
+      }
+      opts.game_argv.emplace_back(*it);
     }
   } // for (auto it{arg_span.begin()}; it < arg_span.end(); ++it)
-  if (exe_path.empty()) {
+  if (!profile_path.empty()) {
+    // The profile already contains the complete launch configuration, so
+    //    anything else that would change it is rejected rather than ignored
+    if (!profile_conflict.empty()) {
+      display_error(
+          std::format(L"--ti-profile can't be combined with {} {}",
+                      profile_conflict.starts_with(L"--ti-") ? L"option"
+                                                             : L"game argument",
+                      profile_conflict)
+              .data());
+      return EXIT_FAILURE;
+    }
+    tek_inj_game_args args;
+    if (!load_profile(profile_path, args, opts.extra_dll_paths,
+                      opts.prefetch_paths, opts.job_limits)) {
+      return EXIT_FAILURE;
+    }
+    return run(args, supervise_game, max_restarts, trace_path);
+  }
+  if (!manifest_path.empty()) {
+    if (!output.json_path.empty()) {
+      // Results of all instances are collected in the file
+      std::ofstream{std::filesystem::path{output.json_path}};
+      output.json_append = true;
+    }
+    return run_manifest(manifest_path, opts, concurrency, stagger);
+  }
+  if (attach_pid) {
+    if (!prepare_settings(opts.settings_path, opts.current_dir,
+                          opts.binary_settings, opts.compress_settings,
+                          opts.type, opts.settings_data)) {
+      return EXIT_FAILURE;
+    }
+    tek_inj_attach_args args{
+        .ctx = nullptr,
+        .pid = attach_pid,
+        .dll_path = opts.dll_path.data(),
+        .extra_dll_paths = opts.extra_dll_paths.data(),
+        .num_extra_dlls =
+            static_cast<std::uint32_t>(opts.extra_dll_paths.size()),
+        .type = opts.type,
+        .data_size = static_cast<std::uint32_t>(opts.settings_data.length()),
+        .data = opts.settings_data.data(),
+        .inject_timeout = opts.inject_timeout,
+        .result = TEK_INJ_RES_ok,
+        .win32_error = 0,
+        .failed_dll = 0};
+    tek_inj_attach(&args);
+    return report_result(args);
+  }
+  if (opts.exe_path.empty()) {
+    if (output.headless) {
+      display_error(L"Game executable path must be specified with "
+                    L"--ti-exe-path in headless mode");
+      return EXIT_FAILURE;
+    }
     // Select executable path via a dialog
     com_ctx ctx;
     if (FAILED(ctx.hr)) {
@@ -171,96 +1705,15 @@ int wmain(int argc, wchar_t *argv[]) {
                         .data());
       return EXIT_FAILURE;
     }
-    exe_path = path;
+    opts.exe_path = path;
     CoTaskMemFree(path);
-  } else { // if (exe_path.empty())
-    // Convert the path from the command line to absolute
-    const auto abs_path_len{
-        GetFullPathNameW(exe_path.data(), 0, nullptr, nullptr)};
-    if (!abs_path_len) {
-      display_error(std::format(L"Failed to get full executable path: {}",
-                                get_os_err_msg(GetLastError()).get())
-                        .data());
-      return EXIT_FAILURE;
-    }
-    std::wstring abs_path(abs_path_len - 1, L'\0');
-    GetFullPathNameW(exe_path.data(), abs_path_len, abs_path.data(), nullptr);
-    exe_path = std::move(abs_path);
-  } // if (exe_path.empty()) else
-  if (current_dir.empty()) {
-    // Set executable's parent directory as current
-    current_dir = std::filesystem::path{exe_path}.parent_path();
-  }
-  tek_inj_game_args args{.exe_path = exe_path.data(),
-                         .current_dir = current_dir.data(),
-                         .dll_path = dll_path.data(),
-                         .type = TEK_GR_LOAD_TYPE_file_path,
-                         .argc = static_cast<int>(game_argv.size()),
-                         .argv = game_argv.data(),
-                         .flags = flags,
-                         .data_size =
-                             static_cast<std::uint32_t>(settings_path.length()),
-                         .data = settings_path.data(),
-                         .result = TEK_INJ_RES_ok,
-                         .win32_error = 0};
-  tek_inj_run_game(&args);
-  if (args.result == TEK_INJ_RES_ok) {
-    return EXIT_SUCCESS;
   }
-  std::wstring msg;
-  switch (args.result) {
-  case TEK_INJ_RES_ok:
-    return EXIT_SUCCESS;
-  case TEK_INJ_RES_get_token_info:
-    msg = L"Failed to get process token information";
-    break;
-  case TEK_INJ_RES_open_token:
-    msg = L"Failed to open current process token";
-    break;
-  case TEK_INJ_RES_duplicate_token:
-    msg = L"Failed to duplicate process token";
-    break;
-  case TEK_INJ_RES_set_token_info:
-    msg = L"Failed to set token information";
-    break;
-  case TEK_INJ_RES_create_process:
-    msg = L"Failed to create game process";
-    break;
-  case TEK_INJ_RES_mem_alloc:
-    msg = L"Failed to allocate memory in game process";
-    break;
-  case TEK_INJ_RES_mem_write:
-    msg = L"Failed to write to game process memory";
-    break;
-  case TEK_INJ_RES_sec_desc:
-    msg = L"Failed to setup security descriptor for the pipe";
-    break;
-  case TEK_INJ_RES_create_mapping:
-    msg = L"Failed to create file mapping";
-    break;
-  case TEK_INJ_RES_map_view:
-    msg = L"Failed to map view of the file mapping";
-    break;
-  case TEK_INJ_RES_create_thread:
-    msg = L"Failed to create injection thread";
-    break;
-  case TEK_INJ_RES_thread_wait:
-    msg = L"Failed to wait for injection thread to finish";
-    break;
-  case TEK_INJ_RES_dll_load:
-    msg = L"TEK Game Runtime failed to load";
-    break;
-  case TEK_INJ_RES_resume_thread:
-    msg = L"Failed to resume game's main thread";
-    break;
-  default:
-    msg = std::format(L"Unknown result code {}", static_cast<int>(args.result));
-    break;
+  tek_inj_game_args args;
+  if (!prepare_launch(opts, args)) {
+    return EXIT_FAILURE;
   }
-  if (args.win32_error) {
-    msg = std::format(L"{}: ({}) {}", msg, args.win32_error,
-                      get_os_err_msg(args.win32_error).get());
+  if (!save_profile_path.empty()) {
+    return save_profile(save_profile_path, args) ? EXIT_SUCCESS : EXIT_FAILURE;
   }
-  display_error(msg.data());
-  return EXIT_FAILURE;
+  return run(args, supervise_game, max_restarts, trace_path);
 }
@@ -14,29 +14,44 @@
 //===----------------------------------------------------------------------===//
 #include "tek-injector.h"
 
+#include "cmd_line.hpp"
+#include "loader_stub.hpp"
+#include "metrics.hpp"
+#include "payload.hpp"
+#include "pe.hpp"
+#include "prefetch.hpp"
+#include "settings.hpp"
+
 #include <algorithm>
 #include <array>
+#include <atomic>
+#include <cassert>
 #include <cstddef>
 #include <cstdint>
+#include <functional>
 #include <memory>
-#include <ranges>
 #include <span>
 #include <string>
 #include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#ifndef TEK_INJ_FAKE_OS
+// I/O priority of another process can be set only via native API, which
+//    windows.h doesn't declare
+extern "C" {
+NTSYSAPI LONG NTAPI NtSetInformationProcess(HANDLE process, ULONG info_class,
+                                            PVOID info, ULONG info_size);
+NTSYSAPI ULONG NTAPI RtlNtStatusToDosError(LONG status);
+}
+#endif // ndef TEK_INJ_FAKE_OS
 
 namespace {
 
-/// The header of data for TEK Game Runtime input file mapping.
-struct data_header {
-  /// Settings loading method.
-  tek_gr_load_type type;
-  /// Size of the remaining data in the file mapping, in bytes. When @ref type
-  ///    is @ref TEK_GR_LOAD_TYPE_file_path, the data is path to the file, or
-  ///    "tek-gr-settings.json" in current directory if the size is zero. When
-  ///    @ref type is @ref TEK_GR_LOAD_TYPE_data, the data is actual settings
-  ///    JSON content.
-  std::uint32_t size;
-};
+/// `ProcessIoPriority` value of `PROCESSINFOCLASS`.
+constexpr ULONG process_io_priority{33};
 
 /// RAII wrapper for Windows handles.
 class [[gnu::visibility("internal")]] unique_handle {
@@ -52,7 +67,18 @@ public:
   }
   constexpr operator HANDLE() const noexcept { return value; }
   constexpr PHANDLE operator&() noexcept { return &value; }
-  constexpr void operator=(HANDLE handle) noexcept { value = handle; }
+  void operator=(HANDLE handle) noexcept {
+    close();
+    value = handle;
+  }
+  /// Release ownership of the handle.
+  ///
+  /// @return The handle, which the caller must close.
+  constexpr HANDLE release() noexcept {
+    const auto handle{value};
+    value = nullptr;
+    return handle;
+  }
   void close() noexcept {
     if (value) {
       CloseHandle(value);
@@ -64,292 +90,2594 @@ public:
 /// RAII wrapper for process handles that terminates on failure.
 struct [[gnu::visibility("internal")]] unique_process : public unique_handle {
   bool success;
+  constexpr unique_process() noexcept : success{false} {}
   constexpr unique_process(HANDLE handle) noexcept
       : unique_handle{handle}, success{false} {}
+  using unique_handle::operator=;
   ~unique_process() noexcept {
-    if (!success) {
+    if (value && !success) {
       TerminateProcess(value, 0);
     }
   }
 };
 
-} // namespace
+/// RAII wrapper for mapped views of file mappings.
+using unique_view = std::unique_ptr<VOID, decltype(&UnmapViewOfFile)>;
 
-extern "C" void tek_inj_run_game(tek_inj_game_args *args) {
-  const auto token{GetCurrentProcessToken()};
-  bool elevated;
-  // Check if current process is elevated
-  {
-    TOKEN_ELEVATION_TYPE elevation_type;
-    DWORD ret_size;
-    if (!GetTokenInformation(token, TokenElevationType, &elevation_type,
-                             sizeof elevation_type, &ret_size)) {
-      args->result = TEK_INJ_RES_get_token_info;
-      args->win32_error = GetLastError();
-      return;
+/// Bump allocator for transient state of a launch, backed by either
+///    caller-supplied buffer or a single heap allocation.
+class [[gnu::visibility("internal")]] arena_allocator {
+  /// Heap buffer, if caller didn't supply one.
+  std::unique_ptr<char[]> heap_buf;
+  /// Pointer to the next free byte.
+  void *cur{};
+  /// Number of free bytes.
+  std::size_t space{};
+
+public:
+  /// Get the number of bytes that allocation of an array may take, including
+  ///    alignment padding.
+  ///
+  /// @param count
+  ///    Number of elements in the array.
+  /// @return Size of the allocation, in bytes.
+  template <typename T>
+  static constexpr std::size_t size_for(std::size_t count) noexcept {
+    return count * sizeof(T) + alignof(T) - 1;
+  }
+
+  /// Set up the buffer.
+  ///
+  /// @param buf
+  ///    Pointer to the caller-supplied buffer, or `nullptr` to allocate one on
+  ///    the heap.
+  /// @param buf_size
+  ///    Size of @p buf, in bytes.
+  /// @param required
+  ///    Total size of all allocations that will be made, in bytes.
+  /// @return Value indicating whether @p buf is large enough.
+  bool init(void *_Nullable buf, std::size_t buf_size, std::size_t required) {
+    if (buf) {
+      if (buf_size < required) {
+        return false;
+      }
+      cur = buf;
+    } else if (required) {
+      heap_buf = std::make_unique_for_overwrite<char[]>(required);
+      cur = heap_buf.get();
+    }
+    space = required;
+    return true;
+  }
+
+  /// Allocate an array. Total size of allocations must not exceed the size
+  ///    passed to @ref init, with every allocation counted by
+  ///    @ref size_for.
+  ///
+  /// @param count
+  ///    Number of elements in the array.
+  /// @return Pointer to uninitialized array.
+  template <typename T>
+  T *_Nonnull alloc(std::size_t count) noexcept {
+    const auto size{count * sizeof(T)};
+    const auto ptr{static_cast<T *>(std::align(alignof(T), size, cur, space))};
+    // std::align only fails if the size passed to init is too small
+    assert(ptr);
+    cur = static_cast<char *>(cur) + size;
+    space -= size;
+    return ptr;
+  }
+};
+
+/// Record current time as the start of a launch phase, if timings are
+///    requested.
+static inline void phase_start(tek_inj_timings *_Nullable timings,
+                               tek_inj_phase phase) noexcept {
+  if (timings) {
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    timings->start[phase] = counter.QuadPart;
+  }
+}
+
+/// Record current time as the end of a launch phase, if timings are
+///    requested.
+static inline void phase_end(tek_inj_timings *_Nullable timings,
+                             tek_inj_phase phase) noexcept {
+  if (timings) {
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    timings->end[phase] = counter.QuadPart;
+  }
+}
+
+/// Check if current process is elevated.
+///
+/// @param [out] elevated
+///    Variable that receives the value indicating whether current process is
+///    elevated.
+/// @param [out] args
+///    Input/output arguments of the public API function, only result fields
+///    are used.
+/// @return Value indicating whether the check succeeded. If it didn't, @p args
+///    result fields are set.
+template <typename Args>
+static bool is_elevated(bool &elevated, Args &args) {
+  TOKEN_ELEVATION_TYPE elevation_type;
+  DWORD ret_size;
+  if (!GetTokenInformation(GetCurrentProcessToken(), TokenElevationType,
+                           &elevation_type, sizeof elevation_type, &ret_size)) {
+    args.result = TEK_INJ_RES_get_token_info;
+    args.win32_error = GetLastError();
+    return false;
+  }
+  elevated = elevation_type == TokenElevationTypeFull;
+  return true;
+}
+
+/// Create a primary token for running game process without elevation: a copy
+///    of current process token with medium integrity level.
+///
+/// @param [out] token
+///    Variable that receives the token handle.
+/// @param [out] args
+///    Input/output arguments of the public API function, only result fields
+///    are used.
+/// @return Value indicating whether the token has been created. If it hasn't,
+///    @p args result fields are set.
+template <typename Args>
+static bool create_mil_token(unique_handle &token, Args &args) {
+  unique_handle proc_token;
+  if (!OpenProcessToken(GetCurrentProcess(), TOKEN_DUPLICATE, &proc_token)) {
+    args.result = TEK_INJ_RES_open_token;
+    args.win32_error = GetLastError();
+    return false;
+  }
+  if (!DuplicateTokenEx(proc_token,
+                        TOKEN_ASSIGN_PRIMARY | TOKEN_DUPLICATE | TOKEN_QUERY |
+                            TOKEN_ADJUST_DEFAULT,
+                        nullptr, SecurityImpersonation, TokenPrimary,
+                        &token)) {
+    args.result = TEK_INJ_RES_duplicate_token;
+    args.win32_error = GetLastError();
+    return false;
+  }
+  proc_token.close();
+  SID mil_sid{.Revision = 1,
+              .SubAuthorityCount = 1,
+              .IdentifierAuthority = SECURITY_MANDATORY_LABEL_AUTHORITY,
+              .SubAuthority = {SECURITY_MANDATORY_MEDIUM_RID}};
+  TOKEN_MANDATORY_LABEL label{
+      .Label = {.Sid = &mil_sid, .Attributes = SE_GROUP_INTEGRITY}};
+  if (!SetTokenInformation(token, TokenIntegrityLevel, &label, sizeof label)) {
+    args.result = TEK_INJ_RES_set_token_info;
+    args.win32_error = GetLastError();
+    return false;
+  }
+  return true;
+}
+
+/// Security attributes for file mappings that are accessible only to current
+///    user at medium integrity level: with full access for input mappings
+///    when calling process is elevated and the target process is not, and
+///    with read-only access for shared settings mappings. Not movable, since
+///    the attributes point to the other members.
+struct [[gnu::visibility("internal")]] mapping_security {
+  /// Buffer for the DACL that allows access only to current user. SIDs have
+  ///    bounded size, so it doesn't need a heap allocation.
+  alignas(ACL) std::array<char, sizeof(ACL) + sizeof(ACCESS_ALLOWED_ACE) +
+                                    SECURITY_MAX_SID_SIZE - sizeof(DWORD)>
+      dacl_buf;
+  /// Buffer for the SACL that allows access for medium integrity level.
+  alignas(ACL)
+      std::array<char, sizeof(ACL) + sizeof(SYSTEM_MANDATORY_LABEL_ACE) +
+                           sizeof(SID) - sizeof(DWORD)>
+          sacl_buf;
+  /// Security descriptor referencing the ACLs.
+  SECURITY_DESCRIPTOR desc;
+  /// Security attributes referencing @ref desc.
+  SECURITY_ATTRIBUTES attrs;
+};
+
+/// Initialize security attributes for restricted file mappings.
+///
+/// @param [out] sec
+///    The structure to initialize.
+/// @param access
+///    Access rights to grant to current user.
+/// @param [out] args
+///    Input/output arguments of the public API function, only result fields
+///    are used.
+/// @return Value indicating whether the attributes have been initialized. If
+///    they haven't, @p args result fields are set.
+template <typename Args>
+static bool init_mapping_security(mapping_security &sec, DWORD access,
+                                  Args &args) {
+  // SIDs have bounded size, so token user fits into a stack buffer
+  alignas(TOKEN_USER)
+      std::array<char, sizeof(TOKEN_USER) + SECURITY_MAX_SID_SIZE>
+          token_user_buf;
+  DWORD ret_size;
+  if (!GetTokenInformation(GetCurrentProcessToken(), TokenUser,
+                           token_user_buf.data(), token_user_buf.size(),
+                           &ret_size)) {
+    args.result = TEK_INJ_RES_get_token_info;
+    args.win32_error = GetLastError();
+    return false;
+  }
+  const auto user_sid{
+      reinterpret_cast<const TOKEN_USER *>(token_user_buf.data())->User.Sid};
+  const auto dacl_size{sizeof(ACL) + sizeof(ACCESS_ALLOWED_ACE) +
+                       GetLengthSid(user_sid) - sizeof(DWORD)};
+  const auto dacl{reinterpret_cast<PACL>(sec.dacl_buf.data())};
+  if (!InitializeAcl(dacl, dacl_size, ACL_REVISION)) {
+    args.result = TEK_INJ_RES_sec_desc;
+    args.win32_error = GetLastError();
+    return false;
+  }
+  if (!AddAccessAllowedAce(dacl, ACL_REVISION, access, user_sid)) {
+    args.result = TEK_INJ_RES_sec_desc;
+    args.win32_error = GetLastError();
+    return false;
+  }
+  SID mil_sid{.Revision = 1,
+              .SubAuthorityCount = 1,
+              .IdentifierAuthority = SECURITY_MANDATORY_LABEL_AUTHORITY,
+              .SubAuthority = {SECURITY_MANDATORY_MEDIUM_RID}};
+  const auto sacl{reinterpret_cast<PACL>(sec.sacl_buf.data())};
+  if (!InitializeAcl(sacl, sec.sacl_buf.size(), ACL_REVISION)) {
+    args.result = TEK_INJ_RES_sec_desc;
+    args.win32_error = GetLastError();
+    return false;
+  }
+  if (!AddMandatoryAce(sacl, ACL_REVISION, 0,
+                       SYSTEM_MANDATORY_LABEL_NO_READ_UP, &mil_sid)) {
+    args.result = TEK_INJ_RES_sec_desc;
+    args.win32_error = GetLastError();
+    return false;
+  }
+  if (!InitializeSecurityDescriptor(&sec.desc, SECURITY_DESCRIPTOR_REVISION)) {
+    args.result = TEK_INJ_RES_sec_desc;
+    args.win32_error = GetLastError();
+    return false;
+  }
+  if (!SetSecurityDescriptorDacl(&sec.desc, TRUE, dacl, FALSE)) {
+    args.result = TEK_INJ_RES_sec_desc;
+    args.win32_error = GetLastError();
+    return false;
+  }
+  if (!SetSecurityDescriptorSacl(&sec.desc, TRUE, sacl, FALSE)) {
+    args.result = TEK_INJ_RES_sec_desc;
+    args.win32_error = GetLastError();
+    return false;
+  }
+  sec.attrs = {.nLength = sizeof sec.attrs,
+               .lpSecurityDescriptor = &sec.desc,
+               .bInheritHandle = FALSE};
+  return true;
+}
+
+/// Write decimal representation of an integer.
+///
+/// @param [out] out
+///    Pointer to the buffer that receives the digits, must have space for at
+///    least 10 characters.
+/// @param value
+///    The integer to write.
+/// @return Pointer to the character past the last written digit.
+static constexpr WCHAR *_Nonnull append_decimal(WCHAR *_Nonnull out,
+                                                DWORD value) noexcept {
+  std::array<WCHAR, 10> digits;
+  auto it{digits.end()};
+  do {
+    *--it = static_cast<WCHAR>(L'0' + value % 10);
+    value /= 10;
+  } while (value);
+  return std::ranges::copy(it, digits.end(), out).out;
+}
+
+/// Access rights that game processes have to shared settings mappings. They
+///    can't get write access even by duplicating their own handles.
+constexpr DWORD shared_payload_access{SECTION_MAP_READ | SECTION_QUERY};
+
+/// Prefix of names of shared settings mappings, followed by ID of current
+///    process, a hyphen and a sequence number.
+constexpr std::wstring_view shared_payload_name_prefix{
+    L"tek-injector-shared-"};
+
+/// Sequence number of the next shared settings mapping created by current
+///    process.
+constinit std::atomic<DWORD> next_shared_payload;
+
+/// Process-wide state of @ref TEK_INJ_LEGACY_MAPPING_NAME.
+struct [[gnu::visibility("internal")]] legacy_name_state {
+  /// Lock protecting @ref busy.
+  SRWLOCK lock = SRWLOCK_INIT;
+  /// Condition variable signaled when @ref busy is cleared.
+  CONDITION_VARIABLE released = CONDITION_VARIABLE_INIT;
+  /// Value indicating whether a launch made by current process is using the
+  ///    name.
+  bool busy{};
+};
+
+/// State of the legacy mapping name for launches made by current process.
+constinit legacy_name_state legacy_name;
+
+/// Exclusive use of @ref TEK_INJ_LEGACY_MAPPING_NAME by a launch within
+///    current process, released upon destruction. It's not tied to a thread,
+///    as asynchronous launches complete on thread pool threads.
+class [[gnu::visibility("internal")]] legacy_name_lease {
+  /// Value indicating whether the lease has been acquired.
+  bool owned{};
+
+public:
+  constexpr legacy_name_lease() noexcept = default;
+  legacy_name_lease(const legacy_name_lease &) = delete;
+  legacy_name_lease &operator=(const legacy_name_lease &) = delete;
+  ~legacy_name_lease() noexcept {
+    if (owned) {
+      AcquireSRWLockExclusive(&legacy_name.lock);
+      legacy_name.busy = false;
+      ReleaseSRWLockExclusive(&legacy_name.lock);
+      WakeAllConditionVariable(&legacy_name.released);
+    }
+  }
+
+  /// Wait until no other launch uses the name, and take it.
+  void acquire() noexcept {
+    AcquireSRWLockExclusive(&legacy_name.lock);
+    while (legacy_name.busy) {
+      SleepConditionVariableSRW(&legacy_name.released, &legacy_name.lock,
+                                INFINITE, 0);
+    }
+    legacy_name.busy = true;
+    ReleaseSRWLockExclusive(&legacy_name.lock);
+    owned = true;
+  }
+};
+
+/// Create TEK Game Runtime input file mapping for a process.
+///
+/// @param pid
+///    ID of the target process.
+/// @param attrs
+///    Optional pointer to security attributes for the file mapping, see
+///    @ref mapping_security.
+/// @param size
+///    Size of the file mapping, in bytes.
+/// @param [out] legacy
+///    Optional pointer to the lease to acquire for naming the mapping
+///    @ref TEK_INJ_LEGACY_MAPPING_NAME. If `nullptr`, the mapping is named
+///    after @p pid.
+/// @param [out] mapping
+///    Variable that receives handle to the created file mapping.
+/// @param [out] args
+///    Input/output arguments of the public API function, only result fields
+///    are used.
+/// @return Value indicating whether the mapping has been created. If it
+///    hasn't, @p args result fields are set.
+template <typename Args>
+static bool create_mapping(DWORD pid,
+                           const SECURITY_ATTRIBUTES *_Nullable attrs,
+                           std::uint64_t size,
+                           legacy_name_lease *_Nullable legacy,
+                           unique_handle &mapping, Args &args) {
+  // Create input file mapping for TEK Game Runtime, named after game process
+  //    ID so concurrent launches don't collide, unless the runtime only knows
+  //    the legacy name
+  std::array<WCHAR, std::size(TEK_INJ_MAPPING_NAME_PREFIX) + 10> mapping_name;
+  if (legacy) {
+    legacy->acquire();
+    std::ranges::copy(TEK_INJ_LEGACY_MAPPING_NAME, mapping_name.begin());
+    // Round the size up to allocation granularity, so the mapping may be
+    //    reused by later launches with slightly larger data
+    size = (size + 0xFFFF) & ~std::uint64_t{0xFFFF};
+  } else {
+    *append_decimal(std::ranges::copy(TEK_INJ_MAPPING_NAME_PREFIX,
+                                      mapping_name.begin())
+                            .out -
+                        1,
+                    pid) = L'\0';
+  }
+  mapping = CreateFileMappingW(
+      INVALID_HANDLE_VALUE, const_cast<LPSECURITY_ATTRIBUTES>(attrs),
+      PAGE_READWRITE, static_cast<DWORD>(size >> 32), static_cast<DWORD>(size),
+      mapping_name.data());
+  if (!mapping) {
+    args.result = TEK_INJ_RES_create_mapping;
+    args.win32_error = GetLastError();
+    return false;
+  }
+  // The legacy mapping may be kept open by runtimes loaded earlier, which have
+  //    read their input already, so it's reused like older injector versions
+  //    did. Views of it are mapped with explicit size, which fails if it's
+  //    too small
+  if (!legacy && GetLastError() == ERROR_ALREADY_EXISTS) {
+    // A stale mapping left by someone else, don't pass its content to the game
+    args.result = TEK_INJ_RES_create_mapping;
+    args.win32_error = ERROR_ALREADY_EXISTS;
+    return false;
+  }
+  return true;
+}
+
+/// Create a job object with specified limits and assign a process to it.
+///
+/// @param process
+///    Handle to the process to assign to the job.
+/// @param limits
+///    Resource limits of the job.
+/// @param [out] job
+///    Variable that receives handle to the created job object.
+/// @param [out] args
+///    Input/output arguments of the public API function, only result fields
+///    are used.
+/// @return Value indicating whether the process has been assigned to the job.
+///    If it hasn't, @p args result fields are set.
+template <typename Args>
+static bool create_job(HANDLE process, const tek_inj_job_limits &limits,
+                       unique_handle &job, Args &args) {
+  job = CreateJobObjectW(nullptr, nullptr);
+  if (!job) {
+    args.result = TEK_INJ_RES_job;
+    args.win32_error = GetLastError();
+    return false;
+  }
+  JOBOBJECT_EXTENDED_LIMIT_INFORMATION limit_info{};
+  auto &basic_info{limit_info.BasicLimitInformation};
+  if (limits.memory_limit) {
+    basic_info.LimitFlags |= JOB_OBJECT_LIMIT_JOB_MEMORY;
+    limit_info.JobMemoryLimit = static_cast<SIZE_T>(limits.memory_limit);
+  }
+  if (limits.max_processes) {
+    basic_info.LimitFlags |= JOB_OBJECT_LIMIT_ACTIVE_PROCESS;
+    basic_info.ActiveProcessLimit = limits.max_processes;
+  }
+  if (basic_info.LimitFlags &&
+      !SetInformationJobObject(job, JobObjectExtendedLimitInformation,
+                               &limit_info, sizeof limit_info)) {
+    args.result = TEK_INJ_RES_job;
+    args.win32_error = GetLastError();
+    return false;
+  }
+  if (limits.cpu_rate) {
+    JOBOBJECT_CPU_RATE_CONTROL_INFORMATION rate_info{};
+    rate_info.ControlFlags = JOB_OBJECT_CPU_RATE_CONTROL_ENABLE |
+                             JOB_OBJECT_CPU_RATE_CONTROL_HARD_CAP;
+    rate_info.CpuRate = limits.cpu_rate;
+    if (!SetInformationJobObject(job, JobObjectCpuRateControlInformation,
+                                 &rate_info, sizeof rate_info)) {
+      args.result = TEK_INJ_RES_job;
+      args.win32_error = GetLastError();
+      return false;
+    }
+  }
+  if (!AssignProcessToJobObject(job, process)) {
+    args.result = TEK_INJ_RES_job;
+    args.win32_error = GetLastError();
+    return false;
+  }
+  return true;
+}
+
+/// Architecture of images that can be injected into, the loader stub and
+///    `LoadLibraryW` address passed to the injection thread are x86-64 ones.
+constexpr std::uint16_t native_machine{tek_inj::pe::machine_amd64};
+
+/// Result of parsing a PE image file.
+struct [[gnu::visibility("internal")]] image_entry {
+  /// Size of the file, in bytes.
+  std::uint64_t size;
+  /// Last write time of the file.
+  std::uint64_t write_time;
+  /// Parsing error.
+  tek_inj::pe::error error;
+  /// Information about the image, valid if @ref error is
+  ///    @ref tek_inj::pe::error::none.
+  tek_inj::pe::image_info info;
+  /// Sorted names of functions exported by the image, if it's a DLL.
+  std::vector<std::string> exports;
+};
+
+/// Parse a PE image file.
+///
+/// @param path
+///    Path to the file.
+/// @param [in, out] entry
+///    Entry with file size and last write time set, that receives the rest
+///    of parsing results.
+/// @param [out] args
+///    Input/output arguments of the public API function, only result fields
+///    are used.
+/// @return Value indicating whether the file has been read. If it hasn't,
+///    @p args result fields are set. Parsing errors are reported via
+///    @p entry instead.
+template <typename Args>
+static bool parse_image(LPCWSTR path, image_entry &entry, Args &args) {
+  if (!entry.size) {
+    entry.error = tek_inj::pe::error::truncated;
+    return true;
+  }
+  const auto file_handle{CreateFileW(
+      path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr,
+      OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr)};
+  if (file_handle == INVALID_HANDLE_VALUE) {
+    args.result = TEK_INJ_RES_image_open;
+    args.win32_error = GetLastError();
+    return false;
+  }
+  const unique_handle file{file_handle};
+  // Only the pages with headers and export names are actually read
+  const unique_handle mapping{
+      CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr)};
+  if (!mapping) {
+    args.result = TEK_INJ_RES_image_open;
+    args.win32_error = GetLastError();
+    return false;
+  }
+  const unique_view view{MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0),
+                         UnmapViewOfFile};
+  if (!view) {
+    args.result = TEK_INJ_RES_image_open;
+    args.win32_error = GetLastError();
+    return false;
+  }
+  const std::span content{static_cast<const char *>(view.get()),
+                          static_cast<std::size_t>(entry.size)};
+  entry.error = tek_inj::pe::parse(content, entry.info);
+  if (entry.error == tek_inj::pe::error::none &&
+      (entry.info.characteristics & tek_inj::pe::characteristic_dll)) {
+    std::vector<std::string_view> names;
+    entry.error = tek_inj::pe::export_names(content, entry.info, names);
+    entry.exports.assign(names.begin(), names.end());
+    std::ranges::sort(entry.exports);
+  }
+  return true;
+}
+
+/// State of reading files into the file system cache on thread pool threads.
+struct [[gnu::visibility("internal")]] prefetch_state {
+  /// Files to read, thread pool callbacks are its workers.
+  tek_inj::prefetch::batch<std::wstring> batch;
+  /// Optional pointer to timings of the launch, the end of
+  ///    @ref TEK_INJ_PHASE_prefetch is recorded in it by the last callback to
+  ///    finish.
+  tek_inj_timings *_Nullable timings;
+  /// Thread pool work object that reads the files.
+  PTP_WORK work{};
+
+  ~prefetch_state() noexcept {
+    if (work) {
+      batch.cancel();
+      WaitForThreadpoolWorkCallbacks(work, TRUE);
+      CloseThreadpoolWork(work);
+    }
+  }
+};
+
+/// Read a file into the file system cache.
+///
+/// @param path
+///    Path to the file.
+/// @return Size of the file in bytes if it has been read, otherwise 0.
+static std::uint64_t prefetch_file(LPCWSTR path) noexcept {
+  const auto file_handle{
+      CreateFileW(path, GENERIC_READ,
+                  FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                  nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr)};
+  if (file_handle == INVALID_HANDLE_VALUE) {
+    return 0;
+  }
+  const unique_handle file{file_handle};
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(file, &size) || !size.QuadPart) {
+    return 0;
+  }
+  const unique_handle mapping{
+      CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr)};
+  if (!mapping) {
+    return 0;
+  }
+  const unique_view view{MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0),
+                         UnmapViewOfFile};
+  if (!view) {
+    return 0;
+  }
+  // The memory manager reads the whole range with large concurrent I/O
+  //    requests, and the pages stay cached after the view is unmapped, where
+  //    the loader and the game find them
+  WIN32_MEMORY_RANGE_ENTRY range{
+      .VirtualAddress = view.get(),
+      .NumberOfBytes = static_cast<SIZE_T>(size.QuadPart)};
+  return PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0)
+             ? static_cast<std::uint64_t>(size.QuadPart)
+             : 0;
+}
+
+/// Thread pool callback that reads files into the file system cache until
+///    none are left.
+///
+/// @param [in, out] context
+///    Pointer to the prefetch state.
+static void CALLBACK prefetch_cb(PTP_CALLBACK_INSTANCE, PVOID context,
+                                 PTP_WORK) {
+  auto &state{*static_cast<prefetch_state *>(context)};
+  if (state.batch.work([](const std::wstring &path) {
+        return prefetch_file(path.data());
+      })) {
+    phase_end(state.timings, TEK_INJ_PHASE_prefetch);
+  }
+}
+
+/// Default time to wait for TEK Game Runtime DLL to load, in milliseconds.
+constexpr DWORD default_inject_timeout{3000};
+
+/// Get the time to wait for TEK Game Runtime DLL to load.
+///
+/// @param args
+///    Input arguments of the public API function.
+/// @return Timeout value, in milliseconds.
+template <typename Args>
+static constexpr DWORD inject_timeout(const Args &args) noexcept {
+  return args.inject_timeout ? args.inject_timeout : default_inject_timeout;
+}
+
+/// State of TEK Game Runtime DLL injection into a process.
+struct [[gnu::visibility("internal")]] injection {
+  /// Handle to the target process.
+  HANDLE process{};
+  /// Handle to game's suspended main thread, used by strategies other than
+  ///    @ref TEK_INJ_STRATEGY_remote_thread.
+  HANDLE main_thread{};
+  /// Technique for loading the DLLs.
+  tek_inj_strategy strategy{TEK_INJ_STRATEGY_remote_thread};
+  /// Address of DLL path, or the loader stub block when there are multiple
+  ///    DLLs or they are loaded on game's main thread, in target process
+  ///    memory.
+  LPVOID mem{};
+  /// Number of DLLs to load.
+  std::uint32_t num_dlls{1};
+  /// Handle to the injection thread.
+  unique_handle thread;
+  /// If the DLLs are loaded on game's main thread, event signaled by the
+  ///    loader stub after loading them.
+  unique_handle event;
+
+  ~injection() noexcept {
+    if (mem) {
+      VirtualFreeEx(process, mem, 0, MEM_RELEASE);
+    }
+  }
+};
+
+/// Get the size of arena allocations made by @ref start_injection.
+///
+/// @param args
+///    Input arguments of the public API function.
+/// @param strategy
+///    Technique for loading the DLLs.
+/// @return Size of the allocations, in bytes.
+template <typename Args>
+static std::size_t injection_arena_size(const Args &args,
+                                        tek_inj_strategy strategy) noexcept {
+  if (!args.num_extra_dlls && strategy == TEK_INJ_STRATEGY_remote_thread) {
+    return 0;
+  }
+  // Size of the loader stub block is linear in paths, so the block for all of
+  //    them is as large as blocks for the first one and for the rest combined,
+  //    minus fixed part that they both include
+  const auto block_size{
+      tek_inj::loader_stub::size({&args.dll_path, 1}) +
+      tek_inj::loader_stub::size(
+          {args.extra_dll_paths, args.num_extra_dlls}) -
+      tek_inj::loader_stub::size({})};
+  return arena_allocator::size_for<LPCWSTR>(args.num_extra_dlls + 1) +
+         arena_allocator::size_for<char>(block_size);
+}
+
+/// Write DLL paths to target process memory and start the routine that loads
+///    them, without waiting for it to finish. With
+///    @ref TEK_INJ_STRATEGY_remote_thread, the routine runs on a new thread,
+///    otherwise it runs on game's main thread once it's resumed.
+///
+/// @param [in, out] inj
+///    Injection state, with the process handle, strategy and, if the strategy
+///    requires it, main thread handle set.
+/// @param [in, out] arena
+///    Arena with at least @ref injection_arena_size bytes available.
+/// @param [out] timings
+///    Optional pointer to the structure that receives timestamps of remote
+///    write and inject phases.
+/// @param [in, out] args
+///    Input/output arguments of the public API function. Only DLL paths and
+///    result fields are used.
+/// @return Value indicating whether the routine has been started. If it
+///    hasn't, @p args result fields are set.
+template <typename Args>
+static bool start_injection(injection &inj, arena_allocator &arena,
+                            tek_inj_timings *_Nullable timings, Args &args) {
+  phase_start(timings, TEK_INJ_PHASE_remote_write);
+  const std::wstring_view dll_path{args.dll_path};
+  const bool on_main_thread{inj.strategy != TEK_INJ_STRATEGY_remote_thread};
+  // Multiple DLLs, or DLLs loaded on game's main thread, are loaded by the
+  //    loader stub, a single one is loaded by LoadLibraryW directly
+  const bool use_stub{args.num_extra_dlls > 0 || on_main_thread};
+  std::span<LPCWSTR> paths;
+  if (use_stub) {
+    inj.num_dlls = args.num_extra_dlls + 1;
+    paths = {arena.alloc<LPCWSTR>(inj.num_dlls), inj.num_dlls};
+    paths[0] = args.dll_path;
+    std::copy_n(args.extra_dll_paths, args.num_extra_dlls, paths.begin() + 1);
+  }
+  tek_inj::loader_stub::param param{};
+  param.load_library = reinterpret_cast<std::uintptr_t>(LoadLibraryW);
+  CONTEXT context;
+  if (on_main_thread) {
+    // Game's main thread doesn't exit after loading the DLLs, so the loader
+    //    stub signals an event instead
+    inj.event = CreateEventW(nullptr, FALSE, FALSE, nullptr);
+    HANDLE remote_event;
+    if (!inj.event ||
+        !DuplicateHandle(GetCurrentProcess(), inj.event, inj.process,
+                         &remote_event, EVENT_MODIFY_STATE, FALSE, 0)) {
+      args.result = TEK_INJ_RES_main_thread;
+      args.win32_error = GetLastError();
+      return false;
     }
-    elevated = elevation_type == TokenElevationTypeFull;
-  }
-  // Build command line
-  std::wstring command_line{args->exe_path};
-  if (command_line.contains(L' ')) {
-    for (auto pos{command_line.find(L'"')}; pos != std::string::npos;
-         pos = command_line.find(L'"', pos)) {
-      command_line.replace(pos, 1, L"\\\"");
-      pos += 2;
-    }
-    command_line.insert(command_line.begin(), L'"');
-    command_line.push_back(L'"');
-  }
-  for (auto &&arg :
-       std::span{args->argv, static_cast<std::size_t>(args->argc)} |
-           std::views::transform([](auto ptr) { return std::wstring{ptr}; })) {
-    if (arg.empty()) {
-      arg = L"\"\"";
-    } else if (arg.contains(L' ')) {
-      for (auto pos{arg.find(L'"')}; pos != std::string::npos;
-           pos = arg.find(L'"', pos)) {
-        arg.replace(pos, 1, L"\\\"");
-        pos += 2;
+    param.set_event = reinterpret_cast<std::uintptr_t>(SetEvent);
+    param.event = reinterpret_cast<std::uintptr_t>(remote_event);
+    if (inj.strategy == TEK_INJ_STRATEGY_entry_trampoline) {
+      // A suspended thread that hasn't started yet receives its start address
+      //    in RCX, which the trampoline jumps to afterwards
+      context.ContextFlags = CONTEXT_INTEGER;
+      if (!GetThreadContext(inj.main_thread, &context)) {
+        args.result = TEK_INJ_RES_main_thread;
+        args.win32_error = GetLastError();
+        return false;
       }
-      arg.append(std::ranges::find_last_if_not(
-                     arg, [](auto ch) { return ch == L'\\'; })
-                     .advance(1)
-                     .size(),
-                 L'\\');
-      arg.insert(arg.begin(), L'"');
-      arg.push_back(L'"');
+      param.entry = context.Rcx;
     }
-    command_line.push_back(L' ');
-    command_line.append(arg);
   }
-  // Create suspended game process
-  const DWORD create_flags = (args->flags & TEK_INJ_FLAG_high_proc_prio)
-                                 ? CREATE_SUSPENDED | HIGH_PRIORITY_CLASS
-                                 : CREATE_SUSPENDED;
-  STARTUPINFOW startup_info{};
-  startup_info.cb = sizeof startup_info;
-  PROCESS_INFORMATION proc_info;
-  if (elevated && !(args->flags & TEK_INJ_FLAG_run_as_admin)) {
-    // Copy current process token and set its integrity level to medium first,
-    //    so game process runs without elevation
-    unique_handle proc_token;
-    if (!OpenProcessToken(GetCurrentProcess(), TOKEN_DUPLICATE, &proc_token)) {
-      args->result = TEK_INJ_RES_open_token;
-      args->win32_error = GetLastError();
-      return;
+  const auto mem_size{use_stub ? tek_inj::loader_stub::size(paths)
+                               : (dll_path.length() + 1) *
+                                     sizeof(decltype(dll_path)::value_type)};
+  // Allocate memory for DLL paths
+  inj.mem = VirtualAllocEx(inj.process, nullptr, mem_size,
+                           MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+  if (!inj.mem) {
+    args.result = TEK_INJ_RES_mem_alloc;
+    args.win32_error = GetLastError();
+    return false;
+  }
+  const auto mem{static_cast<char *>(inj.mem)};
+  const void *src{dll_path.data()};
+  if (use_stub) {
+    const auto block{arena.alloc<char>(mem_size)};
+    tek_inj::loader_stub::write(block, reinterpret_cast<std::uintptr_t>(mem),
+                                param, paths);
+    src = block;
+  }
+  // Write the paths to the allocated pages
+  if (!WriteProcessMemory(inj.process, mem, src, mem_size, nullptr)) {
+    args.result = TEK_INJ_RES_mem_write;
+    args.win32_error = GetLastError();
+    return false;
+  }
+  if (use_stub) {
+    // Only the code page is made executable, the loader stub writes the
+    //    number of loaded DLLs to its parameter
+    DWORD old_protect;
+    if (!VirtualProtectEx(inj.process, mem,
+                          tek_inj::loader_stub::param_offset,
+                          PAGE_EXECUTE_READ, &old_protect)) {
+      args.result = TEK_INJ_RES_mem_protect;
+      args.win32_error = GetLastError();
+      return false;
     }
-    unique_handle mil_token;
-    if (!DuplicateTokenEx(proc_token,
-                          TOKEN_ASSIGN_PRIMARY | TOKEN_DUPLICATE | TOKEN_QUERY |
-                              TOKEN_ADJUST_DEFAULT,
-                          nullptr, SecurityImpersonation, TokenPrimary,
-                          &mil_token)) {
-      args->result = TEK_INJ_RES_duplicate_token;
-      args->win32_error = GetLastError();
-      return;
+  }
+  phase_end(timings, TEK_INJ_PHASE_remote_write);
+  phase_start(timings, TEK_INJ_PHASE_inject);
+  const auto param_addr{mem + tek_inj::loader_stub::param_offset};
+  switch (inj.strategy) {
+  case TEK_INJ_STRATEGY_remote_thread: {
+    // Create the thread for injecting the DLLs
+    const auto routine{use_stub
+                           ? mem + tek_inj::loader_stub::routine_offset
+                           : reinterpret_cast<char *>(LoadLibraryW)};
+    inj.thread = CreateRemoteThread(
+        inj.process, nullptr, 0,
+        reinterpret_cast<LPTHREAD_START_ROUTINE>(routine),
+        use_stub ? param_addr : mem, 0, nullptr);
+    if (!inj.thread) {
+      args.result = TEK_INJ_RES_create_thread;
+      args.win32_error = GetLastError();
+      return false;
     }
-    proc_token.close();
-    SID mil_sid{.Revision = 1,
-                .SubAuthorityCount = 1,
-                .IdentifierAuthority = SECURITY_MANDATORY_LABEL_AUTHORITY,
-                .SubAuthority = {SECURITY_MANDATORY_MEDIUM_RID}};
-    TOKEN_MANDATORY_LABEL label{
-        .Label = {.Sid = &mil_sid, .Attributes = SE_GROUP_INTEGRITY}};
-    if (!SetTokenInformation(mil_token, TokenIntegrityLevel, &label,
-                             sizeof label)) {
-      args->result = TEK_INJ_RES_set_token_info;
-      args->win32_error = GetLastError();
+    return true;
+  }
+  case TEK_INJ_STRATEGY_apc:
+    if (!QueueUserAPC(reinterpret_cast<PAPCFUNC>(
+                          mem + tek_inj::loader_stub::routine_offset),
+                      inj.main_thread,
+                      reinterpret_cast<ULONG_PTR>(param_addr))) {
+      break;
+    }
+    return true;
+  case TEK_INJ_STRATEGY_entry_trampoline:
+    context.Rcx = reinterpret_cast<std::uintptr_t>(
+        mem + tek_inj::loader_stub::trampoline_offset);
+    if (!SetThreadContext(inj.main_thread, &context)) {
+      break;
+    }
+    return true;
+  default:
+    SetLastError(ERROR_INVALID_PARAMETER);
+    break;
+  }
+  args.result = TEK_INJ_RES_main_thread;
+  args.win32_error = GetLastError();
+  return false;
+}
+
+/// Wait for the DLL loading routine started by @ref start_injection to
+///    finish.
+///
+/// @param inj
+///    Injection state after successful @ref start_injection. If the DLLs are
+///    loaded on game's main thread, it must have been resumed.
+/// @param timeout
+///    Time to wait, in milliseconds.
+/// @return `WAIT_OBJECT_0` if the routine has finished, `WAIT_TIMEOUT`, or
+///    `WAIT_FAILED` with last error set.
+static DWORD wait_injection(const injection &inj, DWORD timeout) {
+  if (!inj.event) {
+    return WaitForSingleObject(inj.thread, timeout);
+  }
+  const std::array<HANDLE, 2> handles{inj.event, inj.process};
+  const auto res{WaitForMultipleObjects(handles.size(), handles.data(), FALSE,
+                                        timeout)};
+  if (res == WAIT_OBJECT_0 + 1) {
+    // Game process has exited before the routine signaled the event
+    SetLastError(ERROR_PROCESS_ABORTED);
+    return WAIT_FAILED;
+  }
+  return res;
+}
+
+/// Free the loader stub block after game's main thread has signaled the event,
+///    once it has left the block. If it doesn't do so in time, or its state
+///    can't be checked, the block is left allocated.
+///
+/// @param [in, out] inj
+///    Injection state with the event signaled. @ref injection::mem is set to
+///    `nullptr`.
+static void free_stub_block(injection &inj) noexcept {
+  const auto mem{static_cast<char *>(inj.mem)};
+  inj.mem = nullptr;
+  const auto event_addr{mem + tek_inj::loader_stub::param_offset +
+                        offsetof(tek_inj::loader_stub::param, event)};
+  // The routine clears the event after SetEvent returns, and the thread may
+  //    only be in the code after that for a few instructions
+  const auto deadline{GetTickCount64() + 1000};
+  do {
+    if (SuspendThread(inj.main_thread) == static_cast<DWORD>(-1)) {
       return;
     }
-    if (!CreateProcessAsUserW(mil_token, args->exe_path, command_line.data(),
-                              nullptr, nullptr, FALSE, create_flags, nullptr,
-                              args->current_dir, &startup_info, &proc_info)) {
-      args->result = TEK_INJ_RES_create_process;
-      args->win32_error = GetLastError();
+    CONTEXT context;
+    context.ContextFlags = CONTEXT_CONTROL;
+    std::uint64_t event;
+    const bool ok{GetThreadContext(inj.main_thread, &context) &&
+                  ReadProcessMemory(inj.process, event_addr, &event,
+                                    sizeof event, nullptr)};
+    ResumeThread(inj.main_thread);
+    if (!ok) {
       return;
     }
-  } else { // if (elevated && !(args->flags & TEK_INJ_FLAGS_run_as_admin))
-    if (!CreateProcessW(args->exe_path, command_line.data(), nullptr, nullptr,
-                        FALSE, create_flags, nullptr, args->current_dir,
-                        &startup_info, &proc_info)) {
-      args->result = TEK_INJ_RES_create_process;
-      args->win32_error = GetLastError();
+    const auto rip{reinterpret_cast<char *>(context.Rip)};
+    if (!event &&
+        (rip < mem || rip >= mem + tek_inj::loader_stub::code.size())) {
+      VirtualFreeEx(inj.process, mem, 0, MEM_RELEASE);
       return;
     }
-  } // if (elevated && !(args->flags & TEK_INJ_FLAGS_run_as_admin)) else
-  command_line = {};
-  unique_process process{proc_info.hProcess};
-  const unique_handle thread{proc_info.hThread};
-  // Allocate memory for DLL path
-  const std::wstring_view dll_path{args->dll_path};
-  const auto dll_path_size{(dll_path.length() + 1) *
-                           sizeof(decltype(dll_path)::value_type)};
-  auto deleter{[&process](LPVOID addr) {
-    VirtualFreeEx(process, addr, 0, MEM_RELEASE);
+    SwitchToThread();
+  } while (GetTickCount64() < deadline);
+}
+
+/// Check the outcome of the DLL loading routine after waiting for it.
+///
+/// @param [in, out] inj
+///    Injection state after successful @ref start_injection.
+/// @param wait_res
+///    Result of waiting for the routine: `WAIT_OBJECT_0`, `WAIT_TIMEOUT`, or
+///    `WAIT_FAILED` with last error set.
+/// @param [out] timings
+///    Optional pointer to the structure that receives timestamp of inject
+///    phase end.
+/// @param [in, out] args
+///    Input/output arguments of the public API function. Only result fields
+///    are used.
+/// @return Value indicating whether the DLL has been loaded. If it hasn't,
+///    @p args result fields are set.
+template <typename Args>
+static bool finish_injection(injection &inj, DWORD wait_res,
+                             tek_inj_timings *_Nullable timings, Args &args) {
+  switch (wait_res) {
+  case WAIT_OBJECT_0:
+    break;
+  case WAIT_TIMEOUT:
+    SetLastError(ERROR_TIMEOUT);
+    [[fallthrough]];
+  default:
+    args.result = TEK_INJ_RES_thread_wait;
+    args.win32_error = GetLastError();
+    if (inj.thread) {
+      // The injection thread is terminated so it can't finish loading the DLL
+      //    into a process that has been given up on, after that the path it
+      //    uses may be freed
+      TerminateThread(inj.thread, 0);
+    } else {
+      // Game's main thread may still be running the loader stub, it can't be
+      //    stopped without the process, so the block is left allocated
+      inj.mem = nullptr;
+    }
+    return false;
+  }
+  // Check the number of loaded DLLs, or injection thread exit code
+  DWORD exit_code;
+  if (inj.event) {
+    const auto param{static_cast<char *>(inj.mem) +
+                     tek_inj::loader_stub::param_offset};
+    inj.event.close();
+    std::uint64_t loaded;
+    if (!ReadProcessMemory(inj.process,
+                           param + offsetof(tek_inj::loader_stub::param,
+                                            loaded),
+                           &loaded, sizeof loaded, nullptr)) {
+      args.result = TEK_INJ_RES_thread_wait;
+      args.win32_error = GetLastError();
+      // Game's main thread may still be executing the loader stub
+      inj.mem = nullptr;
+      return false;
+    }
+    // Game's main thread may still be executing the loader stub after
+    //    signaling the event
+    free_stub_block(inj);
+    exit_code = static_cast<DWORD>(loaded);
+    args.win32_error = 0;
+  } else {
+    VirtualFreeEx(inj.process, inj.mem, 0, MEM_RELEASE);
+    inj.mem = nullptr;
+    if (GetExitCodeThread(inj.thread, &exit_code)) {
+      args.win32_error = 0;
+    } else {
+      exit_code = 0;
+      args.win32_error = GetLastError();
+    }
+    inj.thread.close();
+  }
+  // The loader stub returns the number of loaded DLLs, LoadLibraryW returns
+  //    truncated module handle
+  const bool stub_used{inj.num_dlls > 1 ||
+                       inj.strategy != TEK_INJ_STRATEGY_remote_thread};
+  if (stub_used ? exit_code < inj.num_dlls : !exit_code) {
+    args.result = TEK_INJ_RES_dll_load;
+    args.failed_dll = stub_used ? exit_code : 0;
+    return false;
+  }
+  phase_end(timings, TEK_INJ_PHASE_inject);
+  return true;
+}
+
+/// Inject TEK Game Runtime DLL into a running process and wait for it to
+///    load.
+/// The process keeps running if the wait fails, and the injection thread may
+///    be holding the loader lock, so terminating the thread could deadlock
+///    the process. Instead, the thread is left to finish loading, and the
+///    block it uses is deliberately leaked.
+///
+/// @param process
+///    Handle to the target process.
+/// @param [in, out] arena
+///    Arena with at least @ref injection_arena_size bytes available.
+/// @param timeout
+///    Time to wait for the DLL to load, in milliseconds.
+/// @param [out] timings
+///    Optional pointer to the structure that receives timestamps of remote
+///    write and inject phases.
+/// @param [in, out] args
+///    Input/output arguments of the public API function. Only DLL path and
+///    result fields are used.
+/// @return Value indicating whether injection succeeded. If it didn't,
+///    @p args result fields are set.
+template <typename Args>
+static bool load_dll(HANDLE process, arena_allocator &arena, DWORD timeout,
+                     tek_inj_timings *_Nullable timings, Args &args) {
+  injection inj;
+  inj.process = process;
+  if (!start_injection(inj, arena, timings, args)) {
+    return false;
+  }
+  switch (const auto wait_res{WaitForSingleObject(inj.thread, timeout)}) {
+  case WAIT_OBJECT_0:
+    return finish_injection(inj, wait_res, timings, args);
+  case WAIT_TIMEOUT:
+    SetLastError(ERROR_TIMEOUT);
+    [[fallthrough]];
+  default:
+    args.result = TEK_INJ_RES_thread_wait;
+    args.win32_error = GetLastError();
+    inj.mem = nullptr;
+    return false;
+  }
+}
+
+/// Read-only file mapping with settings data, shared by launches with
+///    identical data.
+struct [[gnu::visibility("internal")]] shared_payload {
+  /// Hash of the data computed by @ref tek_inj::payload::hash.
+  std::uint64_t hash;
+  /// Size of the data, in bytes.
+  std::uint64_t size;
+  /// Handle to the file mapping, with read-only access.
+  unique_handle mapping;
+  /// Read-only view of @ref mapping, used to compare its content with data of
+  ///    other launches.
+  unique_view view{nullptr, UnmapViewOfFile};
+};
+
+/// Create a sealed read-only file mapping with settings data.
+///
+/// @param data
+///    The data to write to the file mapping, must not be empty.
+/// @param hash
+///    Hash of @p data.
+/// @param attrs
+///    Security attributes for the file mapping, granting
+///    @ref shared_payload_access.
+/// @param [out] args
+///    Input/output arguments of the public API function, only result fields
+///    are used.
+/// @return Pointer to the created mapping, or `nullptr` on failure, in which
+///    case @p args result fields are set.
+template <typename Args>
+static std::shared_ptr<shared_payload>
+create_shared_payload(std::string_view data, std::uint64_t hash,
+                      const SECURITY_ATTRIBUTES &attrs, Args &args) {
+  auto payload{std::make_shared<shared_payload>()};
+  payload->hash = hash;
+  payload->size = data.size();
+  // The system ignores the DACL of unnamed mappings, so the mapping is named
+  //    for its security descriptor to apply. The creator is granted full
+  //    access regardless
+  std::array<WCHAR, shared_payload_name_prefix.length() + 22> name;
+  auto name_end{append_decimal(
+      std::ranges::copy(shared_payload_name_prefix, name.begin()).out,
+      GetCurrentProcessId())};
+  *name_end++ = L'-';
+  *append_decimal(name_end, next_shared_payload.fetch_add(
+                                1, std::memory_order::relaxed)) = L'\0';
+  unique_handle mapping{CreateFileMappingW(
+      INVALID_HANDLE_VALUE, const_cast<LPSECURITY_ATTRIBUTES>(&attrs),
+      PAGE_READWRITE, static_cast<DWORD>(payload->size >> 32),
+      static_cast<DWORD>(payload->size), name.data())};
+  if (!mapping) {
+    args.result = TEK_INJ_RES_shared_payload;
+    args.win32_error = GetLastError();
+    return nullptr;
+  }
+  // A mapping created by someone else under the same name can't be trusted
+  if (GetLastError() == ERROR_ALREADY_EXISTS) {
+    args.result = TEK_INJ_RES_shared_payload;
+    args.win32_error = ERROR_ALREADY_EXISTS;
+    return nullptr;
+  }
+  {
+    const unique_view view{MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, 0),
+                           UnmapViewOfFile};
+    if (!view) {
+      args.result = TEK_INJ_RES_map_view;
+      args.win32_error = GetLastError();
+      return nullptr;
+    }
+    std::ranges::copy(data, static_cast<char *>(view.get()));
+  }
+  // Seal the mapping by replacing the only handle with write access with a
+  //    read-only one, so neither this process nor game processes that get
+  //    handles duplicated from it can modify the data
+  HANDLE read_only;
+  if (!DuplicateHandle(GetCurrentProcess(), mapping.release(),
+                       GetCurrentProcess(), &read_only, FILE_MAP_READ, FALSE,
+                       DUPLICATE_CLOSE_SOURCE)) {
+    args.result = TEK_INJ_RES_shared_payload;
+    args.win32_error = GetLastError();
+    return nullptr;
+  }
+  payload->mapping = read_only;
+  payload->view.reset(MapViewOfFile(read_only, FILE_MAP_READ, 0, 0, 0));
+  if (!payload->view) {
+    args.result = TEK_INJ_RES_map_view;
+    args.win32_error = GetLastError();
+    return nullptr;
+  }
+  return payload;
+}
+
+} // namespace
+
+/// State cached for launches made through it.
+struct tek_inj_ctx {
+  /// Value indicating whether current process is elevated.
+  bool elevated;
+  /// If current process is elevated, primary token for running game processes
+  ///    without elevation.
+  unique_handle mil_token;
+  /// If current process is elevated, security attributes for restricted file
+  ///    mappings.
+  mapping_security security;
+  /// Security attributes for shared settings mappings.
+  mapping_security payload_security;
+  /// Lock protecting @ref images.
+  mutable SRWLOCK images_lock = SRWLOCK_INIT;
+  /// Cached results of parsing image files, keyed on their paths.
+  mutable std::unordered_map<std::wstring, std::shared_ptr<const image_entry>>
+      images;
+  /// Lock protecting @ref payloads.
+  mutable SRWLOCK payloads_lock = SRWLOCK_INIT;
+  /// Shared settings mappings used by launches in progress, keyed on hashes
+  ///    of their data.
+  mutable std::unordered_map<std::uint64_t, std::weak_ptr<const shared_payload>>
+      payloads;
+};
+
+/// State of a game launch between game process creation and injection.
+struct tek_inj_launch {
+  /// Input/output arguments of the launch, `nullptr` while it's idle in a
+  ///    @ref tek_inj_pool.
+  tek_inj_game_args *_Nullable args;
+  /// Timings of the launch: @ref tek_inj_game_args::timings if it's set, or
+  ///    @ref own_timings otherwise, so launch statistics are recorded either
+  ///    way.
+  tek_inj_timings *_Nonnull timings;
+  /// Timings used if launch arguments don't have them.
+  tek_inj_timings own_timings{};
+  /// Value indicating whether game process is started without elevation by an
+  ///    elevated process, so the file mapping must be restricted.
+  bool restrict_mapping;
+  /// Arena for transient state of the launch.
+  arena_allocator arena;
+  /// Game process handle.
+  unique_process process;
+  /// Game's main thread handle.
+  unique_handle thread;
+  /// Handle to the job object that game process is assigned to, if any.
+  unique_handle job;
+  /// If @ref TEK_INJ_FLAG_prefetch is set, state of reading files into the
+  ///    file system cache.
+  std::unique_ptr<prefetch_state> prefetch;
+  /// ID of the game process.
+  DWORD pid;
+  /// If @ref TEK_INJ_FLAG_legacy_mapping_name is set, use of the mapping
+  ///    name by this launch, released after @ref mapping is closed.
+  legacy_name_lease legacy_lease;
+  /// TEK Game Runtime input file mapping handle.
+  unique_handle mapping;
+  /// If @ref TEK_INJ_FLAG_shared_payload is used, the shared mapping with
+  ///    settings data, referenced until TEK Game Runtime is loaded.
+  std::shared_ptr<const shared_payload> shared;
+  /// View of @ref mapping, available until the launch is committed, or until
+  ///    TEK Game Runtime reports readiness if @ref status is used.
+  unique_view view{nullptr, UnmapViewOfFile};
+  /// If @ref TEK_INJ_FLAG_wait_ready is set, pointer to the status block in
+  ///    @ref view.
+  tek_inj::payload::status_block *_Nullable status{};
+  /// If @ref TEK_INJ_FLAG_wait_ready is set, event signaled by TEK Game
+  ///    Runtime after every update of @ref status.
+  unique_handle status_event;
+  /// Value of `GetTickCount64` after which waiting for injection and runtime
+  ///    readiness times out.
+  ULONGLONG deadline{};
+  /// State of TEK Game Runtime DLL injection for asynchronous commit.
+  injection inj;
+  /// Event signaled upon completion of asynchronous commit.
+  unique_handle event;
+  /// Handle of the thread pool wait for @ref inj thread.
+  HANDLE wait{};
+  /// Function to call upon completion of asynchronous commit.
+  tek_inj_launch_cb *_Nullable cb{};
+  /// Value to pass to @ref cb.
+  void *_Nullable user_data{};
+  /// Lock held while @ref wait is being registered, and protecting the
+  ///    fields below.
+  SRWLOCK lock = SRWLOCK_INIT;
+  /// Condition variable signaled when @ref deferred is reset.
+  CONDITION_VARIABLE deferred_done = CONDITION_VARIABLE_INIT;
+  /// Value indicating whether completion of asynchronous commit that failed
+  ///    early is submitted to the thread pool and hasn't finished yet.
+  bool deferred{};
+  /// Value indicating whether the launch is being freed, so deferred
+  ///    completion must not call @ref cb.
+  bool cancelled{};
+  /// Value indicating whether asynchronous commit has completed.
+  std::atomic_bool done{};
+
+  constexpr tek_inj_launch(tek_inj_game_args *_Nonnull args) noexcept
+      : args{args}, timings{args->timings ? args->timings : &own_timings} {}
+  ~tek_inj_launch() noexcept {
+    if (wait) {
+      // Cancel the wait if it hasn't fired yet, or wait for the callback to
+      //    return otherwise
+      UnregisterWaitEx(wait, INVALID_HANDLE_VALUE);
+    }
+    AcquireSRWLockExclusive(&lock);
+    cancelled = true;
+    while (deferred) {
+      SleepConditionVariableSRW(&deferred_done, &lock, INFINITE, 0);
+    }
+    ReleaseSRWLockExclusive(&lock);
+  }
+};
+
+/// Pool of suspended game processes.
+struct tek_inj_pool {
+  /// Arguments for starting pooled game processes.
+  const tek_inj_game_args args;
+  /// Policy for replacing claimed processes.
+  const tek_inj_pool_refill refill;
+  /// Lock protecting the fields below.
+  SRWLOCK lock = SRWLOCK_INIT;
+  /// Condition variable signaled when @ref pending_refills drops to zero.
+  CONDITION_VARIABLE refills_done = CONDITION_VARIABLE_INIT;
+  /// Launches with suspended game processes ready to be claimed.
+  std::vector<std::unique_ptr<tek_inj_launch>> idle;
+  /// Number of background refills that haven't finished yet.
+  std::uint32_t pending_refills{};
+
+  tek_inj_pool(const tek_inj_game_args &args,
+               tek_inj_pool_refill refill) noexcept
+      : args{args}, refill{refill} {}
+};
+
+namespace {
+
+/// Statistics of launches made by current process, updated upon completion
+///    of every launch with relaxed atomic operations, as counters are
+///    independent of each other.
+constinit tek_inj::metrics::registry launch_metrics;
+
+/// Check if current process is elevated, using cached state if available.
+///
+/// @param ctx
+///    Optional context with cached state.
+/// @param [out] elevated
+///    Variable that receives the value indicating whether current process is
+///    elevated.
+/// @param [out] args
+///    Input/output arguments of the public API function, only result fields
+///    are used.
+/// @return Value indicating whether the check succeeded. If it didn't, @p args
+///    result fields are set.
+template <typename Args>
+static bool is_elevated(const tek_inj_ctx *_Nullable ctx, bool &elevated,
+                        Args &args) {
+  if (ctx) {
+    elevated = ctx->elevated;
+    return true;
+  }
+  return is_elevated(elevated, args);
+}
+
+/// Get security attributes for a restricted file mapping, using cached ones if
+///    available.
+///
+/// @param ctx
+///    Optional context with cached state.
+/// @param [out] local
+///    Structure to initialize if @p ctx is `nullptr`.
+/// @param [out] args
+///    Input/output arguments of the public API function, only result fields
+///    are used.
+/// @return Pointer to the attributes, or `nullptr` on failure, in which case
+///    @p args result fields are set.
+template <typename Args>
+static const SECURITY_ATTRIBUTES *_Nullable restricted_attrs(
+    const tek_inj_ctx *_Nullable ctx, mapping_security &local, Args &args) {
+  if (ctx) {
+    return &ctx->security.attrs;
+  }
+  return init_mapping_security(local, GENERIC_ALL, args) ? &local.attrs
+                                                        : nullptr;
+}
+
+/// Get the result of parsing a PE image file, using cached one if available.
+///
+/// @param ctx
+///    Optional context with cached state.
+/// @param path
+///    Path to the file.
+/// @param optional
+///    Value indicating whether a missing file is not an error.
+/// @param [out] entry
+///    Variable that receives the result, or `nullptr` if @p optional is
+///    `true` and the file doesn't exist.
+/// @param [out] args
+///    Input/output arguments of the public API function, only result fields
+///    are used.
+/// @return Value indicating whether the file has been read. If it hasn't,
+///    @p args result fields are set.
+template <typename Args>
+static bool get_image(const tek_inj_ctx *_Nullable ctx,
+                      const std::wstring &path, bool optional,
+                      std::shared_ptr<const image_entry> &entry, Args &args) {
+  entry.reset();
+  WIN32_FILE_ATTRIBUTE_DATA attrs;
+  if (!GetFileAttributesExW(path.data(), GetFileExInfoStandard, &attrs)) {
+    const auto error{GetLastError()};
+    if (optional &&
+        (error == ERROR_FILE_NOT_FOUND || error == ERROR_PATH_NOT_FOUND)) {
+      return true;
+    }
+    args.result = TEK_INJ_RES_image_open;
+    args.win32_error = error;
+    return false;
+  }
+  const auto size{std::uint64_t{attrs.nFileSizeHigh} << 32 |
+                  attrs.nFileSizeLow};
+  const auto write_time{
+      std::uint64_t{attrs.ftLastWriteTime.dwHighDateTime} << 32 |
+      attrs.ftLastWriteTime.dwLowDateTime};
+  if (ctx) {
+    AcquireSRWLockShared(&ctx->images_lock);
+    if (const auto it{ctx->images.find(path)}; it != ctx->images.end() &&
+        it->second->size == size && it->second->write_time == write_time) {
+      entry = it->second;
+    }
+    ReleaseSRWLockShared(&ctx->images_lock);
+    if (entry) {
+      return true;
+    }
+  }
+  auto new_entry{std::make_shared<image_entry>()};
+  new_entry->size = size;
+  new_entry->write_time = write_time;
+  if (!parse_image(path.data(), *new_entry, args)) {
+    return false;
+  }
+  if (ctx) {
+    AcquireSRWLockExclusive(&ctx->images_lock);
+    ctx->images.insert_or_assign(path, new_entry);
+    ReleaseSRWLockExclusive(&ctx->images_lock);
+  }
+  entry = std::move(new_entry);
+  return true;
+}
+
+/// Get a shared read-only file mapping with settings data, reusing the one
+///    used by another launch in progress if its data is identical.
+///
+/// @param ctx
+///    Optional context with cached state.
+/// @param data
+///    The settings data, must not be empty.
+/// @param [out] payload
+///    Variable that receives the mapping.
+/// @param [out] args
+///    Input/output arguments of the public API function, only result fields
+///    are used.
+/// @return Value indicating whether the mapping has been obtained. If it
+///    hasn't, @p args result fields are set.
+template <typename Args>
+static bool get_shared_payload(const tek_inj_ctx *_Nullable ctx,
+                               std::string_view data,
+                               std::shared_ptr<const shared_payload> &payload,
+                               Args &args) {
+  const auto hash{tek_inj::payload::hash(data)};
+  // Equal hashes don't guarantee equal data, so the content is compared too
+  const auto find{[ctx, data, hash] {
+    std::shared_ptr<const shared_payload> res;
+    if (const auto it{ctx->payloads.find(hash)}; it != ctx->payloads.end()) {
+      res = it->second.lock();
+      if (res && (res->size != data.size() ||
+                  !std::ranges::equal(
+                      std::string_view{static_cast<const char *>(
+                                           res->view.get()),
+                                       data.size()},
+                      data))) {
+        res.reset();
+      }
+    }
+    return res;
   }};
-  std::unique_ptr<VOID, decltype(deleter)> mem{
-      VirtualAllocEx(process, nullptr, dll_path_size, MEM_COMMIT | MEM_RESERVE,
-                     PAGE_READWRITE),
-      deleter};
-  if (!mem) {
-    args->result = TEK_INJ_RES_mem_alloc;
-    args->win32_error = GetLastError();
-    return;
+  if (ctx) {
+    AcquireSRWLockShared(&ctx->payloads_lock);
+    payload = find();
+    ReleaseSRWLockShared(&ctx->payloads_lock);
+    if (payload) {
+      return true;
+    }
   }
-  // Write DLL path to the allocated page
-  if (!WriteProcessMemory(process, mem.get(), dll_path.data(), dll_path_size,
-                          nullptr)) {
-    args->result = TEK_INJ_RES_mem_write;
-    args->win32_error = GetLastError();
+  mapping_security local_security;
+  if (!ctx &&
+      !init_mapping_security(local_security, shared_payload_access, args)) {
+    return false;
+  }
+  auto new_payload{create_shared_payload(
+      data, hash, ctx ? ctx->payload_security.attrs : local_security.attrs,
+      args)};
+  if (!new_payload) {
+    return false;
+  }
+  if (ctx) {
+    AcquireSRWLockExclusive(&ctx->payloads_lock);
+    // Another launch with the same data may have created its mapping
+    //    concurrently, keep only one of them in use
+    payload = find();
+    if (!payload) {
+      std::erase_if(ctx->payloads,
+                    [](const auto &entry) { return entry.second.expired(); });
+      // On a hash collision the mapping is used without being cached
+      ctx->payloads.try_emplace(hash, new_payload);
+    }
+    ReleaseSRWLockExclusive(&ctx->payloads_lock);
+    if (payload) {
+      return true;
+    }
+  }
+  payload = std::move(new_payload);
+  return true;
+}
+
+/// Check whether a path is relative to current directory, i.e. has neither
+///    a root nor a drive.
+///
+/// @param path
+///    The path to check.
+/// @return Value indicating whether @p path is relative.
+static constexpr bool is_relative(std::wstring_view path) noexcept {
+  return !(path.starts_with(L'\\') || path.starts_with(L'/') ||
+           (path.length() >= 2 && path[1] == L':'));
+}
+
+/// Resolve a path the way game process will, against its current directory.
+///
+/// @param args
+///    Arguments of the launch.
+/// @param path
+///    The path to resolve.
+/// @return @p path prefixed with @ref tek_inj_game_args::current_dir if it's
+///    relative and the directory is specified, otherwise @p path as is.
+static std::wstring resolve_path(const tek_inj_game_args &args,
+                                 std::wstring_view path) {
+  std::wstring res;
+  if (args.current_dir && is_relative(path)) {
+    res = args.current_dir;
+    res += L'\\';
+  }
+  res += path;
+  return res;
+}
+
+/// Validate game executable and DLLs to inject.
+///
+/// @param [in, out] args
+///    Input/output arguments of the launch. Result fields and
+///    @ref tek_inj_game_args::failed_dll are set on failure.
+/// @param [out] timings
+///    Timings of the launch that receive timestamps of image check phase.
+/// @return Value indicating whether all images are valid.
+static bool check_images(tek_inj_game_args &args,
+                         tek_inj_timings *_Nonnull timings) {
+  phase_start(timings, TEK_INJ_PHASE_image_check);
+  std::shared_ptr<const image_entry> entry;
+  // Game process is created with the path as is, so it's checked that way
+  if (!get_image(args.ctx, args.exe_path, false, entry, args)) {
+    args.failed_dll = UINT32_MAX;
+    return false;
+  }
+  const auto fail{[&args](tek_inj_res result, DWORD win32_error,
+                          std::uint32_t index) {
+    args.result = result;
+    args.win32_error = win32_error;
+    args.failed_dll = index;
+    return false;
+  }};
+  constexpr auto exe_required{tek_inj::pe::characteristic_executable};
+  if (entry->error != tek_inj::pe::error::none ||
+      (entry->info.characteristics &
+       (exe_required | tek_inj::pe::characteristic_dll)) != exe_required ||
+      (entry->info.subsystem != tek_inj::pe::subsystem_windows_gui &&
+       entry->info.subsystem != tek_inj::pe::subsystem_windows_cui)) {
+    return fail(TEK_INJ_RES_image_invalid, ERROR_BAD_EXE_FORMAT, UINT32_MAX);
+  }
+  if (entry->info.machine != native_machine) {
+    return fail(TEK_INJ_RES_image_machine, ERROR_EXE_MACHINE_TYPE_MISMATCH,
+                UINT32_MAX);
+  }
+  for (std::uint32_t i{}; i <= args.num_extra_dlls; ++i) {
+    const std::wstring_view dll_path{i ? args.extra_dll_paths[i - 1]
+                                       : args.dll_path};
+    // Relative paths are resolved against game's current directory, but the
+    //    loader may also find them elsewhere, so they're checked only if
+    //    they're found there
+    if (!get_image(args.ctx, resolve_path(args, dll_path),
+                   is_relative(dll_path), entry, args)) {
+      args.failed_dll = i;
+      return false;
+    }
+    if (!entry) {
+      continue;
+    }
+    if (entry->error != tek_inj::pe::error::none ||
+        !(entry->info.characteristics & tek_inj::pe::characteristic_dll)) {
+      return fail(TEK_INJ_RES_image_invalid, ERROR_BAD_EXE_FORMAT, i);
+    }
+    if (entry->info.machine != native_machine) {
+      return fail(TEK_INJ_RES_image_machine, ERROR_EXE_MACHINE_TYPE_MISMATCH,
+                  i);
+    }
+    if (i) {
+      continue;
+    }
+    for (const std::string_view name : std::span{args.required_exports,
+                                                 args.num_required_exports}) {
+      if (!std::ranges::binary_search(entry->exports, name, std::less{})) {
+        return fail(TEK_INJ_RES_image_export, ERROR_PROC_NOT_FOUND, 0);
+      }
+    }
+  }
+  phase_end(timings, TEK_INJ_PHASE_image_check);
+  return true;
+}
+
+/// Start reading game executable, DLLs, the settings file and extra files
+///    requested by the caller into the file system cache on thread pool
+///    threads. Failures are ignored, since prefetch only speeds up the start
+///    of the game.
+///
+/// @param [in, out] launch
+///    The launch state to store prefetch state in.
+static void start_prefetch(tek_inj_launch &launch) {
+  auto &args{*launch.args};
+  auto prefetch{std::make_unique<prefetch_state>()};
+  prefetch->timings = launch.timings;
+  auto &paths{prefetch->batch.paths};
+  paths.reserve(2 + args.num_extra_dlls + args.num_prefetch_paths + 1);
+  paths.emplace_back(args.exe_path);
+  paths.emplace_back(resolve_path(args, args.dll_path));
+  for (const auto path : std::span{args.extra_dll_paths, args.num_extra_dlls}) {
+    paths.emplace_back(resolve_path(args, path));
+  }
+  if (args.type == TEK_GR_LOAD_TYPE_file_path) {
+    // The path is UTF-8, and an empty one refers to the default file
+    std::wstring settings_path(args.data_size, L'\0');
+    settings_path.resize(static_cast<std::size_t>(MultiByteToWideChar(
+        CP_UTF8, 0, args.data, static_cast<int>(args.data_size),
+        settings_path.data(), static_cast<int>(settings_path.length()))));
+    paths.emplace_back(resolve_path(
+        args, settings_path.empty() ? L"tek-gr-settings.json" : settings_path));
+  }
+  for (const auto path :
+       std::span{args.prefetch_paths, args.num_prefetch_paths}) {
+    paths.emplace_back(resolve_path(args, path));
+  }
+  prefetch->work = CreateThreadpoolWork(prefetch_cb, prefetch.get(), nullptr);
+  if (!prefetch->work) {
     return;
   }
-  // Create input file mapping for TEK Game Runtime
-  unique_handle mapping;
-  const DWORD buf_size = sizeof(data_header) + args->data_size;
-  if (elevated && !(args->flags & TEK_INJ_FLAG_run_as_admin)) {
-    // Initialize security descriptor with DACL that allows only current user
-    //    and SACL that allows access for medium integrity level
-    DWORD ret_size;
-    if (!GetTokenInformation(token, TokenUser, nullptr, 0, &ret_size)) {
-      const auto err{GetLastError()};
-      if (err != ERROR_INSUFFICIENT_BUFFER) {
-        args->result = TEK_INJ_RES_get_token_info;
-        args->win32_error = err;
-        return;
+  const auto num_workers{prefetch->batch.start()};
+  phase_start(launch.timings, TEK_INJ_PHASE_prefetch);
+  for (std::size_t i{}; i < num_workers; ++i) {
+    SubmitThreadpoolWork(prefetch->work);
+  }
+  launch.prefetch = std::move(prefetch);
+}
+
+/// Wait for reading files into the file system cache to complete, and report
+///    the number of bytes read.
+///
+/// @param [in, out] launch
+///    State of the launch with @ref tek_inj_launch::prefetch set.
+static void finish_prefetch(tek_inj_launch &launch) {
+  auto &prefetch{*launch.prefetch};
+  WaitForThreadpoolWorkCallbacks(prefetch.work, FALSE);
+  launch.args->prefetched_bytes =
+      prefetch.batch.bytes.load(std::memory_order::relaxed);
+  launch.prefetch.reset();
+}
+
+/// Reset launch timings and set their frequency.
+///
+/// @param [out] timings
+///    Optional pointer to the structure to reset.
+static void init_timings(tek_inj_timings *_Nullable timings) {
+  if (timings) {
+    *timings = {};
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    timings->frequency = frequency.QuadPart;
+  }
+}
+
+/// Start suspended game process.
+///
+/// @param [in, out] launch
+///    The launch state to fill.
+/// @return Value indicating whether the process has been started. If it
+///    hasn't, launch arguments' result fields are set.
+static bool start_process(tek_inj_launch &launch) {
+  auto &args{*launch.args};
+  const auto timings{launch.timings};
+  args.prefetched_bytes = 0;
+  args.pid = 0;
+  args.tid = 0;
+  if ((args.flags & TEK_INJ_FLAG_check_images) &&
+      !check_images(args, timings)) {
+    return false;
+  }
+  // Set up the arena for all transient state of the launch first, so a too
+  //    small one is reported without side effects
+  const std::span argv{args.argv, static_cast<std::size_t>(args.argc)};
+  const auto command_line_len{
+      args.command_line
+          ? std::wstring_view{args.command_line}.length()
+          : tek_inj::cmd_line::length<WCHAR>(args.exe_path, argv)};
+  // Processor group affinity and preferred NUMA node are set via process
+  //    creation attributes, so game's main thread never runs elsewhere
+  const bool numa{(args.flags & TEK_INJ_FLAG_numa_node) != 0};
+  const bool set_affinity{args.affinity_mask || numa};
+  const DWORD num_attrs{static_cast<DWORD>(set_affinity) +
+                        static_cast<DWORD>(numa)};
+  SIZE_T attr_list_size{};
+  if (num_attrs) {
+    InitializeProcThreadAttributeList(nullptr, num_attrs, 0, &attr_list_size);
+  }
+  const auto attr_list_count{(attr_list_size + sizeof(ULONG_PTR) - 1) /
+                             sizeof(ULONG_PTR)};
+  const auto arena_size{
+      arena_allocator::size_for<WCHAR>(command_line_len + 1) +
+      arena_allocator::size_for<ULONG_PTR>(attr_list_count) +
+      injection_arena_size(args, args.strategy)};
+  if (!launch.arena.init(args.arena, args.arena_size, arena_size)) {
+    args.result = TEK_INJ_RES_arena_size;
+    args.win32_error = 0;
+    args.arena_size = arena_size;
+    return false;
+  }
+  if (args.flags & TEK_INJ_FLAG_prefetch) {
+    // Reading happens while the process is being created and injected into
+    start_prefetch(launch);
+  }
+  phase_start(timings, TEK_INJ_PHASE_token);
+  bool elevated;
+  if (!is_elevated(args.ctx, elevated, args)) {
+    return false;
+  }
+  launch.restrict_mapping =
+      elevated && !(args.flags & TEK_INJ_FLAG_run_as_admin);
+  unique_handle local_mil_token;
+  HANDLE mil_token{};
+  if (launch.restrict_mapping) {
+    // Game process must run without elevation
+    if (args.ctx) {
+      mil_token = args.ctx->mil_token;
+    } else {
+      if (!create_mil_token(local_mil_token, args)) {
+        return false;
       }
+      mil_token = local_mil_token;
     }
-    auto token_user_buf{std::make_unique_for_overwrite<char[]>(ret_size)};
-    if (!GetTokenInformation(token, TokenUser, token_user_buf.get(), ret_size,
-                             &ret_size)) {
-      args->result = TEK_INJ_RES_get_token_info;
-      args->win32_error = GetLastError();
-      return;
+  }
+  phase_end(timings, TEK_INJ_PHASE_token);
+  phase_start(timings, TEK_INJ_PHASE_create_process);
+  // Build command line, or copy the provided one since CreateProcessW may
+  //    modify it
+  const auto command_line{launch.arena.alloc<WCHAR>(command_line_len + 1)};
+  if (args.command_line) {
+    std::wstring_view{args.command_line}.copy(command_line, command_line_len);
+  } else {
+    tek_inj::cmd_line::write<WCHAR>(args.exe_path, argv, command_line);
+  }
+  command_line[command_line_len] = L'\0';
+  // Create suspended game process
+  DWORD create_flags = (args.flags & TEK_INJ_FLAG_high_proc_prio)
+                           ? CREATE_SUSPENDED | HIGH_PRIORITY_CLASS
+                           : CREATE_SUSPENDED;
+  STARTUPINFOEXW startup_info{};
+  startup_info.StartupInfo.cb = sizeof startup_info.StartupInfo;
+  GROUP_AFFINITY affinity{};
+  USHORT numa_node{args.numa_node};
+  std::unique_ptr<std::remove_pointer_t<LPPROC_THREAD_ATTRIBUTE_LIST>,
+                  decltype(&DeleteProcThreadAttributeList)>
+      attr_list{nullptr, DeleteProcThreadAttributeList};
+  if (num_attrs) {
+    if (args.affinity_mask) {
+      affinity.Mask = static_cast<KAFFINITY>(args.affinity_mask);
+      affinity.Group = args.processor_group;
+    } else if (!GetNumaNodeProcessorMaskEx(numa_node, &affinity)) {
+      args.result = TEK_INJ_RES_placement;
+      args.win32_error = GetLastError();
+      return false;
     }
-    const auto user_sid{
-        reinterpret_cast<const TOKEN_USER *>(token_user_buf.get())->User.Sid};
-    const auto dacl_size{sizeof(ACL) + sizeof(ACCESS_ALLOWED_ACE) +
-                         GetLengthSid(user_sid) - sizeof(DWORD)};
-    const auto dacl_buf{std::make_unique_for_overwrite<char[]>(dacl_size)};
-    const auto dacl{reinterpret_cast<PACL>(dacl_buf.get())};
-    if (!InitializeAcl(dacl, dacl_size, ACL_REVISION)) {
-      args->result = TEK_INJ_RES_sec_desc;
-      args->win32_error = GetLastError();
-      return;
+    const auto buf{reinterpret_cast<LPPROC_THREAD_ATTRIBUTE_LIST>(
+        launch.arena.alloc<ULONG_PTR>(attr_list_count))};
+    if (!InitializeProcThreadAttributeList(buf, num_attrs, 0,
+                                           &attr_list_size)) {
+      args.result = TEK_INJ_RES_placement;
+      args.win32_error = GetLastError();
+      return false;
     }
-    if (!AddAccessAllowedAce(dacl, ACL_REVISION, GENERIC_ALL, user_sid)) {
-      args->result = TEK_INJ_RES_sec_desc;
-      args->win32_error = GetLastError();
-      return;
+    attr_list.reset(buf);
+    if (!UpdateProcThreadAttribute(
+            buf, 0, PROC_THREAD_ATTRIBUTE_GROUP_AFFINITY, &affinity,
+            sizeof affinity, nullptr, nullptr) ||
+        (numa && !UpdateProcThreadAttribute(
+                     buf, 0, PROC_THREAD_ATTRIBUTE_PREFERRED_NODE, &numa_node,
+                     sizeof numa_node, nullptr, nullptr))) {
+      args.result = TEK_INJ_RES_placement;
+      args.win32_error = GetLastError();
+      return false;
     }
-    token_user_buf.reset();
-    SID mil_sid{.Revision = 1,
-                .SubAuthorityCount = 1,
-                .IdentifierAuthority = SECURITY_MANDATORY_LABEL_AUTHORITY,
-                .SubAuthority = {SECURITY_MANDATORY_MEDIUM_RID}};
-    std::array<char, sizeof(ACL) + sizeof(SYSTEM_MANDATORY_LABEL_ACE) +
-                         sizeof mil_sid - sizeof(DWORD)>
-        sacl_buf;
-    const auto sacl{reinterpret_cast<PACL>(sacl_buf.data())};
-    if (!InitializeAcl(sacl, sacl_buf.size(), ACL_REVISION)) {
-      args->result = TEK_INJ_RES_sec_desc;
-      args->win32_error = GetLastError();
-      return;
+    startup_info.StartupInfo.cb = sizeof startup_info;
+    startup_info.lpAttributeList = buf;
+    create_flags |= EXTENDED_STARTUPINFO_PRESENT;
+  }
+  PROCESS_INFORMATION proc_info;
+  if (!(mil_token
+            ? CreateProcessAsUserW(mil_token, args.exe_path, command_line,
+                                   nullptr, nullptr, FALSE, create_flags,
+                                   nullptr, args.current_dir,
+                                   &startup_info.StartupInfo, &proc_info)
+            : CreateProcessW(args.exe_path, command_line, nullptr, nullptr,
+                             FALSE, create_flags, nullptr, args.current_dir,
+                             &startup_info.StartupInfo, &proc_info))) {
+    args.result = TEK_INJ_RES_create_process;
+    args.win32_error = GetLastError();
+    return false;
+  }
+  local_mil_token.close();
+  attr_list.reset();
+  launch.process = proc_info.hProcess;
+  launch.thread = proc_info.hThread;
+  launch.pid = proc_info.dwProcessId;
+  args.pid = proc_info.dwProcessId;
+  args.tid = proc_info.dwThreadId;
+  // The attribute only sets affinity of the main thread, restrict threads
+  //    created later as well
+  if (set_affinity &&
+      !SetProcessAffinityMask(launch.process,
+                              static_cast<DWORD_PTR>(affinity.Mask))) {
+    args.result = TEK_INJ_RES_placement;
+    args.win32_error = GetLastError();
+    return false;
+  }
+  if (args.memory_priority) {
+    MEMORY_PRIORITY_INFORMATION info{.MemoryPriority = args.memory_priority};
+    if (!SetProcessInformation(launch.process, ProcessMemoryPriority, &info,
+                               sizeof info)) {
+      args.result = TEK_INJ_RES_placement;
+      args.win32_error = GetLastError();
+      return false;
     }
-    if (!AddMandatoryAce(sacl, ACL_REVISION, 0,
-                         SYSTEM_MANDATORY_LABEL_NO_READ_UP, &mil_sid)) {
-      args->result = TEK_INJ_RES_sec_desc;
-      args->win32_error = GetLastError();
-      return;
+  }
+  if (args.io_priority) {
+    if (args.io_priority > TEK_INJ_IO_PRIORITY_normal) {
+      args.result = TEK_INJ_RES_placement;
+      args.win32_error = ERROR_INVALID_PARAMETER;
+      return false;
     }
-    SECURITY_DESCRIPTOR desc;
-    if (!InitializeSecurityDescriptor(&desc, SECURITY_DESCRIPTOR_REVISION)) {
-      args->result = TEK_INJ_RES_sec_desc;
-      args->win32_error = GetLastError();
-      return;
+    // IO_PRIORITY_HINT values start with IoPriorityVeryLow at 0
+    ULONG priority{static_cast<ULONG>(args.io_priority) - 1};
+    if (const auto status{NtSetInformationProcess(launch.process,
+                                                  process_io_priority,
+                                                  &priority, sizeof priority)};
+        status < 0) {
+      args.result = TEK_INJ_RES_placement;
+      args.win32_error = RtlNtStatusToDosError(status);
+      return false;
     }
-    if (!SetSecurityDescriptorDacl(&desc, TRUE, dacl, FALSE)) {
-      args->result = TEK_INJ_RES_sec_desc;
-      args->win32_error = GetLastError();
-      return;
+  }
+  if (args.job_limits &&
+      !create_job(launch.process, *args.job_limits, launch.job, args)) {
+    return false;
+  }
+  phase_end(timings, TEK_INJ_PHASE_create_process);
+  return true;
+}
+
+/// Create the file mapping for started game process and write the payload
+///    header to it.
+///
+/// @param [in, out] launch
+///    The launch state after successful @ref start_process.
+/// @param data_size
+///    Size of the settings data that will be written to the file mapping, in
+///    bytes.
+/// @param shared
+///    Value indicating whether the payload references settings data in a
+///    shared file mapping instead of including it.
+/// @return Pointer to the buffer in the file mapping view that settings data
+///    should be written to, or `nullptr` on failure, in which case launch
+///    arguments' result fields are set.
+static char *_Nullable create_payload(tek_inj_launch &launch,
+                                      std::uint64_t data_size,
+                                      bool shared = false) {
+  auto &args{*launch.args};
+  const auto timings{launch.timings};
+  phase_start(timings, TEK_INJ_PHASE_mapping);
+  // Create input file mapping and write the header to it
+  mapping_security local_security;
+  const SECURITY_ATTRIBUTES *attrs{};
+  if (launch.restrict_mapping) {
+    attrs = restricted_attrs(args.ctx, local_security, args);
+    if (!attrs) {
+      return nullptr;
     }
-    if (!SetSecurityDescriptorSacl(&desc, TRUE, sacl, FALSE)) {
-      args->result = TEK_INJ_RES_sec_desc;
-      args->win32_error = GetLastError();
+  }
+  const bool status{(args.flags & TEK_INJ_FLAG_wait_ready) != 0};
+  const std::uint32_t flags{(status ? tek_inj::payload::flag_status : 0) |
+                            (shared ? tek_inj::payload::flag_shared : 0)};
+  const auto size{tek_inj::payload::size(data_size, flags)};
+  if (!create_mapping(launch.pid, attrs, size,
+                      (args.flags & TEK_INJ_FLAG_legacy_mapping_name)
+                          ? &launch.legacy_lease
+                          : nullptr,
+                      launch.mapping, args)) {
+    return nullptr;
+  }
+  launch.view.reset(
+      MapViewOfFile(launch.mapping, FILE_MAP_WRITE, 0, 0, size));
+  if (!launch.view) {
+    args.result = TEK_INJ_RES_map_view;
+    args.win32_error = GetLastError();
+    return nullptr;
+  }
+  const auto data{tek_inj::payload::write_header(launch.view.get(), args.type,
+                                                 data_size, flags)};
+  if (status) {
+    // Give the runtime an event to signal its status updates with, so they
+    //    are waited for instead of polled
+    launch.status_event = CreateEventW(nullptr, FALSE, FALSE, nullptr);
+    HANDLE remote_event;
+    if (!launch.status_event ||
+        !DuplicateHandle(GetCurrentProcess(), launch.status_event,
+                         launch.process, &remote_event, EVENT_MODIFY_STATE,
+                         FALSE, 0)) {
+      args.result = TEK_INJ_RES_status_event;
+      args.win32_error = GetLastError();
+      return nullptr;
+    }
+    launch.status = tek_inj::payload::get_status(launch.view.get());
+    launch.status->event = reinterpret_cast<std::uintptr_t>(remote_event);
+  }
+  return data;
+}
+
+/// Start suspended game process and create the file mapping for it.
+///
+/// @param [in, out] launch
+///    The launch state to fill.
+/// @param data_size
+///    Size of the settings data that will be written to the file mapping, in
+///    bytes.
+/// @return Pointer to the buffer in the file mapping view that settings data
+///    should be written to, or `nullptr` on failure, in which case launch
+///    arguments' result fields are set.
+static char *_Nullable begin(tek_inj_launch &launch, std::uint64_t data_size) {
+  init_timings(launch.timings);
+  return start_process(launch) ? create_payload(launch, data_size) : nullptr;
+}
+
+/// Create the file mapping for started game process and put settings data
+///    from launch arguments into it, or a reference to the shared mapping
+///    with the data if @ref TEK_INJ_FLAG_shared_payload is set.
+///
+/// @param [in, out] launch
+///    The launch state after successful @ref start_process.
+/// @return Value indicating whether the data has been put. If it hasn't,
+///    launch arguments' result fields are set.
+static bool put_data(tek_inj_launch &launch) {
+  auto &args{*launch.args};
+  if (!(args.flags & TEK_INJ_FLAG_shared_payload) || !args.data_size) {
+    const auto data{create_payload(launch, args.data_size)};
+    if (!data) {
+      return false;
+    }
+    std::copy_n(args.data, args.data_size, data);
+    return true;
+  }
+  if (!create_payload(launch, args.data_size, true) ||
+      !get_shared_payload(args.ctx, {args.data, args.data_size},
+                          launch.shared, args)) {
+    return false;
+  }
+  HANDLE remote_mapping;
+  if (!DuplicateHandle(GetCurrentProcess(), launch.shared->mapping,
+                       launch.process, &remote_mapping, FILE_MAP_READ, FALSE,
+                       0)) {
+    args.result = TEK_INJ_RES_shared_payload;
+    args.win32_error = GetLastError();
+    return false;
+  }
+  auto &block{*tek_inj::payload::get_shared(launch.view.get())};
+  block.mapping = reinterpret_cast<std::uintptr_t>(remote_mapping);
+  block.hash = launch.shared->hash;
+  return true;
+}
+
+/// Start suspended game process and put settings data from launch arguments
+///    into its file mapping.
+///
+/// @param [in, out] launch
+///    The launch state to fill.
+/// @return Value indicating whether the launch is ready to be committed. If
+///    it isn't, launch arguments' result fields are set.
+static bool begin_with_data(tek_inj_launch &launch) {
+  init_timings(launch.timings);
+  return start_process(launch) && put_data(launch);
+}
+
+/// Resume game's main thread.
+///
+/// @param [in, out] launch
+///    State of the launch.
+/// @return Value indicating whether the thread has been resumed. If it
+///    hasn't, launch arguments' result fields are set.
+static bool resume_thread(tek_inj_launch &launch) {
+  auto &args{*launch.args};
+  const auto timings{launch.timings};
+  // Game process has its own handle to the shared mapping, which keeps it
+  //    alive, and further launches with the same data don't have to reuse it
+  launch.shared.reset();
+  if (launch.prefetch) {
+    // Game's main thread would otherwise block on reading the same files
+    finish_prefetch(launch);
+  }
+  // Resume game's main thread execution
+  phase_start(timings, TEK_INJ_PHASE_resume);
+  if (ResumeThread(launch.thread) == static_cast<DWORD>(-1)) {
+    args.result = TEK_INJ_RES_resume_thread;
+    args.win32_error = GetLastError();
+    return false;
+  }
+  phase_end(timings, TEK_INJ_PHASE_resume);
+  return true;
+}
+
+/// Complete a launch after TEK Game Runtime has been loaded and game's main
+///    thread has been resumed.
+///
+/// @param [in, out] launch
+///    State of the launch. Launch arguments' result fields are set upon
+///    return.
+static void finish_launch(tek_inj_launch &launch) {
+  auto &args{*launch.args};
+  launch.mapping.close();
+  launch.process.success = true;
+  if (args.flags & TEK_INJ_FLAG_keep_process) {
+    args.process = launch.process.release();
+  }
+  if (launch.job) {
+    args.job = launch.job.release();
+  }
+  args.result = TEK_INJ_RES_ok;
+}
+
+/// Complete a launch whose DLL loading routine has finished successfully.
+///
+/// @param [in, out] launch
+///    State of the launch. Launch arguments' result fields are set upon
+///    return.
+static void resume(tek_inj_launch &launch) {
+  // With strategies that load the DLLs on game's main thread, it has been
+  //    resumed already
+  if (launch.inj.strategy != TEK_INJ_STRATEGY_remote_thread ||
+      resume_thread(launch)) {
+    finish_launch(launch);
+  }
+}
+
+/// Wait for TEK Game Runtime to report the outcome of its initialization via
+///    the status block.
+///
+/// @param [in, out] launch
+///    State of the launch with @ref tek_inj_launch::status set.
+/// @param loaded
+///    Value indicating whether all DLLs have been loaded. If they haven't,
+///    only a failure already reported by the runtime is checked for, as it
+///    explains the failure better than launch arguments' result fields
+///    already set.
+/// @return Value indicating whether the runtime is ready. If it isn't, launch
+///    arguments' result fields are set.
+static bool wait_ready(tek_inj_launch &launch, bool loaded) {
+  using tek_inj::payload::state;
+  auto &args{*launch.args};
+  auto &status{*launch.status};
+  const std::atomic_ref status_state{status.state};
+  for (;;) {
+    switch (static_cast<state>(
+        status_state.load(std::memory_order::acquire))) {
+    case state::ready:
+      if (!loaded) {
+        return false;
+      }
+      {
+        // The runtime's own timestamps exclude the time it took to notice
+        //    its status updates
+        const auto timings{launch.timings};
+        const auto &times{status.times};
+        const auto loaded_time{times[static_cast<int>(state::loaded)]};
+        const auto ready_time{times[static_cast<int>(state::ready)]};
+        timings->start[TEK_INJ_PHASE_runtime_init] =
+            loaded_time ? loaded_time : timings->start[TEK_INJ_PHASE_inject];
+        if (ready_time) {
+          timings->end[TEK_INJ_PHASE_runtime_init] = ready_time;
+        } else {
+          phase_end(timings, TEK_INJ_PHASE_runtime_init);
+        }
+      }
+      launch.status = nullptr;
+      launch.view.reset();
+      return true;
+    case state::failed: {
+      args.result = TEK_INJ_RES_runtime_init;
+      args.win32_error = status.error;
+      // The message is written by another process, so don't rely on it being
+      //    null-terminated
+      static_assert(
+          std::extent_v<decltype(tek_inj_game_args::runtime_message)> ==
+          tek_inj::payload::max_message_len);
+      const auto len{std::min<std::size_t>(
+          std::ranges::find(status.message, u'\0') - status.message,
+          tek_inj::payload::max_message_len - 1)};
+      *std::copy_n(status.message, len, args.runtime_message) = L'\0';
+      return false;
+    }
+    default:
+      break;
+    }
+    if (!loaded) {
+      return false;
+    }
+    const auto now{GetTickCount64()};
+    const auto wait_res{
+        now < launch.deadline
+            ? WaitForSingleObject(launch.status_event,
+                                  static_cast<DWORD>(launch.deadline - now))
+            : WAIT_TIMEOUT};
+    switch (wait_res) {
+    case WAIT_OBJECT_0:
+      continue;
+    case WAIT_TIMEOUT:
+      SetLastError(ERROR_TIMEOUT);
+      [[fallthrough]];
+    default:
+      args.result = TEK_INJ_RES_runtime_init;
+      args.win32_error = GetLastError();
+      return false;
+    }
+  }
+}
+
+/// Inject TEK Game Runtime into the game process and resume its main thread.
+///
+/// @param [in, out] launch
+///    State of the launch started by @ref begin. Launch arguments' result
+///    fields are set upon return.
+static void commit(tek_inj_launch &launch) {
+  auto &args{*launch.args};
+  const auto timings{launch.timings};
+  if (!launch.status) {
+    launch.view.reset();
+  }
+  phase_end(timings, TEK_INJ_PHASE_mapping);
+  launch.deadline = GetTickCount64() + inject_timeout(args);
+  auto &inj{launch.inj};
+  inj.process = launch.process;
+  inj.main_thread = launch.thread;
+  inj.strategy = args.strategy;
+  bool loaded{start_injection(inj, launch.arena, timings, args)};
+  if (loaded) {
+    // Game's main thread must run for the DLLs to be loaded on it
+    if (inj.event && !resume_thread(launch)) {
       return;
     }
-    SECURITY_ATTRIBUTES attrs{.nLength = sizeof attrs,
-                              .lpSecurityDescriptor = &desc,
-                              .bInheritHandle = FALSE};
-    mapping = CreateFileMappingW(INVALID_HANDLE_VALUE, &attrs, PAGE_READWRITE,
-                                 0, buf_size, L"tek-game-runtime");
-  } else { // if (elevated && !(args->flags & TEK_INJ_FLAGS_run_as_admin))
-    mapping = CreateFileMappingW(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
-                                 0, buf_size, L"tek-game-runtime");
-  } // if (elevated && !(args->flags & TEK_INJ_FLAGS_run_as_admin)) else
-  if (!mapping) {
-    args->result = TEK_INJ_RES_create_mapping;
-    args->win32_error = GetLastError();
+    loaded = finish_injection(inj, wait_injection(inj, inject_timeout(args)),
+                              timings, args);
+  }
+  if (launch.status ? !wait_ready(launch, loaded) : !loaded) {
     return;
   }
-  // Map view of the file mapping and write data to it
-  std::unique_ptr<VOID, decltype(&UnmapViewOfFile)> view{
-      MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, 0), UnmapViewOfFile};
-  if (!view) {
-    args->result = TEK_INJ_RES_map_view;
-    args->win32_error = GetLastError();
+  resume(launch);
+}
+
+/// Record the outcome and phase durations of a completed launch in
+///    @ref launch_metrics.
+///
+/// @param launch
+///    State of the launch, with result fields of its arguments set.
+static void record_launch(const tek_inj_launch &launch) {
+  const auto &args{*launch.args};
+  LARGE_INTEGER now;
+  QueryPerformanceCounter(&now);
+  tek_inj::metrics::record(launch_metrics, *launch.timings, args.result,
+                           (args.result == TEK_INJ_RES_thread_wait ||
+                            args.result == TEK_INJ_RES_runtime_init) &&
+                               args.win32_error == ERROR_TIMEOUT,
+                           now.QuadPart);
+}
+
+/// Complete asynchronous commit: call the completion function and signal the
+///    event.
+///
+/// @param [in, out] launch
+///    State of the launch, with result fields of its arguments set.
+static void complete(tek_inj_launch &launch) {
+  record_launch(launch);
+  launch.done.store(true, std::memory_order::release);
+  if (launch.cb) {
+    launch.cb(&launch, launch.user_data);
+  }
+  if (launch.event) {
+    SetEvent(launch.event);
+  }
+}
+
+/// Thread pool callback completing asynchronous commit that has failed
+///    before the wait for the DLL to load has been registered.
+///
+/// @param [in, out] context
+///    Pointer to the launch state.
+static void CALLBACK deferred_complete_cb(PTP_CALLBACK_INSTANCE,
+                                          PVOID context) {
+  auto &launch{*static_cast<tek_inj_launch *>(context)};
+  AcquireSRWLockShared(&launch.lock);
+  const bool cancelled{launch.cancelled};
+  ReleaseSRWLockShared(&launch.lock);
+  if (!cancelled) {
+    complete(launch);
+  }
+  AcquireSRWLockExclusive(&launch.lock);
+  launch.deferred = false;
+  WakeAllConditionVariable(&launch.deferred_done);
+  ReleaseSRWLockExclusive(&launch.lock);
+}
+
+/// Complete asynchronous commit that has failed early on a thread pool
+///    thread, so the completion function doesn't run before the caller gets
+///    the launch state.
+///
+/// @param [in, out] launch
+///    State of the launch, with result fields of its arguments set.
+static void complete_deferred(tek_inj_launch &launch) {
+  // The launch is not visible to other threads yet, so the lock is not needed
+  launch.deferred = true;
+  if (!TrySubmitThreadpoolCallback(deferred_complete_cb, &launch, nullptr)) {
+    launch.deferred = false;
+    complete(launch);
+  }
+}
+
+/// Thread pool wait callback for the injection thread, or the event signaled
+///    by the loader stub on game's main thread, of asynchronous commit.
+///    If @ref TEK_INJ_FLAG_wait_ready is set, it also waits for TEK Game
+///    Runtime readiness, which normally follows the DLL load closely, and if
+///    @ref TEK_INJ_FLAG_prefetch is set, for prefetch to complete.
+///
+/// @param [in, out] context
+///    Pointer to the launch state.
+/// @param timed_out
+///    Value indicating whether the wait has timed out.
+static void CALLBACK inj_thread_wait_cb(PVOID context, BOOLEAN timed_out) {
+  auto &launch{*static_cast<tek_inj_launch *>(context)};
+  // Wait for commit_async to publish the wait handle, which the completion
+  //    function may rely on by freeing the launch after it's signaled
+  AcquireSRWLockShared(&launch.lock);
+  ReleaseSRWLockShared(&launch.lock);
+  auto &args{*launch.args};
+  const bool loaded{finish_injection(launch.inj,
+                                     timed_out ? WAIT_TIMEOUT : WAIT_OBJECT_0,
+                                     launch.timings, args)};
+  if (launch.status ? wait_ready(launch, loaded) : loaded) {
+    resume(launch);
+  }
+  complete(launch);
+}
+
+/// Begin injecting TEK Game Runtime into the game process without waiting for
+///    the DLL to load. The rest of the commit is performed by
+///    @ref inj_thread_wait_cb.
+///
+/// @param [in, out] launch
+///    State of the launch started by @ref begin.
+/// @param [in] cb
+///    Optional function to call upon completion of the launch.
+/// @param [in, out] user_data
+///    Value to pass to @p cb.
+static void commit_async(tek_inj_launch &launch,
+                         tek_inj_launch_cb *_Nullable cb,
+                         void *_Nullable user_data) {
+  auto &args{*launch.args};
+  const auto timings{launch.timings};
+  launch.cb = cb;
+  launch.user_data = user_data;
+  launch.event = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+  if (!launch.event) {
+    args.result = TEK_INJ_RES_thread_wait;
+    args.win32_error = GetLastError();
+    complete_deferred(launch);
     return;
   }
-  const auto hdr{reinterpret_cast<data_header *>(view.get())};
-  *hdr = {.type = args->type, .size = args->data_size};
-  std::ranges::copy_n(args->data, args->data_size,
-                      reinterpret_cast<char *>(hdr + 1));
-  view.reset();
-  // Create the thread for injecting the DLL
-  unique_handle inj_thread{
-      CreateRemoteThread(process, nullptr, 0,
-                         reinterpret_cast<LPTHREAD_START_ROUTINE>(
-                             reinterpret_cast<void *>(LoadLibraryW)),
-                         mem.get(), 0, nullptr)};
-  if (!inj_thread) {
-    args->result = TEK_INJ_RES_create_thread;
-    args->win32_error = GetLastError();
+  if (!launch.status) {
+    launch.view.reset();
+  }
+  phase_end(timings, TEK_INJ_PHASE_mapping);
+  launch.deadline = GetTickCount64() + inject_timeout(args);
+  auto &inj{launch.inj};
+  inj.process = launch.process;
+  inj.main_thread = launch.thread;
+  inj.strategy = args.strategy;
+  if (!start_injection(inj, launch.arena, timings, args)) {
+    complete_deferred(launch);
     return;
   }
-  // Wait for injection thread to finish
-  switch (WaitForSingleObject(inj_thread, 3000)) {
-  case WAIT_OBJECT_0:
-    break;
-  case WAIT_TIMEOUT:
-    SetLastError(ERROR_TIMEOUT);
-    [[fallthrough]];
-  default:
-    args->result = TEK_INJ_RES_thread_wait;
-    args->win32_error = GetLastError();
-    TerminateThread(inj_thread, 0);
+  // Game's main thread must run for the DLLs to be loaded on it, this also
+  //    waits for prefetch to complete on the calling thread
+  if (inj.event && !resume_thread(launch)) {
+    complete_deferred(launch);
     return;
   }
-  mapping.close();
-  mem.reset();
-  // Check injection thread exit code
-  DWORD exit_code;
-  if (GetExitCodeThread(inj_thread, &exit_code)) {
-    args->win32_error = 0;
+  // The callback may run before RegisterWaitForSingleObject returns, so it
+  //    waits for the lock until the handle is stored
+  AcquireSRWLockExclusive(&launch.lock);
+  HANDLE wait;
+  const bool registered{static_cast<bool>(RegisterWaitForSingleObject(
+      &wait, inj.event ? inj.event : inj.thread, inj_thread_wait_cb, &launch,
+      inject_timeout(args),
+      launch.status || launch.prefetch
+          ? WT_EXECUTEONLYONCE | WT_EXECUTELONGFUNCTION
+          : WT_EXECUTEONLYONCE))};
+  if (registered) {
+    launch.wait = wait;
+  }
+  ReleaseSRWLockExclusive(&launch.lock);
+  if (!registered) {
+    finish_injection(inj, WAIT_FAILED, timings, args);
+    complete_deferred(launch);
+  }
+}
+
+/// Start a suspended game process and add it to the pool.
+///
+/// @param [in, out] pool
+///    The pool to add the process to.
+/// @param [out] args
+///    Variable that receives arguments of the launch, including result
+///    fields.
+/// @return Value indicating whether the process has been started.
+static bool add_process(tek_inj_pool &pool, tek_inj_game_args &args) {
+  args = pool.args;
+  args.timings = nullptr;
+  // Pooled processes are started long before they're resumed, so there is
+  //    nothing for prefetch to overlap with
+  args.flags = static_cast<tek_inj_flag>(args.flags & ~TEK_INJ_FLAG_prefetch);
+  auto launch{std::make_unique<tek_inj_launch>(&args)};
+  if (!start_process(*launch)) {
+    return false;
+  }
+  // args is owned by the caller and doesn't outlive this call, launch
+  //    arguments are set to the claim's ones when the process is claimed
+  launch->args = nullptr;
+  AcquireSRWLockExclusive(&pool.lock);
+  pool.idle.emplace_back(std::move(launch));
+  ReleaseSRWLockExclusive(&pool.lock);
+  return true;
+}
+
+/// Decrement the number of pending background refills of the pool.
+///
+/// @param [in, out] pool
+///    The pool that the refill has been performed for.
+static void end_refill(tek_inj_pool &pool) {
+  AcquireSRWLockExclusive(&pool.lock);
+  if (!--pool.pending_refills) {
+    WakeAllConditionVariable(&pool.refills_done);
+  }
+  ReleaseSRWLockExclusive(&pool.lock);
+}
+
+/// Thread pool callback for background refill of the pool.
+///
+/// @param context
+///    Pointer to the pool.
+static void CALLBACK refill_cb(PTP_CALLBACK_INSTANCE, PVOID context) {
+  auto &pool{*static_cast<tek_inj_pool *>(context)};
+  // Failures are not reported, claims fall back to starting new processes
+  tek_inj_game_args args;
+  add_process(pool, args);
+  end_refill(pool);
+}
+
+/// Replace a claimed process according to the pool's refill policy.
+///
+/// @param [in, out] pool
+///    The pool to refill.
+static void refill(tek_inj_pool &pool) {
+  switch (pool.refill) {
+  case TEK_INJ_POOL_REFILL_none:
+    return;
+  case TEK_INJ_POOL_REFILL_on_claim: {
+    tek_inj_game_args args;
+    add_process(pool, args);
+    return;
+  }
+  case TEK_INJ_POOL_REFILL_background:
+    AcquireSRWLockExclusive(&pool.lock);
+    ++pool.pending_refills;
+    ReleaseSRWLockExclusive(&pool.lock);
+    if (!TrySubmitThreadpoolCallback(refill_cb, &pool, nullptr)) {
+      end_refill(pool);
+    }
+    return;
+  }
+}
+
+} // namespace
+
+extern "C" void tek_inj_run_game(tek_inj_game_args *args) {
+  tek_inj_launch launch{args};
+  if (begin_with_data(launch)) {
+    commit(launch);
+  }
+  record_launch(launch);
+}
+
+extern "C" tek_inj_launch *tek_inj_game_begin(tek_inj_game_args *args,
+                                              uint64_t data_size,
+                                              void **data) {
+  auto launch{std::make_unique<tek_inj_launch>(args)};
+  const auto buf{begin(*launch, data_size)};
+  if (!buf) {
+    record_launch(*launch);
+    return nullptr;
+  }
+  *data = buf;
+  return launch.release();
+}
+
+extern "C" void tek_inj_game_commit(tek_inj_launch *launch) {
+  const std::unique_ptr<tek_inj_launch> ptr{launch};
+  commit(*launch);
+  record_launch(*launch);
+}
+
+extern "C" void tek_inj_game_abort(tek_inj_launch *launch) { delete launch; }
+
+extern "C" tek_inj_launch *tek_inj_run_game_async(tek_inj_game_args *args,
+                                                  tek_inj_launch_cb *cb,
+                                                  void *user_data) {
+  auto launch{std::make_unique<tek_inj_launch>(args)};
+  if (!begin_with_data(*launch)) {
+    record_launch(*launch);
+    return nullptr;
+  }
+  commit_async(*launch, cb, user_data);
+  return launch.release();
+}
+
+extern "C" void tek_inj_game_commit_async(tek_inj_launch *launch,
+                                          tek_inj_launch_cb *cb,
+                                          void *user_data) {
+  commit_async(*launch, cb, user_data);
+}
+
+extern "C" HANDLE tek_inj_launch_event(const tek_inj_launch *launch) {
+  return launch->event;
+}
+
+extern "C" bool tek_inj_launch_done(const tek_inj_launch *launch) {
+  return launch->done.load(std::memory_order::acquire);
+}
+
+extern "C" void tek_inj_launch_free(tek_inj_launch *launch) { delete launch; }
+
+extern "C" tek_inj_pool *tek_inj_pool_create(tek_inj_pool_args *args) {
+  // Every pooled launch has its own arena
+  auto game_args{*args->game_args};
+  game_args.arena = nullptr;
+  auto pool{std::make_unique<tek_inj_pool>(game_args, args->refill)};
+  pool->idle.reserve(args->size);
+  for (std::uint32_t i{}; i < args->size; ++i) {
+    tek_inj_game_args process_args;
+    if (!add_process(*pool, process_args)) {
+      args->result = process_args.result;
+      args->win32_error = process_args.win32_error;
+      return nullptr;
+    }
+  }
+  args->result = TEK_INJ_RES_ok;
+  return pool.release();
+}
+
+extern "C" void tek_inj_pool_claim(tek_inj_pool *pool,
+                                   tek_inj_game_args *args) {
+  std::unique_ptr<tek_inj_launch> launch;
+  AcquireSRWLockExclusive(&pool->lock);
+  if (!pool->idle.empty()) {
+    launch = std::move(pool->idle.back());
+    pool->idle.pop_back();
+  }
+  ReleaseSRWLockExclusive(&pool->lock);
+  // Combine process arguments of the pool with settings arguments of the claim
+  auto game_args{pool->args};
+  game_args.type = args->type;
+  game_args.data_size = args->data_size;
+  game_args.data = args->data;
+  game_args.inject_timeout = args->inject_timeout;
+  game_args.timings = args->timings;
+  game_args.prefetched_bytes = 0;
+  if (launch) {
+    launch->args = &game_args;
+    launch->timings =
+        game_args.timings ? game_args.timings : &launch->own_timings;
+    game_args.pid = launch->pid;
+    game_args.tid = GetThreadId(launch->thread);
+    init_timings(launch->timings);
+    if (put_data(*launch)) {
+      commit(*launch);
+    }
+    record_launch(*launch);
+    launch.reset();
   } else {
-    exit_code = 0;
-    args->win32_error = GetLastError();
+    // The pool is exhausted
+    tek_inj_run_game(&game_args);
+  }
+  args->result = game_args.result;
+  args->win32_error = game_args.win32_error;
+  args->failed_dll = game_args.failed_dll;
+  args->prefetched_bytes = game_args.prefetched_bytes;
+  args->pid = game_args.pid;
+  args->tid = game_args.tid;
+  if (game_args.result == TEK_INJ_RES_runtime_init) {
+    std::ranges::copy(game_args.runtime_message, args->runtime_message);
+  }
+  if (game_args.result == TEK_INJ_RES_ok &&
+      (game_args.flags & TEK_INJ_FLAG_keep_process)) {
+    args->process = game_args.process;
+  }
+  if (game_args.result == TEK_INJ_RES_ok && game_args.job_limits) {
+    args->job = game_args.job;
   }
-  inj_thread.close();
-  if (!exit_code) {
-    args->result = TEK_INJ_RES_dll_load;
+  refill(*pool);
+}
+
+extern "C" uint32_t tek_inj_pool_available(tek_inj_pool *pool) {
+  AcquireSRWLockShared(&pool->lock);
+  const auto available{static_cast<std::uint32_t>(pool->idle.size())};
+  ReleaseSRWLockShared(&pool->lock);
+  return available;
+}
+
+extern "C" void tek_inj_pool_destroy(tek_inj_pool *pool) {
+  AcquireSRWLockExclusive(&pool->lock);
+  while (pool->pending_refills) {
+    SleepConditionVariableSRW(&pool->refills_done, &pool->lock, INFINITE, 0);
+  }
+  ReleaseSRWLockExclusive(&pool->lock);
+  // Destructors of the launches terminate unclaimed processes
+  delete pool;
+}
+
+extern "C" tek_inj_ctx *tek_inj_ctx_create(tek_inj_res *result,
+                                           DWORD *win32_error) {
+  // Helper functions report errors via result fields of API arguments
+  struct {
+    tek_inj_res result;
+    DWORD win32_error;
+  } status;
+  auto ctx{std::make_unique<tek_inj_ctx>()};
+  if (!is_elevated(ctx->elevated, status) ||
+      (ctx->elevated && (!create_mil_token(ctx->mil_token, status) ||
+                         !init_mapping_security(ctx->security, GENERIC_ALL,
+                                                status))) ||
+      !init_mapping_security(ctx->payload_security, shared_payload_access,
+                             status)) {
+    *result = status.result;
+    *win32_error = status.win32_error;
+    return nullptr;
+  }
+  *result = TEK_INJ_RES_ok;
+  return ctx.release();
+}
+
+extern "C" void tek_inj_ctx_destroy(tek_inj_ctx *ctx) { delete ctx; }
+
+extern "C" bool tek_inj_job_query(HANDLE job, tek_inj_job_stats *stats) {
+  JOBOBJECT_BASIC_AND_IO_ACCOUNTING_INFORMATION acct_info;
+  JOBOBJECT_EXTENDED_LIMIT_INFORMATION limit_info;
+  if (!QueryInformationJobObject(job, JobObjectBasicAndIoAccountingInformation,
+                                 &acct_info, sizeof acct_info, nullptr) ||
+      !QueryInformationJobObject(job, JobObjectExtendedLimitInformation,
+                                 &limit_info, sizeof limit_info, nullptr)) {
+    return false;
+  }
+  const auto &basic_info{acct_info.BasicInfo};
+  *stats = {.user_time = basic_info.TotalUserTime.QuadPart,
+            .kernel_time = basic_info.TotalKernelTime.QuadPart,
+            .peak_job_memory = limit_info.PeakJobMemoryUsed,
+            .peak_process_memory = limit_info.PeakProcessMemoryUsed,
+            .read_bytes = acct_info.IoInfo.ReadTransferCount,
+            .write_bytes = acct_info.IoInfo.WriteTransferCount,
+            .page_faults = basic_info.TotalPageFaultCount,
+            .active_processes = basic_info.ActiveProcesses,
+            .total_processes = basic_info.TotalProcesses};
+  return true;
+}
+
+extern "C" bool tek_inj_encode_settings(const char *json, size_t json_size,
+                                        char *buf, size_t buf_size,
+                                        size_t *size) {
+  const auto res{tek_inj::settings::encode({json, json_size}, buf, buf_size)};
+  *size = res.size;
+  return res.valid;
+}
+
+extern "C" size_t tek_inj_compress_settings(const char *data, size_t size,
+                                            char *buf) {
+  // Output that isn't smaller than the input is useless
+  return size ? tek_inj::settings::compress({data, size}, buf, size - 1) : 0;
+}
+
+extern "C" void tek_inj_attach(tek_inj_attach_args *args) {
+  bool elevated;
+  if (!is_elevated(args->ctx, elevated, *args)) {
     return;
   }
-  // Resume game's main thread execution
-  if (ResumeThread(thread) == static_cast<DWORD>(-1)) {
-    args->result = TEK_INJ_RES_resume_thread;
+  const unique_handle process{
+      OpenProcess(PROCESS_CREATE_THREAD | PROCESS_QUERY_INFORMATION |
+                      PROCESS_VM_OPERATION | PROCESS_VM_WRITE |
+                      PROCESS_VM_READ | SYNCHRONIZE,
+                  FALSE, args->pid)};
+  if (!process) {
+    args->result = TEK_INJ_RES_open_process;
     args->win32_error = GetLastError();
     return;
   }
-  process.success = true;
+  // Integrity level of the target process is unknown, so when current process
+  //    is elevated, restrict the mapping the same way as for non-elevated game
+  //    processes, it's accessible for elevated ones as well
+  mapping_security local_security;
+  const SECURITY_ATTRIBUTES *attrs{};
+  if (elevated) {
+    attrs = restricted_attrs(args->ctx, local_security, *args);
+    if (!attrs) {
+      return;
+    }
+  }
+  unique_handle mapping;
+  if (!create_mapping(args->pid, attrs, tek_inj::payload::size(args->data_size),
+                      nullptr, mapping, *args)) {
+    return;
+  }
+  {
+    const unique_view view{MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, 0),
+                           UnmapViewOfFile};
+    if (!view) {
+      args->result = TEK_INJ_RES_map_view;
+      args->win32_error = GetLastError();
+      return;
+    }
+    tek_inj::payload::write(view.get(), args->type, args->data,
+                            args->data_size);
+  }
+  arena_allocator arena;
+  arena.init(nullptr, 0,
+             injection_arena_size(*args, TEK_INJ_STRATEGY_remote_thread));
+  if (!load_dll(process, arena, inject_timeout(*args), nullptr, *args)) {
+    return;
+  }
   args->result = TEK_INJ_RES_ok;
 }
+
+extern "C" void tek_inj_metrics_snapshot(tek_inj_metrics *metrics,
+                                         bool reset) {
+  tek_inj::metrics::snapshot(launch_metrics, *metrics, reset);
+}
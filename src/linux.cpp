@@ -0,0 +1,1368 @@
+//===-- linux.cpp - TEK Injector Linux backend ----------------------------===//
+//
+// Copyright (c) 2025 Nuclearist <nuclearist@teknology-hub.com>
+// Part of tek-injector, under the GNU General Public License v3.0 or later
+// See https://github.com/teknology-hub/tek-injector/blob/main/COPYING for
+//    license information.
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+//===----------------------------------------------------------------------===//
+///
+/// @file
+///  Implementation of TEK Injector functions on Linux, via the platform
+///    backend that starts game processes with `fork` and `execve`, holding
+///    them in between until they're placed, and loads TEK Game Runtime via
+///    `LD_PRELOAD`, and of attaching to running processes via ptrace.
+///
+//===----------------------------------------------------------------------===//
+#include "tek-injector.h"
+
+#include "backend.hpp"
+#include "metrics.hpp"
+#include "payload.hpp"
+#include "prefetch.hpp"
+#include "ptrace_stub.hpp"
+#include "settings.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <charconv>
+#include <climits>
+#include <csignal>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <gnu/lib-names.h>
+#include <initializer_list>
+#include <linux/futex.h>
+#include <linux/ioprio.h>
+#include <sched.h>
+#include <span>
+#include <string>
+#include <string_view>
+#include <sys/mman.h>
+#include <sys/ptrace.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/sysmacros.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <sys/wait.h>
+#include <system_error>
+#include <thread>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+#ifdef __x86_64__
+#include <cpuid.h>
+#include <sys/user.h>
+#endif // def __x86_64__
+
+namespace {
+
+/// RAII wrapper for file descriptors.
+class [[gnu::visibility("internal")]] unique_fd {
+  int value;
+
+public:
+  constexpr unique_fd() noexcept : value{-1} {}
+  constexpr unique_fd(int fd) noexcept : value{fd} {}
+  unique_fd(const unique_fd &) = delete;
+  unique_fd &operator=(const unique_fd &) = delete;
+  ~unique_fd() noexcept { close(); }
+  constexpr explicit operator bool() const noexcept { return value >= 0; }
+  constexpr operator int() const noexcept { return value; }
+  void operator=(int fd) noexcept {
+    close();
+    value = fd;
+  }
+  int release() noexcept { return std::exchange(value, -1); }
+  void close() noexcept {
+    if (value >= 0) {
+      ::close(value);
+      value = -1;
+    }
+  }
+};
+
+/// State that game process uses between `fork` and `execve`, prepared
+///    before `fork`.
+struct [[gnu::visibility("internal")]] child_state {
+  /// Path to the game executable.
+  const char *_Nonnull exe_path;
+  /// Path to the current directory to set, or `nullptr`.
+  const char *_Nullable current_dir;
+  /// Null-terminated array of command-line arguments.
+  char *_Nullable const *_Nonnull argv;
+  /// Null-terminated array of environment variables.
+  char *_Nullable const *_Nonnull envp;
+  /// memfd with the payload, inherited by the executable.
+  int payload_fd;
+  /// Socket that the calling process writes to once the process is placed.
+  int release_fd;
+  /// Write end of the pipe that receives `errno` value if the executable
+  ///    can't be run.
+  int exec_fd;
+};
+
+/// Run game process side of the launch between `fork` and `execve`. Only
+///    async-signal-safe functions may be called here, as other threads of
+///    the calling process may have held locks at the time of `fork`.
+///
+/// @param state
+///    State prepared before `fork`.
+[[noreturn]] static void run_child(const child_state &state) noexcept {
+  // Signal mask is preserved by execve, unlike handlers, so don't pass the
+  //    calling thread's one on to the game
+  sigset_t mask;
+  sigemptyset(&mask);
+  sigprocmask(SIG_SETMASK, &mask, nullptr);
+  int err{};
+  if (fcntl(state.payload_fd, F_SETFD, 0) < 0) {
+    err = errno;
+  } else {
+    // Wait until the process is placed. If the calling process gives up, it
+    //    closes its end of the socket, and read returns 0
+    char cmd;
+    ssize_t res;
+    while ((res = read(state.release_fd, &cmd, 1)) < 0 && errno == EINTR)
+      ;
+    if (res != 1) {
+      _exit(127);
+    }
+    if (state.current_dir && chdir(state.current_dir) < 0) {
+      err = errno;
+    } else {
+      execve(state.exe_path, state.argv, state.envp);
+      err = errno;
+    }
+  }
+  if (write(state.exec_fd, &err, sizeof err)) {
+    // Nothing can be done if reporting the error fails, the calling process
+    //    sees an unexpected size either way
+  }
+  _exit(127);
+}
+
+/// Append a shared object path to the value of `LD_PRELOAD`.
+///
+/// @param [in, out] preload
+///    The value to append the path to.
+/// @param path
+///    Path to the shared object.
+/// @param current_dir
+///    Current directory of game process that relative @p path is relative
+///    to, or `nullptr` if it's the one of the calling process.
+/// @return 0 on success, otherwise `errno` value describing why the shared
+///    object can't be preloaded.
+static int append_preload(std::string &preload, std::string_view path,
+                          const char *_Nullable current_dir) {
+  const auto start{preload.length()};
+  if (start) {
+    preload.push_back(':');
+  }
+  const auto entry_start{preload.length()};
+  // The dynamic linker searches library directories for names without a
+  //    slash, so make relative paths explicit
+  if (!path.starts_with('/')) {
+    if (current_dir) {
+      preload.append(current_dir).push_back('/');
+    } else {
+      preload.append("./");
+    }
+  }
+  preload.append(path);
+  if (path.empty() ||
+      std::string_view{preload}.substr(entry_start).find_first_of(" :") !=
+          std::string_view::npos) {
+    preload.resize(start);
+    return EINVAL;
+  }
+  if (access(preload.c_str() + entry_start, R_OK) < 0) {
+    const auto err{errno};
+    preload.resize(start);
+    return err;
+  }
+  return 0;
+}
+
+/// Write a value to a control file of a cgroup.
+///
+/// @param cgroup_fd
+///    Descriptor of the cgroup directory.
+/// @param name
+///    Name of the control file.
+/// @param value
+///    The value to write.
+/// @return 0 on success, otherwise `errno` value describing the failure.
+static int write_control(int cgroup_fd, const char *_Nonnull name,
+                         std::string_view value) noexcept {
+  const unique_fd fd{openat(cgroup_fd, name, O_WRONLY | O_CLOEXEC)};
+  if (!fd) {
+    return errno;
+  }
+  // Control files take each value in a single write
+  if (write(fd, value.data(), value.size()) < 0) {
+    return errno;
+  }
+  return 0;
+}
+
+/// Write a number to a control file of a cgroup.
+///
+/// @param cgroup_fd
+///    Descriptor of the cgroup directory.
+/// @param name
+///    Name of the control file.
+/// @param value
+///    The number to write, in decimal.
+/// @param suffix
+///    String to append after the number.
+/// @return 0 on success, otherwise `errno` value describing the failure.
+static int write_control(int cgroup_fd, const char *_Nonnull name,
+                         std::uint64_t value,
+                         std::string_view suffix = {}) noexcept {
+  std::array<char, 48> buf;
+  const auto end{std::to_chars(buf.data(), buf.data() + 20, value).ptr};
+  return write_control(cgroup_fd, name,
+                       {buf.data(), std::ranges::copy(suffix, end).out});
+}
+
+/// Read a control file of a cgroup.
+///
+/// @param cgroup_fd
+///    Descriptor of the cgroup directory.
+/// @param name
+///    Name of the control file.
+/// @param [out] content
+///    Variable that receives content of the file. It's empty if the file
+///    doesn't exist, which is the case for files of controllers that aren't
+///    enabled for the cgroup.
+/// @return 0 on success, otherwise `errno` value describing the failure.
+static int read_control(int cgroup_fd, const char *_Nonnull name,
+                        std::string &content) {
+  content.clear();
+  const unique_fd fd{openat(cgroup_fd, name, O_RDONLY | O_CLOEXEC)};
+  if (!fd) {
+    return errno == ENOENT ? 0 : errno;
+  }
+  for (;;) {
+    const auto size{content.size()};
+    content.resize(size + 4096);
+    const auto res{read(fd, content.data() + size, 4096)};
+    if (res <= 0) {
+      content.resize(size);
+      if (res < 0) {
+        return errno;
+      }
+      return 0;
+    }
+    content.resize(size + static_cast<std::size_t>(res));
+  }
+}
+
+/// Parse a number at the start of a string.
+///
+/// @param str
+///    The string to parse.
+/// @return The number, or 0 if @p str doesn't start with one.
+static std::uint64_t parse_number(std::string_view str) noexcept {
+  std::uint64_t value{};
+  std::from_chars(str.data(), str.data() + str.size(), value);
+  return value;
+}
+
+/// Sum values of a key in content of a flat keyed or nested keyed control
+///    file of a cgroup, such as `cpu.stat` ("key value" lines) or `io.stat`
+///    ("device key=value..." lines).
+///
+/// @param content
+///    Content of the control file.
+/// @param key
+///    The key with its separator from the value, ' ' for flat keyed files
+///    and '=' for nested keyed ones.
+/// @return Sum of all values of @p key, 0 if there are none.
+static std::uint64_t sum_values(std::string_view content,
+                                std::string_view key) noexcept {
+  std::uint64_t sum{};
+  for (auto pos{content.find(key)}; pos != std::string_view::npos;
+       pos = content.find(key, pos + key.size())) {
+    if (pos && content[pos - 1] != '\n' && content[pos - 1] != ' ') {
+      continue;
+    }
+    sum += parse_number(content.substr(pos + key.size()));
+  }
+  return sum;
+}
+
+/// Platform backend for Linux, see @ref tek_inj::backend::platform.
+class [[gnu::visibility("internal")]] linux_backend {
+  /// memfd with the payload.
+  unique_fd payload_fd;
+  /// Mapped view of @ref payload_fd.
+  void *_Nonnull view{MAP_FAILED};
+  /// Size of @ref view, in bytes.
+  std::size_t view_size{};
+  /// ID of game process, 0 if it's not running or has been reaped.
+  pid_t pid{};
+  /// Socket that releases held game process when written to.
+  unique_fd release_fd;
+  /// Read end of the pipe that receives `errno` value from held game process
+  ///    if it fails to run the executable, closed by successful `execve`.
+  unique_fd exec_fd;
+  /// Descriptor of the directory that the cgroup of game process is created
+  ///    in.
+  unique_fd cgroup_parent_fd;
+  /// Descriptor of the cgroup directory of game process.
+  unique_fd cgroup_fd;
+  /// Null-terminated name of the cgroup of game process, empty if it hasn't
+  ///    been created.
+  std::array<char, 32> cgroup_name{};
+  /// Files to read into the file system cache.
+  tek_inj::prefetch::batch<std::string> prefetch;
+  /// Descriptor of current directory of game process, which relative paths
+  ///    in @ref prefetch are relative to.
+  unique_fd prefetch_dir_fd;
+  /// Threads reading @ref prefetch.
+  std::vector<std::thread> prefetch_threads;
+  /// Timestamp when the last thread reading @ref prefetch finished.
+  std::int64_t prefetch_end{};
+
+  /// Read files of @ref prefetch until none are left.
+  void prefetch_work() noexcept {
+    const int dir_fd{prefetch_dir_fd ? int{prefetch_dir_fd} : AT_FDCWD};
+    if (prefetch.work([dir_fd](const std::string &path) {
+          return tek_inj::prefetch::read_ahead(dir_fd, path.c_str());
+        })) {
+      prefetch_end = now();
+    }
+  }
+
+  /// Wait for threads reading @ref prefetch to finish.
+  void join_prefetch() noexcept {
+    for (auto &thread : prefetch_threads) {
+      thread.join();
+    }
+    prefetch_threads.clear();
+  }
+
+  /// Make threads reading @ref prefetch stop after their current file, and
+  ///    wait for them to finish.
+  void stop_prefetch() noexcept {
+    prefetch.cancel();
+    join_prefetch();
+  }
+
+  /// Create the cgroup of game process, set its limits, and move the process
+  ///    into it.
+  ///
+  /// @param limits
+  ///    Resource limits of the cgroup.
+  /// @param [in, out] args
+  ///    Input/output arguments of the launch.
+  /// @return Value indicating whether the process has been moved into the
+  ///    cgroup. If it hasn't, @p args result fields are set.
+  bool create_cgroup(const tek_inj_job_limits &limits,
+                     tek_inj_linux_game_args &args) noexcept {
+    if (!args.cgroup_parent || limits.cpu_rate > 10000) {
+      report(args, TEK_INJ_RES_job, EINVAL);
+      return false;
+    }
+    cgroup_parent_fd =
+        open(args.cgroup_parent, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (!cgroup_parent_fd) {
+      report(args, TEK_INJ_RES_job, errno);
+      return false;
+    }
+    constexpr std::string_view prefix{TEK_INJ_CGROUP_NAME_PREFIX};
+    std::array<char, 32> name{};
+    std::to_chars(std::ranges::copy(prefix, name.data()).out,
+                  name.data() + name.size() - 1, pid);
+    if (mkdirat(cgroup_parent_fd, name.data(), 0755) < 0) {
+      report(args, TEK_INJ_RES_job, errno);
+      return false;
+    }
+    cgroup_name = name;
+    cgroup_fd = openat(cgroup_parent_fd, name.data(),
+                       O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (!cgroup_fd) {
+      report(args, TEK_INJ_RES_job, errno);
+      return false;
+    }
+    // The quota is per period for all CPUs together, and the kernel rejects
+    //    ones below 1 ms
+    constexpr std::uint64_t cpu_period{100'000};
+    const auto num_cpus{static_cast<std::uint64_t>(
+        std::max(sysconf(_SC_NPROCESSORS_ONLN), 1L))};
+    const auto cpu_quota{std::max<std::uint64_t>(
+        limits.cpu_rate * cpu_period * num_cpus / 10000, 1000)};
+    int err{};
+    if (limits.memory_limit) {
+      err = write_control(cgroup_fd, "memory.max", limits.memory_limit);
+    }
+    if (!err && limits.cpu_rate) {
+      err = write_control(cgroup_fd, "cpu.max", cpu_quota, " 100000");
+    }
+    if (!err && limits.max_processes) {
+      err = write_control(cgroup_fd, "pids.max", limits.max_processes);
+    }
+    if (!err) {
+      err = write_control(cgroup_fd, "cgroup.procs",
+                          static_cast<std::uint64_t>(pid));
+    }
+    if (err) {
+      report(args, TEK_INJ_RES_job, err);
+      return false;
+    }
+    return true;
+  }
+
+public:
+  using args_type = tek_inj_linux_game_args;
+  static constexpr std::int64_t frequency{1'000'000'000};
+  static constexpr int timeout_error{ETIMEDOUT};
+
+  static std::int64_t now() noexcept {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<std::int64_t>(ts.tv_sec) * frequency + ts.tv_nsec;
+  }
+  static void report(args_type &args, tek_inj_res result,
+                     int error) noexcept {
+    args.result = result;
+    args.sys_error = error;
+  }
+
+  linux_backend() = default;
+  linux_backend(const linux_backend &) = delete;
+  linux_backend &operator=(const linux_backend &) = delete;
+  ~linux_backend() noexcept {
+    stop_prefetch();
+    if (view != MAP_FAILED) {
+      munmap(view, view_size);
+    }
+  }
+
+  void start_prefetch(const args_type &args) {
+    auto &paths{prefetch.paths};
+    paths.reserve(2 + args.num_extra_paths + args.num_prefetch_paths + 1);
+    paths.emplace_back(args.exe_path);
+    paths.emplace_back(args.runtime_path);
+    for (std::uint32_t i{}; i < args.num_extra_paths; ++i) {
+      paths.emplace_back(args.extra_paths[i]);
+    }
+    if (args.type == TEK_GR_LOAD_TYPE_file_path) {
+      // An empty path refers to the default file
+      paths.emplace_back(args.data && args.data_size
+                             ? std::string{args.data, args.data_size}
+                             : std::string{"tek-gr-settings.json"});
+    }
+    for (std::uint32_t i{}; i < args.num_prefetch_paths; ++i) {
+      paths.emplace_back(args.prefetch_paths[i]);
+    }
+    if (args.current_dir) {
+      prefetch_dir_fd =
+          open(args.current_dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+      if (!prefetch_dir_fd) {
+        return;
+      }
+    }
+    const auto num_workers{prefetch.start()};
+    prefetch_threads.reserve(num_workers);
+    for (std::size_t i{}; i < num_workers; ++i) {
+      try {
+        prefetch_threads.emplace_back(&linux_backend::prefetch_work, this);
+      } catch (const std::system_error &) {
+        // Do the work of the thread that can't be created, so the last one
+        //    to finish is still known
+        prefetch_work();
+      }
+    }
+  }
+
+  std::int64_t finish_prefetch(args_type &args) noexcept {
+    join_prefetch();
+    args.prefetched_bytes = prefetch.bytes.load(std::memory_order::relaxed);
+    return prefetch_end ? prefetch_end : now();
+  }
+
+  void *_Nullable create_payload(std::uint64_t size, args_type &args) {
+    payload_fd = memfd_create("tek-game-runtime",
+                              MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (!payload_fd ||
+        ftruncate(payload_fd, static_cast<off_t>(size)) < 0) {
+      report(args, TEK_INJ_RES_create_mapping, errno);
+      return nullptr;
+    }
+    view = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, payload_fd,
+                0);
+    if (view == MAP_FAILED) {
+      report(args, TEK_INJ_RES_map_view, errno);
+      return nullptr;
+    }
+    view_size = size;
+    return view;
+  }
+
+  bool spawn(args_type &args) {
+    // Game process must not be able to resize the memfd, as accesses to the
+    //    view beyond its end would fault
+    if (fcntl(payload_fd, F_ADD_SEALS,
+              F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) < 0) {
+      report(args, TEK_INJ_RES_create_mapping, errno);
+      return false;
+    }
+    // Everything game process uses is prepared before fork, see run_child
+    std::string preload;
+    for (std::uint32_t i{}; i <= args.num_extra_paths; ++i) {
+      if (const auto err{append_preload(
+              preload, i ? args.extra_paths[i - 1] : args.runtime_path,
+              args.current_dir)};
+          err) {
+        report(args, TEK_INJ_RES_dll_load, err);
+        args.failed_dll = i;
+        return false;
+      }
+    }
+    preload.insert(0, "LD_PRELOAD=");
+    const auto payload_var{std::string{TEK_INJ_PAYLOAD_FD_ENV "="}.append(
+        std::to_string(static_cast<int>(payload_fd)))};
+    std::vector<const char *> envp;
+    constexpr std::string_view preload_prefix{"LD_PRELOAD="};
+    for (auto var{args.envp ? args.envp : environ}; *var; ++var) {
+      const std::string_view var_view{*var};
+      if (var_view.starts_with(preload_prefix)) {
+        if (const auto value{var_view.substr(preload_prefix.length())};
+            !value.empty()) {
+          preload.append(":").append(value);
+        }
+        continue;
+      }
+      if (!var_view.starts_with(TEK_INJ_PAYLOAD_FD_ENV "=")) {
+        envp.emplace_back(*var);
+      }
+    }
+    envp.emplace_back(preload.c_str());
+    envp.emplace_back(payload_var.c_str());
+    envp.emplace_back(nullptr);
+    std::vector<const char *> argv;
+    argv.reserve(static_cast<std::size_t>(args.argc) + 2);
+    argv.emplace_back(args.exe_path);
+    for (int i{}; i < args.argc; ++i) {
+      argv.emplace_back(args.argv[i]);
+    }
+    argv.emplace_back(nullptr);
+    int release_fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, release_fds) < 0) {
+      report(args, TEK_INJ_RES_create_process, errno);
+      return false;
+    }
+    release_fd = release_fds[0];
+    const unique_fd child_release_fd{release_fds[1]};
+    int exec_fds[2];
+    if (pipe2(exec_fds, O_CLOEXEC) < 0) {
+      report(args, TEK_INJ_RES_create_process, errno);
+      return false;
+    }
+    exec_fd = exec_fds[0];
+    const unique_fd child_exec_fd{exec_fds[1]};
+    const auto child{fork()};
+    if (child < 0) {
+      report(args, TEK_INJ_RES_create_process, errno);
+      return false;
+    }
+    if (!child) {
+      run_child({.exe_path = args.exe_path,
+                 .current_dir = args.current_dir,
+                 .argv = const_cast<char *const *>(argv.data()),
+                 .envp = const_cast<char *const *>(envp.data()),
+                 .payload_fd = payload_fd,
+                 .release_fd = child_release_fd,
+                 .exec_fd = child_exec_fd});
+    }
+    pid = child;
+    args.pid = child;
+    return true;
+  }
+
+  bool place(args_type &args) noexcept {
+    // The cgroup goes first, as its cpuset may restrict affinity
+    if (args.job_limits && !create_cgroup(*args.job_limits, args)) {
+      return false;
+    }
+    // Held process is single-threaded, and threads it creates later inherit
+    //    both settings, as does the executable
+    if (args.affinity_mask) {
+      cpu_set_t set;
+      CPU_ZERO(&set);
+      for (unsigned cpu{}; cpu < 64; ++cpu) {
+        if (args.affinity_mask & (std::uint64_t{1} << cpu)) {
+          CPU_SET(cpu, &set);
+        }
+      }
+      if (sched_setaffinity(pid, sizeof set, &set) < 0) {
+        report(args, TEK_INJ_RES_placement, errno);
+        return false;
+      }
+    }
+    if (args.io_priority) {
+      int ioprio;
+      switch (args.io_priority) {
+      case TEK_INJ_IO_PRIORITY_very_low:
+        ioprio = IOPRIO_PRIO_VALUE(IOPRIO_CLASS_IDLE, 0);
+        break;
+      case TEK_INJ_IO_PRIORITY_low:
+        ioprio = IOPRIO_PRIO_VALUE(IOPRIO_CLASS_BE, 7);
+        break;
+      case TEK_INJ_IO_PRIORITY_normal:
+        ioprio = IOPRIO_PRIO_VALUE(IOPRIO_CLASS_BE, 4);
+        break;
+      default:
+        report(args, TEK_INJ_RES_placement, EINVAL);
+        return false;
+      }
+      if (syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, pid, ioprio) < 0) {
+        report(args, TEK_INJ_RES_placement, errno);
+        return false;
+      }
+    }
+    return true;
+  }
+
+  bool resume(args_type &args) {
+    // The process may only be gone if it's been killed, which must not
+    //    raise SIGPIPE in the calling process
+    constexpr char cmd{1};
+    if (send(release_fd, &cmd, 1, MSG_NOSIGNAL) != 1) {
+      report(args, TEK_INJ_RES_resume_thread, errno);
+      return false;
+    }
+    release_fd.close();
+    int err;
+    ssize_t res;
+    while ((res = read(exec_fd, &err, sizeof err)) < 0 && errno == EINTR)
+      ;
+    if (!res) {
+      return true;
+    }
+    if (res != sizeof err) {
+      err = res < 0 ? errno : EIO;
+    }
+    report(args, TEK_INJ_RES_create_process, err);
+    return false;
+  }
+
+  bool wait_status(const std::uint32_t &word, std::uint32_t value,
+                   std::int64_t deadline) noexcept {
+    const auto remaining{deadline - now()};
+    if (remaining <= 0) {
+      return false;
+    }
+    const timespec timeout{.tv_sec = static_cast<time_t>(remaining / frequency),
+                           .tv_nsec = static_cast<long>(remaining % frequency)};
+    // Wakes, timeouts, interruptions and value mismatches all make the caller
+    //    check the state again
+    syscall(SYS_futex, const_cast<std::uint32_t *>(&word), FUTEX_WAIT, value,
+            &timeout, nullptr, 0);
+    return true;
+  }
+
+  void terminate() noexcept {
+    stop_prefetch();
+    if (pid) {
+      kill(pid, SIGKILL);
+      while (waitpid(pid, nullptr, 0) < 0 && errno == EINTR)
+        ;
+      pid = 0;
+    }
+    // A cgroup can only be removed once it has no processes
+    if (cgroup_name[0]) {
+      cgroup_fd.close();
+      unlinkat(cgroup_parent_fd, cgroup_name.data(), AT_REMOVEDIR);
+      cgroup_name[0] = '\0';
+    }
+  }
+
+  /// Transfer ownership of the cgroup directory descriptor to the caller.
+  ///
+  /// @return Descriptor of the cgroup directory of game process, or -1 if
+  ///    there is none.
+  int release_cgroup() noexcept { return cgroup_fd.release(); }
+};
+
+static_assert(tek_inj::backend::platform<linux_backend>);
+
+#ifdef __x86_64__
+
+//===-- Attaching ---------------------------------------------------------===//
+
+/// Location of libc functions that the loader routine uses, relative to the
+///    start of libc file mapping, which is the same in every process that
+///    uses the same libc file.
+struct [[gnu::visibility("internal")]] libc_info {
+  /// Device of libc file.
+  dev_t dev;
+  /// Inode number of libc file.
+  ino_t ino;
+  /// Offset of `dlopen`.
+  std::uint64_t dlopen_offset;
+  /// Offset of the `syscall` instruction inside of `syscall` function.
+  std::uint64_t syscall_offset;
+};
+
+/// Find libc functions used for attaching in the calling process.
+///
+/// @param [out] info
+///    Variable that receives locations of the functions.
+/// @return 0 on success, otherwise `errno` value describing why they can't be
+///    found.
+static int find_libc(libc_info &info) noexcept {
+  // Functions are looked up in libc itself, as sanitizers intercept dlopen in
+  //    the calling process
+  const auto handle{dlopen(LIBC_SO, RTLD_LAZY | RTLD_NOLOAD)};
+  if (!handle) {
+    return ENOSYS;
+  }
+  const auto dlopen_addr{dlsym(handle, "dlopen")};
+  const auto syscall_addr{dlsym(handle, "syscall")};
+  dlclose(handle);
+  Dl_info dl_info;
+  if (!dlopen_addr || !syscall_addr || !dladdr(dlopen_addr, &dl_info)) {
+    return ENOSYS;
+  }
+  struct stat st;
+  if (stat(dl_info.dli_fname, &st) < 0) {
+    return errno;
+  }
+  // syscall function only moves its arguments to the registers before the
+  //    instruction
+  const std::string_view code{static_cast<const char *>(syscall_addr), 64};
+  const auto pos{code.find("\x0F\x05")};
+  if (pos == std::string_view::npos) {
+    return ENOSYS;
+  }
+  const auto base{reinterpret_cast<std::uintptr_t>(dl_info.dli_fbase)};
+  info = {.dev = st.st_dev,
+          .ino = st.st_ino,
+          .dlopen_offset = reinterpret_cast<std::uintptr_t>(dlopen_addr) - base,
+          .syscall_offset =
+              reinterpret_cast<std::uintptr_t>(syscall_addr) + pos - base};
+  return 0;
+}
+
+/// Find the start of libc file mapping in a process.
+///
+/// @param proc_fd
+///    Descriptor of /proc directory of the process.
+/// @param libc
+///    Information about libc of the calling process.
+/// @return Address of the mapping, or 0 if the process doesn't use the same
+///    libc file.
+static std::uint64_t find_remote_libc(int proc_fd, const libc_info &libc) {
+  const unique_fd maps_fd{openat(proc_fd, "maps", O_RDONLY | O_CLOEXEC)};
+  if (!maps_fd) {
+    return 0;
+  }
+  std::string maps;
+  for (;;) {
+    char buf[4096];
+    const auto res{read(maps_fd, buf, sizeof buf)};
+    if (res > 0) {
+      maps.append(buf, static_cast<std::size_t>(res));
+    } else if (!res || errno != EINTR) {
+      break;
+    }
+  }
+  for (std::size_t pos{}; pos < maps.length();) {
+    auto end{maps.find('\n', pos)};
+    if (end == std::string::npos) {
+      end = maps.length();
+    }
+    maps[end] = '\0';
+    unsigned long long start, offset, inode;
+    unsigned dev_major, dev_minor;
+    if (std::sscanf(maps.c_str() + pos, "%llx-%*x %*s %llx %x:%x %llu", &start,
+                    &offset, &dev_major, &dev_minor, &inode) == 5 &&
+        !offset && inode == libc.ino &&
+        makedev(dev_major, dev_minor) == libc.dev) {
+      return start;
+    }
+    pos = end + 1;
+  }
+  return 0;
+}
+
+/// Get the size of the FPU state area for the loader routine.
+///
+/// @param [out] xsave
+///    Variable that receives value indicating whether `xsave` is used.
+/// @return Size of the area, in bytes.
+static std::size_t fpu_state_size(bool &xsave) noexcept {
+  unsigned eax, ebx, ecx, edx;
+  // OSXSAVE bit tells that the OS has enabled xsave and set XCR0
+  xsave = __get_cpuid(1, &eax, &ebx, &ecx, &edx) && (ecx & bit_OSXSAVE) &&
+          __get_cpuid_count(0xD, 0, &eax, &ebx, &ecx, &edx) && ebx;
+  return xsave ? ebx : tek_inj::ptrace_stub::fxsave_size;
+}
+
+/// Check whether a system call result is an error code.
+///
+/// @param res
+///    The result.
+/// @return Value indicating whether @p res is a negated `errno` value.
+static constexpr bool is_sys_error(std::int64_t res) noexcept {
+  return res < 0 && res > -4096;
+}
+
+/// Main thread of another process seized via ptrace and stopped. Upon
+///    destruction, it's detached with the registers that it was stopped
+///    with, unless they're replaced via @ref detach.
+class [[gnu::visibility("internal")]] traced_thread {
+  /// ID of the thread, 0 if it's not seized.
+  pid_t tid{};
+  /// Signal that the thread has received while being traced, delivered to it
+  ///    upon detaching.
+  int pending_signal{};
+  /// Value indicating whether registers of the thread differ from
+  ///    @ref stop_regs.
+  bool modified{};
+  /// Register values that the thread was stopped with.
+  user_regs_struct stop_regs;
+
+  /// Wait until the thread stops for the expected reason. Signals received in
+  ///    the meantime are held until detaching.
+  ///
+  /// @param request
+  ///    `PTRACE_INTERRUPT` to wait for the stop that it causes, or
+  ///    `PTRACE_SINGLESTEP` to wait for the step to complete.
+  /// @return 0 on success, otherwise `errno` value.
+  int wait_stop(__ptrace_request request) noexcept {
+    for (;;) {
+      int status;
+      if (waitpid(tid, &status, __WALL) < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        return errno;
+      }
+      if (!WIFSTOPPED(status)) {
+        tid = 0;
+        return ESRCH;
+      }
+      const auto event{status >> 16};
+      const auto sig{WSTOPSIG(status)};
+      if (request == PTRACE_INTERRUPT ? event == PTRACE_EVENT_STOP
+                                      : !event && sig == SIGTRAP) {
+        return 0;
+      }
+      if (!event) {
+        pending_signal = sig;
+      }
+      // Signal-delivery-stops happen before the step, so it's repeated
+      if (ptrace(request == PTRACE_INTERRUPT ? PTRACE_CONT : request, tid,
+                 nullptr, nullptr) < 0) {
+        return errno;
+      }
+    }
+  }
+
+public:
+  traced_thread() = default;
+  traced_thread(const traced_thread &) = delete;
+  traced_thread &operator=(const traced_thread &) = delete;
+  ~traced_thread() noexcept {
+    if (tid) {
+      detach(stop_regs);
+    }
+  }
+
+  /// Register values that the thread was stopped with.
+  constexpr const user_regs_struct &regs() const noexcept { return stop_regs; }
+
+  /// Seize and stop the thread.
+  ///
+  /// @param pid
+  ///    ID of the process, which is also the ID of its main thread.
+  /// @return 0 on success, otherwise `errno` value.
+  int seize(pid_t pid) noexcept {
+    if (ptrace(PTRACE_SEIZE, pid, nullptr, nullptr) < 0) {
+      return errno;
+    }
+    tid = pid;
+    if (ptrace(PTRACE_INTERRUPT, tid, nullptr, nullptr) < 0) {
+      return errno;
+    }
+    if (const auto err{wait_stop(PTRACE_INTERRUPT)}; err) {
+      return err;
+    }
+    return ptrace(PTRACE_GETREGS, tid, nullptr, &stop_regs) < 0 ? errno : 0;
+  }
+
+  /// Make a system call on the thread by stepping over an existing `syscall`
+  ///    instruction, so no code of the process is modified.
+  ///
+  /// @param insn
+  ///    Address of the instruction.
+  /// @param nr
+  ///    Number of the system call.
+  /// @return Result of the system call, or negated `errno` value if it can't
+  ///    be made.
+  std::int64_t syscall(std::uint64_t insn, long nr, std::uint64_t arg1,
+                       std::uint64_t arg2, std::uint64_t arg3 = 0,
+                       std::uint64_t arg4 = 0, std::uint64_t arg5 = 0,
+                       std::uint64_t arg6 = 0) noexcept {
+    auto regs{stop_regs};
+    regs.rip = insn;
+    regs.rax = static_cast<std::uint64_t>(nr);
+    regs.rdi = arg1;
+    regs.rsi = arg2;
+    regs.rdx = arg3;
+    regs.r10 = arg4;
+    regs.r8 = arg5;
+    regs.r9 = arg6;
+    // Keep the kernel from restarting the system call that the thread has
+    //    been interrupted in, if any
+    regs.orig_rax = static_cast<std::uint64_t>(-1);
+    modified = true;
+    if (ptrace(PTRACE_SETREGS, tid, nullptr, &regs) < 0 ||
+        ptrace(PTRACE_SINGLESTEP, tid, nullptr, nullptr) < 0) {
+      return -errno;
+    }
+    if (const auto err{wait_stop(PTRACE_SINGLESTEP)}; err) {
+      return -err;
+    }
+    if (ptrace(PTRACE_GETREGS, tid, nullptr, &regs) < 0) {
+      return -errno;
+    }
+    return static_cast<std::int64_t>(regs.rax);
+  }
+
+  /// Set registers of the thread and detach from it.
+  ///
+  /// @param regs
+  ///    Register values to set.
+  /// @return 0 on success, otherwise `errno` value.
+  int detach(const user_regs_struct &regs) noexcept {
+    int err{};
+    if (ptrace(PTRACE_SETREGS, tid, nullptr, &regs) < 0) {
+      err = errno;
+      if (modified) {
+        ptrace(PTRACE_SETREGS, tid, nullptr, &stop_regs);
+      }
+    }
+    ptrace(PTRACE_DETACH, tid, nullptr,
+           reinterpret_cast<void *>(static_cast<std::uintptr_t>(
+               pending_signal)));
+    tid = 0;
+    return err;
+  }
+};
+
+/// Get register values that the thread must continue with after the loader
+///    routine, completing interruption of the system call that the thread
+///    may have been in the way the kernel would have upon resuming it.
+///
+/// @param regs
+///    Register values that the thread was stopped with.
+/// @return Register values for the routine to restore.
+static tek_inj::ptrace_stub::regs resume_regs(const user_regs_struct &regs) {
+  tek_inj::ptrace_stub::regs res{.rip = regs.rip,
+                                 .rsp = regs.rsp,
+                                 .rflags = regs.eflags,
+                                 .rax = regs.rax,
+                                 .rbx = regs.rbx,
+                                 .rcx = regs.rcx,
+                                 .rdx = regs.rdx,
+                                 .rsi = regs.rsi,
+                                 .rdi = regs.rdi,
+                                 .rbp = regs.rbp,
+                                 .r8 = regs.r8,
+                                 .r9 = regs.r9,
+                                 .r10 = regs.r10,
+                                 .r11 = regs.r11,
+                                 .r12 = regs.r12,
+                                 .r13 = regs.r13,
+                                 .r14 = regs.r14,
+                                 .r15 = regs.r15};
+  if (static_cast<std::int64_t>(regs.orig_rax) < 0) {
+    return res;
+  }
+  // Kernel-internal error codes that request a restart
+  constexpr std::int64_t erestartsys{512};
+  constexpr std::int64_t erestartnointr{513};
+  constexpr std::int64_t erestartnohand{514};
+  constexpr std::int64_t erestart_restartblock{516};
+  switch (-static_cast<std::int64_t>(regs.rax)) {
+  case erestartsys:
+  case erestartnointr:
+  case erestartnohand:
+    // Run the syscall instruction again
+    res.rax = regs.orig_rax;
+    res.rip -= 2;
+    break;
+  case erestart_restartblock:
+    // The restart state is kept by the kernel per thread, and system calls
+    //    made by constructors of the shared objects may replace it
+    res.rax = static_cast<std::uint64_t>(-EINTR);
+    break;
+  default:
+    break;
+  }
+  return res;
+}
+
+/// Free the block of the loader routine after it has set the completion flag,
+///    once the thread has left the code. If it doesn't do so in time, or its
+///    state can't be checked, the block is left allocated.
+///
+/// @param pid
+///    ID of the process.
+/// @param insn
+///    Address of a `syscall` instruction in the process.
+/// @param block
+///    Address of the block.
+/// @param block_size
+///    Size of the block, in bytes.
+static void free_block(pid_t pid, std::uint64_t insn, std::uint64_t block,
+                       std::size_t block_size) noexcept {
+  // The thread may only be in the code for a few instructions after setting
+  //    the flag
+  const auto deadline{linux_backend::now() + linux_backend::frequency};
+  do {
+    traced_thread thread;
+    if (thread.seize(pid)) {
+      return;
+    }
+    if (const auto rip{thread.regs().rip};
+        rip < block || rip >= block + tek_inj::ptrace_stub::code.size()) {
+      thread.syscall(insn, SYS_munmap, block, block_size);
+      return;
+    }
+    thread.detach(thread.regs());
+    sched_yield();
+  } while (linux_backend::now() < deadline);
+}
+
+/// Load shared objects on the main thread of a running process via the
+///    loader routine, and wait for them to load.
+/// If the wait fails, the thread may be holding the dynamic linker's lock,
+///    so it's left to finish loading, and the block it uses is deliberately
+///    leaked.
+///
+/// @param proc_fd
+///    Descriptor of /proc directory of the process.
+/// @param libc
+///    Information about libc of the calling process.
+/// @param paths
+///    Absolute paths to the shared objects to load.
+/// @param [in, out] args
+///    Input/output arguments of the public API function. Only result fields
+///    are used.
+/// @return Value indicating whether the shared objects have been loaded. If
+///    they haven't, @p args result fields are set.
+static bool load_shared_objects(int proc_fd, const libc_info &libc,
+                                std::span<const char *const> paths,
+                                tek_inj_linux_attach_args &args) {
+  const auto libc_base{find_remote_libc(proc_fd, libc)};
+  if (!libc_base) {
+    args.result = TEK_INJ_RES_create_thread;
+    args.sys_error = ENOENT;
+    return false;
+  }
+  const auto insn{libc_base + libc.syscall_offset};
+  bool xsave;
+  const auto fpu_size{fpu_state_size(xsave)};
+  const auto page_size{static_cast<std::size_t>(sysconf(_SC_PAGESIZE))};
+  const auto block_size{
+      (tek_inj::ptrace_stub::size(paths, fpu_size) + page_size - 1) &
+      ~(page_size - 1)};
+  std::uint64_t block;
+  {
+    traced_thread thread;
+    if (const auto err{thread.seize(args.pid)}; err) {
+      args.result = TEK_INJ_RES_open_process;
+      args.sys_error = err;
+      return false;
+    }
+    // Check that the instruction is there, in case the process has mapped the
+    //    same file differently
+    std::uint16_t insn_bytes;
+    const iovec local_insn{.iov_base = &insn_bytes,
+                           .iov_len = sizeof insn_bytes};
+    const iovec remote_insn{.iov_base = reinterpret_cast<void *>(insn),
+                            .iov_len = sizeof insn_bytes};
+    if (process_vm_readv(args.pid, &local_insn, 1, &remote_insn, 1, 0) !=
+            sizeof insn_bytes ||
+        insn_bytes != 0x050F) {
+      args.result = TEK_INJ_RES_create_thread;
+      args.sys_error = ENOEXEC;
+      return false;
+    }
+    const auto mmap_res{thread.syscall(insn, SYS_mmap, 0, block_size,
+                                       PROT_READ | PROT_WRITE,
+                                       MAP_PRIVATE | MAP_ANONYMOUS,
+                                       static_cast<std::uint64_t>(-1), 0)};
+    if (is_sys_error(mmap_res)) {
+      args.result = TEK_INJ_RES_mem_alloc;
+      args.sys_error = static_cast<int>(-mmap_res);
+      return false;
+    }
+    block = static_cast<std::uint64_t>(mmap_res);
+    std::vector<char> buf(block_size);
+    tek_inj::ptrace_stub::write(
+        buf.data(), block,
+        {.dlopen = libc_base + libc.dlopen_offset,
+         .num_paths = 0,
+         .fpu_state = 0,
+         .xsave = xsave,
+         .loaded = 0,
+         .done = 0,
+         .saved = resume_regs(thread.regs())},
+        paths, fpu_size);
+    const iovec local_block{.iov_base = buf.data(), .iov_len = buf.size()};
+    const iovec remote_block{.iov_base = reinterpret_cast<void *>(block),
+                             .iov_len = buf.size()};
+    if (process_vm_writev(args.pid, &local_block, 1, &remote_block, 1, 0) !=
+        static_cast<ssize_t>(buf.size())) {
+      args.result = TEK_INJ_RES_mem_write;
+      args.sys_error = errno;
+      thread.syscall(insn, SYS_munmap, block, block_size);
+      return false;
+    }
+    if (const auto res{thread.syscall(insn, SYS_mprotect, block,
+                                      tek_inj::ptrace_stub::param_offset,
+                                      PROT_READ | PROT_EXEC)};
+        is_sys_error(res)) {
+      args.result = TEK_INJ_RES_mem_protect;
+      args.sys_error = static_cast<int>(-res);
+      thread.syscall(insn, SYS_munmap, block, block_size);
+      return false;
+    }
+    // Redirect the thread to the routine, with the stack below the red zone
+    //    and aligned the way it is before a call instruction
+    auto regs{thread.regs()};
+    regs.rip = block;
+    regs.rsp = (regs.rsp - 128) & ~std::uint64_t{15};
+    regs.orig_rax = static_cast<std::uint64_t>(-1);
+    if (const auto err{thread.detach(regs)}; err) {
+      args.result = TEK_INJ_RES_create_thread;
+      args.sys_error = err;
+      return false;
+    }
+  }
+  // There is nothing in the process to wait on, so poll the completion flag
+  const std::int64_t timeout{args.inject_timeout ? args.inject_timeout
+                                                 : 3000};
+  const auto deadline{linux_backend::now() +
+                      timeout * linux_backend::frequency / 1000};
+  tek_inj::ptrace_stub::param param;
+  const iovec local_param{.iov_base = &param, .iov_len = sizeof param};
+  const iovec remote_param{
+      .iov_base = reinterpret_cast<void *>(block +
+                                           tek_inj::ptrace_stub::param_offset),
+      .iov_len = sizeof param};
+  for (;;) {
+    if (process_vm_readv(args.pid, &local_param, 1, &remote_param, 1, 0) !=
+        sizeof param) {
+      args.result = TEK_INJ_RES_thread_wait;
+      args.sys_error = errno;
+      return false;
+    }
+    if (param.done) {
+      break;
+    }
+    if (linux_backend::now() >= deadline) {
+      args.result = TEK_INJ_RES_thread_wait;
+      args.sys_error = ETIMEDOUT;
+      return false;
+    }
+    constexpr timespec interval{.tv_sec = 0, .tv_nsec = 1'000'000};
+    nanosleep(&interval, nullptr);
+  }
+  free_block(args.pid, insn, block, block_size);
+  if (param.loaded < paths.size()) {
+    args.result = TEK_INJ_RES_dll_load;
+    args.failed_dll = static_cast<std::uint32_t>(param.loaded);
+    return false;
+  }
+  return true;
+}
+
+#endif // def __x86_64__
+
+/// Statistics of launches made by current process.
+constinit tek_inj::metrics::registry launch_metrics;
+
+} // namespace
+
+extern "C" void tek_inj_linux_run_game(tek_inj_linux_game_args *args) {
+  linux_backend backend;
+  tek_inj::backend::run(backend, *args, launch_metrics);
+  if (args->result == TEK_INJ_RES_ok && args->job_limits) {
+    args->cgroup_fd = backend.release_cgroup();
+  }
+}
+
+extern "C" bool tek_inj_linux_job_query(int cgroup_fd,
+                                        tek_inj_job_stats *stats) {
+  std::string cpu_stat;
+  std::string memory_peak;
+  std::string memory_stat;
+  std::string io_stat;
+  std::string procs;
+  for (const auto &[name, content] :
+       std::initializer_list<std::pair<const char *, std::string &>>{
+           {"cpu.stat", cpu_stat},
+           {"memory.peak", memory_peak},
+           {"memory.stat", memory_stat},
+           {"io.stat", io_stat},
+           {"cgroup.procs", procs}}) {
+    if (const auto err{read_control(cgroup_fd, name, content)}; err) {
+      errno = err;
+      return false;
+    }
+  }
+  // cpu.stat is present in every cgroup, unlike files of controllers
+  if (cpu_stat.empty()) {
+    errno = ENOENT;
+    return false;
+  }
+  *stats = {
+      .user_time =
+          static_cast<std::int64_t>(sum_values(cpu_stat, "user_usec ") * 10),
+      .kernel_time =
+          static_cast<std::int64_t>(sum_values(cpu_stat, "system_usec ") * 10),
+      .peak_job_memory = parse_number(memory_peak),
+      .peak_process_memory = 0,
+      .read_bytes = sum_values(io_stat, "rbytes="),
+      .write_bytes = sum_values(io_stat, "wbytes="),
+      .page_faults = static_cast<std::uint32_t>(std::min<std::uint64_t>(
+          sum_values(memory_stat, "pgfault "), UINT32_MAX)),
+      .active_processes = static_cast<std::uint32_t>(
+          std::ranges::count(procs, '\n')),
+      .total_processes = 0};
+  return true;
+}
+
+extern "C" void tek_inj_linux_attach(tek_inj_linux_attach_args *args) {
+  args->result = TEK_INJ_RES_ok;
+  args->sys_error = 0;
+  args->failed_dll = 0;
+#ifdef __x86_64__
+  const auto proc_path{std::string{"/proc/"}.append(std::to_string(args->pid))};
+  const unique_fd proc_fd{
+      open(proc_path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC)};
+  if (!proc_fd) {
+    args->result = TEK_INJ_RES_open_process;
+    args->sys_error = errno == ENOENT ? ESRCH : errno;
+    return;
+  }
+  // dlopen resolves relative paths against current directory of the process,
+  //    which may change, so make them absolute
+  std::string cwd;
+  std::vector<std::string> paths;
+  paths.reserve(args->num_extra_paths + 1);
+  for (std::uint32_t i{}; i <= args->num_extra_paths; ++i) {
+    const std::string_view path{i ? args->extra_paths[i - 1]
+                                  : args->runtime_path};
+    auto &abs_path{paths.emplace_back()};
+    if (!path.starts_with('/')) {
+      if (cwd.empty()) {
+        char buf[PATH_MAX];
+        const auto len{readlinkat(proc_fd, "cwd", buf, sizeof buf)};
+        if (len < 0) {
+          args->result = TEK_INJ_RES_open_process;
+          args->sys_error = errno;
+          return;
+        }
+        cwd.assign(buf, static_cast<std::size_t>(len));
+      }
+      abs_path.assign(cwd).push_back('/');
+    }
+    abs_path.append(path);
+    if (path.empty() || access(abs_path.c_str(), R_OK) < 0) {
+      args->result = TEK_INJ_RES_dll_load;
+      args->sys_error = path.empty() ? EINVAL : errno;
+      args->failed_dll = i;
+      return;
+    }
+  }
+  libc_info libc;
+  if (const auto err{find_libc(libc)}; err) {
+    args->result = TEK_INJ_RES_create_thread;
+    args->sys_error = err;
+    return;
+  }
+  const auto shm_name{std::string{TEK_INJ_SHM_NAME_PREFIX}.append(
+      std::to_string(args->pid))};
+  // An object left by an injector that has crashed would make creation fail
+  shm_unlink(shm_name.c_str());
+  const unique_fd shm_fd{shm_open(shm_name.c_str(),
+                                  O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC,
+                                  S_IRUSR | S_IWUSR)};
+  if (!shm_fd) {
+    args->result = TEK_INJ_RES_create_mapping;
+    args->sys_error = errno;
+    return;
+  }
+  const auto size{tek_inj::payload::size(args->data_size)};
+  struct stat proc_st;
+  // The process may run as another user if the calling one is privileged
+  if (fstat(proc_fd, &proc_st) < 0 ||
+      (proc_st.st_uid != geteuid() &&
+       fchown(shm_fd, proc_st.st_uid, static_cast<gid_t>(-1)) < 0) ||
+      ftruncate(shm_fd, static_cast<off_t>(size)) < 0) {
+    args->result = TEK_INJ_RES_create_mapping;
+    args->sys_error = errno;
+    shm_unlink(shm_name.c_str());
+    return;
+  }
+  const auto view{
+      mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd, 0)};
+  if (view == MAP_FAILED) {
+    args->result = TEK_INJ_RES_map_view;
+    args->sys_error = errno;
+    shm_unlink(shm_name.c_str());
+    return;
+  }
+  tek_inj::payload::write(view, args->type, args->data, args->data_size);
+  munmap(view, size);
+  std::vector<const char *> path_ptrs;
+  path_ptrs.reserve(paths.size());
+  for (const auto &path : paths) {
+    path_ptrs.emplace_back(path.c_str());
+  }
+  // The runtime opens the object while loading, so it's no longer needed
+  //    once loading has finished, or has been given up on
+  load_shared_objects(proc_fd, libc, path_ptrs, *args);
+  shm_unlink(shm_name.c_str());
+#else  // def __x86_64__
+  args->result = TEK_INJ_RES_create_thread;
+  args->sys_error = ENOSYS;
+#endif // def __x86_64__ else
+}
+
+extern "C" bool tek_inj_encode_settings(const char *json, size_t json_size,
+                                        char *buf, size_t buf_size,
+                                        size_t *size) {
+  const auto res{tek_inj::settings::encode({json, json_size}, buf, buf_size)};
+  *size = res.size;
+  return res.valid;
+}
+
+extern "C" size_t tek_inj_compress_settings(const char *data, size_t size,
+                                            char *buf) {
+  // Output that isn't smaller than the input is useless
+  return size ? tek_inj::settings::compress({data, size}, buf, size - 1) : 0;
+}
+
+extern "C" void tek_inj_metrics_snapshot(tek_inj_metrics *metrics,
+                                         bool reset) {
+  tek_inj::metrics::snapshot(launch_metrics, *metrics, reset);
+}
@@ -0,0 +1,164 @@
+//===-- loader_stub.hpp - Remote multi-DLL loader -------------------------===//
+//
+// Copyright (c) 2025 Nuclearist <nuclearist@teknology-hub.com>
+// Part of tek-injector, under the GNU General Public License v3.0 or later
+// See https://github.com/teknology-hub/tek-injector/blob/main/COPYING for
+//    license information.
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+//===----------------------------------------------------------------------===//
+///
+/// @file
+///  Declarations and implementation of portable functions for building the
+///    remote memory block that loads multiple DLLs in order, either on a
+///    remote thread, or on game's main thread via an APC or a trampoline that
+///    its start address is redirected to.
+///  The block consists of x86-64 machine code of the routines, followed on the
+///    next page by their parameter: addresses of `LoadLibraryW` and
+///    `SetEvent`, number of DLLs, the event to signal, the address to jump to
+///    after loading, the number of loaded DLLs written back by the routine,
+///    and DLL path addresses followed by the paths themselves. All addresses
+///    are in the target process, so the block is written with a single
+///    remote write and needs no relocation there. The code page is made
+///    executable, while the parameter stays writable.
+///  The routine calls `LoadLibraryW` for each path until one fails, stores
+///    the number of DLLs loaded, signals the event if there is one and clears
+///    it in the parameter, and returns the number, so either the thread exit
+///    code or the parameter tells which DLL failed. The cleared event tells
+///    the injector that `SetEvent` has returned, so once the thread's
+///    instruction pointer is also outside of the code, the block may be
+///    freed.
+///
+//===----------------------------------------------------------------------===//
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <string_view>
+
+namespace tek_inj::loader_stub {
+
+/// Machine code of the routines, with Microsoft x64 calling convention. The
+///    trampoline at offset 0 takes no parameter and addresses it relative to
+///    itself, so it relies on @ref param_offset being 0x1000.
+inline constexpr std::array<std::uint8_t, 87> code{
+    // trampoline:
+    0x51,                                     // push rcx
+    0x48, 0x8D, 0x0D, 0xF8, 0x0F, 0x00, 0x00, // lea rcx, [rip + param]
+    0xE8, 0x07, 0x00, 0x00, 0x00,             // call routine
+    0x59,                                     // pop rcx
+    0xFF, 0x25, 0x0C, 0x10, 0x00, 0x00,       // jmp [rip + param + 32]
+    // routine:
+    0x53,                         // push rbx
+    0x56,                         // push rsi
+    0x48, 0x83, 0xEC, 0x28,       // sub rsp, 0x28
+    0x48, 0x89, 0xCB,             // mov rbx, rcx
+    0x31, 0xF6,                   // xor esi, esi
+                                  // loop:
+    0x48, 0x3B, 0x73, 0x08,       // cmp rsi, [rbx + 8]
+    0x73, 0x11,                   // jae done
+    0x48, 0x8B, 0x4C, 0xF3, 0x30, // mov rcx, [rbx + rsi * 8 + 48]
+    0xFF, 0x13,                   // call [rbx]
+    0x48, 0x85, 0xC0,             // test rax, rax
+    0x74, 0x05,                   // jz done
+    0x48, 0xFF, 0xC6,             // inc rsi
+    0xEB, 0xE9,                   // jmp loop
+                                  // done:
+    0x48, 0x89, 0x73, 0x28,       // mov [rbx + 40], rsi
+    0x48, 0x8B, 0x4B, 0x18,       // mov rcx, [rbx + 24]
+    0x48, 0x85, 0xC9,             // test rcx, rcx
+    0x74, 0x0B,                   // jz skip
+    0xFF, 0x53, 0x10,             // call [rbx + 16]
+    0x48, 0xC7, 0x43, 0x18, 0x00, // mov qword [rbx + 24], 0
+    0x00, 0x00, 0x00,
+                                  // skip:
+    0x89, 0xF0,                   // mov eax, esi
+    0x48, 0x83, 0xC4, 0x28,       // add rsp, 0x28
+    0x5E,                         // pop rsi
+    0x5B,                         // pop rbx
+    0xC3                          // ret
+};
+
+/// Offset of the trampoline, which loads the DLLs and jumps to
+///    @ref param::entry with the register of the first argument preserved, in
+///    the block.
+inline constexpr std::size_t trampoline_offset{0};
+/// Offset of the routine that takes the address of the parameter as its only
+///    argument, usable as both a thread routine and an APC routine, in the
+///    block.
+inline constexpr std::size_t routine_offset{0x14};
+/// Offset of the routine parameter in the block, the size of a page, so the
+///    parameter may have different protection than the code.
+inline constexpr std::size_t param_offset{0x1000};
+
+/// Fixed part of the routine parameter, followed by DLL path addresses.
+struct param {
+  /// Address of `LoadLibraryW`.
+  std::uint64_t load_library;
+  /// Number of DLLs to load.
+  std::uint64_t num_dlls;
+  /// Address of `SetEvent`.
+  std::uint64_t set_event;
+  /// Handle to the event to signal after loading, 0 if there is none. Set to 0
+  ///    by the routine after signaling it.
+  std::uint64_t event;
+  /// Address for the trampoline to jump to after loading.
+  std::uint64_t entry;
+  /// Number of DLLs loaded, written by the routine.
+  std::uint64_t loaded;
+};
+
+/// Get the size of the block.
+///
+/// @param paths
+///    Null-terminated paths to the DLLs to load.
+/// @return Size of the block, in bytes.
+[[gnu::visibility("internal")]]
+constexpr std::size_t size(std::span<const wchar_t *const> paths) noexcept {
+  auto size{param_offset + sizeof(param) +
+            paths.size() * sizeof(std::uint64_t)};
+  for (const auto path : paths) {
+    size += (std::wstring_view{path}.length() + 1) * sizeof(wchar_t);
+  }
+  return size;
+}
+
+/// Write the block.
+///
+/// @param [out] buf
+///    Pointer to the buffer that receives the block. Must have space for at
+///    least @ref size bytes.
+/// @param remote_base
+///    Address that the block will be written to in the target process.
+/// @param fixed
+///    Fixed part of the routine parameter, @ref param::num_dlls and
+///    @ref param::loaded are ignored.
+/// @param paths
+///    Null-terminated paths to the DLLs to load.
+[[gnu::visibility("internal")]]
+inline void write(void *buf, std::uint64_t remote_base, param fixed,
+                  std::span<const wchar_t *const> paths) noexcept {
+  const auto base{static_cast<char *>(buf)};
+  std::memcpy(base, code.data(), code.size());
+  std::memset(base + code.size(), 0xCC, param_offset - code.size());
+  fixed.num_dlls = paths.size();
+  fixed.loaded = 0;
+  std::memcpy(base + param_offset, &fixed, sizeof fixed);
+  auto addr{base + param_offset + sizeof fixed};
+  auto str_offset{param_offset + sizeof fixed +
+                  paths.size() * sizeof(std::uint64_t)};
+  for (const auto path : paths) {
+    const auto path_size{(std::wstring_view{path}.length() + 1) *
+                         sizeof(wchar_t)};
+    std::memcpy(base + str_offset, path, path_size);
+    const std::uint64_t path_addr{remote_base + str_offset};
+    std::memcpy(addr, &path_addr, sizeof path_addr);
+    addr += sizeof path_addr;
+    str_offset += path_size;
+  }
+}
+
+} // namespace tek_inj::loader_stub
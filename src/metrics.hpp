@@ -0,0 +1,163 @@
+//===-- metrics.hpp - Launch statistics -----------------------------------===//
+//
+// Copyright (c) 2025 Nuclearist <nuclearist@teknology-hub.com>
+// Part of tek-injector, under the GNU General Public License v3.0 or later
+// See https://github.com/teknology-hub/tek-injector/blob/main/COPYING for
+//    license information.
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+//===----------------------------------------------------------------------===//
+///
+/// @file
+///  Declarations and implementation of portable cumulative statistics of game
+///    launches, shared by all platform implementations of
+///    `tek_inj_metrics_snapshot`.
+///
+//===----------------------------------------------------------------------===//
+#pragma once
+
+#include "tek-injector.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+
+namespace tek_inj::metrics {
+
+/// Histogram of durations updated concurrently without locks.
+class [[gnu::visibility("internal")]] histogram {
+  /// Number of durations in each bucket.
+  std::array<std::atomic_uint64_t, TEK_INJ_HISTOGRAM_NUM_BUCKETS> buckets;
+  /// Sum of all durations, in microseconds.
+  std::atomic_uint64_t sum;
+
+public:
+  /// Record a duration.
+  ///
+  /// @param us
+  ///    The duration, in microseconds.
+  void record(std::uint64_t us) noexcept {
+    // Upper bound of bucket N is 100 << N microseconds
+    const auto bucket{std::min<std::size_t>(
+        us ? std::bit_width((us - 1) / 100) : 0, buckets.size() - 1)};
+    buckets[bucket].fetch_add(1, std::memory_order::relaxed);
+    sum.fetch_add(us, std::memory_order::relaxed);
+  }
+  /// Copy the histogram, optionally resetting it.
+  ///
+  /// @param [out] out
+  ///    Variable that receives the histogram.
+  /// @param reset
+  ///    Value indicating whether to reset the histogram.
+  void snapshot(tek_inj_histogram &out, bool reset) noexcept {
+    for (std::size_t i{}; i < buckets.size(); ++i) {
+      auto &bucket{buckets[i]};
+      out.buckets[i] = reset ? bucket.exchange(0, std::memory_order::relaxed)
+                             : bucket.load(std::memory_order::relaxed);
+    }
+    out.sum = reset ? sum.exchange(0, std::memory_order::relaxed)
+                    : sum.load(std::memory_order::relaxed);
+  }
+};
+
+/// Cumulative statistics of game launches made by current process.
+struct [[gnu::visibility("internal")]] registry {
+  /// Number of completed launches.
+  std::atomic_uint64_t launches;
+  /// Number of launches completed with each result code.
+  std::array<std::atomic_uint64_t, TEK_INJ_RES_count> results;
+  /// Number of launches that failed because of a timeout.
+  std::atomic_uint64_t timeouts;
+  /// Histograms of durations of launch phases.
+  std::array<histogram, TEK_INJ_PHASE_count> phases;
+  /// Histogram of total launch durations.
+  histogram total;
+};
+
+/// Convert a timestamp interval to microseconds.
+///
+/// @param ticks
+///    The interval, in counts.
+/// @param frequency
+///    Frequency of the timestamps, in counts per second.
+/// @return The interval, in microseconds.
+[[gnu::visibility("internal")]]
+constexpr std::uint64_t ticks_to_us(std::int64_t ticks,
+                                    std::int64_t frequency) noexcept {
+  return ticks > 0 && frequency > 0
+             ? static_cast<std::uint64_t>(ticks) * 1'000'000 /
+                   static_cast<std::uint64_t>(frequency)
+             : 0;
+}
+
+/// Record the outcome and phase durations of a completed launch. Counters are
+///    independent of each other, so they're updated with relaxed atomic
+///    operations.
+///
+/// @param [in, out] reg
+///    The registry to record the launch in.
+/// @param timings
+///    Timestamps of launch phases.
+/// @param result
+///    Result code of the launch.
+/// @param timeout
+///    Value indicating whether the launch failed because of a timeout.
+/// @param now
+///    Current timestamp, which ends the launch.
+[[gnu::visibility("internal")]]
+inline void record(registry &reg, const tek_inj_timings &timings,
+                   tek_inj_res result, bool timeout,
+                   std::int64_t now) noexcept {
+  reg.launches.fetch_add(1, std::memory_order::relaxed);
+  if (result >= 0 && result < TEK_INJ_RES_count) {
+    reg.results[result].fetch_add(1, std::memory_order::relaxed);
+  }
+  if (timeout) {
+    reg.timeouts.fetch_add(1, std::memory_order::relaxed);
+  }
+  std::int64_t first_start{now};
+  for (int phase{}; phase < TEK_INJ_PHASE_count; ++phase) {
+    const auto start{timings.start[phase]};
+    const auto end{timings.end[phase]};
+    if (!start) {
+      continue;
+    }
+    first_start = std::min(first_start, start);
+    if (end) {
+      reg.phases[phase].record(ticks_to_us(end - start, timings.frequency));
+    }
+  }
+  if (first_start != now) {
+    reg.total.record(ticks_to_us(now - first_start, timings.frequency));
+  }
+}
+
+/// Copy statistics from a registry, optionally resetting them.
+///
+/// @param [in, out] reg
+///    The registry to copy statistics from.
+/// @param [out] out
+///    Variable that receives the statistics.
+/// @param reset
+///    Value indicating whether to reset the statistics to zero.
+[[gnu::visibility("internal")]]
+inline void snapshot(registry &reg, tek_inj_metrics &out, bool reset) noexcept {
+  const auto take{[reset](std::atomic_uint64_t &counter) {
+    return reset ? counter.exchange(0, std::memory_order::relaxed)
+                 : counter.load(std::memory_order::relaxed);
+  }};
+  out.launches = take(reg.launches);
+  for (int i{}; i < TEK_INJ_RES_count; ++i) {
+    out.results[i] = take(reg.results[i]);
+  }
+  out.timeouts = take(reg.timeouts);
+  for (int i{}; i < TEK_INJ_PHASE_count; ++i) {
+    reg.phases[i].snapshot(out.phases[i], reset);
+  }
+  reg.total.snapshot(out.total, reset);
+}
+
+} // namespace tek_inj::metrics
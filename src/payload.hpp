@@ -0,0 +1,258 @@
+//===-- payload.hpp - TEK Game Runtime input payload ----------------------===//
+//
+// Copyright (c) 2025 Nuclearist <nuclearist@teknology-hub.com>
+// Part of tek-injector, under the GNU General Public License v3.0 or later
+// See https://github.com/teknology-hub/tek-injector/blob/main/COPYING for
+//    license information.
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+//===----------------------------------------------------------------------===//
+///
+/// @file
+///  Declarations and implementation of portable functions for building the
+///    content of TEK Game Runtime input file mapping.
+///  When @ref flag_status is set in @ref data_header_v2::flags, the header is
+///    followed by @ref status_block, which TEK Game Runtime updates as its
+///    initialization progresses, and the data follows the status block.
+///  When @ref flag_shared is set, @ref shared_block follows the header and
+///    the status block, if any, and the data is not in the file mapping at
+///    all, but in the read-only one that the block references.
+///
+//===----------------------------------------------------------------------===//
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+namespace tek_inj::payload {
+
+/// The header of data for TEK Game Runtime input file mapping, used when data
+///    size fits into 32 bits, for compatibility with runtime versions that
+///    don't support @ref data_header_v2.
+struct data_header {
+  /// Settings loading method, value of `tek_gr_load_type`.
+  std::int32_t type;
+  /// Size of the remaining data in the file mapping, in bytes. When @ref type
+  ///    is `TEK_GR_LOAD_TYPE_file_path`, the data is path to the file, or
+  ///    "tek-gr-settings.json" in current directory if the size is zero. When
+  ///    @ref type is `TEK_GR_LOAD_TYPE_data`, the data is actual settings JSON
+  ///    content.
+  std::uint32_t size;
+};
+
+/// Value of @ref data_header_v2::magic, "TGRH" in little-endian. Settings
+///    loading method values never get this large, so it tells the header
+///    versions apart.
+inline constexpr std::uint32_t data_header_magic{0x48524754};
+
+/// Versioned header of data for TEK Game Runtime input file mapping.
+struct data_header_v2 {
+  /// Must be @ref data_header_magic.
+  std::uint32_t magic;
+  /// Version of the header structure, 2 for this one.
+  std::uint32_t version;
+  /// Settings loading method, value of `tek_gr_load_type`.
+  std::int32_t type;
+  /// Payload format extension flags, combination of @ref flag_status and
+  ///    @ref flag_shared.
+  std::uint32_t flags;
+  /// Size of the remaining data in the file mapping, in bytes. Meaning of the
+  ///    data is the same as for @ref data_header::size.
+  std::uint64_t size;
+};
+
+/// @ref data_header_v2::flags bit indicating that the header is followed by
+///    @ref status_block.
+inline constexpr std::uint32_t flag_status{1 << 0};
+/// @ref data_header_v2::flags bit indicating that the data is in a separate
+///    read-only file mapping referenced by @ref shared_block.
+inline constexpr std::uint32_t flag_shared{1 << 1};
+
+/// States of TEK Game Runtime initialization reported via @ref status_block.
+enum class state : std::uint32_t {
+  /// The runtime hasn't reported anything yet.
+  pending,
+  /// The runtime DLL has been loaded and found the status block.
+  loaded,
+  /// Settings have been read from the file mapping and parsed.
+  settings_parsed,
+  /// Hooks have been installed.
+  hooks_installed,
+  /// Initialization is complete, the game may be resumed.
+  ready,
+  /// Initialization has failed, @ref status_block::error and
+  ///    @ref status_block::message describe the reason.
+  failed
+};
+
+/// Number of @ref state values.
+inline constexpr std::size_t num_states{
+    static_cast<std::size_t>(state::failed) + 1};
+
+/// Maximum length of @ref status_block::message, including the null
+///    terminator.
+inline constexpr std::size_t max_message_len{256};
+
+/// Block of TEK Game Runtime initialization status, written by the runtime and
+///    read by the injector.
+struct status_block {
+  /// Current @ref state value. The runtime writes it with release semantics
+  ///    after all other fields relevant to the state.
+  std::uint32_t state;
+  /// If @ref state is @ref state::failed, Win32 error code or a runtime
+  ///    specific code describing the failure.
+  std::uint32_t error;
+  /// Value of the handle to an auto-reset event in the game process, which the
+  ///    runtime signals after every change of @ref state. On Linux, it's
+  ///    zero, and the runtime wakes waiters with `FUTEX_WAKE` on @ref state
+  ///    instead, without `FUTEX_PRIVATE_FLAG` as the memory is shared.
+  std::uint64_t event;
+  /// `QueryPerformanceCounter` values at the time each state has been
+  ///    entered, indexed by @ref state. Zero for states that haven't been
+  ///    entered. On Linux, `CLOCK_MONOTONIC` values in nanoseconds.
+  std::int64_t times[num_states];
+  /// If @ref state is @ref state::failed, null-terminated UTF-16 description
+  ///    of the failure.
+  char16_t message[max_message_len];
+};
+
+/// Reference to settings data in a read-only file mapping shared by game
+///    processes with identical settings.
+struct shared_block {
+  /// Value of the handle to the shared file mapping in the game process, with
+  ///    read-only access. The data starts at the beginning of the mapping,
+  ///    and its size is @ref data_header_v2::size.
+  std::uint64_t mapping;
+  /// Hash of the data computed by @ref hash.
+  std::uint64_t hash;
+};
+
+/// Get the size of the header for given data size.
+///
+/// @param data_size
+///    Size of the data, in bytes.
+/// @param flags
+///    Payload format extension flags, blocks for which follow the header.
+/// @return Size of the header, in bytes, including extension blocks.
+[[gnu::visibility("internal")]]
+constexpr std::size_t header_size(std::uint64_t data_size,
+                                  std::uint32_t flags = 0) noexcept {
+  if (flags) {
+    return sizeof(data_header_v2) +
+           ((flags & flag_status) ? sizeof(status_block) : 0) +
+           ((flags & flag_shared) ? sizeof(shared_block) : 0);
+  }
+  return data_size > UINT32_MAX ? sizeof(data_header_v2) : sizeof(data_header);
+}
+
+/// Get the size of the payload for given data size.
+///
+/// @param data_size
+///    Size of the data, in bytes.
+/// @param flags
+///    Payload format extension flags.
+/// @return Size of the payload, in bytes. With @ref flag_shared, it doesn't
+///    include the data.
+[[gnu::visibility("internal")]]
+constexpr std::uint64_t size(std::uint64_t data_size,
+                             std::uint32_t flags = 0) noexcept {
+  return header_size(data_size, flags) +
+         ((flags & flag_shared) ? 0 : data_size);
+}
+
+/// Compute 64-bit FNV-1a hash of settings data, which identifies the content
+///    of shared file mappings.
+///
+/// @param data
+///    The data to hash.
+/// @return The hash.
+[[gnu::visibility("internal")]]
+constexpr std::uint64_t hash(std::string_view data) noexcept {
+  std::uint64_t res{0xCBF29CE484222325};
+  for (const auto ch : data) {
+    res = (res ^ static_cast<unsigned char>(ch)) * 0x100000001B3;
+  }
+  return res;
+}
+
+/// Write the payload header.
+///
+/// @param [out] buf
+///    Pointer to the buffer that receives the payload. Must be suitably
+///    aligned for the header and have space for at least @ref size bytes.
+/// @param type
+///    Settings loading method, value of `tek_gr_load_type`.
+/// @param data_size
+///    Size of the data that will follow the header, in bytes.
+/// @param flags
+///    Payload format extension flags, zero-initialized blocks for which are
+///    written after the header.
+/// @return Pointer to the buffer for the data, unused with @ref flag_shared.
+[[gnu::visibility("internal")]]
+inline char *write_header(void *buf, std::int32_t type, std::uint64_t data_size,
+                          std::uint32_t flags = 0) noexcept {
+  if (flags || data_size > UINT32_MAX) {
+    const auto hdr{static_cast<data_header_v2 *>(buf)};
+    *hdr = {.magic = data_header_magic,
+            .version = 2,
+            .type = type,
+            .flags = flags,
+            .size = data_size};
+    const auto blocks{reinterpret_cast<char *>(hdr + 1)};
+    const auto blocks_size{header_size(data_size, flags) - sizeof *hdr};
+    std::memset(blocks, 0, blocks_size);
+    return blocks + blocks_size;
+  }
+  const auto hdr{static_cast<data_header *>(buf)};
+  *hdr = {.type = type, .size = static_cast<std::uint32_t>(data_size)};
+  return reinterpret_cast<char *>(hdr + 1);
+}
+
+/// Get the status block of a payload written with it.
+///
+/// @param buf
+///    Pointer to the payload written by @ref write_header with status block.
+/// @return Pointer to the status block.
+[[gnu::visibility("internal")]]
+inline status_block *get_status(void *buf) noexcept {
+  return reinterpret_cast<status_block *>(static_cast<data_header_v2 *>(buf) +
+                                          1);
+}
+
+/// Get the shared data reference of a payload written with it.
+///
+/// @param buf
+///    Pointer to the payload written by @ref write_header with
+///    @ref flag_shared.
+/// @return Pointer to the shared data reference.
+[[gnu::visibility("internal")]]
+inline shared_block *get_shared(void *buf) noexcept {
+  const auto hdr{static_cast<data_header_v2 *>(buf)};
+  auto block{reinterpret_cast<char *>(hdr + 1)};
+  if (hdr->flags & flag_status) {
+    block += sizeof(status_block);
+  }
+  return reinterpret_cast<shared_block *>(block);
+}
+
+/// Write the payload.
+///
+/// @param [out] buf
+///    Pointer to the buffer that receives the payload. Must be suitably
+///    aligned for the header and have space for at least @ref size bytes.
+/// @param type
+///    Settings loading method, value of `tek_gr_load_type`.
+/// @param data
+///    Pointer to the data to pass to TEK Game Runtime.
+/// @param data_size
+///    Size of @p data, in bytes.
+[[gnu::visibility("internal")]]
+inline void write(void *buf, std::int32_t type, const char *data,
+                  std::uint64_t data_size) noexcept {
+  std::copy_n(data, data_size, write_header(buf, type, data_size));
+}
+
+} // namespace tek_inj::payload
@@ -0,0 +1,256 @@
+//===-- pe.cpp - PE image header parsing implementation -------------------===//
+//
+// Copyright (c) 2025 Nuclearist <nuclearist@teknology-hub.com>
+// Part of tek-injector, under the GNU General Public License v3.0 or later
+// See https://github.com/teknology-hub/tek-injector/blob/main/COPYING for
+//    license information.
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+//===----------------------------------------------------------------------===//
+///
+/// @file
+///  Implementation of @ref tek_inj::pe::parse and
+///    @ref tek_inj::pe::export_names.
+///
+//===----------------------------------------------------------------------===//
+#include "pe.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <string_view>
+#include <vector>
+
+namespace tek_inj::pe {
+
+namespace {
+
+/// Value of `IMAGE_DOS_HEADER::e_magic`, "MZ".
+constexpr std::uint16_t dos_magic{0x5A4D};
+/// Offset of `IMAGE_DOS_HEADER::e_lfanew`.
+constexpr std::size_t lfanew_offset{0x3C};
+/// Value of `IMAGE_NT_HEADERS::Signature`, "PE\0\0".
+constexpr std::uint32_t nt_signature{0x00004550};
+/// Size of `IMAGE_FILE_HEADER`.
+constexpr std::size_t file_header_size{20};
+/// `IMAGE_OPTIONAL_HEADER::Magic` value for PE32 images.
+constexpr std::uint16_t pe32_magic{0x10B};
+/// `IMAGE_OPTIONAL_HEADER::Magic` value for PE32+ images.
+constexpr std::uint16_t pe32_plus_magic{0x20B};
+/// Offset of `IMAGE_OPTIONAL_HEADER::Subsystem`, same for PE32 and PE32+.
+constexpr std::size_t subsystem_offset{68};
+/// Size of `IMAGE_SECTION_HEADER`.
+constexpr std::size_t section_header_size{40};
+/// Maximum length of an export name, longer ones are treated as corrupt.
+constexpr std::size_t max_name_len{4096};
+
+/// Read a little-endian value from the content.
+///
+/// @param content
+///    The content to read from.
+/// @param offset
+///    Offset of the value in @p content, in bytes.
+/// @param [out] value
+///    Variable that receives the value.
+/// @return Value indicating whether the value is within @p content.
+template <typename T>
+[[gnu::visibility("internal")]]
+bool read(std::span<const char> content, std::uint64_t offset,
+          T &value) noexcept {
+  if (offset > content.size() || content.size() - offset < sizeof value) {
+    return false;
+  }
+  std::memcpy(&value, content.data() + offset, sizeof value);
+  return true;
+}
+
+/// Location of a section's raw data.
+struct [[gnu::visibility("internal")]] section_range {
+  /// RVA of the section.
+  std::uint32_t virtual_address;
+  /// Size of the section's raw data, in bytes.
+  std::uint32_t raw_size;
+  /// File offset of the section's raw data.
+  std::uint32_t raw_offset;
+};
+
+/// Section table of an image, read once for translating many RVAs.
+struct [[gnu::visibility("internal")]] section_table {
+  /// Entries of the table, in table order.
+  std::array<section_range, max_sections> entries;
+  /// Number of used elements in @ref entries.
+  std::uint16_t size;
+};
+
+/// Read the section table of an image.
+///
+/// @param content
+///    Content of the image file.
+/// @param info
+///    Information about the image from successful @ref parse.
+/// @param [out] table
+///    Variable that receives the table.
+/// @return Value indicating whether the table is within @p content.
+[[gnu::visibility("internal")]]
+bool read_sections(std::span<const char> content, const image_info &info,
+                   section_table &table) noexcept {
+  table.size = std::min(info.num_sections, max_sections);
+  for (std::uint16_t i{}; i < table.size; ++i) {
+    const auto section{std::uint64_t{info.sections_offset} +
+                       i * section_header_size};
+    auto &entry{table.entries[i]};
+    if (!read(content, section + 12, entry.virtual_address) ||
+        !read(content, section + 16, entry.raw_size) ||
+        !read(content, section + 20, entry.raw_offset)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/// Translate an RVA into a file offset via the section table.
+///
+/// @param table
+///    Section table of the image.
+/// @param rva
+///    The RVA to translate.
+/// @param [out] offset
+///    Variable that receives the file offset.
+/// @return Value indicating whether @p rva is within raw data of a section.
+[[gnu::visibility("internal")]]
+bool rva_to_offset(const section_table &table, std::uint32_t rva,
+                   std::uint64_t &offset) noexcept {
+  for (std::uint16_t i{}; i < table.size; ++i) {
+    const auto &entry{table.entries[i]};
+    if (rva >= entry.virtual_address &&
+        rva - entry.virtual_address < entry.raw_size) {
+      offset = std::uint64_t{entry.raw_offset} + (rva - entry.virtual_address);
+      return true;
+    }
+  }
+  return false;
+}
+
+} // namespace
+
+error parse(std::span<const char> content, image_info &info) noexcept {
+  info = {};
+  std::uint16_t magic;
+  std::uint32_t nt_offset;
+  if (!read(content, 0, magic) || !read(content, lfanew_offset, nt_offset)) {
+    return error::truncated;
+  }
+  if (magic != dos_magic) {
+    return error::not_pe;
+  }
+  std::uint32_t signature;
+  if (!read(content, nt_offset, signature)) {
+    return error::truncated;
+  }
+  if (signature != nt_signature) {
+    return error::not_pe;
+  }
+  const auto file_header{std::uint64_t{nt_offset} + sizeof signature};
+  std::uint16_t optional_header_size;
+  if (!read(content, file_header, info.machine) ||
+      !read(content, file_header + 2, info.num_sections) ||
+      !read(content, file_header + 16, optional_header_size) ||
+      !read(content, file_header + 18, info.characteristics)) {
+    return error::truncated;
+  }
+  const auto optional_header{file_header + file_header_size};
+  std::uint16_t optional_magic;
+  if (!read(content, optional_header, optional_magic)) {
+    return error::truncated;
+  }
+  // Data directories follow the fields, which are wider in PE32+
+  std::size_t num_dirs_offset;
+  switch (optional_magic) {
+  case pe32_magic:
+    num_dirs_offset = 92;
+    break;
+  case pe32_plus_magic:
+    num_dirs_offset = 108;
+    break;
+  default:
+    return error::bad_optional_header;
+  }
+  if (optional_header_size < num_dirs_offset + 4) {
+    return error::bad_optional_header;
+  }
+  std::uint32_t num_dirs;
+  if (!read(content, optional_header + subsystem_offset, info.subsystem) ||
+      !read(content, optional_header + num_dirs_offset, num_dirs)) {
+    return error::truncated;
+  }
+  if (info.num_sections > max_sections) {
+    return error::too_many_sections;
+  }
+  const auto sections_offset{optional_header + optional_header_size};
+  if (sections_offset + info.num_sections * section_header_size >
+      content.size()) {
+    return error::truncated;
+  }
+  info.sections_offset = static_cast<std::uint32_t>(sections_offset);
+  // The export directory is the first data directory
+  if (num_dirs > 0 && optional_header_size >= num_dirs_offset + 4 + 8 &&
+      !read(content, optional_header + num_dirs_offset + 4,
+            info.exports_rva)) {
+    return error::truncated;
+  }
+  return error::none;
+}
+
+error export_names(std::span<const char> content, const image_info &info,
+                   std::vector<std::string_view> &names) {
+  names.clear();
+  if (!info.exports_rva) {
+    return error::none;
+  }
+  section_table sections;
+  std::uint64_t dir_offset;
+  if (!read_sections(content, info, sections) ||
+      !rva_to_offset(sections, info.exports_rva, dir_offset)) {
+    return error::bad_exports;
+  }
+  std::uint32_t num_names, names_rva;
+  if (!read(content, dir_offset + 24, num_names) ||
+      !read(content, dir_offset + 32, names_rva)) {
+    return error::bad_exports;
+  }
+  if (!num_names) {
+    return error::none;
+  }
+  if (num_names > max_export_names) {
+    return error::bad_exports;
+  }
+  std::uint64_t names_offset;
+  if (!rva_to_offset(sections, names_rva, names_offset) ||
+      names_offset + std::uint64_t{num_names} * 4 > content.size()) {
+    return error::bad_exports;
+  }
+  names.reserve(num_names);
+  for (std::uint32_t i{}; i < num_names; ++i) {
+    std::uint32_t name_rva;
+    std::uint64_t name_offset;
+    if (!read(content, names_offset + i * 4, name_rva) ||
+        !rva_to_offset(sections, name_rva, name_offset) ||
+        name_offset >= content.size()) {
+      return error::bad_exports;
+    }
+    const std::string_view rest{
+        content.data() + name_offset,
+        std::min<std::size_t>(content.size() - name_offset, max_name_len)};
+    const auto len{rest.find('\0')};
+    if (len == std::string_view::npos) {
+      return error::bad_exports;
+    }
+    names.emplace_back(rest.substr(0, len));
+  }
+  return error::none;
+}
+
+} // namespace tek_inj::pe
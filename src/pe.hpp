@@ -0,0 +1,115 @@
+//===-- pe.hpp - PE image header parsing ----------------------------------===//
+//
+// Copyright (c) 2025 Nuclearist <nuclearist@teknology-hub.com>
+// Part of tek-injector, under the GNU General Public License v3.0 or later
+// See https://github.com/teknology-hub/tek-injector/blob/main/COPYING for
+//    license information.
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+//===----------------------------------------------------------------------===//
+///
+/// @file
+///  Declarations of portable functions for parsing headers and export names
+///    of PE images, used to validate the game executable and DLLs before
+///    starting game process.
+///  Images are parsed from their file content rather than from loaded
+///    modules, so RVAs are translated into file offsets via the section
+///    table. Every read is bounds-checked, so arbitrary content is handled
+///    without reading outside of it.
+///
+//===----------------------------------------------------------------------===//
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <vector>
+
+namespace tek_inj::pe {
+
+/// `IMAGE_FILE_HEADER::Machine` value for x86.
+inline constexpr std::uint16_t machine_i386{0x014C};
+/// `IMAGE_FILE_HEADER::Machine` value for x86-64.
+inline constexpr std::uint16_t machine_amd64{0x8664};
+/// `IMAGE_FILE_HEADER::Machine` value for ARM64.
+inline constexpr std::uint16_t machine_arm64{0xAA64};
+
+/// `IMAGE_FILE_HEADER::Characteristics` flag of executable images.
+inline constexpr std::uint16_t characteristic_executable{0x0002};
+/// `IMAGE_FILE_HEADER::Characteristics` flag of DLLs.
+inline constexpr std::uint16_t characteristic_dll{0x2000};
+
+/// `IMAGE_OPTIONAL_HEADER::Subsystem` value for GUI applications.
+inline constexpr std::uint16_t subsystem_windows_gui{2};
+/// `IMAGE_OPTIONAL_HEADER::Subsystem` value for console applications.
+inline constexpr std::uint16_t subsystem_windows_cui{3};
+
+/// Maximum number of sections in an image, the Windows loader refuses to load
+///    images with more.
+inline constexpr std::uint16_t max_sections{96};
+/// Maximum number of export names, export ordinals are 16-bit so images
+///    produced by linkers never have more.
+inline constexpr std::uint32_t max_export_names{0x10000};
+
+/// Parsing errors.
+enum class error {
+  none,
+  /// The content ends before a structure that it references.
+  truncated,
+  /// The content doesn't start with a valid DOS header followed by PE
+  ///    signature.
+  not_pe,
+  /// Optional header is neither PE32 nor PE32+ one, or is too small.
+  bad_optional_header,
+  /// The section table has more than @ref max_sections entries.
+  too_many_sections,
+  /// Export directory or names it references are outside of the image
+  ///    sections, or there are more than @ref max_export_names names.
+  bad_exports
+};
+
+/// Information about a parsed image.
+struct image_info {
+  /// Target architecture of the image.
+  std::uint16_t machine;
+  /// Image characteristic flags.
+  std::uint16_t characteristics;
+  /// Subsystem required to run the image.
+  std::uint16_t subsystem;
+  /// Number of entries in the section table.
+  std::uint16_t num_sections;
+  /// Offset of the section table from the start of the content, in bytes.
+  std::uint32_t sections_offset;
+  /// RVA of the export directory, 0 if the image has no exports.
+  std::uint32_t exports_rva;
+};
+
+/// Parse image headers.
+///
+/// @param content
+///    Content of the image file. It may be truncated after the section
+///    table if only headers are needed.
+/// @param [out] info
+///    Variable that receives information about the image.
+/// @return Parsing error, @ref error::none on success.
+[[gnu::visibility("internal")]]
+error parse(std::span<const char> content, image_info &info) noexcept;
+
+/// Get names of functions exported by the image. The section table is read
+///    once, so the work is linear in the number of names, with at most
+///    @ref max_sections steps for translating each name's RVA.
+///
+/// @param content
+///    Full content of the image file.
+/// @param info
+///    Information about the image from successful @ref parse.
+/// @param [out] names
+///    Vector that receives the names, in the order of the export name table,
+///    which is lexical for images produced by linkers. The names point into
+///    @p content.
+/// @return Parsing error, @ref error::none on success.
+[[gnu::visibility("internal")]]
+error export_names(std::span<const char> content, const image_info &info,
+                   std::vector<std::string_view> &names);
+
+} // namespace tek_inj::pe
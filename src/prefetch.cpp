@@ -0,0 +1,55 @@
+//===-- prefetch.cpp - POSIX file read-ahead implementation ---------------===//
+//
+// Copyright (c) 2025 Nuclearist <nuclearist@teknology-hub.com>
+// Part of tek-injector, under the GNU General Public License v3.0 or later
+// See https://github.com/teknology-hub/tek-injector/blob/main/COPYING for
+//    license information.
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+//===----------------------------------------------------------------------===//
+///
+/// @file
+///  Implementation of reading files into the file system cache on POSIX
+///    systems.
+///
+//===----------------------------------------------------------------------===//
+#include "prefetch.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace tek_inj::prefetch {
+
+std::uint64_t read_ahead(int dir_fd, const char *path) noexcept {
+  const int fd{openat(dir_fd, path, O_RDONLY | O_CLOEXEC)};
+  if (fd < 0) {
+    return 0;
+  }
+  std::uint64_t res{};
+  struct stat st;
+  if (!fstat(fd, &st) && S_ISREG(st.st_mode) && st.st_size > 0) {
+    // Both calls queue reads of the whole file and return without waiting
+    //    for them, and the pages stay cached after the file is closed, where
+    //    the dynamic linker and the game find them
+    if (!posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED)) {
+      res = static_cast<std::uint64_t>(st.st_size);
+    } else {
+      const auto size{static_cast<std::size_t>(st.st_size)};
+      const auto view{mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0)};
+      if (view != MAP_FAILED) {
+        if (!madvise(view, size, MADV_WILLNEED)) {
+          res = size;
+        }
+        munmap(view, size);
+      }
+    }
+  }
+  close(fd);
+  return res;
+}
+
+} // namespace tek_inj::prefetch
@@ -0,0 +1,101 @@
+//===-- prefetch.hpp - Reading files into the file system cache -----------===//
+//
+// Copyright (c) 2025 Nuclearist <nuclearist@teknology-hub.com>
+// Part of tek-injector, under the GNU General Public License v3.0 or later
+// See https://github.com/teknology-hub/tek-injector/blob/main/COPYING for
+//    license information.
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+//===----------------------------------------------------------------------===//
+///
+/// @file
+///  Declarations and implementation of portable functions for distributing
+///    files to read into the file system cache among worker threads, and
+///    declaration of the POSIX function that reads a file there.
+///  Workers claim files one by one from a shared batch until none are left,
+///    so large files don't hold up small ones. The last worker to finish is
+///    told so, to record the end of the prefetch phase. Reading a file only
+///    asks the OS to start reading it ahead: `PrefetchVirtualMemory` on a
+///    mapped view on Windows, implemented in lib.cpp, and `posix_fadvise`
+///    with `POSIX_FADV_WILLNEED`, or `madvise` with `MADV_WILLNEED` on a
+///    mapped view where the former isn't supported, elsewhere.
+///
+//===----------------------------------------------------------------------===//
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace tek_inj::prefetch {
+
+/// Maximum number of workers reading files for a single launch.
+inline constexpr std::size_t max_workers{4};
+
+/// Files to read into the file system cache, shared by workers.
+///
+/// @tparam Path
+///    Type of file paths.
+template <typename Path> struct [[gnu::visibility("internal")]] batch {
+  /// Paths to the files to read.
+  std::vector<Path> paths;
+  /// Index of the next element of @ref paths to read.
+  std::atomic_size_t next{};
+  /// Number of workers that haven't finished yet.
+  std::atomic_size_t active{};
+  /// Total size of the files that have been read, in bytes.
+  std::atomic_uint64_t bytes{};
+
+  /// Prepare the batch for workers to run.
+  ///
+  /// @return Number of workers to run, 0 if there are no files to read.
+  std::size_t start() noexcept {
+    const auto num_workers{std::min(paths.size(), max_workers)};
+    active.store(num_workers, std::memory_order::relaxed);
+    return num_workers;
+  }
+
+  /// Make running workers stop after their current file.
+  void cancel() noexcept {
+    next.store(paths.size(), std::memory_order::relaxed);
+  }
+
+  /// Read files until none are left.
+  ///
+  /// @param read
+  ///    Function that reads a file into the file system cache, taking its
+  ///    path and returning its size in bytes if it has been read, otherwise
+  ///    0.
+  /// @return Value indicating whether the calling worker is the last one to
+  ///    finish.
+  template <typename Read> bool work(Read &&read) noexcept {
+    for (;;) {
+      const auto i{next.fetch_add(1, std::memory_order::relaxed)};
+      if (i >= paths.size()) {
+        break;
+      }
+      bytes.fetch_add(read(paths[i]), std::memory_order::relaxed);
+    }
+    return active.fetch_sub(1, std::memory_order::acq_rel) == 1;
+  }
+};
+
+#ifndef _WIN32
+
+/// Start reading a file into the file system cache.
+///
+/// @param dir_fd
+///    Descriptor of the directory that relative @p path is relative to, or
+///    `AT_FDCWD`.
+/// @param path
+///    Path to the file.
+/// @return Size of the file in bytes if reading it has been started,
+///    otherwise 0.
+[[gnu::visibility("internal")]]
+std::uint64_t read_ahead(int dir_fd, const char *path) noexcept;
+
+#endif // ndef _WIN32
+
+} // namespace tek_inj::prefetch
@@ -0,0 +1,359 @@
+//===-- profile.hpp - Compiled launch profiles ----------------------------===//
+//
+// Copyright (c) 2025 Nuclearist <nuclearist@teknology-hub.com>
+// Part of tek-injector, under the GNU General Public License v3.0 or later
+// See https://github.com/teknology-hub/tek-injector/blob/main/COPYING for
+//    license information.
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+//===----------------------------------------------------------------------===//
+///
+/// @file
+///  Declarations and implementation of portable functions for writing and
+///    validating compiled launch profiles.
+///  A profile is a single binary blob that starts with @ref header, followed
+///    by arrays of @ref string_ref for extra DLL paths and prefetch paths,
+///    null-terminated UTF-16 strings, and settings data. Everything is
+///    referenced by offsets from the start of the profile, so a memory-mapped
+///    profile is used in place, without any parsing.
+///
+//===----------------------------------------------------------------------===//
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <string_view>
+
+namespace tek_inj::profile {
+
+/// Value of @ref header::magic, "TIPF" in little-endian.
+inline constexpr std::uint32_t magic{0x46504954};
+/// Current value of @ref header::version.
+inline constexpr std::uint32_t version{5};
+
+/// Reference to a null-terminated string in the profile.
+struct string_ref {
+  /// Offset of the string from the start of the profile, in bytes.
+  std::uint32_t offset;
+  /// Length of the string, in characters, not including the null terminator.
+  std::uint32_t length;
+};
+
+/// The header of a profile.
+struct header {
+  /// Must be @ref magic.
+  std::uint32_t magic;
+  /// Version of the profile format, profiles with other versions are rejected.
+  std::uint32_t version;
+  /// Injection flags, value of `tek_inj_flag`.
+  std::uint32_t flags;
+  /// Settings loading method, value of `tek_gr_load_type`.
+  std::int32_t type;
+  /// Time to wait for TEK Game Runtime DLL to load, in milliseconds, 0 for
+  ///    default.
+  std::uint32_t inject_timeout;
+  /// Number of elements in the array at @ref extra_dlls_offset.
+  std::uint32_t num_extra_dlls;
+  /// Absolute path to the game executable.
+  string_ref exe_path;
+  /// Absolute path to the current directory for game process.
+  string_ref current_dir;
+  /// Path to libtek-game-runtime.dll.
+  string_ref dll_path;
+  /// Full command line for game process, with all arguments quoted.
+  string_ref command_line;
+  /// Offset of the array of @ref string_ref for extra DLL paths from the start
+  ///    of the profile, in bytes.
+  std::uint32_t extra_dlls_offset;
+  /// Offset of settings data from the start of the profile, in bytes.
+  std::uint32_t data_offset;
+  /// Size of settings data, in bytes.
+  std::uint32_t data_size;
+  /// Processor group that @ref affinity_mask refers to.
+  std::uint16_t processor_group;
+  /// Preferred NUMA node, used only if `TEK_INJ_FLAG_numa_node` is set in
+  ///    @ref flags.
+  std::uint16_t numa_node;
+  /// Mask of processors that game process may run on, 0 for no restriction.
+  std::uint64_t affinity_mask;
+  /// Memory limit of the job object for game process, in bytes. If it and the
+  ///    other job limits are 0, the process is not placed into a job.
+  std::uint64_t job_memory_limit;
+  /// CPU rate limit of the job object, in 1/100 of a percent, 0 for none.
+  std::uint32_t job_cpu_rate;
+  /// Active process limit of the job object, 0 for none.
+  std::uint32_t job_max_processes;
+  /// Number of elements in the array at @ref prefetch_paths_offset.
+  std::uint32_t num_prefetch_paths;
+  /// Offset of the array of @ref string_ref for paths to additional files to
+  ///    prefetch from the start of the profile, in bytes.
+  std::uint32_t prefetch_paths_offset;
+  /// Technique for loading TEK Game Runtime DLLs, value of
+  ///    `tek_inj_strategy`.
+  std::uint32_t strategy;
+  /// Memory priority of game process, one of `MEMORY_PRIORITY_*` values, 0
+  ///    to keep the default one.
+  std::uint16_t memory_priority;
+  /// I/O priority of game process, value of `tek_inj_io_priority`.
+  std::uint16_t io_priority;
+};
+
+/// Launch configuration to write to a profile.
+struct contents {
+  /// Injection flags, value of `tek_inj_flag`.
+  std::uint32_t flags;
+  /// Settings loading method, value of `tek_gr_load_type`.
+  std::int32_t type;
+  /// Time to wait for TEK Game Runtime DLL to load, in milliseconds.
+  std::uint32_t inject_timeout;
+  /// Technique for loading TEK Game Runtime DLLs, value of
+  ///    `tek_inj_strategy`.
+  std::uint32_t strategy;
+  /// Processor group that @ref affinity_mask refers to.
+  std::uint16_t processor_group;
+  /// Preferred NUMA node.
+  std::uint16_t numa_node;
+  /// Mask of processors that game process may run on.
+  std::uint64_t affinity_mask;
+  /// Memory limit of the job object for game process, in bytes.
+  std::uint64_t job_memory_limit;
+  /// CPU rate limit of the job object, in 1/100 of a percent.
+  std::uint32_t job_cpu_rate;
+  /// Active process limit of the job object.
+  std::uint32_t job_max_processes;
+  /// Memory priority of game process.
+  std::uint16_t memory_priority;
+  /// I/O priority of game process, value of `tek_inj_io_priority`.
+  std::uint16_t io_priority;
+  /// Absolute path to the game executable.
+  std::wstring_view exe_path;
+  /// Absolute path to the current directory for game process.
+  std::wstring_view current_dir;
+  /// Path to libtek-game-runtime.dll.
+  std::wstring_view dll_path;
+  /// Full command line for game process.
+  std::wstring_view command_line;
+  /// Null-terminated paths to extra DLLs to inject.
+  std::span<const wchar_t *const> extra_dll_paths;
+  /// Null-terminated paths to additional files to prefetch.
+  std::span<const wchar_t *const> prefetch_paths;
+  /// Settings data.
+  std::string_view data;
+};
+
+/// Get the size of the profile.
+///
+/// @param contents
+///    The launch configuration to write.
+/// @return Size of the profile, in bytes.
+[[gnu::visibility("internal")]]
+constexpr std::size_t size(const contents &contents) noexcept {
+  auto num_chars{contents.exe_path.length() + contents.current_dir.length() +
+                 contents.dll_path.length() + contents.command_line.length() +
+                 4};
+  for (const auto path : contents.extra_dll_paths) {
+    num_chars += std::wstring_view{path}.length() + 1;
+  }
+  for (const auto path : contents.prefetch_paths) {
+    num_chars += std::wstring_view{path}.length() + 1;
+  }
+  return sizeof(header) +
+         (contents.extra_dll_paths.size() + contents.prefetch_paths.size()) *
+             sizeof(string_ref) +
+         num_chars * sizeof(wchar_t) + contents.data.size();
+}
+
+/// Write the profile.
+///
+/// @param [out] buf
+///    Pointer to the buffer that receives the profile. Must be suitably
+///    aligned for the header and have space for at least @ref size bytes.
+/// @param contents
+///    The launch configuration to write.
+[[gnu::visibility("internal")]]
+inline void write(void *buf, const contents &contents) noexcept {
+  const auto base{static_cast<char *>(buf)};
+  const auto hdr{static_cast<header *>(buf)};
+  const auto extra_refs{reinterpret_cast<string_ref *>(hdr + 1)};
+  const auto prefetch_refs{extra_refs + contents.extra_dll_paths.size()};
+  auto offset{
+      sizeof(header) +
+      (contents.extra_dll_paths.size() + contents.prefetch_paths.size()) *
+          sizeof(string_ref)};
+  const auto put_str{[base, &offset](std::wstring_view str) {
+    const string_ref ref{.offset = static_cast<std::uint32_t>(offset),
+                         .length = static_cast<std::uint32_t>(str.length())};
+    std::memcpy(base + offset, str.data(), str.length() * sizeof(wchar_t));
+    offset += str.length() * sizeof(wchar_t);
+    constexpr wchar_t terminator{};
+    std::memcpy(base + offset, &terminator, sizeof terminator);
+    offset += sizeof terminator;
+    return ref;
+  }};
+  *hdr = {.magic = magic,
+          .version = version,
+          .flags = contents.flags,
+          .type = contents.type,
+          .inject_timeout = contents.inject_timeout,
+          .num_extra_dlls =
+              static_cast<std::uint32_t>(contents.extra_dll_paths.size()),
+          .exe_path = put_str(contents.exe_path),
+          .current_dir = put_str(contents.current_dir),
+          .dll_path = put_str(contents.dll_path),
+          .command_line = put_str(contents.command_line),
+          .extra_dlls_offset = static_cast<std::uint32_t>(sizeof(header)),
+          .data_offset = 0,
+          .data_size = static_cast<std::uint32_t>(contents.data.size()),
+          .processor_group = contents.processor_group,
+          .numa_node = contents.numa_node,
+          .affinity_mask = contents.affinity_mask,
+          .job_memory_limit = contents.job_memory_limit,
+          .job_cpu_rate = contents.job_cpu_rate,
+          .job_max_processes = contents.job_max_processes,
+          .num_prefetch_paths =
+              static_cast<std::uint32_t>(contents.prefetch_paths.size()),
+          .prefetch_paths_offset = static_cast<std::uint32_t>(
+              reinterpret_cast<char *>(prefetch_refs) - base),
+          .strategy = contents.strategy,
+          .memory_priority = contents.memory_priority,
+          .io_priority = contents.io_priority};
+  for (std::size_t i{}; i < contents.extra_dll_paths.size(); ++i) {
+    extra_refs[i] = put_str(contents.extra_dll_paths[i]);
+  }
+  for (std::size_t i{}; i < contents.prefetch_paths.size(); ++i) {
+    prefetch_refs[i] = put_str(contents.prefetch_paths[i]);
+  }
+  hdr->data_offset = static_cast<std::uint32_t>(offset);
+  std::memcpy(base + offset, contents.data.data(), contents.data.size());
+}
+
+/// Check whether a string reference points to a valid null-terminated string
+///    inside the profile.
+///
+/// @param profile
+///    The profile.
+/// @param ref
+///    The reference to check.
+/// @return Value indicating whether @p ref is valid.
+[[gnu::visibility("internal")]]
+inline bool valid_string(std::span<const char> profile,
+                         string_ref ref) noexcept {
+  if (ref.offset % alignof(wchar_t) ||
+      ref.offset + (std::uint64_t{ref.length} + 1) * sizeof(wchar_t) >
+          profile.size()) {
+    return false;
+  }
+  wchar_t terminator;
+  std::memcpy(&terminator,
+              profile.data() + ref.offset + ref.length * sizeof(wchar_t),
+              sizeof terminator);
+  return terminator == L'\0';
+}
+
+/// Check whether an array of string references is inside the profile and
+///    all strings it references are valid.
+///
+/// @param profile
+///    The profile.
+/// @param offset
+///    Offset of the array from the start of the profile, in bytes.
+/// @param count
+///    Number of elements in the array.
+/// @return Value indicating whether the array is valid.
+[[gnu::visibility("internal")]]
+inline bool valid_string_array(std::span<const char> profile,
+                               std::uint32_t offset,
+                               std::uint32_t count) noexcept {
+  if (offset % alignof(string_ref) ||
+      offset + std::uint64_t{count} * sizeof(string_ref) > profile.size()) {
+    return false;
+  }
+  const auto refs{
+      reinterpret_cast<const string_ref *>(profile.data() + offset)};
+  for (std::uint32_t i{}; i < count; ++i) {
+    if (!valid_string(profile, refs[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/// Validate the profile.
+///
+/// @param profile
+///    The profile to validate. Must be suitably aligned for the header.
+/// @return Pointer to the header of the profile if it's valid, or `nullptr`
+///    otherwise.
+[[gnu::visibility("internal")]]
+inline const header *validate(std::span<const char> profile) noexcept {
+  if (profile.size() < sizeof(header)) {
+    return nullptr;
+  }
+  const auto hdr{reinterpret_cast<const header *>(profile.data())};
+  if (hdr->magic != magic || hdr->version != version ||
+      std::uint64_t{hdr->data_offset} + hdr->data_size > profile.size() ||
+      !valid_string(profile, hdr->exe_path) ||
+      !valid_string(profile, hdr->current_dir) ||
+      !valid_string(profile, hdr->dll_path) ||
+      !valid_string(profile, hdr->command_line) ||
+      !valid_string_array(profile, hdr->extra_dlls_offset,
+                          hdr->num_extra_dlls) ||
+      !valid_string_array(profile, hdr->prefetch_paths_offset,
+                          hdr->num_prefetch_paths)) {
+    return nullptr;
+  }
+  return hdr;
+}
+
+/// Get a string referenced by the profile.
+///
+/// @param hdr
+///    Header of a validated profile.
+/// @param ref
+///    Reference to the string.
+/// @return Pointer to the null-terminated string.
+[[gnu::visibility("internal")]]
+inline const wchar_t *string(const header &hdr, string_ref ref) noexcept {
+  return reinterpret_cast<const wchar_t *>(
+      reinterpret_cast<const char *>(&hdr) + ref.offset);
+}
+
+/// Get the array of extra DLL path references of the profile.
+///
+/// @param hdr
+///    Header of a validated profile.
+/// @return The array.
+[[gnu::visibility("internal")]]
+inline std::span<const string_ref> extra_dlls(const header &hdr) noexcept {
+  return {reinterpret_cast<const string_ref *>(
+              reinterpret_cast<const char *>(&hdr) + hdr.extra_dlls_offset),
+          hdr.num_extra_dlls};
+}
+
+/// Get the array of prefetch path references of the profile.
+///
+/// @param hdr
+///    Header of a validated profile.
+/// @return The array.
+[[gnu::visibility("internal")]]
+inline std::span<const string_ref> prefetch_paths(const header &hdr) noexcept {
+  return {reinterpret_cast<const string_ref *>(
+              reinterpret_cast<const char *>(&hdr) +
+              hdr.prefetch_paths_offset),
+          hdr.num_prefetch_paths};
+}
+
+/// Get settings data of the profile.
+///
+/// @param hdr
+///    Header of a validated profile.
+/// @return The data.
+[[gnu::visibility("internal")]]
+inline std::string_view data(const header &hdr) noexcept {
+  return {reinterpret_cast<const char *>(&hdr) + hdr.data_offset,
+          hdr.data_size};
+}
+
+} // namespace tek_inj::profile
@@ -0,0 +1,235 @@
+//===-- ptrace_stub.hpp - Remote shared object loader for ptrace ----------===//
+//
+// Copyright (c) 2025 Nuclearist <nuclearist@teknology-hub.com>
+// Part of tek-injector, under the GNU General Public License v3.0 or later
+// See https://github.com/teknology-hub/tek-injector/blob/main/COPYING for
+//    license information.
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+//===----------------------------------------------------------------------===//
+///
+/// @file
+///  Declarations and implementation of portable functions for building the
+///    remote memory block that loads multiple shared objects in order on a
+///    thread of a running process hijacked via ptrace, the Linux counterpart
+///    of @ref loader_stub.hpp.
+///  The block consists of x86-64 machine code of the routine, followed on the
+///    next page by its parameter: address of `dlopen`, number of shared
+///    objects, address of the area that FPU state is saved to, the number of
+///    loaded shared objects and the completion flag written back by the
+///    routine, register values of the thread to restore afterwards, and path
+///    addresses followed by the paths themselves and the FPU state area. All
+///    addresses are in the target process, so the block is written with a
+///    single remote write and needs no relocation there. The code page is
+///    made executable, while the parameter stays writable.
+///  The thread is redirected to the routine with its stack pointer moved
+///    below the red zone. The routine saves FPU state, calls `dlopen` for
+///    each path until one fails, stores the number of shared objects loaded,
+///    restores FPU state, sets the completion flag, and restores all
+///    registers, jumping to the saved instruction pointer. The flag tells the
+///    injector that the thread only has a few instructions left in the code,
+///    so once its instruction pointer is also outside of it, the block may
+///    be freed.
+///
+//===----------------------------------------------------------------------===//
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <string_view>
+
+namespace tek_inj::ptrace_stub {
+
+/// Machine code of the routine. It addresses its parameter relative to
+///    itself, so it relies on @ref param_offset being 0x1000.
+inline constexpr std::array<std::uint8_t, 220> code{
+    0x48, 0x8D, 0x1D, 0xF9, 0x0F, 0x00, 0x00, // lea rbx, [rip + param]
+    0xFC,                                     // cld
+    0x48, 0x8B, 0x7B, 0x10,                   // mov rdi, [rbx + 16]
+    0x48, 0x83, 0x7B, 0x18, 0x00,             // cmp qword [rbx + 24], 0
+    0x74, 0x10,                               // je fxsave
+    0xB8, 0xFF, 0xFF, 0xFF, 0xFF,             // mov eax, -1
+    0xBA, 0xFF, 0xFF, 0xFF, 0xFF,             // mov edx, -1
+    0x48, 0x0F, 0xAE, 0x27,                   // xsave64 [rdi]
+    0xEB, 0x04,                               // jmp saved
+                                              // fxsave:
+    0x48, 0x0F, 0xAE, 0x07,                   // fxsave64 [rdi]
+                                              // saved:
+    0x45, 0x31, 0xE4,                         // xor r12d, r12d
+                                              // loop:
+    0x4C, 0x3B, 0x63, 0x08,                   // cmp r12, [rbx + 8]
+    0x73, 0x19,                               // jae done
+    0x4A, 0x8B, 0xBC, 0xE3, 0xC0, 0x00, 0x00, // mov rdi, [rbx + r12 * 8 + 192]
+    0x00,
+    0xBE, 0x02, 0x00, 0x00, 0x00, // mov esi, RTLD_NOW
+    0xFF, 0x13,                   // call [rbx]
+    0x48, 0x85, 0xC0,             // test rax, rax
+    0x74, 0x05,                   // jz done
+    0x49, 0xFF, 0xC4,             // inc r12
+    0xEB, 0xE1,                   // jmp loop
+                                  // done:
+    0x4C, 0x89, 0x63, 0x20,       // mov [rbx + 32], r12
+    0x48, 0x8B, 0x7B, 0x10,       // mov rdi, [rbx + 16]
+    0x48, 0x83, 0x7B, 0x18, 0x00, // cmp qword [rbx + 24], 0
+    0x74, 0x10,                   // je fxrstor
+    0xB8, 0xFF, 0xFF, 0xFF, 0xFF, // mov eax, -1
+    0xBA, 0xFF, 0xFF, 0xFF, 0xFF, // mov edx, -1
+    0x48, 0x0F, 0xAE, 0x2F,       // xrstor64 [rdi]
+    0xEB, 0x04,                   // jmp restored
+                                  // fxrstor:
+    0x48, 0x0F, 0xAE, 0x0F,       // fxrstor64 [rdi]
+                                  // restored:
+    0x48, 0xC7, 0x43, 0x28, 0x01, // mov qword [rbx + 40], 1
+    0x00, 0x00, 0x00,
+    0xFF, 0x73, 0x40,                         // push qword [rbx + 64]
+    0x9D,                                     // popfq
+    0x48, 0x8B, 0x43, 0x48,                   // mov rax, [rbx + 72]
+    0x48, 0x8B, 0x4B, 0x58,                   // mov rcx, [rbx + 88]
+    0x48, 0x8B, 0x53, 0x60,                   // mov rdx, [rbx + 96]
+    0x48, 0x8B, 0x73, 0x68,                   // mov rsi, [rbx + 104]
+    0x48, 0x8B, 0x7B, 0x70,                   // mov rdi, [rbx + 112]
+    0x48, 0x8B, 0x6B, 0x78,                   // mov rbp, [rbx + 120]
+    0x4C, 0x8B, 0x83, 0x80, 0x00, 0x00, 0x00, // mov r8, [rbx + 128]
+    0x4C, 0x8B, 0x8B, 0x88, 0x00, 0x00, 0x00, // mov r9, [rbx + 136]
+    0x4C, 0x8B, 0x93, 0x90, 0x00, 0x00, 0x00, // mov r10, [rbx + 144]
+    0x4C, 0x8B, 0x9B, 0x98, 0x00, 0x00, 0x00, // mov r11, [rbx + 152]
+    0x4C, 0x8B, 0xA3, 0xA0, 0x00, 0x00, 0x00, // mov r12, [rbx + 160]
+    0x4C, 0x8B, 0xAB, 0xA8, 0x00, 0x00, 0x00, // mov r13, [rbx + 168]
+    0x4C, 0x8B, 0xB3, 0xB0, 0x00, 0x00, 0x00, // mov r14, [rbx + 176]
+    0x4C, 0x8B, 0xBB, 0xB8, 0x00, 0x00, 0x00, // mov r15, [rbx + 184]
+    0x48, 0x8B, 0x25, 0x69, 0x0F, 0x00, 0x00, // mov rsp, [rip + param + 56]
+    0x48, 0x8B, 0x1D, 0x7A, 0x0F, 0x00, 0x00, // mov rbx, [rip + param + 80]
+    0xFF, 0x25, 0x54, 0x0F, 0x00, 0x00        // jmp [rip + param + 48]
+};
+
+/// Offset of the routine parameter in the block, the size of a page, so the
+///    parameter may have different protection than the code.
+inline constexpr std::size_t param_offset{0x1000};
+/// Required alignment of the FPU state area, the one of `xsave`.
+inline constexpr std::size_t fpu_state_align{64};
+/// Size of the FPU state area used with `fxsave`.
+inline constexpr std::size_t fxsave_size{512};
+
+/// Register values of the hijacked thread that the routine restores, in
+///    the order it expects them.
+struct regs {
+  std::uint64_t rip;
+  std::uint64_t rsp;
+  std::uint64_t rflags;
+  std::uint64_t rax;
+  std::uint64_t rbx;
+  std::uint64_t rcx;
+  std::uint64_t rdx;
+  std::uint64_t rsi;
+  std::uint64_t rdi;
+  std::uint64_t rbp;
+  std::uint64_t r8;
+  std::uint64_t r9;
+  std::uint64_t r10;
+  std::uint64_t r11;
+  std::uint64_t r12;
+  std::uint64_t r13;
+  std::uint64_t r14;
+  std::uint64_t r15;
+};
+
+/// Fixed part of the routine parameter, followed by shared object path
+///    addresses.
+struct param {
+  /// Address of `dlopen`.
+  std::uint64_t dlopen;
+  /// Number of shared objects to load.
+  std::uint64_t num_paths;
+  /// Address of the FPU state area.
+  std::uint64_t fpu_state;
+  /// Non-zero to save FPU state with `xsave` for all components enabled by
+  ///    the OS, zero to save x87 and SSE state only, with `fxsave`.
+  std::uint64_t xsave;
+  /// Number of shared objects loaded, written by the routine.
+  std::uint64_t loaded;
+  /// Set to 1 by the routine after it has restored FPU state.
+  std::uint64_t done;
+  /// Register values to restore.
+  regs saved;
+};
+
+static_assert(offsetof(param, saved) == 48 && sizeof(param) == 192,
+              "The routine relies on the layout of its parameter");
+
+/// Get the offset of the FPU state area in the block.
+///
+/// @param paths
+///    Null-terminated paths to the shared objects to load.
+/// @return Offset of the area, in bytes.
+[[gnu::visibility("internal")]]
+constexpr std::size_t fpu_state_offset(
+    std::span<const char *const> paths) noexcept {
+  auto offset{param_offset + sizeof(param) +
+              paths.size() * sizeof(std::uint64_t)};
+  for (const auto path : paths) {
+    offset += std::string_view{path}.length() + 1;
+  }
+  return (offset + fpu_state_align - 1) & ~(fpu_state_align - 1);
+}
+
+/// Get the size of the block.
+///
+/// @param paths
+///    Null-terminated paths to the shared objects to load.
+/// @param fpu_state_size
+///    Size of the FPU state area, in bytes.
+/// @return Size of the block, in bytes.
+[[gnu::visibility("internal")]]
+constexpr std::size_t size(std::span<const char *const> paths,
+                           std::size_t fpu_state_size) noexcept {
+  return fpu_state_offset(paths) + fpu_state_size;
+}
+
+/// Write the block.
+///
+/// @param [out] buf
+///    Pointer to the buffer that receives the block. Must have space for at
+///    least @ref size bytes.
+/// @param remote_base
+///    Address that the block will be written to in the target process.
+/// @param fixed
+///    Fixed part of the routine parameter, @ref param::num_paths,
+///    @ref param::fpu_state, @ref param::loaded and @ref param::done are
+///    ignored.
+/// @param paths
+///    Null-terminated paths to the shared objects to load.
+/// @param fpu_state_size
+///    Size of the FPU state area, in bytes.
+[[gnu::visibility("internal")]]
+inline void write(void *buf, std::uint64_t remote_base, param fixed,
+                  std::span<const char *const> paths,
+                  std::size_t fpu_state_size) noexcept {
+  const auto base{static_cast<char *>(buf)};
+  std::memcpy(base, code.data(), code.size());
+  std::memset(base + code.size(), 0xCC, param_offset - code.size());
+  const auto state_offset{fpu_state_offset(paths)};
+  fixed.num_paths = paths.size();
+  fixed.fpu_state = remote_base + state_offset;
+  fixed.loaded = 0;
+  fixed.done = 0;
+  std::memcpy(base + param_offset, &fixed, sizeof fixed);
+  auto addr{base + param_offset + sizeof fixed};
+  auto str_offset{param_offset + sizeof fixed +
+                  paths.size() * sizeof(std::uint64_t)};
+  for (const auto path : paths) {
+    const auto path_size{std::string_view{path}.length() + 1};
+    std::memcpy(base + str_offset, path, path_size);
+    const std::uint64_t path_addr{remote_base + str_offset};
+    std::memcpy(addr, &path_addr, sizeof path_addr);
+    addr += sizeof path_addr;
+    str_offset += path_size;
+  }
+  // Padding and the FPU state area are written to the process along with
+  //    the rest of the block
+  std::memset(base + str_offset, 0, state_offset - str_offset + fpu_state_size);
+}
+
+} // namespace tek_inj::ptrace_stub
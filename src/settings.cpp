@@ -0,0 +1,911 @@
+//===-- settings.cpp - Binary settings encoding implementation ------------===//
+//
+// Copyright (c) 2025 Nuclearist <nuclearist@teknology-hub.com>
+// Part of tek-injector, under the GNU General Public License v3.0 or later
+// See https://github.com/teknology-hub/tek-injector/blob/main/COPYING for
+//    license information.
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+//===----------------------------------------------------------------------===//
+///
+/// @file
+///  Implementation of binary settings encoding, compression and decoding.
+///
+//===----------------------------------------------------------------------===//
+#include "settings.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <string_view>
+#include <system_error>
+
+namespace tek_inj::settings {
+
+namespace {
+
+/// Maximum nesting depth of arrays and objects, protects the recursive parser
+///    from stack overflow.
+constexpr int max_depth{256};
+
+/// JSON parser that writes binary encoding of parsed values.
+class [[gnu::visibility("internal")]] encoder {
+  /// Pointer to the current character of the JSON.
+  const char *cur;
+  /// Pointer to the end of the JSON.
+  const char *const end;
+  /// Output buffer.
+  char *const buf;
+  /// Size of @ref buf, in bytes.
+  const std::size_t buf_size;
+  /// Number of bytes in the encoding so far, may exceed @ref buf_size.
+  std::size_t size;
+
+  /// Append a byte to the encoding.
+  constexpr void put(std::uint8_t byte) noexcept {
+    if (size < buf_size) {
+      buf[size] = static_cast<char>(byte);
+    }
+    ++size;
+  }
+
+  /// Append a little-endian 32-bit value to the encoding.
+  constexpr void put_u32(std::uint32_t value) noexcept {
+    for (int i{}; i < 4; ++i) {
+      put(static_cast<std::uint8_t>(value >> (i * 8)));
+    }
+  }
+
+  /// Overwrite a little-endian 32-bit value previously written at @p pos.
+  constexpr void patch_u32(std::size_t pos, std::uint32_t value) noexcept {
+    for (int i{}; i < 4; ++i, ++pos) {
+      if (pos < buf_size) {
+        buf[pos] = static_cast<char>(value >> (i * 8));
+      }
+    }
+  }
+
+  /// Append a UTF-8 encoded code point to the encoding.
+  constexpr void put_utf8(std::uint32_t cp) noexcept {
+    if (cp < 0x80) {
+      put(static_cast<std::uint8_t>(cp));
+    } else if (cp < 0x800) {
+      put(static_cast<std::uint8_t>(0xC0 | (cp >> 6)));
+      put(static_cast<std::uint8_t>(0x80 | (cp & 0x3F)));
+    } else if (cp < 0x10000) {
+      put(static_cast<std::uint8_t>(0xE0 | (cp >> 12)));
+      put(static_cast<std::uint8_t>(0x80 | ((cp >> 6) & 0x3F)));
+      put(static_cast<std::uint8_t>(0x80 | (cp & 0x3F)));
+    } else {
+      put(static_cast<std::uint8_t>(0xF0 | (cp >> 18)));
+      put(static_cast<std::uint8_t>(0x80 | ((cp >> 12) & 0x3F)));
+      put(static_cast<std::uint8_t>(0x80 | ((cp >> 6) & 0x3F)));
+      put(static_cast<std::uint8_t>(0x80 | (cp & 0x3F)));
+    }
+  }
+
+  constexpr void skip_ws() noexcept {
+    while (cur < end &&
+           (*cur == ' ' || *cur == '\t' || *cur == '\n' || *cur == '\r')) {
+      ++cur;
+    }
+  }
+
+  /// Consume a literal if it's next in the JSON.
+  constexpr bool consume(std::string_view literal) noexcept {
+    if (std::string_view{cur, end}.starts_with(literal)) {
+      cur += literal.length();
+      return true;
+    }
+    return false;
+  }
+
+  /// Parse 4 hexadecimal digits of a \u escape sequence.
+  constexpr bool parse_hex4(std::uint32_t &value) noexcept {
+    if (end - cur < 4) {
+      cur = end;
+      return false;
+    }
+    value = 0;
+    for (int i{}; i < 4; ++i, ++cur) {
+      const char ch{*cur};
+      value <<= 4;
+      if (ch >= '0' && ch <= '9') {
+        value |= static_cast<std::uint32_t>(ch - '0');
+      } else if (ch >= 'a' && ch <= 'f') {
+        value |= static_cast<std::uint32_t>(ch - 'a' + 10);
+      } else if (ch >= 'A' && ch <= 'F') {
+        value |= static_cast<std::uint32_t>(ch - 'A' + 10);
+      } else {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  /// Parse a string starting at the opening quote, and write its byte count
+  ///    and unescaped content.
+  constexpr bool parse_string() noexcept {
+    ++cur;
+    const auto size_pos{size};
+    put_u32(0);
+    const auto start{size};
+    while (cur < end) {
+      const auto ch{static_cast<unsigned char>(*cur)};
+      if (ch == '"') {
+        ++cur;
+        const auto len{size - start};
+        if (len > std::numeric_limits<std::uint32_t>::max()) {
+          return false;
+        }
+        patch_u32(size_pos, static_cast<std::uint32_t>(len));
+        return true;
+      }
+      if (ch < 0x20) {
+        return false;
+      }
+      if (ch != '\\') {
+        put(ch);
+        ++cur;
+        continue;
+      }
+      if (++cur == end) {
+        return false;
+      }
+      switch (*cur++) {
+      case '"':
+        put('"');
+        break;
+      case '\\':
+        put('\\');
+        break;
+      case '/':
+        put('/');
+        break;
+      case 'b':
+        put('\b');
+        break;
+      case 'f':
+        put('\f');
+        break;
+      case 'n':
+        put('\n');
+        break;
+      case 'r':
+        put('\r');
+        break;
+      case 't':
+        put('\t');
+        break;
+      case 'u': {
+        std::uint32_t cp;
+        if (!parse_hex4(cp)) {
+          return false;
+        }
+        if (cp >= 0xD800 && cp < 0xDC00) {
+          // High surrogate, must be followed by a low one
+          std::uint32_t low;
+          if (!consume("\\u") || !parse_hex4(low) || low < 0xDC00 ||
+              low >= 0xE000) {
+            return false;
+          }
+          cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+        } else if (cp >= 0xDC00 && cp < 0xE000) {
+          return false;
+        }
+        put_utf8(cp);
+        break;
+      }
+      default:
+        --cur;
+        return false;
+      }
+    }
+    return false;
+  }
+
+  /// Parse a number and write its encoding.
+  constexpr bool parse_number() noexcept {
+    const auto start{cur};
+    bool is_integer{true};
+    if (*cur == '-') {
+      ++cur;
+    }
+    if (cur == end) {
+      return false;
+    }
+    if (*cur == '0') {
+      ++cur;
+    } else if (*cur >= '1' && *cur <= '9') {
+      while (cur < end && *cur >= '0' && *cur <= '9') {
+        ++cur;
+      }
+    } else {
+      return false;
+    }
+    if (cur < end && *cur == '.') {
+      is_integer = false;
+      const auto digits{++cur};
+      while (cur < end && *cur >= '0' && *cur <= '9') {
+        ++cur;
+      }
+      if (cur == digits) {
+        return false;
+      }
+    }
+    if (cur < end && (*cur == 'e' || *cur == 'E')) {
+      is_integer = false;
+      ++cur;
+      if (cur < end && (*cur == '+' || *cur == '-')) {
+        ++cur;
+      }
+      const auto digits{cur};
+      while (cur < end && *cur >= '0' && *cur <= '9') {
+        ++cur;
+      }
+      if (cur == digits) {
+        return false;
+      }
+    }
+    // -0 is kept as a floating-point number, as integers have no sign of zero
+    if (is_integer && !(*start == '-' && start[1] == '0')) {
+      std::int64_t value;
+      if (std::from_chars(start, cur, value).ec == std::errc{}) {
+        put(static_cast<std::uint8_t>(tag::integer));
+        // Zigzag encoding keeps small negative values short
+        auto zz{(static_cast<std::uint64_t>(value) << 1) ^
+                static_cast<std::uint64_t>(value >> 63)};
+        for (; zz >= 0x80; zz >>= 7) {
+          put(static_cast<std::uint8_t>(zz | 0x80));
+        }
+        put(static_cast<std::uint8_t>(zz));
+        return true;
+      }
+      // Out of range for 64 bits, encode as a floating-point number instead
+    }
+    double value;
+    if (std::from_chars(start, cur, value).ec != std::errc{}) {
+      // The syntax has been checked already, so the number is just out of
+      //    binary64 range, keep its text
+      const auto len{static_cast<std::uint32_t>(cur - start)};
+      put(static_cast<std::uint8_t>(tag::decimal));
+      put_u32(len);
+      for (auto it{start}; it < cur; ++it) {
+        put(static_cast<std::uint8_t>(*it));
+      }
+      return true;
+    }
+    put(static_cast<std::uint8_t>(tag::number));
+    const auto bits{std::bit_cast<std::uint64_t>(value)};
+    for (int i{}; i < 8; ++i) {
+      put(static_cast<std::uint8_t>(bits >> (i * 8)));
+    }
+    return true;
+  }
+
+public:
+  constexpr encoder(std::string_view json, char *buf,
+                    std::size_t buf_size) noexcept
+      : cur{json.data()}, end{json.data() + json.size()}, buf{buf},
+        buf_size{buf_size}, size{} {}
+
+  /// Parse a value and write its encoding.
+  ///
+  /// @param depth
+  ///    Current nesting depth.
+  /// @return Value indicating whether the value is valid.
+  constexpr bool parse_value(int depth) noexcept {
+    skip_ws();
+    if (cur == end) {
+      return false;
+    }
+    switch (*cur) {
+    case 'n':
+      put(static_cast<std::uint8_t>(tag::null));
+      return consume("null");
+    case 'f':
+      put(static_cast<std::uint8_t>(tag::false_value));
+      return consume("false");
+    case 't':
+      put(static_cast<std::uint8_t>(tag::true_value));
+      return consume("true");
+    case '"':
+      put(static_cast<std::uint8_t>(tag::string));
+      return parse_string();
+    case '[': {
+      if (++depth > max_depth) {
+        return false;
+      }
+      ++cur;
+      put(static_cast<std::uint8_t>(tag::array));
+      const auto count_pos{size};
+      put_u32(0);
+      std::uint32_t count{};
+      skip_ws();
+      if (cur < end && *cur == ']') {
+        ++cur;
+        return true;
+      }
+      for (;;) {
+        if (!parse_value(depth)) {
+          return false;
+        }
+        ++count;
+        skip_ws();
+        if (cur == end) {
+          return false;
+        }
+        if (*cur == ']') {
+          ++cur;
+          patch_u32(count_pos, count);
+          return true;
+        }
+        if (*cur != ',') {
+          return false;
+        }
+        ++cur;
+      }
+    }
+    case '{': {
+      if (++depth > max_depth) {
+        return false;
+      }
+      ++cur;
+      put(static_cast<std::uint8_t>(tag::object));
+      const auto count_pos{size};
+      put_u32(0);
+      std::uint32_t count{};
+      skip_ws();
+      if (cur < end && *cur == '}') {
+        ++cur;
+        return true;
+      }
+      for (;;) {
+        skip_ws();
+        if (cur == end || *cur != '"' || !parse_string()) {
+          return false;
+        }
+        skip_ws();
+        if (cur == end || *cur != ':') {
+          return false;
+        }
+        ++cur;
+        if (!parse_value(depth)) {
+          return false;
+        }
+        ++count;
+        skip_ws();
+        if (cur == end) {
+          return false;
+        }
+        if (*cur == '}') {
+          ++cur;
+          patch_u32(count_pos, count);
+          return true;
+        }
+        if (*cur != ',') {
+          return false;
+        }
+        ++cur;
+      }
+    }
+    default:
+      return (*cur == '-' || (*cur >= '0' && *cur <= '9')) && parse_number();
+    }
+  }
+
+  /// Check that only whitespace remains after the top-level value.
+  constexpr bool at_end() noexcept {
+    skip_ws();
+    return cur == end;
+  }
+
+  /// Get the offset of current character in the JSON.
+  constexpr std::size_t offset(std::string_view json) const noexcept {
+    return static_cast<std::size_t>(cur - json.data());
+  }
+
+  /// Get the size of the encoding.
+  constexpr std::size_t get_size() const noexcept { return size; }
+};
+
+/// Number of bits in indices of @ref compress hash table.
+constexpr int hash_bits{12};
+/// Minimum length of an LZ4 match.
+constexpr std::size_t min_match{4};
+/// Number of bytes at the end of LZ4 block that are always literals.
+constexpr std::size_t last_literals{5};
+/// Minimum distance from the start of the last LZ4 match to the end of the
+///    block.
+constexpr std::size_t match_start_limit{12};
+/// Maximum distance of an LZ4 match.
+constexpr std::size_t max_offset{0xFFFF};
+
+/// Read a little-endian 32-bit value.
+constexpr std::uint32_t get_u32(const char *ptr) noexcept {
+  std::uint32_t value{};
+  for (int i{}; i < 4; ++i) {
+    value |= std::uint32_t{static_cast<unsigned char>(ptr[i])} << (i * 8);
+  }
+  return value;
+}
+
+/// Writer of output with bounds checking, for @ref compress.
+class [[gnu::visibility("internal")]] bounded_writer {
+  /// Pointer to the next byte to write.
+  char *cur;
+  /// Pointer to the end of the buffer.
+  char *const end;
+
+public:
+  constexpr bounded_writer(char *buf, std::size_t buf_size) noexcept
+      : cur{buf}, end{buf + buf_size} {}
+
+  /// Value indicating whether all writes so far have fit into the buffer.
+  bool ok{true};
+
+  constexpr void put(std::uint8_t byte) noexcept {
+    if (cur < end) {
+      *cur++ = static_cast<char>(byte);
+    } else {
+      ok = false;
+    }
+  }
+
+  constexpr void put_bytes(const char *src, std::size_t size) noexcept {
+    if (static_cast<std::size_t>(end - cur) < size) {
+      ok = false;
+      return;
+    }
+    std::ranges::copy_n(src, static_cast<std::ptrdiff_t>(size), cur);
+    cur += size;
+  }
+
+  /// Write LZ4 length continuation bytes for a length that doesn't fit into
+  ///    a token nibble.
+  constexpr void put_length(std::size_t len) noexcept {
+    for (; len >= 255; len -= 255) {
+      put(255);
+    }
+    put(static_cast<std::uint8_t>(len));
+  }
+
+  /// Write an LZ4 sequence.
+  ///
+  /// @param literals
+  ///    Pointer to the literals.
+  /// @param num_literals
+  ///    Number of literals.
+  /// @param offset
+  ///    Distance of the match, or 0 for the last sequence that has none.
+  /// @param match_len
+  ///    Length of the match.
+  constexpr void put_sequence(const char *literals, std::size_t num_literals,
+                              std::size_t offset,
+                              std::size_t match_len) noexcept {
+    const auto ml{offset ? match_len - min_match : 0};
+    put(static_cast<std::uint8_t>(std::min<std::size_t>(num_literals, 15) << 4 |
+                                  std::min<std::size_t>(ml, 15)));
+    if (num_literals >= 15) {
+      put_length(num_literals - 15);
+    }
+    put_bytes(literals, num_literals);
+    if (!offset) {
+      return;
+    }
+    put(static_cast<std::uint8_t>(offset));
+    put(static_cast<std::uint8_t>(offset >> 8));
+    if (ml >= 15) {
+      put_length(ml - 15);
+    }
+  }
+
+  constexpr std::size_t size(const char *buf) const noexcept {
+    return static_cast<std::size_t>(cur - buf);
+  }
+};
+
+/// Writer of JSON text, for @ref decode.
+class [[gnu::visibility("internal")]] json_writer {
+  /// Output buffer.
+  char *const buf;
+  /// Size of @ref buf, in bytes.
+  const std::size_t buf_size;
+  /// Number of bytes in the text so far, may exceed @ref buf_size.
+  std::size_t size{};
+  /// Reader of the encoding.
+  reader &rd;
+
+  constexpr void put(char ch) noexcept {
+    if (size < buf_size) {
+      buf[size] = ch;
+    }
+    ++size;
+  }
+
+  constexpr void put(std::string_view str) noexcept {
+    for (const auto ch : str) {
+      put(ch);
+    }
+  }
+
+  /// Write a string, escaping characters that can't appear in JSON strings
+  ///    as is.
+  constexpr void put_string(std::string_view str) noexcept {
+    constexpr std::string_view hex{"0123456789abcdef"};
+    put('"');
+    for (const auto ch : str) {
+      switch (ch) {
+      case '"':
+        put(R"(\")");
+        break;
+      case '\\':
+        put(R"(\\)");
+        break;
+      case '\b':
+        put(R"(\b)");
+        break;
+      case '\f':
+        put(R"(\f)");
+        break;
+      case '\n':
+        put(R"(\n)");
+        break;
+      case '\r':
+        put(R"(\r)");
+        break;
+      case '\t':
+        put(R"(\t)");
+        break;
+      default:
+        if (static_cast<unsigned char>(ch) < 0x20) {
+          put(R"(\u00)");
+          put(hex[static_cast<unsigned char>(ch) >> 4]);
+          put(hex[static_cast<unsigned char>(ch) & 0xF]);
+        } else {
+          put(ch);
+        }
+      }
+    }
+    put('"');
+  }
+
+public:
+  constexpr json_writer(reader &rd, char *buf, std::size_t buf_size) noexcept
+      : buf{buf}, buf_size{buf_size}, rd{rd} {}
+
+  /// Read a value and write its JSON text.
+  ///
+  /// @param depth
+  ///    Current nesting depth.
+  /// @return Value indicating whether the value is valid.
+  bool write_value(int depth) noexcept {
+    value val;
+    if (!rd.read(val)) {
+      return false;
+    }
+    switch (val.type) {
+    case tag::null:
+      put("null");
+      return true;
+    case tag::false_value:
+      put("false");
+      return true;
+    case tag::true_value:
+      put("true");
+      return true;
+    case tag::integer: {
+      std::array<char, 20> text;
+      put({text.data(),
+           std::to_chars(text.begin(), text.end(), val.integer).ptr});
+      return true;
+    }
+    case tag::number: {
+      std::array<char, 32> text;
+      const std::string_view str{
+          text.data(),
+          std::to_chars(text.begin(), text.end(), val.number).ptr};
+      put(str);
+      // Keep integral values floating-point, so they read back as such
+      if (str.find_first_of(".e") == str.npos) {
+        put(".0");
+      }
+      return true;
+    }
+    case tag::string:
+      put_string(val.string);
+      return true;
+    case tag::decimal:
+      put(val.string);
+      return true;
+    case tag::array:
+      if (++depth > max_depth) {
+        return false;
+      }
+      put('[');
+      for (std::uint32_t i{}; i < val.count; ++i) {
+        if (i) {
+          put(',');
+        }
+        if (!write_value(depth)) {
+          return false;
+        }
+      }
+      put(']');
+      return true;
+    case tag::object:
+      if (++depth > max_depth) {
+        return false;
+      }
+      put('{');
+      for (std::uint32_t i{}; i < val.count; ++i) {
+        if (i) {
+          put(',');
+        }
+        std::string_view key;
+        if (!rd.read_key(key)) {
+          return false;
+        }
+        put_string(key);
+        put(':');
+        if (!write_value(depth)) {
+          return false;
+        }
+      }
+      put('}');
+      return true;
+    }
+    return false;
+  }
+
+  /// Get the size of the text.
+  constexpr std::size_t get_size() const noexcept { return size; }
+};
+
+/// Skip a value along with its elements or members.
+///
+/// @param rd
+///    Reader of the encoding.
+/// @param depth
+///    Current nesting depth.
+/// @return Value indicating whether the value is valid.
+bool skip_value(reader &rd, int depth) noexcept {
+  value val;
+  if (!rd.read(val)) {
+    return false;
+  }
+  if (val.type != tag::array && val.type != tag::object) {
+    return true;
+  }
+  if (++depth > max_depth) {
+    return false;
+  }
+  for (std::uint32_t i{}; i < val.count; ++i) {
+    std::string_view key;
+    if ((val.type == tag::object && !rd.read_key(key)) ||
+        !skip_value(rd, depth)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+} // namespace
+
+encode_result encode(std::string_view json, char *buf,
+                     std::size_t buf_size) noexcept {
+  encoder enc{json, buf, buf_size};
+  if (!enc.parse_value(0) || !enc.at_end()) {
+    return {.valid = false, .size = enc.offset(json)};
+  }
+  return {.valid = true, .size = enc.get_size()};
+}
+
+std::size_t compress(std::string_view encoding, char *buf,
+                     std::size_t buf_size) noexcept {
+  const auto src{encoding.data()};
+  const auto src_size{encoding.size()};
+  if (buf_size < compressed_header_size ||
+      src_size > std::numeric_limits<std::uint32_t>::max()) {
+    return 0;
+  }
+  for (int i{}; i < 4; ++i) {
+    buf[i] = static_cast<char>(compressed_magic >> (i * 8));
+    buf[4 + i] = static_cast<char>(src_size >> (i * 8));
+  }
+  bounded_writer out{buf + compressed_header_size,
+                     buf_size - compressed_header_size};
+  // Greedy LZ4 block compression with a single-entry hash table of 4-byte
+  //    sequences
+  std::array<std::uint32_t, 1 << hash_bits> table;
+  table.fill(std::numeric_limits<std::uint32_t>::max());
+  std::size_t anchor{};
+  if (src_size > match_start_limit) {
+    const auto match_limit{src_size - match_start_limit};
+    for (std::size_t pos{}; pos < match_limit && out.ok;) {
+      const auto seq{get_u32(src + pos)};
+      auto &entry{table[(seq * 2654435761u) >> (32 - hash_bits)]};
+      const std::size_t ref{entry};
+      entry = static_cast<std::uint32_t>(pos);
+      if (ref == std::numeric_limits<std::uint32_t>::max() ||
+          pos - ref > max_offset || get_u32(src + ref) != seq) {
+        ++pos;
+        continue;
+      }
+      auto len{min_match};
+      while (pos + len < src_size - last_literals &&
+             src[ref + len] == src[pos + len]) {
+        ++len;
+      }
+      out.put_sequence(src + anchor, pos - anchor, pos - ref, len);
+      pos += len;
+      anchor = pos;
+    }
+  }
+  out.put_sequence(src + anchor, src_size - anchor, 0, 0);
+  return out.ok ? compressed_header_size + out.size(buf +
+                                                    compressed_header_size)
+                : 0;
+}
+
+bool is_compressed(std::string_view data) noexcept {
+  return data.size() >= compressed_header_size &&
+         get_u32(data.data()) == compressed_magic;
+}
+
+std::size_t decompressed_size(std::string_view data) noexcept {
+  return is_compressed(data) ? get_u32(data.data() + 4) : 0;
+}
+
+bool decompress(std::string_view data, char *buf) noexcept {
+  if (!is_compressed(data)) {
+    return false;
+  }
+  const auto out_size{decompressed_size(data)};
+  auto in{reinterpret_cast<const unsigned char *>(data.data()) +
+          compressed_header_size};
+  const auto in_end{reinterpret_cast<const unsigned char *>(data.data()) +
+                    data.size()};
+  std::size_t out_pos{};
+  // Read length continuation bytes, fails on truncated input
+  const auto read_length{[&in, in_end](std::size_t &len) {
+    for (;;) {
+      if (in == in_end) {
+        return false;
+      }
+      const auto byte{*in++};
+      len += byte;
+      if (byte != 255) {
+        return true;
+      }
+    }
+  }};
+  for (;;) {
+    if (in == in_end) {
+      return false;
+    }
+    const auto token{*in++};
+    std::size_t num_literals{static_cast<std::size_t>(token >> 4)};
+    if (num_literals == 15 && !read_length(num_literals)) {
+      return false;
+    }
+    if (static_cast<std::size_t>(in_end - in) < num_literals ||
+        out_size - out_pos < num_literals) {
+      return false;
+    }
+    std::ranges::copy_n(in, static_cast<std::ptrdiff_t>(num_literals),
+                        buf + out_pos);
+    in += num_literals;
+    out_pos += num_literals;
+    if (in == in_end) {
+      // The last sequence has no match
+      return out_pos == out_size;
+    }
+    if (in_end - in < 2) {
+      return false;
+    }
+    const std::size_t offset{static_cast<std::size_t>(in[0] | in[1] << 8)};
+    in += 2;
+    std::size_t len{static_cast<std::size_t>(token & 0xF)};
+    if (len == 15 && !read_length(len)) {
+      return false;
+    }
+    len += min_match;
+    if (!offset || offset > out_pos || out_size - out_pos < len) {
+      return false;
+    }
+    // Matches may overlap their output, so they're copied byte by byte
+    for (auto ref{out_pos - offset}; len; --len) {
+      buf[out_pos++] = buf[ref++];
+    }
+  }
+}
+
+bool reader::read(value &val) noexcept {
+  if (cur == end) {
+    return false;
+  }
+  val.type = static_cast<tag>(*cur++);
+  switch (val.type) {
+  case tag::null:
+    return true;
+  case tag::false_value:
+  case tag::true_value:
+    val.boolean = val.type == tag::true_value;
+    return true;
+  case tag::integer: {
+    std::uint64_t zz{};
+    for (int shift{};; shift += 7) {
+      if (cur == end || shift > 63) {
+        return false;
+      }
+      const auto byte{static_cast<unsigned char>(*cur++)};
+      zz |= std::uint64_t{byte & 0x7Fu} << shift;
+      if (!(byte & 0x80)) {
+        break;
+      }
+    }
+    val.integer = static_cast<std::int64_t>(zz >> 1) ^
+                  -static_cast<std::int64_t>(zz & 1);
+    return true;
+  }
+  case tag::number: {
+    if (end - cur < 8) {
+      return false;
+    }
+    std::uint64_t bits{};
+    for (int i{}; i < 8; ++i) {
+      bits |= std::uint64_t{static_cast<unsigned char>(*cur++)} << (i * 8);
+    }
+    val.number = std::bit_cast<double>(bits);
+    return true;
+  }
+  case tag::string:
+  case tag::decimal:
+    return read_key(val.string);
+  case tag::array:
+  case tag::object:
+    if (end - cur < 4) {
+      return false;
+    }
+    val.count = get_u32(cur);
+    cur += 4;
+    // Every element takes at least a byte, which bounds the count for
+    //    callers that reserve space for elements
+    return val.count <= static_cast<std::size_t>(end - cur);
+  default:
+    return false;
+  }
+}
+
+bool reader::read_key(std::string_view &key) noexcept {
+  if (end - cur < 4) {
+    return false;
+  }
+  const auto len{get_u32(cur)};
+  cur += 4;
+  if (static_cast<std::size_t>(end - cur) < len) {
+    return false;
+  }
+  key = {cur, len};
+  cur += len;
+  return true;
+}
+
+bool reader::skip() noexcept { return skip_value(*this, 0); }
+
+decode_result decode(std::string_view encoding, char *buf,
+                     std::size_t buf_size) noexcept {
+  reader rd{encoding};
+  json_writer writer{rd, buf, buf_size};
+  if (!writer.write_value(0) || !rd.at_end()) {
+    return {.valid = false, .size = 0};
+  }
+  return {.valid = true, .size = writer.get_size()};
+}
+
+} // namespace tek_inj::settings
@@ -0,0 +1,228 @@
+//===-- settings.hpp - Binary settings encoding ---------------------------===//
+//
+// Copyright (c) 2025 Nuclearist <nuclearist@teknology-hub.com>
+// Part of tek-injector, under the GNU General Public License v3.0 or later
+// See https://github.com/teknology-hub/tek-injector/blob/main/COPYING for
+//    license information.
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+//===----------------------------------------------------------------------===//
+///
+/// @file
+///  Declarations of portable functions for converting TEK Game Runtime
+///    settings JSON into compact binary encoding, compressing it, and reading
+///    it back. Decoding functions don't depend on anything but the standard
+///    library, so TEK Game Runtime may use these files as is.
+///  The encoding is a pre-order serialization of JSON value tree, where each
+///    value starts with a @ref tag byte followed by its content:
+///  - @ref tag::null, @ref tag::false_value, @ref tag::true_value: nothing.
+///  - @ref tag::integer: zigzag-encoded value as unsigned LEB128 varint.
+///  - @ref tag::number: IEEE 754 binary64 value, little-endian.
+///  - @ref tag::string: 32-bit little-endian byte count followed by unescaped
+///    UTF-8 bytes, without null terminator.
+///  - @ref tag::array: 32-bit little-endian element count followed by the
+///    elements.
+///  - @ref tag::object: 32-bit little-endian member count followed by the
+///    members, each one being a key in the same format as string content
+///    (without the tag byte) followed by the value.
+///  - @ref tag::decimal: number text from the JSON in the same format as
+///    string content.
+///  Compressed encoding starts with @ref compressed_magic, followed by 32-bit
+///    little-endian size of the encoding and a single LZ4 block with it.
+///    The first byte of uncompressed encoding is a tag, so the two can be told
+///    apart by the first 4 bytes.
+///  Decoders validate all sizes and counts against the end of the input, so
+///    malformed input is rejected rather than read out of bounds.
+///
+//===----------------------------------------------------------------------===//
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace tek_inj::settings {
+
+/// Value type tags of the binary encoding.
+enum class tag : std::uint8_t {
+  null,
+  false_value,
+  true_value,
+  /// Number without fraction and exponent that fits into 64-bit signed
+  ///    integer.
+  integer,
+  /// Any other number.
+  number,
+  string,
+  array,
+  object,
+  /// Number that is not representable as binary64 because it's out of its
+  ///    range, e.g. 1e400, kept as text.
+  decimal
+};
+
+/// First 4 bytes of compressed encoding, "TGRZ" in little-endian.
+inline constexpr std::uint32_t compressed_magic{0x5A524754};
+
+/// Size of the header of compressed encoding, in bytes.
+inline constexpr std::size_t compressed_header_size{8};
+
+/// Result of @ref encode.
+struct encode_result {
+  /// Value indicating whether the JSON is valid.
+  bool valid;
+  /// If the JSON is valid, size of its binary encoding, in bytes. Otherwise,
+  ///    offset of the first invalid character in the JSON.
+  std::size_t size;
+};
+
+/// Validate settings JSON and encode it.
+///
+/// @param json
+///    The JSON text to encode.
+/// @param [out] buf
+///    Pointer to the buffer that receives the encoding, may be `nullptr` if
+///    @p buf_size is 0. Only the first @p buf_size bytes of the encoding are
+///    written, so the function may be called with empty buffer first to get
+///    the required size.
+/// @param buf_size
+///    Size of @p buf, in bytes.
+/// @return Result of the encoding.
+[[gnu::visibility("internal")]]
+encode_result encode(std::string_view json, char *buf,
+                     std::size_t buf_size) noexcept;
+
+/// Compress binary encoding of settings.
+///
+/// @param encoding
+///    The encoding to compress.
+/// @param [out] buf
+///    Pointer to the buffer that receives compressed encoding.
+/// @param buf_size
+///    Size of @p buf, in bytes.
+/// @return Size of compressed encoding in bytes, or 0 if it doesn't fit into
+///    @p buf, in which case content of @p buf is unspecified.
+[[gnu::visibility("internal")]]
+std::size_t compress(std::string_view encoding, char *buf,
+                     std::size_t buf_size) noexcept;
+
+/// Check whether data is compressed encoding.
+///
+/// @param data
+///    The data to check.
+/// @return Value indicating whether @p data starts with
+///    @ref compressed_magic.
+[[gnu::visibility("internal")]]
+bool is_compressed(std::string_view data) noexcept;
+
+/// Get the size of the encoding stored in compressed encoding.
+///
+/// @param data
+///    The compressed encoding.
+/// @return Size of the encoding in bytes, or 0 if @p data is not compressed
+///    encoding.
+[[gnu::visibility("internal")]]
+std::size_t decompressed_size(std::string_view data) noexcept;
+
+/// Decompress compressed encoding.
+///
+/// @param data
+///    The compressed encoding.
+/// @param [out] buf
+///    Pointer to the buffer that receives the encoding, must have space for
+///    @ref decompressed_size bytes.
+/// @return Value indicating whether @p data is valid and has been
+///    decompressed.
+[[gnu::visibility("internal")]]
+bool decompress(std::string_view data, char *buf) noexcept;
+
+/// Value read from binary encoding by @ref reader.
+struct value {
+  /// Type of the value.
+  tag type;
+  /// If @ref type is @ref tag::false_value or @ref tag::true_value, the
+  ///    value.
+  bool boolean;
+  /// If @ref type is @ref tag::integer, the value.
+  std::int64_t integer;
+  /// If @ref type is @ref tag::number, the value.
+  double number;
+  /// If @ref type is @ref tag::string, the string. If @ref type is
+  ///    @ref tag::decimal, text of the number.
+  std::string_view string;
+  /// If @ref type is @ref tag::array, number of its elements, or if it's
+  ///    @ref tag::object, number of its members, which follow the value.
+  std::uint32_t count;
+};
+
+/// Sequential reader of binary encoding. Values are read in pre-order: an
+///    array is followed by its elements, and an object by its members, each
+///    member being read with @ref read_key and then @ref read or @ref skip.
+///    Strings are views of the encoding, nothing is copied.
+class [[gnu::visibility("internal")]] reader {
+  /// Pointer to the next byte to read.
+  const char *cur;
+  /// Pointer to the end of the encoding.
+  const char *end;
+
+public:
+  /// Create a reader of uncompressed encoding.
+  ///
+  /// @param encoding
+  ///    The encoding, must stay valid while the reader is used.
+  constexpr explicit reader(std::string_view encoding) noexcept
+      : cur{encoding.data()}, end{encoding.data() + encoding.size()} {}
+
+  /// Read the next value.
+  ///
+  /// @param [out] val
+  ///    Variable that receives the value.
+  /// @return Value indicating whether a valid value has been read.
+  bool read(value &val) noexcept;
+
+  /// Read the key of the next object member.
+  ///
+  /// @param [out] key
+  ///    Variable that receives the key.
+  /// @return Value indicating whether a valid key has been read.
+  bool read_key(std::string_view &key) noexcept;
+
+  /// Skip the next value, along with all its elements or members.
+  ///
+  /// @return Value indicating whether a valid value has been skipped.
+  bool skip() noexcept;
+
+  /// Check whether the whole encoding has been read.
+  ///
+  /// @return Value indicating whether there is nothing left to read.
+  constexpr bool at_end() const noexcept { return cur == end; }
+};
+
+/// Result of @ref decode.
+struct decode_result {
+  /// Value indicating whether the encoding is valid.
+  bool valid;
+  /// If the encoding is valid, size of JSON text produced from it, in bytes.
+  std::size_t size;
+};
+
+/// Convert binary encoding of settings back into JSON text, e.g. for
+///    runtimes that parse JSON themselves. The text has no whitespace, and
+///    numbers are written in the shortest form that reads back into the
+///    same encoding.
+///
+/// @param encoding
+///    The uncompressed encoding to decode.
+/// @param [out] buf
+///    Pointer to the buffer that receives JSON text, may be `nullptr` if
+///    @p buf_size is 0. Only the first @p buf_size bytes of the text are
+///    written, so the function may be called with empty buffer first to get
+///    the required size.
+/// @param buf_size
+///    Size of @p buf, in bytes.
+/// @return Result of the decoding.
+[[gnu::visibility("internal")]]
+decode_result decode(std::string_view encoding, char *buf,
+                     std::size_t buf_size) noexcept;
+
+} // namespace tek_inj::settings
@@ -0,0 +1,208 @@
+//===-- cmd_line.cpp - Command line quoting tests -------------------------===//
+//
+// Copyright (c) 2025 Nuclearist <nuclearist@teknology-hub.com>
+// Part of tek-injector, under the GNU General Public License v3.0 or later
+// See https://github.com/teknology-hub/tek-injector/blob/main/COPYING for
+//    license information.
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+//===----------------------------------------------------------------------===//
+///
+/// @file
+///  Tests of command line building: lines built from program paths and
+///    arguments are split back by a reimplementation of `CommandLineToArgvW`
+///    rules, and the result must match the input exactly. Besides
+///    hand-picked cases, arguments are generated from every combination of
+///    characters that are special to the rules.
+///
+//===----------------------------------------------------------------------===//
+#include "cmd_line.hpp"
+
+#include "test.hpp"
+
+#include <array>
+#include <cstddef>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+/// Split a command line the way `CommandLineToArgvW` does.
+///
+/// @param line
+///    The command line to split.
+/// @return The program path followed by the arguments.
+std::vector<std::wstring> split(std::wstring_view line) {
+  std::vector<std::wstring> res;
+  auto it{line.begin()};
+  const auto end{line.end()};
+  // The first token ends at the closing quote or at whitespace, backslashes
+  //    have no special meaning in it
+  std::wstring program;
+  if (it != end && *it == L'"') {
+    for (++it; it != end && *it != L'"'; ++it) {
+      program += *it;
+    }
+    if (it != end) {
+      ++it;
+    }
+  } else {
+    for (; it != end && *it != L' ' && *it != L'\t'; ++it) {
+      program += *it;
+    }
+  }
+  res.emplace_back(std::move(program));
+  while (it != end && (*it == L' ' || *it == L'\t')) {
+    ++it;
+  }
+  if (it == end) {
+    return res;
+  }
+  // Arguments, with 2N backslashes before a quote producing N backslashes and
+  //    toggling quoted state, 2N+1 ones producing N backslashes and a literal
+  //    quote, and every third consecutive quote producing a literal one
+  std::wstring arg;
+  std::size_t num_backslashes{};
+  int num_quotes{};
+  while (it != end) {
+    const auto ch{*it};
+    if ((ch == L' ' || ch == L'\t') && num_quotes == 0) {
+      res.emplace_back(std::move(arg));
+      arg.clear();
+      num_backslashes = 0;
+      while (it != end && (*it == L' ' || *it == L'\t')) {
+        ++it;
+      }
+      if (it == end) {
+        return res;
+      }
+      continue;
+    }
+    if (ch == L'\\') {
+      arg += ch;
+      ++num_backslashes;
+      ++it;
+      continue;
+    }
+    if (ch == L'"') {
+      arg.resize(arg.size() - num_backslashes / 2);
+      if (num_backslashes % 2) {
+        arg.back() = L'"';
+      } else {
+        ++num_quotes;
+      }
+      ++it;
+      num_backslashes = 0;
+      for (; it != end && *it == L'"'; ++it) {
+        if (++num_quotes == 3) {
+          arg += L'"';
+          num_quotes = 0;
+        }
+      }
+      if (num_quotes == 2) {
+        num_quotes = 0;
+      }
+      continue;
+    }
+    arg += ch;
+    num_backslashes = 0;
+    ++it;
+  }
+  res.emplace_back(std::move(arg));
+  return res;
+}
+
+/// Build a command line and check that it's split back into the input.
+///
+/// @param program
+///    Path to the program executable.
+/// @param args
+///    Arguments to pass to the program.
+/// @return Value indicating whether the check has passed.
+bool round_trip(std::wstring_view program,
+                const std::vector<std::wstring> &args) {
+  std::vector<const wchar_t *> argv;
+  argv.reserve(args.size());
+  for (const auto &arg : args) {
+    argv.emplace_back(arg.data());
+  }
+  std::wstring line(tek_inj::cmd_line::length<wchar_t>(program, argv), L'\0');
+  if (tek_inj::cmd_line::write<wchar_t>(program, argv, line.data()) !=
+      line.data() + line.size()) {
+    return false;
+  }
+  auto expected{args};
+  expected.emplace(expected.begin(), program);
+  return split(line) == expected;
+}
+
+//===-- Test cases --------------------------------------------------------===//
+
+TEST_CASE(plain) {
+  CHECK(round_trip(L"C:\\game\\game.exe", {}));
+  CHECK(round_trip(L"C:\\game\\game.exe", {L"-windowed", L"+map=x"}));
+  constexpr std::span<const wchar_t *const> no_args;
+  CHECK(tek_inj::cmd_line::length<wchar_t>(L"game.exe", no_args) == 8);
+}
+
+TEST_CASE(program_with_spaces) {
+  CHECK(round_trip(L"C:\\Program Files\\game\\game.exe", {L"-a"}));
+  CHECK(round_trip(L"C:\\game\tdir\\game.exe", {L"a b"}));
+  CHECK(round_trip(L"C:\\game\\", {L"x"}));
+}
+
+TEST_CASE(empty_args) {
+  CHECK(round_trip(L"game.exe", {L""}));
+  CHECK(round_trip(L"game.exe", {L"", L"", L""}));
+  CHECK(round_trip(L"game.exe", {L"a", L"", L"b"}));
+}
+
+TEST_CASE(quotes) {
+  CHECK(round_trip(L"game.exe", {L"\""}));
+  CHECK(round_trip(L"game.exe", {L"\"\""}));
+  CHECK(round_trip(L"game.exe", {L"\"\"\""}));
+  CHECK(round_trip(L"game.exe", {L"say \"hi\"", L"a\"b"}));
+}
+
+TEST_CASE(backslashes) {
+  CHECK(round_trip(L"game.exe", {L"\\", L"\\\\", L"C:\\dir\\"}));
+  CHECK(round_trip(L"game.exe", {L"C:\\dir with space\\"}));
+  CHECK(round_trip(L"game.exe", {L"C:\\dir with space\\\\"}));
+  CHECK(round_trip(L"game.exe", {L"\\\"", L"\\\\\"", L"a\\\\\\\"b c"}));
+  CHECK(round_trip(L"game.exe", {L"\\\\server\\share", L"a\\b c\\d"}));
+}
+
+TEST_CASE(whitespace) {
+  CHECK(round_trip(L"game.exe", {L" ", L"\t", L"a\tb", L" lead", L"trail "}));
+  CHECK(round_trip(L"game.exe", {L"a\nb", L"a\vb"}));
+}
+
+TEST_CASE(exhaustive) {
+  // Every argument of up to 5 characters from the alphabet, placed both alone
+  //    and between other arguments
+  constexpr std::array alphabet{L'a', L'\\', L'"', L' ', L'\t'};
+  std::vector<std::wstring> all{L""};
+  for (std::size_t begin{}, len{1}; len <= 5; ++len) {
+    const auto prev_end{all.size()};
+    for (auto i{begin}; i < prev_end; ++i) {
+      for (const auto ch : alphabet) {
+        all.emplace_back(all[i] + ch);
+      }
+    }
+    begin = prev_end;
+  }
+  int failures{};
+  for (const auto &arg : all) {
+    if (!round_trip(L"game.exe", {arg}) ||
+        !round_trip(L"game.exe", {L"x", arg, arg, L"y"})) {
+      ++failures;
+    }
+  }
+  CHECK(failures == 0);
+}
+
+} // namespace
+
+int main(int argc, char **argv) { return test::run(argc, argv); }
@@ -0,0 +1,84 @@
+//===-- cmd_line_bench.cpp - Command line building benchmark --------------===//
+//
+// Copyright (c) 2025 Nuclearist <nuclearist@teknology-hub.com>
+// Part of tek-injector, under the GNU General Public License v3.0 or later
+// See https://github.com/teknology-hub/tek-injector/blob/main/COPYING for
+//    license information.
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+//===----------------------------------------------------------------------===//
+///
+/// @file
+///  Benchmark of building command lines of typical game launches and of
+///    launches with many arguments that need quoting and escaping.
+///  The number of lines to build per case may be passed as the only
+///    argument.
+///
+//===----------------------------------------------------------------------===//
+#include "cmd_line.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+/// Value that the built lines are folded into, so building them isn't
+///    optimized out.
+volatile wchar_t sink;
+
+/// Run a benchmark and print its results.
+///
+/// @param name
+///    Name of the benchmark.
+/// @param num_lines
+///    Number of lines to build.
+/// @param program
+///    Path to the program executable.
+/// @param args
+///    Arguments to pass to the program.
+void bench(const char *name, int num_lines, std::wstring_view program,
+           const std::vector<const wchar_t *> &args) {
+  std::wstring line;
+  const auto start{std::chrono::steady_clock::now()};
+  for (int i{}; i < num_lines; ++i) {
+    line.resize_and_overwrite(
+        tek_inj::cmd_line::length<wchar_t>(program, args),
+        [&](wchar_t *buf, std::size_t) {
+          return tek_inj::cmd_line::write<wchar_t>(program, args, buf) - buf;
+        });
+    sink = line.back();
+  }
+  const std::chrono::duration<double, std::nano> elapsed{
+      std::chrono::steady_clock::now() - start};
+  std::printf("%-10s %5zu chars %10.1f ns/line\n", name, line.size(),
+              elapsed.count() / num_lines);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  const int num_lines{argc > 1 ? std::atoi(argv[1]) : 1000000};
+  if (num_lines <= 0) {
+    return 1;
+  }
+  bench("typical", num_lines,
+        L"C:\\Program Files (x86)\\Steam\\steamapps\\common\\ARK\\"
+        L"ShooterGame\\Binaries\\Win64\\ShooterGame.exe",
+        {L"TheIsland?listen?SessionName=My Server", L"-server", L"-log",
+         L"-NoBattlEye"});
+  std::vector<std::wstring> storage;
+  for (int i{}; i < 64; ++i) {
+    storage.emplace_back(L"-path=C:\\Data Dir " + std::to_wstring(i) +
+                         L"\\ \"quoted\\\" value\" \\\\");
+  }
+  std::vector<const wchar_t *> args;
+  for (const auto &arg : storage) {
+    args.emplace_back(arg.data());
+  }
+  bench("escaped", num_lines / 16, L"C:\\game\\game.exe", args);
+  return 0;
+}
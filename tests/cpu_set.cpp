@@ -0,0 +1,109 @@
+//===-- cpu_set.cpp - CPU set parsing tests -------------------------------===//
+//
+// Copyright (c) 2025 Nuclearist <nuclearist@teknology-hub.com>
+// Part of tek-injector, under the GNU General Public License v3.0 or later
+// See https://github.com/teknology-hub/tek-injector/blob/main/COPYING for
+//    license information.
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+//===----------------------------------------------------------------------===//
+///
+/// @file
+///  Tests of CPU set specification parsing: valid specifications must
+///    produce the expected group and mask, and invalid ones must be rejected
+///    rather than parsed partially.
+///
+//===----------------------------------------------------------------------===//
+#include "cpu_set.hpp"
+
+#include "test.hpp"
+
+#include <cstdint>
+#include <initializer_list>
+#include <string_view>
+
+namespace {
+
+/// Check that a specification is parsed into the expected CPU set.
+///
+/// @param spec
+///    The specification to parse.
+/// @param group
+///    Expected processor group number.
+/// @param mask
+///    Expected affinity mask.
+/// @return Value indicating whether @p spec is parsed as expected.
+bool parses_to(std::string_view spec, std::uint16_t group,
+               std::uint64_t mask) {
+  tek_inj::cpu_set::result res;
+  return tek_inj::cpu_set::parse(spec, res) && res.group == group &&
+         res.mask == mask;
+}
+
+/// Check that a specification is rejected.
+///
+/// @param spec
+///    The specification to parse.
+/// @return Value indicating whether @p spec is rejected.
+bool rejected(std::string_view spec) {
+  tek_inj::cpu_set::result res;
+  return !tek_inj::cpu_set::parse(spec, res);
+}
+
+TEST_CASE(numbers_and_ranges) {
+  CHECK(parses_to("5", 0, 0x20));
+  CHECK(parses_to("0-3,8", 0, 0x10F));
+  CHECK(parses_to("2-2", 0, 0x4));
+  CHECK(parses_to("8,0-1,1", 0, 0x103));
+  CHECK(parses_to("0-63", 0, UINT64_MAX));
+  for (const auto spec : {"0-", "-3", "0,", ",0", "0,,1", "0-1-2", "1 ", "a"}) {
+    CHECK(rejected(spec));
+  }
+}
+
+TEST_CASE(reversed_range) {
+  CHECK(rejected("3-0"));
+  CHECK(rejected("0,8-7"));
+}
+
+TEST_CASE(cpu_numbers_above_group) {
+  CHECK(parses_to("63", 0, std::uint64_t{1} << 63));
+  CHECK(rejected("64"));
+  CHECK(rejected("0-64"));
+  CHECK(rejected("99999999999999999999"));
+}
+
+TEST_CASE(hex_masks) {
+  CHECK(parses_to("0x0F", 0, 0xF));
+  CHECK(parses_to("0XaB", 0, 0xAB));
+  CHECK(parses_to("0xFFFFFFFFFFFFFFFF", 0, UINT64_MAX));
+  CHECK(rejected("0x"));
+  CHECK(rejected("0x0"));
+  CHECK(rejected("0x1G"));
+  CHECK(rejected("0x10000000000000000"));
+}
+
+TEST_CASE(group_prefixes) {
+  CHECK(parses_to("1:0-15", 1, 0xFFFF));
+  CHECK(parses_to("2:0x3", 2, 0x3));
+  CHECK(parses_to("65535:0", 65535, 0x1));
+  CHECK(rejected("65536:0"));
+  CHECK(rejected(":0"));
+  CHECK(rejected("a:0"));
+  CHECK(rejected("1:2:0"));
+}
+
+TEST_CASE(empty_input) {
+  CHECK(rejected(""));
+  CHECK(rejected("1:"));
+}
+
+TEST_CASE(wide_chars) {
+  tek_inj::cpu_set::result res;
+  CHECK(tek_inj::cpu_set::parse(std::wstring_view{L"3:0x30"}, res));
+  CHECK(res.group == 3 && res.mask == 0x30);
+}
+
+} // namespace
+
+int main(int argc, char **argv) { return test::run(argc, argv); }
@@ -0,0 +1,2331 @@
+//===-- fake_os.cpp - Fake Win32 API implementation -----------------------===//
+//
+// Copyright (c) 2025 Nuclearist <nuclearist@teknology-hub.com>
+// Part of tek-injector, under the GNU General Public License v3.0 or later
+// See https://github.com/teknology-hub/tek-injector/blob/main/COPYING for
+//    license information.
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+//===----------------------------------------------------------------------===//
+///
+/// @file
+///  Implementation of the fake OS layer.
+///  All state is protected by a single mutex, and every state change wakes
+///    all waiters of a single condition variable, which is slow but simple
+///    enough to be obviously correct. Handle values are unique across all
+///    simulated processes, and every handle is owned by the process that
+///    received it, so using a handle in the wrong process fails the same way
+///    it does on Windows. Remote memory blocks are host allocations, so
+///    addresses that the library computes for the target process can be
+///    dereferenced directly, but only after checking page protections.
+///  Game threads don't execute machine code: the loader stub is recognized by
+///    its content and its effects are simulated step by step, honoring
+///    suspension and termination between steps.
+///
+//===----------------------------------------------------------------------===//
+#include "fake_os.hpp"
+
+#include "loader_stub.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <charconv>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <optional>
+#include <set>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace fake_os {
+
+namespace {
+
+/// Size of a page of remote memory.
+constexpr std::size_t page_size{0x1000};
+/// Exit code of a process that has crashed, `STATUS_ACCESS_VIOLATION`.
+constexpr DWORD access_violation{0xC0000005};
+/// Value that the simulated `LoadLibraryW` returns in the exit code of a
+///    remote thread, i.e. a truncated module handle.
+constexpr DWORD module_handle{0x7FFE0000};
+
+/// Value of `GetCurrentProcessToken()`.
+const auto current_token{reinterpret_cast<HANDLE>(static_cast<LONG_PTR>(-4))};
+
+//===-- Objects -----------------------------------------------------------===//
+
+/// Kinds of objects that handles may refer to.
+enum class kind { process, thread, event, mapping, file, token, job };
+
+/// Base of all objects.
+struct object {
+  const kind type;
+  constexpr explicit object(kind type) noexcept : type{type} {}
+  virtual ~object() = default;
+  /// Check whether the object is signaled, for waits.
+  virtual bool signaled() const noexcept { return false; }
+  /// Consume the signaled state after a satisfied wait.
+  virtual void acquire() noexcept {}
+};
+
+struct thread_obj;
+struct job_obj;
+
+/// Custom deleter for page-aligned host memory.
+struct aligned_delete {
+  void operator()(char *ptr) const noexcept {
+    ::operator delete[](ptr, std::align_val_t{page_size});
+  }
+};
+
+/// Allocate zero-initialized page-aligned host memory.
+///
+/// @param size
+///    Size of the memory, in bytes.
+/// @return Pointer to the memory.
+std::unique_ptr<char[], aligned_delete> alloc_pages(std::size_t size) {
+  const auto ptr{static_cast<char *>(
+      ::operator new[](size, std::align_val_t{page_size}))};
+  std::memset(ptr, 0, size);
+  return std::unique_ptr<char[], aligned_delete>{ptr};
+}
+
+/// Block of remote memory.
+struct region {
+  /// Host memory that the block occupies.
+  std::unique_ptr<char[], aligned_delete> mem;
+  /// Protection of each page.
+  std::vector<DWORD> protect;
+};
+
+/// Simulated process.
+struct process_obj : object {
+  DWORD pid;
+  bool terminated{};
+  bool crashed{};
+  bool entry_reached{};
+  DWORD exit_code{STILL_ACTIVE};
+  bool elevated{};
+  DWORD create_flags{};
+  std::wstring command_line;
+  std::wstring current_dir;
+  std::vector<std::wstring> loaded;
+  std::uint32_t remote_threads{};
+  std::uint32_t terminated_threads{};
+  std::uint32_t apcs{};
+  std::uint64_t affinity{};
+  std::uint16_t group{};
+  std::uint16_t numa_node{UINT16_MAX};
+  std::uint32_t memory_priority{};
+  std::uint32_t io_priority{2};
+  std::shared_ptr<job_obj> job;
+  /// Remote memory blocks, keyed on their addresses.
+  std::map<std::uintptr_t, region> memory;
+  /// Threads of the process.
+  std::vector<std::weak_ptr<thread_obj>> threads;
+  /// Objects that handles and views owned by the process referred to before
+  ///    it was terminated, kept alive until the process object is destroyed
+  ///    since its simulated threads may still be using them.
+  std::vector<std::shared_ptr<object>> graveyard;
+
+  explicit process_obj(DWORD pid) noexcept : object{kind::process}, pid{pid} {}
+  bool signaled() const noexcept override { return terminated; }
+};
+
+/// Simulated thread.
+struct thread_obj : object {
+  std::shared_ptr<process_obj> proc;
+  DWORD tid;
+  DWORD suspend_count{};
+  bool started{};
+  bool finished{};
+  bool terminated{};
+  DWORD exit_code{STILL_ACTIVE};
+  std::uint64_t rcx{entry_address};
+  std::uint64_t rip{entry_address};
+  /// Number of `GetThreadContext` calls for the thread.
+  std::uint32_t context_reads{};
+  /// Queued APCs: routine and parameter.
+  std::deque<std::pair<std::uint64_t, std::uint64_t>> apcs;
+
+  thread_obj(std::shared_ptr<process_obj> proc, DWORD tid) noexcept
+      : object{kind::thread}, proc{std::move(proc)}, tid{tid} {}
+  bool signaled() const noexcept override { return finished; }
+};
+
+/// Event object.
+struct event_obj : object {
+  bool manual_reset;
+  bool state;
+  event_obj(bool manual_reset, bool state) noexcept
+      : object{kind::event}, manual_reset{manual_reset}, state{state} {}
+  bool signaled() const noexcept override { return state; }
+  void acquire() noexcept override {
+    if (!manual_reset) {
+      state = false;
+    }
+  }
+};
+
+/// File mapping object.
+struct mapping_obj : object {
+  std::size_t size;
+  std::unique_ptr<char[], aligned_delete> buf;
+  /// Value indicating whether the mapping has been created with a security
+  ///    descriptor.
+  bool has_security;
+  /// Value indicating whether the mapping has been created by an elevated
+  ///    process.
+  bool creator_elevated;
+  /// Access rights granted by the DACL of the mapping to handles duplicated
+  ///    with more access than their source.
+  DWORD dacl_access;
+  mapping_obj(std::size_t size, bool has_security, bool creator_elevated,
+              DWORD dacl_access)
+      : object{kind::mapping}, size{size}, buf{alloc_pages(size)},
+        has_security{has_security}, creator_elevated{creator_elevated},
+        dacl_access{dacl_access} {}
+};
+
+/// Content of a file in the virtual file system.
+struct file_data {
+  std::string content;
+  std::uint64_t write_time;
+};
+
+/// Open file object.
+struct file_obj : object {
+  std::shared_ptr<const file_data> data;
+  explicit file_obj(std::shared_ptr<const file_data> data) noexcept
+      : object{kind::file}, data{std::move(data)} {}
+};
+
+/// Access token object.
+struct token_obj : object {
+  bool elevated;
+  bool medium{};
+  explicit token_obj(bool elevated) noexcept
+      : object{kind::token}, elevated{elevated} {}
+};
+
+/// Job object.
+struct job_obj : object {
+  std::uint64_t memory_limit{};
+  std::uint32_t cpu_rate{};
+  std::uint32_t max_processes{};
+  std::uint32_t total{};
+  std::vector<std::weak_ptr<process_obj>> processes;
+  job_obj() noexcept : object{kind::job} {}
+};
+
+/// Entry of the handle table.
+struct handle_entry {
+  DWORD owner;
+  std::shared_ptr<object> obj;
+  DWORD access;
+};
+
+/// Mapped view of a file mapping.
+struct view_entry {
+  DWORD owner;
+  std::shared_ptr<mapping_obj> mapping;
+};
+
+/// Registered thread pool wait.
+struct wait_reg {
+  std::shared_ptr<object> obj;
+  WAITORTIMERCALLBACK cb;
+  PVOID context;
+  DWORD timeout;
+  bool cancelled{};
+  bool finished{};
+  /// Value indicating whether the wait has been unregistered from its own
+  ///    callback, so the thread deletes the registration itself.
+  bool orphaned{};
+  std::thread thread;
+};
+
+//===-- State -------------------------------------------------------------===//
+
+/// Mutex protecting all state.
+std::mutex mtx;
+/// Condition variable notified upon every state change.
+std::condition_variable cv;
+
+/// ID of the simulated process that the calling thread belongs to.
+thread_local DWORD cur_pid{self_pid};
+/// Simulated game thread that the calling thread executes, if any.
+thread_local std::shared_ptr<thread_obj> cur_thread;
+/// Last error code of the calling thread.
+thread_local DWORD last_error;
+/// Depth of calls into the layer on the calling thread.
+thread_local int os_depth;
+
+bool self_elevated;
+DWORD pid_counter;
+DWORD tid_counter;
+std::uintptr_t handle_counter;
+std::map<DWORD, std::shared_ptr<process_obj>> processes;
+std::map<std::uintptr_t, handle_entry> handles;
+std::multimap<const void *, view_entry> views;
+std::map<std::wstring, std::weak_ptr<mapping_obj>> named_mappings;
+std::map<std::wstring, std::shared_ptr<const file_data>> files;
+load_hook hook;
+std::set<wait_reg *> waits;
+std::set<PTP_WORK> works;
+/// Threads started by the layer that haven't been joined yet.
+std::vector<std::thread> threads;
+/// Number of thread pool callbacks that haven't returned yet.
+std::size_t pending_callbacks;
+/// Descriptions of invalid handles that have been closed.
+std::vector<std::string> bad_closes;
+
+/// Injected failure of a function.
+struct failure {
+  DWORD error;
+  unsigned skip;
+};
+/// Mutex protecting @ref failures, separate from @ref mtx so functions that
+///    don't touch other state don't need the latter.
+std::mutex fail_mtx;
+std::map<std::string, failure, std::less<>> failures;
+
+/// RAII marker of a call into the layer.
+struct os_scope {
+  os_scope() noexcept { ++os_depth; }
+  ~os_scope() noexcept { --os_depth; }
+};
+
+/// Check whether a call of a function must fail.
+///
+/// @param name
+///    Name of the function.
+/// @return Error code to fail with, or 0 if the call must proceed.
+DWORD injected(std::string_view name) {
+  const std::lock_guard lock{fail_mtx};
+  const auto it{failures.find(name)};
+  if (it == failures.end()) {
+    return 0;
+  }
+  if (it->second.skip) {
+    --it->second.skip;
+    return 0;
+  }
+  const auto error{it->second.error};
+  failures.erase(it);
+  return error;
+}
+
+/// Mark entry into a fake API function, and return @p fail_value from it if
+///    its call must fail.
+#define FAKE_CALL(fail_value)                                                  \
+  const os_scope scope_;                                                       \
+  if (const auto error_{injected(__func__)}) {                                 \
+    last_error = error_;                                                       \
+    return fail_value;                                                         \
+  }
+
+/// Format an address or a handle value for a leak description.
+std::string hex(const void *value) {
+  std::array<char, 18> buf{'0', 'x'};
+  const auto res{std::to_chars(buf.data() + 2, buf.data() + buf.size(),
+                               reinterpret_cast<std::uintptr_t>(value), 16)};
+  return {buf.data(), res.ptr};
+}
+
+/// Set the last error code and return a value.
+template <typename T> T fail(DWORD error, T value) noexcept {
+  last_error = error;
+  return value;
+}
+
+/// Create a handle.
+///
+/// @param owner
+///    ID of the process that owns the handle.
+/// @param obj
+///    The object that the handle refers to.
+/// @param access
+///    Access rights of the handle.
+/// @return The handle.
+HANDLE add_handle(DWORD owner, std::shared_ptr<object> obj, DWORD access) {
+  handle_counter += 4;
+  handles.emplace(handle_counter,
+                  handle_entry{owner, std::move(obj), access});
+  return reinterpret_cast<HANDLE>(handle_counter);
+}
+
+/// Look up a handle owned by the calling process.
+///
+/// @param handle
+///    The handle.
+/// @param type
+///    Required kind of the object.
+/// @return Pointer to the handle entry, or `nullptr` with last error set.
+handle_entry *get_entry(HANDLE handle, kind type) {
+  const auto it{handles.find(reinterpret_cast<std::uintptr_t>(handle))};
+  if (it == handles.end() || it->second.owner != cur_pid ||
+      it->second.obj->type != type) {
+    last_error = ERROR_INVALID_HANDLE;
+    return nullptr;
+  }
+  return &it->second;
+}
+
+/// Look up an object by a handle owned by the calling process.
+template <typename T> std::shared_ptr<T> get(HANDLE handle, kind type) {
+  const auto entry{get_entry(handle, type)};
+  return entry ? std::static_pointer_cast<T>(entry->obj) : nullptr;
+}
+
+/// Look up a process by a handle owned by the calling process, or the
+///    pseudo handle of the calling process.
+std::shared_ptr<process_obj> get_process(HANDLE handle) {
+  if (handle == INVALID_HANDLE_VALUE) {
+    return processes.at(cur_pid);
+  }
+  return get<process_obj>(handle, kind::process);
+}
+
+/// Terminate a process. @ref mtx must be held.
+///
+/// @param proc
+///    The process.
+/// @param exit_code
+///    Exit code of the process.
+void terminate(process_obj &proc, DWORD exit_code) {
+  if (proc.terminated) {
+    return;
+  }
+  proc.terminated = true;
+  proc.exit_code = exit_code;
+  for (const auto &weak_thread : proc.threads) {
+    if (const auto thread{weak_thread.lock()}; thread && !thread->finished) {
+      thread->finished = true;
+      thread->exit_code = exit_code;
+    }
+  }
+  // The system closes all handles and unmaps all views of the process
+  std::erase_if(handles, [&proc](auto &entry) {
+    if (entry.second.owner != proc.pid) {
+      return false;
+    }
+    proc.graveyard.emplace_back(std::move(entry.second.obj));
+    return true;
+  });
+  std::erase_if(views, [&proc](auto &entry) {
+    if (entry.second.owner != proc.pid) {
+      return false;
+    }
+    proc.graveyard.emplace_back(std::move(entry.second.mapping));
+    return true;
+  });
+  proc.memory.clear();
+  cv.notify_all();
+}
+
+/// Start a thread tracked by the layer. @ref mtx must be held.
+template <typename F> void start_thread(F &&fn) {
+  threads.emplace_back(std::forward<F>(fn));
+}
+
+//===-- Remote memory -----------------------------------------------------===//
+
+/// Check whether a range of remote memory is accessible.
+///
+/// @param proc
+///    The process.
+/// @param addr
+///    Start of the range.
+/// @param size
+///    Size of the range, in bytes.
+/// @param write
+///    Value indicating whether write access is required.
+/// @param exec
+///    Value indicating whether execute access is required.
+/// @return Value indicating whether all pages of the range are committed and
+///    have the required access.
+bool accessible(const process_obj &proc, std::uint64_t addr, std::size_t size,
+                bool write, bool exec) {
+  if (!size) {
+    return true;
+  }
+  auto it{proc.memory.upper_bound(static_cast<std::uintptr_t>(addr))};
+  if (it == proc.memory.begin()) {
+    return false;
+  }
+  --it;
+  const auto offset{addr - it->first};
+  const auto &protect{it->second.protect};
+  if (offset >= protect.size() * page_size ||
+      protect.size() * page_size - offset < size) {
+    return false;
+  }
+  for (auto page{offset / page_size}; page <= (offset + size - 1) / page_size;
+       ++page) {
+    switch (protect[page]) {
+    case PAGE_READONLY:
+      if (write || exec) {
+        return false;
+      }
+      break;
+    case PAGE_READWRITE:
+      if (exec) {
+        return false;
+      }
+      break;
+    case PAGE_EXECUTE_READ:
+      if (write) {
+        return false;
+      }
+      break;
+    default:
+      return false;
+    }
+  }
+  return true;
+}
+
+/// Read remote memory the way code of the process would.
+bool mem_read(const process_obj &proc, std::uint64_t addr, void *buf,
+              std::size_t size) {
+  if (!accessible(proc, addr, size, false, false)) {
+    return false;
+  }
+  std::memcpy(buf, reinterpret_cast<const void *>(addr), size);
+  return true;
+}
+
+/// Write remote memory the way code of the process would.
+bool mem_write(process_obj &proc, std::uint64_t addr, const void *buf,
+               std::size_t size) {
+  if (!accessible(proc, addr, size, true, false)) {
+    return false;
+  }
+  std::memcpy(reinterpret_cast<void *>(addr), buf, size);
+  return true;
+}
+
+/// Read a null-terminated wide string from remote memory.
+bool read_wstr(const process_obj &proc, std::uint64_t addr,
+               std::wstring &str) {
+  str.clear();
+  for (;;) {
+    wchar_t ch;
+    if (!mem_read(proc, addr, &ch, sizeof ch)) {
+      return false;
+    }
+    if (!ch) {
+      return true;
+    }
+    str += ch;
+    addr += sizeof ch;
+  }
+}
+
+//===-- Game thread simulation --------------------------------------------===//
+
+/// Wait until a simulated thread may execute its next step.
+///
+/// @return Value indicating whether the thread may proceed, `false` if it or
+///    its process has been terminated.
+bool step(std::unique_lock<std::mutex> &lock, thread_obj &thread) {
+  cv.wait(lock, [&thread] {
+    return thread.terminated || thread.proc->terminated ||
+           !thread.suspend_count;
+  });
+  return !thread.terminated && !thread.proc->terminated;
+}
+
+/// Crash the process of a simulated thread.
+void crash(thread_obj &thread) {
+  thread.proc->crashed = true;
+  terminate(*thread.proc, access_violation);
+}
+
+/// Load a DLL in a simulated thread, calling the hook with @ref mtx released.
+///
+/// @return Value indicating whether the DLL has been loaded.
+bool load(std::unique_lock<std::mutex> &lock, thread_obj &thread,
+          const std::wstring &path) {
+  const auto fn{hook};
+  lock.unlock();
+  const bool res{fn ? fn(thread.proc->pid, path) : true};
+  lock.lock();
+  if (res && !thread.proc->terminated) {
+    thread.proc->loaded.emplace_back(path);
+  }
+  return res;
+}
+
+/// Simulate the loader stub routine in a thread.
+///
+/// @param base
+///    Address of the loader stub block.
+/// @param param_addr
+///    Address of the routine parameter.
+/// @return Number of DLLs loaded, or an empty value if the process has
+///    crashed or the thread has been terminated. The instruction pointer of
+///    the thread is left in the block, callers move it out.
+std::optional<std::uint64_t> run_stub(std::unique_lock<std::mutex> &lock,
+                                      thread_obj &thread, std::uint64_t base,
+                                      std::uint64_t param_addr) {
+  using tek_inj::loader_stub::code;
+  auto &proc{*thread.proc};
+  thread.rip = base;
+  if (!accessible(proc, base, code.size(), false, true) ||
+      std::memcmp(reinterpret_cast<const void *>(base), code.data(),
+                  code.size())) {
+    crash(thread);
+    return {};
+  }
+  tek_inj::loader_stub::param param;
+  if (!mem_read(proc, param_addr, &param, sizeof param) ||
+      param.load_library != reinterpret_cast<std::uintptr_t>(LoadLibraryW)) {
+    crash(thread);
+    return {};
+  }
+  std::uint64_t loaded{};
+  for (; loaded < param.num_dlls; ++loaded) {
+    std::uint64_t path_addr;
+    std::wstring path;
+    if (!mem_read(proc, param_addr + sizeof param + loaded * sizeof path_addr,
+                  &path_addr, sizeof path_addr) ||
+        !read_wstr(proc, path_addr, path)) {
+      crash(thread);
+      return {};
+    }
+    if (!step(lock, thread)) {
+      return {};
+    }
+    if (!load(lock, thread, path)) {
+      break;
+    }
+    if (!step(lock, thread)) {
+      return {};
+    }
+  }
+  if (!mem_write(proc,
+                 param_addr + offsetof(tek_inj::loader_stub::param, loaded),
+                 &loaded, sizeof loaded)) {
+    crash(thread);
+    return {};
+  }
+  if (param.event) {
+    if (param.set_event != reinterpret_cast<std::uintptr_t>(SetEvent)) {
+      crash(thread);
+      return {};
+    }
+    const auto it{handles.find(static_cast<std::uintptr_t>(param.event))};
+    if (it != handles.end() && it->second.owner == proc.pid &&
+        it->second.obj->type == kind::event) {
+      static_cast<event_obj &>(*it->second.obj).state = true;
+      cv.notify_all();
+    }
+    // Stay in the routine until the injector has looked at the thread once,
+    //    so it always sees it there before the event is cleared
+    const auto reads{thread.context_reads};
+    cv.wait_for(lock, std::chrono::milliseconds{100}, [&thread, reads] {
+      return thread.context_reads != reads || thread.terminated ||
+             thread.proc->terminated;
+    });
+    if (!step(lock, thread)) {
+      return {};
+    }
+    constexpr std::uint64_t cleared{};
+    if (!mem_write(proc,
+                   param_addr + offsetof(tek_inj::loader_stub::param, event),
+                   &cleared, sizeof cleared)) {
+      crash(thread);
+      return {};
+    }
+    if (!step(lock, thread)) {
+      return {};
+    }
+    // The rest of the routine is executed from the block
+    if (!accessible(proc, base, code.size(), false, true)) {
+      crash(thread);
+      return {};
+    }
+  }
+  return loaded;
+}
+
+/// Body of the host thread simulating game's main thread after it's resumed
+///    for the first time: it runs queued APCs, then the trampoline if the
+///    start address has been redirected, then reaches the entry point.
+void run_main(std::shared_ptr<thread_obj> thread) {
+  cur_pid = thread->proc->pid;
+  cur_thread = thread;
+  std::unique_lock lock{mtx};
+  auto &proc{*thread->proc};
+  while (!thread->apcs.empty()) {
+    const auto [routine, param]{thread->apcs.front()};
+    thread->apcs.pop_front();
+    if (!step(lock, *thread) ||
+        !run_stub(lock, *thread,
+                  routine - tek_inj::loader_stub::routine_offset, param)) {
+      return;
+    }
+    thread->rip = 0;
+  }
+  if (!step(lock, *thread)) {
+    return;
+  }
+  if (thread->rcx != entry_address) {
+    const auto base{thread->rcx - tek_inj::loader_stub::trampoline_offset};
+    const auto param_addr{base + tek_inj::loader_stub::param_offset};
+    if (!run_stub(lock, *thread, base, param_addr)) {
+      return;
+    }
+    std::uint64_t entry;
+    if (!mem_read(proc,
+                  param_addr + offsetof(tek_inj::loader_stub::param, entry),
+                  &entry, sizeof entry) ||
+        entry != entry_address) {
+      crash(*thread);
+      return;
+    }
+  }
+  thread->rip = entry_address;
+  proc.entry_reached = true;
+  cv.notify_all();
+}
+
+/// Body of the host thread simulating a remote thread.
+void run_remote(std::shared_ptr<thread_obj> thread, std::uint64_t start,
+                std::uint64_t param) {
+  cur_pid = thread->proc->pid;
+  cur_thread = thread;
+  std::unique_lock lock{mtx};
+  if (!step(lock, *thread)) {
+    return;
+  }
+  DWORD exit_code;
+  if (start == reinterpret_cast<std::uintptr_t>(LoadLibraryW)) {
+    std::wstring path;
+    if (!read_wstr(*thread->proc, param, path)) {
+      crash(*thread);
+      return;
+    }
+    exit_code = load(lock, *thread, path) ? module_handle : 0;
+  } else {
+    const auto loaded{run_stub(
+        lock, *thread, start - tek_inj::loader_stub::routine_offset, param)};
+    if (!loaded) {
+      return;
+    }
+    exit_code = static_cast<DWORD>(*loaded);
+  }
+  if (!thread->finished) {
+    thread->finished = true;
+    thread->exit_code = exit_code;
+  }
+  cv.notify_all();
+}
+
+/// Create a game process. @ref mtx must be held.
+///
+/// @param elevated
+///    Value indicating whether the process runs elevated.
+/// @param suspended
+///    Value indicating whether the main thread starts suspended.
+/// @return The process and its main thread.
+std::pair<std::shared_ptr<process_obj>, std::shared_ptr<thread_obj>>
+new_process(bool elevated, bool suspended) {
+  auto proc{std::make_shared<process_obj>(pid_counter)};
+  pid_counter += 4;
+  proc->elevated = elevated;
+  auto thread{std::make_shared<thread_obj>(proc, tid_counter)};
+  tid_counter += 4;
+  proc->threads.emplace_back(thread);
+  processes.emplace(proc->pid, proc);
+  if (suspended) {
+    thread->suspend_count = 1;
+  } else {
+    thread->started = true;
+    start_thread([thread] { run_main(thread); });
+  }
+  return {std::move(proc), std::move(thread)};
+}
+
+/// Layout of the buffer of a process thread attribute list.
+struct attr_list {
+  std::uint32_t count;
+  std::uint32_t used;
+  struct {
+    DWORD_PTR attr;
+    PVOID value;
+    SIZE_T size;
+  } entries[1];
+};
+
+/// Create a game process for `CreateProcessW` and `CreateProcessAsUserW`.
+BOOL create_process(bool elevated, LPCWSTR app_name, LPWSTR command_line,
+                    DWORD flags, LPCWSTR current_dir,
+                    LPSTARTUPINFOW startup_info,
+                    LPPROCESS_INFORMATION proc_info) {
+  if (!app_name || !files.contains(app_name)) {
+    return fail(ERROR_FILE_NOT_FOUND, FALSE);
+  }
+  const attr_list *attrs{};
+  if (flags & EXTENDED_STARTUPINFO_PRESENT) {
+    if (startup_info->cb != sizeof(STARTUPINFOEXW)) {
+      return fail(ERROR_INVALID_PARAMETER, FALSE);
+    }
+    attrs = reinterpret_cast<const attr_list *>(
+        reinterpret_cast<STARTUPINFOEXW *>(startup_info)->lpAttributeList);
+  }
+  const auto [proc, thread]{
+      new_process(elevated, (flags & CREATE_SUSPENDED) != 0)};
+  proc->create_flags = flags;
+  proc->command_line = command_line ? command_line : app_name;
+  if (current_dir) {
+    proc->current_dir = current_dir;
+  }
+  if (attrs) {
+    for (std::uint32_t i{}; i < attrs->used; ++i) {
+      const auto &entry{attrs->entries[i]};
+      switch (entry.attr) {
+      case PROC_THREAD_ATTRIBUTE_GROUP_AFFINITY: {
+        const auto &affinity{*static_cast<const GROUP_AFFINITY *>(entry.value)};
+        proc->affinity = affinity.Mask;
+        proc->group = affinity.Group;
+        break;
+      }
+      case PROC_THREAD_ATTRIBUTE_PREFERRED_NODE:
+        proc->numa_node = *static_cast<const USHORT *>(entry.value);
+        break;
+      }
+    }
+  }
+  *proc_info = {.hProcess = add_handle(self_pid, proc, 0x1FFFFF),
+                .hThread = add_handle(self_pid, thread, 0x1FFFFF),
+                .dwProcessId = proc->pid,
+                .dwThreadId = thread->tid};
+  last_error = 0;
+  return TRUE;
+}
+
+/// Create the process object of the calling process. @ref mtx must be held.
+void init_self() {
+  auto self{std::make_shared<process_obj>(self_pid)};
+  self->entry_reached = true;
+  processes.emplace(self_pid, std::move(self));
+}
+
+/// Static initializer of the state.
+const struct init {
+  init() {
+    pid_counter = 1000;
+    tid_counter = 2000;
+    handle_counter = 0x100;
+    init_self();
+  }
+} initializer;
+
+} // namespace
+
+//===-- Control interface -------------------------------------------------===//
+
+void reset() {
+  for (;;) {
+    std::vector<std::thread> to_join;
+    std::vector<wait_reg *> to_delete;
+    std::vector<PTP_WORK> works_to_close;
+    {
+      const std::lock_guard lock{mtx};
+      for (const auto &[pid, proc] : processes) {
+        if (pid != self_pid) {
+          terminate(*proc, 1);
+        }
+      }
+      for (const auto reg : waits) {
+        reg->cancelled = true;
+        to_delete.emplace_back(reg);
+      }
+      waits.clear();
+      works_to_close.assign(works.begin(), works.end());
+      works.clear();
+      to_join = std::move(threads);
+      threads.clear();
+      cv.notify_all();
+    }
+    if (to_join.empty() && to_delete.empty() && works_to_close.empty()) {
+      break;
+    }
+    for (auto &thread : to_join) {
+      thread.join();
+    }
+    for (const auto reg : to_delete) {
+      reg->thread.join();
+      delete reg;
+    }
+    for (const auto work : works_to_close) {
+      CloseThreadpoolWork(work);
+    }
+  }
+  const std::lock_guard lock{mtx};
+  processes.clear();
+  handles.clear();
+  views.clear();
+  named_mappings.clear();
+  files.clear();
+  hook = nullptr;
+  pending_callbacks = 0;
+  bad_closes.clear();
+  self_elevated = false;
+  pid_counter = 1000;
+  tid_counter = 2000;
+  handle_counter = 0x100;
+  init_self();
+  const std::lock_guard fail_lock{fail_mtx};
+  failures.clear();
+}
+
+void fail_call(std::string name, DWORD error, unsigned skip) {
+  const std::lock_guard lock{fail_mtx};
+  failures.insert_or_assign(std::move(name),
+                            failure{.error = error, .skip = skip});
+}
+
+void set_elevated(bool elevated) {
+  const std::lock_guard lock{mtx};
+  self_elevated = elevated;
+  processes.at(self_pid)->elevated = elevated;
+}
+
+void add_file(std::wstring path, std::string content,
+              std::uint64_t write_time) {
+  const std::lock_guard lock{mtx};
+  files.insert_or_assign(std::move(path),
+                         std::make_shared<const file_data>(
+                             std::move(content), write_time));
+}
+
+void set_load_hook(load_hook new_hook) {
+  const std::lock_guard lock{mtx};
+  hook = std::move(new_hook);
+}
+
+void wait_until_terminated() {
+  std::unique_lock lock{mtx};
+  const auto thread{cur_thread};
+  cv.wait(lock, [&thread] {
+    return thread->terminated || thread->proc->terminated;
+  });
+}
+
+DWORD spawn() {
+  const std::lock_guard lock{mtx};
+  return new_process(false, false).first->pid;
+}
+
+DWORD next_pid() {
+  const std::lock_guard lock{mtx};
+  return pid_counter;
+}
+
+process_info process(DWORD pid) {
+  const std::lock_guard lock{mtx};
+  const auto it{processes.find(pid)};
+  if (it == processes.end()) {
+    return {};
+  }
+  const auto &proc{*it->second};
+  process_info info{.exists = true,
+                    .terminated = proc.terminated,
+                    .crashed = proc.crashed,
+                    .entry_reached = proc.entry_reached,
+                    .exit_code = proc.exit_code,
+                    .elevated = proc.elevated,
+                    .create_flags = proc.create_flags,
+                    .command_line = proc.command_line,
+                    .current_dir = proc.current_dir,
+                    .loaded = proc.loaded,
+                    .remote_threads = proc.remote_threads,
+                    .terminated_threads = proc.terminated_threads,
+                    .apcs = proc.apcs,
+                    .remote_allocs =
+                        static_cast<std::uint32_t>(proc.memory.size()),
+                    .affinity = proc.affinity,
+                    .group = proc.group,
+                    .numa_node = proc.numa_node,
+                    .memory_priority = proc.memory_priority,
+                    .io_priority = proc.io_priority,
+                    .in_job = static_cast<bool>(proc.job),
+                    .job_memory_limit = 0,
+                    .job_cpu_rate = 0,
+                    .job_max_processes = 0};
+  if (proc.job) {
+    info.job_memory_limit = proc.job->memory_limit;
+    info.job_cpu_rate = proc.job->cpu_rate;
+    info.job_max_processes = proc.job->max_processes;
+  }
+  return info;
+}
+
+std::size_t running_processes() {
+  const std::lock_guard lock{mtx};
+  return static_cast<std::size_t>(
+      std::ranges::count_if(processes, [](const auto &entry) {
+        return entry.first != self_pid && !entry.second->terminated;
+      }));
+}
+
+std::vector<std::string> leaks() {
+  std::unique_lock lock{mtx};
+  cv.wait(lock, [] { return !pending_callbacks; });
+  std::vector<std::string> res;
+  static constexpr std::array<std::string_view, 7> kind_names{
+      "process", "thread", "event", "mapping", "file", "token", "job"};
+  for (const auto &[value, entry] : handles) {
+    if (entry.owner == self_pid) {
+      res.emplace_back(
+          "handle " + hex(reinterpret_cast<const void *>(value)) + " to " +
+          std::string{kind_names[static_cast<std::size_t>(entry.obj->type)]});
+    }
+  }
+  for (const auto &[addr, view] : views) {
+    if (view.owner == self_pid) {
+      res.emplace_back("view " + hex(addr) + " of a file mapping");
+    }
+  }
+  for (const auto reg : waits) {
+    res.emplace_back("thread pool wait " + hex(reg));
+  }
+  for (const auto work : works) {
+    res.emplace_back("thread pool work " + hex(work));
+  }
+  res.insert(res.end(), bad_closes.begin(), bad_closes.end());
+  return res;
+}
+
+bool in_os() noexcept { return os_depth > 0; }
+
+} // namespace fake_os
+
+//===-- Win32 API ---------------------------------------------------------===//
+
+using namespace fake_os;
+
+/// Thread pool work object.
+struct _TP_WORK {
+  PTP_WORK_CALLBACK cb;
+  PVOID context;
+  std::vector<std::thread> threads;
+};
+
+extern "C" {
+
+DWORD GetLastError(void) { return last_error; }
+
+VOID SetLastError(DWORD error) { last_error = error; }
+
+BOOL CloseHandle(HANDLE object) {
+  FAKE_CALL(FALSE);
+  if (object == INVALID_HANDLE_VALUE || object == current_token) {
+    return TRUE;
+  }
+  const std::lock_guard lock{mtx};
+  const auto it{handles.find(reinterpret_cast<std::uintptr_t>(object))};
+  if (it == handles.end() || it->second.owner != cur_pid) {
+    bad_closes.emplace_back(
+        "invalid handle " + hex(object) + " closed by process " +
+        std::to_string(cur_pid));
+    return fail(ERROR_INVALID_HANDLE, FALSE);
+  }
+  handles.erase(it);
+  return TRUE;
+}
+
+BOOL DuplicateHandle(HANDLE source_process, HANDLE source,
+                     HANDLE target_process, PHANDLE target, DWORD access,
+                     BOOL, DWORD options) {
+  FAKE_CALL(FALSE);
+  const std::lock_guard lock{mtx};
+  const auto src_proc{get_process(source_process)};
+  const auto tgt_proc{get_process(target_process)};
+  if (!src_proc || !tgt_proc) {
+    return FALSE;
+  }
+  const auto it{handles.find(reinterpret_cast<std::uintptr_t>(source))};
+  if (it == handles.end() || it->second.owner != src_proc->pid) {
+    return fail(ERROR_INVALID_HANDLE, FALSE);
+  }
+  const auto entry{it->second};
+  if (options & DUPLICATE_CLOSE_SOURCE) {
+    handles.erase(it);
+  }
+  if (tgt_proc->terminated) {
+    return fail(ERROR_ACCESS_DENIED, FALSE);
+  }
+  // Access beyond that of the source handle is checked against the DACL
+  if (!(options & DUPLICATE_SAME_ACCESS) && (access & ~entry.access) &&
+      entry.obj->type == kind::mapping &&
+      (access & ~static_cast<const mapping_obj &>(*entry.obj).dacl_access)) {
+    return fail(ERROR_ACCESS_DENIED, FALSE);
+  }
+  *target = add_handle(tgt_proc->pid, entry.obj,
+                       (options & DUPLICATE_SAME_ACCESS) ? entry.access
+                                                         : access);
+  return TRUE;
+}
+
+HANDLE GetCurrentProcess(void) { return INVALID_HANDLE_VALUE; }
+
+HANDLE GetCurrentProcessToken(void) { return current_token; }
+
+DWORD GetCurrentProcessId(void) { return cur_pid; }
+
+BOOL GetTokenInformation(HANDLE token, TOKEN_INFORMATION_CLASS info_class,
+                         LPVOID info, DWORD info_size, LPDWORD ret_size) {
+  FAKE_CALL(FALSE);
+  const std::lock_guard lock{mtx};
+  bool elevated;
+  if (token == current_token) {
+    elevated = processes.at(cur_pid)->elevated;
+  } else {
+    const auto obj{get<token_obj>(token, kind::token)};
+    if (!obj) {
+      return FALSE;
+    }
+    elevated = obj->elevated && !obj->medium;
+  }
+  switch (info_class) {
+  case TokenElevationType:
+    *ret_size = sizeof(TOKEN_ELEVATION_TYPE);
+    if (info_size < *ret_size) {
+      return fail(ERROR_INSUFFICIENT_BUFFER, FALSE);
+    }
+    *static_cast<TOKEN_ELEVATION_TYPE *>(info) =
+        elevated ? TokenElevationTypeFull : TokenElevationTypeDefault;
+    return TRUE;
+  case TokenUser: {
+    // S-1-5-21-1-2-3-1001
+    static constexpr std::array<DWORD, 5> sub_auths{21, 1, 2, 3, 1001};
+    constexpr DWORD sid_size{8 + sub_auths.size() * sizeof(DWORD)};
+    *ret_size = sizeof(TOKEN_USER) + sid_size;
+    if (info_size < *ret_size) {
+      return fail(ERROR_INSUFFICIENT_BUFFER, FALSE);
+    }
+    const auto sid{static_cast<BYTE *>(info) + sizeof(TOKEN_USER)};
+    sid[0] = 1;
+    sid[1] = sub_auths.size();
+    constexpr std::array<BYTE, 6> authority{0, 0, 0, 0, 0, 5};
+    std::ranges::copy(authority, &sid[2]);
+    std::memcpy(&sid[8], sub_auths.data(), sub_auths.size() * sizeof(DWORD));
+    *static_cast<TOKEN_USER *>(info) = {.User = {.Sid = sid, .Attributes = 0}};
+    return TRUE;
+  }
+  default:
+    return fail(ERROR_INVALID_PARAMETER, FALSE);
+  }
+}
+
+BOOL SetTokenInformation(HANDLE token, TOKEN_INFORMATION_CLASS info_class,
+                         LPVOID info, DWORD info_size) {
+  FAKE_CALL(FALSE);
+  const std::lock_guard lock{mtx};
+  const auto obj{get<token_obj>(token, kind::token)};
+  if (!obj) {
+    return FALSE;
+  }
+  if (info_class != TokenIntegrityLevel ||
+      info_size < sizeof(TOKEN_MANDATORY_LABEL)) {
+    return fail(ERROR_INVALID_PARAMETER, FALSE);
+  }
+  const auto &sid{*static_cast<const SID *>(
+      static_cast<const TOKEN_MANDATORY_LABEL *>(info)->Label.Sid)};
+  obj->medium = sid.SubAuthority[0] == SECURITY_MANDATORY_MEDIUM_RID;
+  return TRUE;
+}
+
+BOOL OpenProcessToken(HANDLE process, DWORD access, PHANDLE token) {
+  FAKE_CALL(FALSE);
+  const std::lock_guard lock{mtx};
+  const auto proc{get_process(process)};
+  if (!proc) {
+    return FALSE;
+  }
+  *token = add_handle(cur_pid, std::make_shared<token_obj>(proc->elevated),
+                      access);
+  return TRUE;
+}
+
+BOOL DuplicateTokenEx(HANDLE token, DWORD access, LPSECURITY_ATTRIBUTES,
+                      SECURITY_IMPERSONATION_LEVEL, TOKEN_TYPE,
+                      PHANDLE new_token) {
+  FAKE_CALL(FALSE);
+  const std::lock_guard lock{mtx};
+  const auto obj{get<token_obj>(token, kind::token)};
+  if (!obj) {
+    return FALSE;
+  }
+  *new_token = add_handle(cur_pid, std::make_shared<token_obj>(*obj), access);
+  return TRUE;
+}
+
+DWORD GetLengthSid(PSID sid) {
+  return 8 + static_cast<const SID *>(sid)->SubAuthorityCount * sizeof(DWORD);
+}
+
+BOOL InitializeAcl(PACL acl, DWORD acl_size, DWORD revision) {
+  FAKE_CALL(FALSE);
+  if (acl_size < sizeof(ACL) || acl_size > UINT16_MAX) {
+    return fail(ERROR_INSUFFICIENT_BUFFER, FALSE);
+  }
+  if (revision != ACL_REVISION) {
+    return fail(ERROR_INVALID_PARAMETER, FALSE);
+  }
+  // Sbz2 tracks the used size
+  *acl = {.AclRevision = static_cast<BYTE>(revision),
+          .Sbz1 = 0,
+          .AclSize = static_cast<WORD>(acl_size),
+          .AceCount = 0,
+          .Sbz2 = sizeof(ACL)};
+  return TRUE;
+}
+
+} // extern "C"
+
+namespace {
+
+/// Add an ACE to an ACL, for `AddAccessAllowedAce` and `AddMandatoryAce`.
+template <typename Ace>
+BOOL add_ace(PACL acl, BYTE type, DWORD mask, PSID sid) {
+  const auto size{sizeof(Ace) - sizeof(DWORD) + GetLengthSid(sid)};
+  if (acl->Sbz2 + size > acl->AclSize) {
+    return fail(ERROR_ALLOTTED_SPACE_EXCEEDED, FALSE);
+  }
+  const auto ace{reinterpret_cast<char *>(acl) + acl->Sbz2};
+  const Ace hdr{.Header = {.AceType = type,
+                           .AceFlags = 0,
+                           .AceSize = static_cast<WORD>(size)},
+                .Mask = mask,
+                .SidStart = 0};
+  std::memcpy(ace, &hdr, offsetof(Ace, SidStart));
+  std::memcpy(ace + offsetof(Ace, SidStart), sid, GetLengthSid(sid));
+  acl->Sbz2 += static_cast<WORD>(size);
+  ++acl->AceCount;
+  return TRUE;
+}
+
+} // namespace
+
+extern "C" {
+
+BOOL AddAccessAllowedAce(PACL acl, DWORD, DWORD mask, PSID sid) {
+  FAKE_CALL(FALSE);
+  return add_ace<ACCESS_ALLOWED_ACE>(acl, 0, mask, sid);
+}
+
+BOOL AddMandatoryAce(PACL acl, DWORD, DWORD, DWORD policy, PSID sid) {
+  FAKE_CALL(FALSE);
+  return add_ace<SYSTEM_MANDATORY_LABEL_ACE>(acl, 0x11, policy, sid);
+}
+
+BOOL InitializeSecurityDescriptor(SECURITY_DESCRIPTOR *desc, DWORD revision) {
+  FAKE_CALL(FALSE);
+  *desc = {.Revision = static_cast<BYTE>(revision),
+           .Sbz1 = 0,
+           .Control = 0,
+           .Owner = nullptr,
+           .Group = nullptr,
+           .Sacl = nullptr,
+           .Dacl = nullptr};
+  return TRUE;
+}
+
+BOOL SetSecurityDescriptorDacl(SECURITY_DESCRIPTOR *desc, BOOL present,
+                               PACL dacl, BOOL) {
+  FAKE_CALL(FALSE);
+  desc->Dacl = present ? dacl : nullptr;
+  return TRUE;
+}
+
+BOOL SetSecurityDescriptorSacl(SECURITY_DESCRIPTOR *desc, BOOL present,
+                               PACL sacl, BOOL) {
+  FAKE_CALL(FALSE);
+  desc->Sacl = present ? sacl : nullptr;
+  return TRUE;
+}
+
+BOOL CreateProcessW(LPCWSTR app_name, LPWSTR command_line,
+                    LPSECURITY_ATTRIBUTES, LPSECURITY_ATTRIBUTES, BOOL,
+                    DWORD flags, LPVOID, LPCWSTR current_dir,
+                    LPSTARTUPINFOW startup_info,
+                    LPPROCESS_INFORMATION proc_info) {
+  FAKE_CALL(FALSE);
+  const std::lock_guard lock{mtx};
+  return create_process(processes.at(cur_pid)->elevated, app_name,
+                        command_line, flags, current_dir, startup_info,
+                        proc_info);
+}
+
+BOOL CreateProcessAsUserW(HANDLE token, LPCWSTR app_name, LPWSTR command_line,
+                          LPSECURITY_ATTRIBUTES, LPSECURITY_ATTRIBUTES, BOOL,
+                          DWORD flags, LPVOID, LPCWSTR current_dir,
+                          LPSTARTUPINFOW startup_info,
+                          LPPROCESS_INFORMATION proc_info) {
+  FAKE_CALL(FALSE);
+  const std::lock_guard lock{mtx};
+  const auto obj{get<token_obj>(token, kind::token)};
+  if (!obj) {
+    return FALSE;
+  }
+  return create_process(obj->elevated && !obj->medium, app_name, command_line,
+                        flags, current_dir, startup_info, proc_info);
+}
+
+HANDLE OpenProcess(DWORD access, BOOL, DWORD pid) {
+  FAKE_CALL(nullptr);
+  const std::lock_guard lock{mtx};
+  const auto it{processes.find(pid)};
+  if (it == processes.end() || it->second->terminated) {
+    return fail(ERROR_INVALID_PARAMETER, HANDLE{});
+  }
+  return add_handle(cur_pid, it->second, access);
+}
+
+BOOL TerminateProcess(HANDLE process, unsigned exit_code) {
+  FAKE_CALL(FALSE);
+  const std::lock_guard lock{mtx};
+  const auto proc{get_process(process)};
+  if (!proc) {
+    return FALSE;
+  }
+  terminate(*proc, exit_code);
+  return TRUE;
+}
+
+BOOL InitializeProcThreadAttributeList(LPPROC_THREAD_ATTRIBUTE_LIST list,
+                                       DWORD count, DWORD, SIZE_T *size) {
+  FAKE_CALL(FALSE);
+  const auto required{offsetof(attr_list, entries) +
+                      count * sizeof(attr_list::entries[0])};
+  if (!list || *size < required) {
+    *size = required;
+    return fail(ERROR_INSUFFICIENT_BUFFER, FALSE);
+  }
+  const auto attrs{reinterpret_cast<attr_list *>(list)};
+  attrs->count = count;
+  attrs->used = 0;
+  return TRUE;
+}
+
+BOOL UpdateProcThreadAttribute(LPPROC_THREAD_ATTRIBUTE_LIST list, DWORD,
+                               DWORD_PTR attr, PVOID value, SIZE_T size,
+                               PVOID, SIZE_T *) {
+  FAKE_CALL(FALSE);
+  const auto attrs{reinterpret_cast<attr_list *>(list)};
+  if (attrs->used >= attrs->count) {
+    return fail(ERROR_INSUFFICIENT_BUFFER, FALSE);
+  }
+  switch (attr) {
+  case PROC_THREAD_ATTRIBUTE_GROUP_AFFINITY:
+    if (size != sizeof(GROUP_AFFINITY)) {
+      return fail(ERROR_BAD_LENGTH, FALSE);
+    }
+    break;
+  case PROC_THREAD_ATTRIBUTE_PREFERRED_NODE:
+    if (size != sizeof(USHORT)) {
+      return fail(ERROR_BAD_LENGTH, FALSE);
+    }
+    break;
+  default:
+    return fail(ERROR_INVALID_PARAMETER, FALSE);
+  }
+  auto &entry{attrs->entries[attrs->used++]};
+  entry.attr = attr;
+  entry.value = value;
+  entry.size = size;
+  return TRUE;
+}
+
+VOID DeleteProcThreadAttributeList(LPPROC_THREAD_ATTRIBUTE_LIST list) {
+  reinterpret_cast<attr_list *>(list)->used = 0;
+}
+
+BOOL GetNumaNodeProcessorMaskEx(USHORT node, PGROUP_AFFINITY affinity) {
+  FAKE_CALL(FALSE);
+  // Two nodes with four processors each
+  if (node >= 2) {
+    return fail(ERROR_INVALID_PARAMETER, FALSE);
+  }
+  *affinity = {.Mask = KAFFINITY{0xF} << (node * 4), .Group = 0,
+               .Reserved = {}};
+  return TRUE;
+}
+
+BOOL SetProcessAffinityMask(HANDLE process, DWORD_PTR mask) {
+  FAKE_CALL(FALSE);
+  const std::lock_guard lock{mtx};
+  const auto proc{get_process(process)};
+  if (!proc) {
+    return FALSE;
+  }
+  if (!mask) {
+    return fail(ERROR_INVALID_PARAMETER, FALSE);
+  }
+  proc->affinity = mask;
+  return TRUE;
+}
+
+BOOL SetProcessInformation(HANDLE process,
+                           PROCESS_INFORMATION_CLASS info_class, LPVOID info,
+                           DWORD info_size) {
+  FAKE_CALL(FALSE);
+  const std::lock_guard lock{mtx};
+  const auto proc{get_process(process)};
+  if (!proc) {
+    return FALSE;
+  }
+  if (info_class != ProcessMemoryPriority ||
+      info_size != sizeof(MEMORY_PRIORITY_INFORMATION)) {
+    return fail(ERROR_INVALID_PARAMETER, FALSE);
+  }
+  const auto priority{
+      static_cast<const MEMORY_PRIORITY_INFORMATION *>(info)->MemoryPriority};
+  if (priority < MEMORY_PRIORITY_VERY_LOW ||
+      priority > MEMORY_PRIORITY_NORMAL) {
+    return fail(ERROR_INVALID_PARAMETER, FALSE);
+  }
+  proc->memory_priority = priority;
+  return TRUE;
+}
+
+} // extern "C"
+
+namespace {
+
+/// Wrap a Win32 error code into an NTSTATUS value, the way the system reports
+///    errors that have no NTSTATUS of their own.
+LONG ntstatus_from_win32(DWORD error) {
+  return static_cast<LONG>(0xC0070000 | (error & 0xFFFF));
+}
+
+} // namespace
+
+extern "C" {
+
+LONG NtSetInformationProcess(HANDLE process, ULONG info_class, PVOID info,
+                             ULONG info_size) {
+  const os_scope scope_;
+  if (const auto error{injected(__func__)}) {
+    return ntstatus_from_win32(error);
+  }
+  const std::lock_guard lock{mtx};
+  const auto proc{get_process(process)};
+  if (!proc) {
+    return ntstatus_from_win32(last_error);
+  }
+  // Only IoPriorityVeryLow to IoPriorityNormal are allowed without privileges
+  if (info_class != 33 || info_size != sizeof(ULONG) ||
+      *static_cast<const ULONG *>(info) > 2) {
+    return ntstatus_from_win32(ERROR_INVALID_PARAMETER);
+  }
+  proc->io_priority = *static_cast<const ULONG *>(info);
+  return 0;
+}
+
+ULONG RtlNtStatusToDosError(LONG status) {
+  constexpr ULONG error_mr_mid_not_found{317};
+  const auto value{static_cast<ULONG>(status)};
+  return (value & 0xFFFF0000) == 0xC0070000 ? value & 0xFFFF
+                                            : error_mr_mid_not_found;
+}
+
+HANDLE CreateRemoteThread(HANDLE process, LPSECURITY_ATTRIBUTES, SIZE_T,
+                          LPTHREAD_START_ROUTINE start, LPVOID param, DWORD,
+                          LPDWORD tid) {
+  FAKE_CALL(nullptr);
+  const std::lock_guard lock{mtx};
+  const auto proc{get_process(process)};
+  if (!proc) {
+    return nullptr;
+  }
+  if (proc->terminated) {
+    return fail(ERROR_ACCESS_DENIED, HANDLE{});
+  }
+  auto thread{std::make_shared<thread_obj>(proc, tid_counter)};
+  tid_counter += 4;
+  thread->started = true;
+  proc->threads.emplace_back(thread);
+  ++proc->remote_threads;
+  if (tid) {
+    *tid = thread->tid;
+  }
+  start_thread([thread, start = reinterpret_cast<std::uintptr_t>(start),
+                param = reinterpret_cast<std::uintptr_t>(param)] {
+    run_remote(thread, start, param);
+  });
+  return add_handle(cur_pid, std::move(thread), 0x1FFFFF);
+}
+
+DWORD ResumeThread(HANDLE thread) {
+  FAKE_CALL(static_cast<DWORD>(-1));
+  const std::lock_guard lock{mtx};
+  const auto obj{get<thread_obj>(thread, kind::thread)};
+  if (!obj) {
+    return static_cast<DWORD>(-1);
+  }
+  const auto prev{obj->suspend_count};
+  if (prev && !--obj->suspend_count && !obj->started &&
+      !obj->proc->terminated) {
+    obj->started = true;
+    start_thread([obj] { run_main(obj); });
+  }
+  cv.notify_all();
+  return prev;
+}
+
+DWORD SuspendThread(HANDLE thread) {
+  FAKE_CALL(static_cast<DWORD>(-1));
+  const std::lock_guard lock{mtx};
+  const auto obj{get<thread_obj>(thread, kind::thread)};
+  if (!obj) {
+    return static_cast<DWORD>(-1);
+  }
+  return obj->suspend_count++;
+}
+
+BOOL TerminateThread(HANDLE thread, DWORD exit_code) {
+  FAKE_CALL(FALSE);
+  const std::lock_guard lock{mtx};
+  const auto obj{get<thread_obj>(thread, kind::thread)};
+  if (!obj) {
+    return FALSE;
+  }
+  if (!obj->finished) {
+    ++obj->proc->terminated_threads;
+    obj->terminated = true;
+    obj->finished = true;
+    obj->exit_code = exit_code;
+    cv.notify_all();
+  }
+  return TRUE;
+}
+
+BOOL GetExitCodeThread(HANDLE thread, LPDWORD exit_code) {
+  FAKE_CALL(FALSE);
+  const std::lock_guard lock{mtx};
+  const auto obj{get<thread_obj>(thread, kind::thread)};
+  if (!obj) {
+    return FALSE;
+  }
+  *exit_code = obj->exit_code;
+  return TRUE;
+}
+
+DWORD GetThreadId(HANDLE thread) {
+  FAKE_CALL(0);
+  const std::lock_guard lock{mtx};
+  const auto obj{get<thread_obj>(thread, kind::thread)};
+  return obj ? obj->tid : 0;
+}
+
+BOOL GetThreadContext(HANDLE thread, CONTEXT *context) {
+  FAKE_CALL(FALSE);
+  const std::lock_guard lock{mtx};
+  const auto obj{get<thread_obj>(thread, kind::thread)};
+  if (!obj) {
+    return FALSE;
+  }
+  if ((context->ContextFlags & CONTEXT_INTEGER) == CONTEXT_INTEGER) {
+    context->Rcx = obj->rcx;
+  }
+  if ((context->ContextFlags & CONTEXT_CONTROL) == CONTEXT_CONTROL) {
+    context->Rip = obj->rip;
+    context->Rsp = 0;
+  }
+  ++obj->context_reads;
+  cv.notify_all();
+  return TRUE;
+}
+
+BOOL SetThreadContext(HANDLE thread, const CONTEXT *context) {
+  FAKE_CALL(FALSE);
+  const std::lock_guard lock{mtx};
+  const auto obj{get<thread_obj>(thread, kind::thread)};
+  if (!obj) {
+    return FALSE;
+  }
+  if ((context->ContextFlags & CONTEXT_INTEGER) == CONTEXT_INTEGER) {
+    obj->rcx = context->Rcx;
+  }
+  return TRUE;
+}
+
+DWORD QueueUserAPC(PAPCFUNC routine, HANDLE thread, ULONG_PTR param) {
+  FAKE_CALL(0);
+  const std::lock_guard lock{mtx};
+  const auto obj{get<thread_obj>(thread, kind::thread)};
+  if (!obj) {
+    return 0;
+  }
+  if (obj->finished) {
+    return fail(ERROR_ACCESS_DENIED, DWORD{});
+  }
+  obj->apcs.emplace_back(reinterpret_cast<std::uintptr_t>(routine), param);
+  ++obj->proc->apcs;
+  return 1;
+}
+
+LPVOID VirtualAllocEx(HANDLE process, LPVOID address, SIZE_T size, DWORD type,
+                      DWORD protect) {
+  FAKE_CALL(nullptr);
+  const std::lock_guard lock{mtx};
+  const auto proc{get_process(process)};
+  if (!proc) {
+    return nullptr;
+  }
+  if (proc->terminated) {
+    return fail(ERROR_ACCESS_DENIED, LPVOID{});
+  }
+  if (address || !size || type != (MEM_COMMIT | MEM_RESERVE)) {
+    return fail(ERROR_INVALID_PARAMETER, LPVOID{});
+  }
+  const auto num_pages{(size + page_size - 1) / page_size};
+  auto mem{alloc_pages(num_pages * page_size)};
+  const auto addr{mem.get()};
+  proc->memory.emplace(reinterpret_cast<std::uintptr_t>(addr),
+                       region{.mem = std::move(mem),
+                              .protect = std::vector(num_pages, protect)});
+  return addr;
+}
+
+BOOL VirtualFreeEx(HANDLE process, LPVOID address, SIZE_T size, DWORD type) {
+  FAKE_CALL(FALSE);
+  const std::lock_guard lock{mtx};
+  const auto proc{get_process(process)};
+  if (!proc) {
+    return FALSE;
+  }
+  if (type != MEM_RELEASE || size) {
+    return fail(ERROR_INVALID_PARAMETER, FALSE);
+  }
+  const auto it{proc->memory.find(reinterpret_cast<std::uintptr_t>(address))};
+  if (it == proc->memory.end()) {
+    return fail(ERROR_INVALID_ADDRESS, FALSE);
+  }
+  proc->memory.erase(it);
+  return TRUE;
+}
+
+BOOL VirtualProtectEx(HANDLE process, LPVOID address, SIZE_T size,
+                      DWORD protect, LPDWORD old_protect) {
+  FAKE_CALL(FALSE);
+  const std::lock_guard lock{mtx};
+  const auto proc{get_process(process)};
+  if (!proc) {
+    return FALSE;
+  }
+  const auto addr{reinterpret_cast<std::uintptr_t>(address)};
+  auto it{proc->memory.upper_bound(addr)};
+  if (it == proc->memory.begin() || !size) {
+    return fail(ERROR_INVALID_ADDRESS, FALSE);
+  }
+  --it;
+  auto &protects{it->second.protect};
+  const auto first{(addr - it->first) / page_size};
+  const auto last{(addr - it->first + size - 1) / page_size};
+  if (last >= protects.size()) {
+    return fail(ERROR_INVALID_ADDRESS, FALSE);
+  }
+  *old_protect = protects[first];
+  std::fill(&protects[first], &protects[last] + 1, protect);
+  return TRUE;
+}
+
+BOOL WriteProcessMemory(HANDLE process, LPVOID address, LPCVOID buf,
+                        SIZE_T size, SIZE_T *written) {
+  FAKE_CALL(FALSE);
+  const std::lock_guard lock{mtx};
+  const auto proc{get_process(process)};
+  if (!proc) {
+    return FALSE;
+  }
+  // Like the real function, it writes to read-only pages as well
+  if (!accessible(*proc, reinterpret_cast<std::uintptr_t>(address), size,
+                  false, false)) {
+    return fail(ERROR_NOACCESS, FALSE);
+  }
+  std::memcpy(address, buf, size);
+  if (written) {
+    *written = size;
+  }
+  return TRUE;
+}
+
+BOOL ReadProcessMemory(HANDLE process, LPCVOID address, LPVOID buf,
+                       SIZE_T size, SIZE_T *read) {
+  FAKE_CALL(FALSE);
+  const std::lock_guard lock{mtx};
+  const auto proc{get_process(process)};
+  if (!proc) {
+    return FALSE;
+  }
+  if (!mem_read(*proc, reinterpret_cast<std::uintptr_t>(address), buf,
+                size)) {
+    return fail(ERROR_NOACCESS, FALSE);
+  }
+  if (read) {
+    *read = size;
+  }
+  return TRUE;
+}
+
+HMODULE LoadLibraryW(LPCWSTR) {
+  FAKE_CALL(nullptr);
+  // Only game processes load DLLs, via the simulated loader
+  return fail(ERROR_MOD_NOT_FOUND, HMODULE{});
+}
+
+} // extern "C"
+
+namespace {
+
+/// Get access rights that security attributes grant via their DACL, for
+///    @ref mapping_obj::dacl_access.
+DWORD dacl_access(const SECURITY_ATTRIBUTES *attrs) {
+  if (!attrs || !attrs->lpSecurityDescriptor) {
+    return FILE_MAP_ALL_ACCESS;
+  }
+  const auto dacl{
+      static_cast<const SECURITY_DESCRIPTOR *>(attrs->lpSecurityDescriptor)
+          ->Dacl};
+  if (!dacl) {
+    return FILE_MAP_ALL_ACCESS;
+  }
+  DWORD access{};
+  auto ace{reinterpret_cast<const char *>(dacl) + sizeof(ACL)};
+  for (WORD i{}; i < dacl->AceCount; ++i) {
+    ACCESS_ALLOWED_ACE hdr;
+    std::memcpy(&hdr, ace, offsetof(ACCESS_ALLOWED_ACE, SidStart));
+    if (hdr.Header.AceType == 0) {
+      access |= (hdr.Mask & GENERIC_ALL) ? DWORD{FILE_MAP_ALL_ACCESS}
+                                         : hdr.Mask;
+    }
+    ace += hdr.Header.AceSize;
+  }
+  return access;
+}
+
+} // namespace
+
+extern "C" {
+
+HANDLE CreateFileMappingW(HANDLE file, LPSECURITY_ATTRIBUTES attrs,
+                          DWORD protect, DWORD size_high, DWORD size_low,
+                          LPCWSTR name) {
+  FAKE_CALL(nullptr);
+  const std::lock_guard lock{mtx};
+  std::size_t size{static_cast<std::size_t>(std::uint64_t{size_high} << 32 |
+                                            size_low)};
+  std::shared_ptr<const file_data> content;
+  if (file == INVALID_HANDLE_VALUE) {
+    if (!size) {
+      return fail(ERROR_INVALID_PARAMETER, HANDLE{});
+    }
+  } else {
+    const auto obj{get<file_obj>(file, kind::file)};
+    if (!obj) {
+      return nullptr;
+    }
+    content = obj->data;
+    if (!size) {
+      size = content->content.size();
+    }
+    if (!size) {
+      return fail(ERROR_FILE_INVALID, HANDLE{});
+    }
+  }
+  const DWORD access{protect == PAGE_READONLY ? DWORD{FILE_MAP_READ}
+                                              : DWORD{FILE_MAP_ALL_ACCESS}};
+  if (name) {
+    if (const auto it{named_mappings.find(name)};
+        it != named_mappings.end()) {
+      if (auto existing{it->second.lock()}) {
+        const auto handle{add_handle(cur_pid, std::move(existing), access)};
+        last_error = ERROR_ALREADY_EXISTS;
+        return handle;
+      }
+    }
+  }
+  // Like the real system, DACLs of unnamed mappings are ignored
+  auto mapping{std::make_shared<mapping_obj>(
+      size, attrs && attrs->lpSecurityDescriptor,
+      processes.at(cur_pid)->elevated,
+      name ? dacl_access(attrs) : DWORD{FILE_MAP_ALL_ACCESS})};
+  if (content) {
+    std::memcpy(mapping->buf.get(), content->content.data(),
+                std::min(size, content->content.size()));
+  }
+  if (name) {
+    named_mappings.insert_or_assign(name, mapping);
+  }
+  last_error = 0;
+  return add_handle(cur_pid, std::move(mapping), access);
+}
+
+HANDLE OpenFileMappingW(DWORD access, BOOL, LPCWSTR name) {
+  FAKE_CALL(nullptr);
+  const std::lock_guard lock{mtx};
+  const auto it{named_mappings.find(name)};
+  auto mapping{it == named_mappings.end() ? nullptr : it->second.lock()};
+  if (!mapping) {
+    return fail(ERROR_FILE_NOT_FOUND, HANDLE{});
+  }
+  // Default security of objects created by elevated processes denies access
+  //    to non-elevated ones
+  if (mapping->creator_elevated && !mapping->has_security &&
+      !processes.at(cur_pid)->elevated) {
+    return fail(ERROR_ACCESS_DENIED, HANDLE{});
+  }
+  return add_handle(cur_pid, std::move(mapping), access);
+}
+
+LPVOID MapViewOfFile(HANDLE mapping, DWORD access, DWORD offset_high,
+                     DWORD offset_low, SIZE_T size) {
+  FAKE_CALL(nullptr);
+  const std::lock_guard lock{mtx};
+  const auto entry{get_entry(mapping, kind::mapping)};
+  if (!entry) {
+    return nullptr;
+  }
+  if ((access & FILE_MAP_WRITE) && !(entry->access & FILE_MAP_WRITE)) {
+    return fail(ERROR_ACCESS_DENIED, LPVOID{});
+  }
+  auto obj{std::static_pointer_cast<mapping_obj>(entry->obj)};
+  if (offset_high || offset_low || size > obj->size) {
+    return fail(ERROR_INVALID_PARAMETER, LPVOID{});
+  }
+  const auto addr{obj->buf.get()};
+  views.emplace(addr, view_entry{cur_pid, std::move(obj)});
+  return addr;
+}
+
+BOOL UnmapViewOfFile(LPCVOID address) {
+  FAKE_CALL(FALSE);
+  const std::lock_guard lock{mtx};
+  auto [it, end]{views.equal_range(address)};
+  for (; it != end; ++it) {
+    if (it->second.owner == cur_pid) {
+      views.erase(it);
+      return TRUE;
+    }
+  }
+  return fail(ERROR_INVALID_ADDRESS, FALSE);
+}
+
+BOOL PrefetchVirtualMemory(HANDLE process, ULONG_PTR,
+                           WIN32_MEMORY_RANGE_ENTRY *, ULONG) {
+  FAKE_CALL(FALSE);
+  const std::lock_guard lock{mtx};
+  return get_process(process) ? TRUE : FALSE;
+}
+
+HANDLE CreateFileW(LPCWSTR path, DWORD, DWORD, LPSECURITY_ATTRIBUTES,
+                   DWORD disposition, DWORD, HANDLE) {
+  FAKE_CALL(INVALID_HANDLE_VALUE);
+  const std::lock_guard lock{mtx};
+  if (disposition != OPEN_EXISTING) {
+    return fail(ERROR_INVALID_PARAMETER, INVALID_HANDLE_VALUE);
+  }
+  const auto it{files.find(path)};
+  if (it == files.end()) {
+    return fail(ERROR_FILE_NOT_FOUND, INVALID_HANDLE_VALUE);
+  }
+  return add_handle(cur_pid, std::make_shared<file_obj>(it->second),
+                    GENERIC_READ);
+}
+
+BOOL GetFileSizeEx(HANDLE file, LARGE_INTEGER *size) {
+  FAKE_CALL(FALSE);
+  const std::lock_guard lock{mtx};
+  const auto obj{get<file_obj>(file, kind::file)};
+  if (!obj) {
+    return FALSE;
+  }
+  size->QuadPart = static_cast<LONGLONG>(obj->data->content.size());
+  return TRUE;
+}
+
+BOOL GetFileAttributesExW(LPCWSTR path, GET_FILEEX_INFO_LEVELS, LPVOID info) {
+  FAKE_CALL(FALSE);
+  const std::lock_guard lock{mtx};
+  const auto it{files.find(path)};
+  if (it == files.end()) {
+    return fail(ERROR_FILE_NOT_FOUND, FALSE);
+  }
+  const auto size{static_cast<std::uint64_t>(it->second->content.size())};
+  const auto write_time{it->second->write_time};
+  *static_cast<WIN32_FILE_ATTRIBUTE_DATA *>(info) = {
+      .dwFileAttributes = FILE_ATTRIBUTE_NORMAL,
+      .ftCreationTime = {},
+      .ftLastAccessTime = {},
+      .ftLastWriteTime = {.dwLowDateTime = static_cast<DWORD>(write_time),
+                          .dwHighDateTime =
+                              static_cast<DWORD>(write_time >> 32)},
+      .nFileSizeHigh = static_cast<DWORD>(size >> 32),
+      .nFileSizeLow = static_cast<DWORD>(size)};
+  return TRUE;
+}
+
+int MultiByteToWideChar(unsigned code_page, DWORD, LPCSTR str, int str_len,
+                        LPWSTR buf, int buf_len) {
+  FAKE_CALL(0);
+  if (code_page != CP_UTF8) {
+    return fail(ERROR_INVALID_PARAMETER, 0);
+  }
+  const std::string_view src{str, static_cast<std::size_t>(str_len)};
+  std::wstring res;
+  for (std::size_t i{}; i < src.size();) {
+    const auto lead{static_cast<unsigned char>(src[i])};
+    const int len{lead < 0x80   ? 1
+                  : lead < 0xC0 ? 0
+                  : lead < 0xE0 ? 2
+                  : lead < 0xF0 ? 3
+                  : lead < 0xF8 ? 4
+                                : 0};
+    if (!len || i + static_cast<std::size_t>(len) > src.size()) {
+      res += L'\xFFFD';
+      ++i;
+      continue;
+    }
+    char32_t cp{len == 1 ? lead : lead & (0x7Fu >> len)};
+    for (int j{1}; j < len; ++j) {
+      cp = cp << 6 | (static_cast<unsigned char>(src[i + j]) & 0x3F);
+    }
+    res += static_cast<wchar_t>(cp);
+    i += static_cast<std::size_t>(len);
+  }
+  if (!buf_len) {
+    return static_cast<int>(res.size());
+  }
+  if (static_cast<std::size_t>(buf_len) < res.size()) {
+    return fail(ERROR_INSUFFICIENT_BUFFER, 0);
+  }
+  std::ranges::copy(res, buf);
+  return static_cast<int>(res.size());
+}
+
+HANDLE CreateJobObjectW(LPSECURITY_ATTRIBUTES, LPCWSTR) {
+  FAKE_CALL(nullptr);
+  const std::lock_guard lock{mtx};
+  return add_handle(cur_pid, std::make_shared<job_obj>(), 0x1F001F);
+}
+
+BOOL SetInformationJobObject(HANDLE job, JOBOBJECTINFOCLASS info_class,
+                             LPVOID info, DWORD info_size) {
+  FAKE_CALL(FALSE);
+  const std::lock_guard lock{mtx};
+  const auto obj{get<job_obj>(job, kind::job)};
+  if (!obj) {
+    return FALSE;
+  }
+  switch (info_class) {
+  case JobObjectExtendedLimitInformation: {
+    if (info_size != sizeof(JOBOBJECT_EXTENDED_LIMIT_INFORMATION)) {
+      return fail(ERROR_BAD_LENGTH, FALSE);
+    }
+    const auto &limits{
+        *static_cast<const JOBOBJECT_EXTENDED_LIMIT_INFORMATION *>(info)};
+    const auto flags{limits.BasicLimitInformation.LimitFlags};
+    obj->memory_limit =
+        (flags & JOB_OBJECT_LIMIT_JOB_MEMORY) ? limits.JobMemoryLimit : 0;
+    obj->max_processes = (flags & JOB_OBJECT_LIMIT_ACTIVE_PROCESS)
+                             ? limits.BasicLimitInformation.ActiveProcessLimit
+                             : 0;
+    return TRUE;
+  }
+  case JobObjectCpuRateControlInformation: {
+    if (info_size != sizeof(JOBOBJECT_CPU_RATE_CONTROL_INFORMATION)) {
+      return fail(ERROR_BAD_LENGTH, FALSE);
+    }
+    const auto &rate{
+        *static_cast<const JOBOBJECT_CPU_RATE_CONTROL_INFORMATION *>(info)};
+    if ((rate.ControlFlags & JOB_OBJECT_CPU_RATE_CONTROL_ENABLE) &&
+        (!rate.CpuRate || rate.CpuRate > 10000)) {
+      return fail(ERROR_INVALID_PARAMETER, FALSE);
+    }
+    obj->cpu_rate = (rate.ControlFlags & JOB_OBJECT_CPU_RATE_CONTROL_ENABLE)
+                        ? rate.CpuRate
+                        : 0;
+    return TRUE;
+  }
+  default:
+    return fail(ERROR_INVALID_PARAMETER, FALSE);
+  }
+}
+
+BOOL QueryInformationJobObject(HANDLE job, JOBOBJECTINFOCLASS info_class,
+                               LPVOID info, DWORD info_size,
+                               LPDWORD ret_size) {
+  FAKE_CALL(FALSE);
+  const std::lock_guard lock{mtx};
+  const auto obj{get<job_obj>(job, kind::job)};
+  if (!obj) {
+    return FALSE;
+  }
+  switch (info_class) {
+  case JobObjectBasicAndIoAccountingInformation: {
+    if (info_size < sizeof(JOBOBJECT_BASIC_AND_IO_ACCOUNTING_INFORMATION)) {
+      return fail(ERROR_BAD_LENGTH, FALSE);
+    }
+    JOBOBJECT_BASIC_AND_IO_ACCOUNTING_INFORMATION acct{};
+    acct.BasicInfo.TotalProcesses = obj->total;
+    acct.BasicInfo.ActiveProcesses = static_cast<DWORD>(
+        std::ranges::count_if(obj->processes, [](const auto &weak_proc) {
+          const auto proc{weak_proc.lock()};
+          return proc && !proc->terminated;
+        }));
+    std::memcpy(info, &acct, sizeof acct);
+    break;
+  }
+  case JobObjectExtendedLimitInformation: {
+    if (info_size < sizeof(JOBOBJECT_EXTENDED_LIMIT_INFORMATION)) {
+      return fail(ERROR_BAD_LENGTH, FALSE);
+    }
+    JOBOBJECT_EXTENDED_LIMIT_INFORMATION limits{};
+    limits.JobMemoryLimit = obj->memory_limit;
+    limits.BasicLimitInformation.ActiveProcessLimit = obj->max_processes;
+    std::memcpy(info, &limits, sizeof limits);
+    break;
+  }
+  default:
+    return fail(ERROR_INVALID_PARAMETER, FALSE);
+  }
+  if (ret_size) {
+    *ret_size = info_size;
+  }
+  return TRUE;
+}
+
+BOOL AssignProcessToJobObject(HANDLE job, HANDLE process) {
+  FAKE_CALL(FALSE);
+  const std::lock_guard lock{mtx};
+  const auto obj{get<job_obj>(job, kind::job)};
+  const auto proc{get_process(process)};
+  if (!obj || !proc) {
+    return FALSE;
+  }
+  if (proc->terminated || proc->job) {
+    return fail(ERROR_ACCESS_DENIED, FALSE);
+  }
+  proc->job = obj;
+  obj->processes.emplace_back(proc);
+  ++obj->total;
+  return TRUE;
+}
+
+HANDLE CreateEventW(LPSECURITY_ATTRIBUTES, BOOL manual_reset,
+                    BOOL initial_state, LPCWSTR name) {
+  FAKE_CALL(nullptr);
+  if (name) {
+    return fail(ERROR_INVALID_PARAMETER, HANDLE{});
+  }
+  const std::lock_guard lock{mtx};
+  return add_handle(cur_pid,
+                    std::make_shared<event_obj>(manual_reset, initial_state),
+                    0x1F0003);
+}
+
+BOOL SetEvent(HANDLE event) {
+  FAKE_CALL(FALSE);
+  const std::lock_guard lock{mtx};
+  const auto obj{get<event_obj>(event, kind::event)};
+  if (!obj) {
+    return FALSE;
+  }
+  obj->state = true;
+  cv.notify_all();
+  return TRUE;
+}
+
+DWORD WaitForMultipleObjects(DWORD count, const HANDLE *handles_arr,
+                             BOOL wait_all, DWORD timeout) {
+  FAKE_CALL(WAIT_FAILED);
+  std::unique_lock lock{mtx};
+  std::vector<std::shared_ptr<object>> objs;
+  for (DWORD i{}; i < count; ++i) {
+    const auto it{
+        handles.find(reinterpret_cast<std::uintptr_t>(handles_arr[i]))};
+    if (it == handles.end() || it->second.owner != cur_pid) {
+      return fail(ERROR_INVALID_HANDLE, DWORD{WAIT_FAILED});
+    }
+    objs.emplace_back(it->second.obj);
+  }
+  if (wait_all) {
+    return fail(ERROR_INVALID_PARAMETER, DWORD{WAIT_FAILED});
+  }
+  std::optional<DWORD> res;
+  const auto ready{[&objs, &res] {
+    for (std::size_t i{}; i < objs.size(); ++i) {
+      if (objs[i]->signaled()) {
+        objs[i]->acquire();
+        res = WAIT_OBJECT_0 + static_cast<DWORD>(i);
+        return true;
+      }
+    }
+    return false;
+  }};
+  if (timeout == INFINITE) {
+    cv.wait(lock, ready);
+  } else if (!cv.wait_for(lock, std::chrono::milliseconds{timeout}, ready)) {
+    return WAIT_TIMEOUT;
+  }
+  return *res;
+}
+
+DWORD WaitForSingleObject(HANDLE handle, DWORD timeout) {
+  return WaitForMultipleObjects(1, &handle, FALSE, timeout);
+}
+
+BOOL SwitchToThread(void) {
+  std::this_thread::yield();
+  return TRUE;
+}
+
+ULONGLONG GetTickCount64(void) {
+  return static_cast<ULONGLONG>(
+      std::chrono::duration_cast<std::chrono::milliseconds>(
+          std::chrono::steady_clock::now().time_since_epoch())
+          .count());
+}
+
+BOOL QueryPerformanceCounter(LARGE_INTEGER *counter) {
+  // 100-nanosecond units, like on most Windows systems
+  counter->QuadPart = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                          std::chrono::steady_clock::now().time_since_epoch())
+                          .count() /
+                      100;
+  return TRUE;
+}
+
+BOOL QueryPerformanceFrequency(LARGE_INTEGER *frequency) {
+  frequency->QuadPart = 10'000'000;
+  return TRUE;
+}
+
+} // extern "C"
+
+//===-- Slim reader/writer locks and condition variables ------------------===//
+
+namespace {
+
+/// Mutex protecting states of all SRW locks and condition variables, which
+///    are stored in their pointer-sized fields, so they need no allocation.
+std::mutex srw_mtx;
+/// Condition variable notified upon every state change of an SRW lock or a
+///    condition variable.
+std::condition_variable srw_cv;
+/// SRW lock state of an exclusively owned lock.
+constexpr std::uintptr_t exclusive{UINTPTR_MAX};
+
+std::uintptr_t load(const void *const &ptr) noexcept {
+  return std::bit_cast<std::uintptr_t>(ptr);
+}
+
+void store(void *&ptr, std::uintptr_t value) noexcept {
+  ptr = std::bit_cast<void *>(value);
+}
+
+void acquire_srw(std::unique_lock<std::mutex> &lock, SRWLOCK &srw,
+                 bool shared) {
+  if (shared) {
+    srw_cv.wait(lock, [&srw] { return load(srw.Ptr) != exclusive; });
+    store(srw.Ptr, load(srw.Ptr) + 1);
+  } else {
+    srw_cv.wait(lock, [&srw] { return !load(srw.Ptr); });
+    store(srw.Ptr, exclusive);
+  }
+}
+
+void release_srw(SRWLOCK &srw) {
+  const auto state{load(srw.Ptr)};
+  store(srw.Ptr, state == exclusive ? 0 : state - 1);
+  srw_cv.notify_all();
+}
+
+} // namespace
+
+extern "C" {
+
+VOID AcquireSRWLockExclusive(PSRWLOCK lock) {
+  std::unique_lock guard{srw_mtx};
+  acquire_srw(guard, *lock, false);
+}
+
+VOID ReleaseSRWLockExclusive(PSRWLOCK lock) {
+  const std::lock_guard guard{srw_mtx};
+  release_srw(*lock);
+}
+
+VOID AcquireSRWLockShared(PSRWLOCK lock) {
+  std::unique_lock guard{srw_mtx};
+  acquire_srw(guard, *lock, true);
+}
+
+VOID ReleaseSRWLockShared(PSRWLOCK lock) {
+  const std::lock_guard guard{srw_mtx};
+  release_srw(*lock);
+}
+
+BOOL SleepConditionVariableSRW(PCONDITION_VARIABLE cond, PSRWLOCK lock,
+                               DWORD timeout, ULONG flags) {
+  if (timeout != INFINITE) {
+    return fail(ERROR_INVALID_PARAMETER, FALSE);
+  }
+  std::unique_lock guard{srw_mtx};
+  const auto seq{load(cond->Ptr)};
+  release_srw(*lock);
+  srw_cv.wait(guard, [cond, seq] { return load(cond->Ptr) != seq; });
+  // CONDITION_VARIABLE_LOCKMODE_SHARED
+  acquire_srw(guard, *lock, flags & 1);
+  return TRUE;
+}
+
+VOID WakeAllConditionVariable(PCONDITION_VARIABLE cond) {
+  const std::lock_guard guard{srw_mtx};
+  store(cond->Ptr, load(cond->Ptr) + 1);
+  srw_cv.notify_all();
+}
+
+//===-- Thread pool -------------------------------------------------------===//
+
+BOOL RegisterWaitForSingleObject(PHANDLE wait, HANDLE object,
+                                 WAITORTIMERCALLBACK callback, PVOID context,
+                                 ULONG timeout, ULONG) {
+  FAKE_CALL(FALSE);
+  wait_reg *reg;
+  {
+    const std::lock_guard lock{mtx};
+    const auto it{handles.find(reinterpret_cast<std::uintptr_t>(object))};
+    if (it == handles.end() || it->second.owner != cur_pid) {
+      return fail(ERROR_INVALID_HANDLE, FALSE);
+    }
+    reg = new wait_reg{.obj = it->second.obj,
+                       .cb = callback,
+                       .context = context,
+                       .timeout = timeout,
+                       .thread{}};
+    waits.emplace(reg);
+    // The callback may run before the handle is returned, as it may on
+    //    Windows
+    reg->thread = std::thread{[reg] {
+      std::unique_lock lock{mtx};
+      const auto ready{
+          [reg] { return reg->cancelled || reg->obj->signaled(); }};
+      bool timed_out{};
+      if (reg->timeout == INFINITE) {
+        cv.wait(lock, ready);
+      } else {
+        timed_out = !cv.wait_for(lock, std::chrono::milliseconds{reg->timeout},
+                                 ready);
+      }
+      if (!reg->cancelled) {
+        if (!timed_out) {
+          reg->obj->acquire();
+        }
+        lock.unlock();
+        reg->cb(reg->context, timed_out);
+        lock.lock();
+      }
+      reg->finished = true;
+      cv.notify_all();
+      if (reg->orphaned) {
+        lock.unlock();
+        reg->thread.detach();
+        delete reg;
+      }
+    }};
+  }
+  *wait = reg;
+  return TRUE;
+}
+
+BOOL UnregisterWaitEx(HANDLE wait, HANDLE) {
+  FAKE_CALL(FALSE);
+  const auto reg{static_cast<wait_reg *>(wait)};
+  std::unique_lock lock{mtx};
+  if (!waits.erase(reg)) {
+    return fail(ERROR_INVALID_HANDLE, FALSE);
+  }
+  reg->cancelled = true;
+  cv.notify_all();
+  if (reg->thread.get_id() == std::this_thread::get_id()) {
+    reg->orphaned = true;
+    return TRUE;
+  }
+  cv.wait(lock, [reg] { return reg->finished; });
+  lock.unlock();
+  reg->thread.join();
+  delete reg;
+  return TRUE;
+}
+
+BOOL TrySubmitThreadpoolCallback(PTP_SIMPLE_CALLBACK callback, PVOID context,
+                                 PTP_CALLBACK_ENVIRON) {
+  FAKE_CALL(FALSE);
+  const std::lock_guard lock{mtx};
+  ++pending_callbacks;
+  start_thread([callback, context] {
+    callback(nullptr, context);
+    const std::lock_guard lock{mtx};
+    --pending_callbacks;
+    cv.notify_all();
+  });
+  return TRUE;
+}
+
+PTP_WORK CreateThreadpoolWork(PTP_WORK_CALLBACK callback, PVOID context,
+                              PTP_CALLBACK_ENVIRON) {
+  FAKE_CALL(nullptr);
+  const std::lock_guard lock{mtx};
+  const auto work{new _TP_WORK{.cb = callback, .context = context, .threads{}}};
+  works.emplace(work);
+  return work;
+}
+
+VOID SubmitThreadpoolWork(PTP_WORK work) {
+  const std::lock_guard lock{mtx};
+  work->threads.emplace_back(
+      [work] { work->cb(nullptr, work->context, work); });
+}
+
+VOID WaitForThreadpoolWorkCallbacks(PTP_WORK work, BOOL) {
+  std::vector<std::thread> to_join;
+  {
+    const std::lock_guard lock{mtx};
+    to_join = std::move(work->threads);
+    work->threads.clear();
+  }
+  for (auto &thread : to_join) {
+    thread.join();
+  }
+}
+
+VOID CloseThreadpoolWork(PTP_WORK work) {
+  WaitForThreadpoolWorkCallbacks(work, TRUE);
+  {
+    const std::lock_guard lock{mtx};
+    works.erase(work);
+  }
+  delete work;
+}
+
+} // extern "C"
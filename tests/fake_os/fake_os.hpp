@@ -0,0 +1,190 @@
+//===-- fake_os.hpp - Fake Win32 API control interface --------------------===//
+//
+// Copyright (c) 2025 Nuclearist <nuclearist@teknology-hub.com>
+// Part of tek-injector, under the GNU General Public License v3.0 or later
+// See https://github.com/teknology-hub/tek-injector/blob/main/COPYING for
+//    license information.
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+//===----------------------------------------------------------------------===//
+///
+/// @file
+///  Functions for tests to set up and inspect the state of the fake OS layer
+///    that implements Win32 API declared in windows.h in this directory.
+///  The layer simulates the calling process and game processes started by
+///    the library within the test process: handle tables with per-process
+///    ownership, events, file mappings, remote memory with page protections,
+///    suspended main threads, remote threads and APCs executing the loader
+///    stub the way the real routine would, thread pool waits and callbacks,
+///    and a virtual file system. Any API call may be made to fail with a
+///    chosen error code, and everything the library leaves behind is
+///    reported by @ref leaks.
+///
+//===----------------------------------------------------------------------===//
+#pragma once
+
+#include <windows.h>
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace fake_os {
+
+/// ID of the process that tests run as.
+inline constexpr DWORD self_pid{100};
+
+/// Address that game's main thread starts executing at, in RCX of its
+///    initial context.
+inline constexpr std::uint64_t entry_address{0x140001000};
+
+/// Function called when a game process loads a DLL, on the thread of that
+///    process that loads it, so Win32 API calls it makes are made by that
+///    process. It may act as TEK Game Runtime.
+///
+/// @param pid
+///    ID of the process.
+/// @param path
+///    Path to the DLL, as passed to `LoadLibraryW`.
+/// @return Value indicating whether the DLL has been loaded.
+using load_hook = std::function<bool(DWORD pid, std::wstring_view path)>;
+
+/// State of a game process.
+struct process_info {
+  /// Value indicating whether the process exists.
+  bool exists;
+  /// Value indicating whether the process has been terminated.
+  bool terminated;
+  /// Value indicating whether the process has crashed by executing or
+  ///    accessing invalid memory.
+  bool crashed;
+  /// Value indicating whether game's main thread has reached the entry point
+  ///    of the executable.
+  bool entry_reached;
+  /// Exit code of the process, if it has been terminated.
+  DWORD exit_code;
+  /// Value indicating whether the process has been started elevated.
+  bool elevated;
+  /// Process creation flags.
+  DWORD create_flags;
+  /// Command line of the process.
+  std::wstring command_line;
+  /// Current directory of the process, empty if it's inherited.
+  std::wstring current_dir;
+  /// Paths of the DLLs loaded by the process, in order.
+  std::vector<std::wstring> loaded;
+  /// Number of threads created in the process by other processes.
+  std::uint32_t remote_threads;
+  /// Number of threads of the process terminated by other processes.
+  std::uint32_t terminated_threads;
+  /// Number of APCs queued to game's main thread.
+  std::uint32_t apcs;
+  /// Number of remote memory blocks currently allocated in the process by
+  ///    other processes.
+  std::uint32_t remote_allocs;
+  /// Processor affinity mask of the process, 0 if it hasn't been set.
+  std::uint64_t affinity;
+  /// Processor group set via process creation attributes.
+  std::uint16_t group;
+  /// Preferred NUMA node set via process creation attributes, or
+  ///    `UINT16_MAX` if it hasn't been set.
+  std::uint16_t numa_node;
+  /// Memory priority of the process, 0 if it hasn't been set.
+  std::uint32_t memory_priority;
+  /// I/O priority of the process, `IoPriorityNormal` (2) if it hasn't been
+  ///    set.
+  std::uint32_t io_priority;
+  /// Value indicating whether the process has been assigned to a job.
+  bool in_job;
+  /// Job memory limit, 0 if it hasn't been set.
+  std::uint64_t job_memory_limit;
+  /// Job CPU rate limit, 0 if it hasn't been set.
+  std::uint32_t job_cpu_rate;
+  /// Job active process limit, 0 if it hasn't been set.
+  std::uint32_t job_max_processes;
+};
+
+/// Terminate all game processes, wait for all threads of the layer to exit,
+///    and reset all state to the initial one: no files, no game processes,
+///    no failures, non-elevated calling process, and every DLL loading
+///    successfully.
+void reset();
+
+/// Make a call of a Win32 API function fail.
+///
+/// @param name
+///    Name of the function.
+/// @param error
+///    Win32 error code for the function to set.
+/// @param skip
+///    Number of calls of the function to let succeed before the failing one.
+void fail_call(std::string name, DWORD error, unsigned skip = 0);
+
+/// Set the elevation state of the calling process.
+///
+/// @param elevated
+///    Value indicating whether the calling process is elevated.
+void set_elevated(bool elevated);
+
+/// Add a file to the virtual file system, or replace it.
+///
+/// @param path
+///    Full path to the file, as passed to file functions.
+/// @param content
+///    Content of the file.
+/// @param write_time
+///    Last write time of the file.
+void add_file(std::wstring path, std::string content,
+              std::uint64_t write_time = 1);
+
+/// Set the function called when a game process loads a DLL.
+///
+/// @param hook
+///    The function, or an empty one for every DLL to load successfully.
+void set_load_hook(load_hook hook);
+
+/// Block the calling thread of a game process until that process is
+///    terminated, e.g. to simulate a DLL that never finishes loading. Must be
+///    called from @ref load_hook.
+void wait_until_terminated();
+
+/// Start a running game process, e.g. to attach to.
+///
+/// @return ID of the process.
+DWORD spawn();
+
+/// Get the ID that the next game process will receive.
+///
+/// @return The process ID.
+DWORD next_pid();
+
+/// Get the state of a game process.
+///
+/// @param pid
+///    ID of the process.
+/// @return State of the process, with @ref process_info::exists set to
+///    `false` if it doesn't exist.
+process_info process(DWORD pid);
+
+/// Get the number of game processes that are running.
+///
+/// @return The number of processes.
+std::size_t running_processes();
+
+/// Wait for thread pool callbacks submitted so far to return, then describe
+///    resources owned by the calling process that are still allocated:
+///    handles, mapped views, thread pool waits and work objects, as well as
+///    invalid handles that have been closed.
+///
+/// @return Descriptions of the leaked resources, empty if there are none.
+std::vector<std::string> leaks();
+
+/// Check whether the calling thread is executing a function of the layer,
+///    so allocations it makes may be told apart from the library's own.
+///
+/// @return Value indicating whether a function of the layer is executing.
+bool in_os() noexcept;
+
+} // namespace fake_os
@@ -0,0 +1,569 @@
+//===-- windows.h - Fake Win32 API declarations ---------------------------===//
+//
+// Copyright (c) 2025 Nuclearist <nuclearist@teknology-hub.com>
+// Part of tek-injector, under the GNU General Public License v3.0 or later
+// See https://github.com/teknology-hub/tek-injector/blob/main/COPYING for
+//    license information.
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+//===----------------------------------------------------------------------===//
+///
+/// @file
+///  Declarations of the subset of Win32 API used by src/lib.cpp, implemented
+///    by the fake OS layer in fake_os.cpp, so the launch pipeline builds and
+///    runs on other hosts. Types have the sizes and layouts they have on
+///    64-bit Windows, except for `WCHAR`, which is the host `wchar_t`, like
+///    string literals that the library passes to the functions.
+///  Only what the library uses is declared, with the same names, so the
+///    library code compiles against it unchanged.
+///
+//===----------------------------------------------------------------------===//
+#pragma once
+#pragma GCC system_header
+
+#include <stddef.h>
+#include <stdint.h>
+
+//===-- Basic types -------------------------------------------------------===//
+
+#define WINAPI
+#define CALLBACK
+#define NTAPI
+#define VOID void
+
+typedef int BOOL;
+typedef unsigned char BYTE, UCHAR, BOOLEAN;
+typedef unsigned short WORD, USHORT;
+typedef uint32_t DWORD, ULONG;
+typedef int32_t LONG;
+typedef int64_t LONGLONG;
+typedef uint64_t ULONGLONG, DWORD64;
+typedef uintptr_t ULONG_PTR, SIZE_T, DWORD_PTR, KAFFINITY;
+typedef intptr_t LONG_PTR;
+typedef DWORD *LPDWORD;
+typedef char CHAR;
+typedef const CHAR *LPCSTR;
+typedef CHAR *LPSTR;
+typedef wchar_t WCHAR;
+typedef WCHAR *LPWSTR;
+typedef const WCHAR *LPCWSTR;
+typedef void *HANDLE, *LPVOID, *PVOID;
+typedef const void *LPCVOID;
+typedef HANDLE *PHANDLE;
+typedef struct HINSTANCE__ *HMODULE;
+
+typedef union _LARGE_INTEGER {
+  struct {
+    DWORD LowPart;
+    LONG HighPart;
+  };
+  LONGLONG QuadPart;
+} LARGE_INTEGER;
+
+typedef struct _FILETIME {
+  DWORD dwLowDateTime;
+  DWORD dwHighDateTime;
+} FILETIME;
+
+#define TRUE 1
+#define FALSE 0
+#define INFINITE 0xFFFFFFFF
+#define INVALID_HANDLE_VALUE ((HANDLE)(LONG_PTR)-1)
+
+//===-- Error codes -------------------------------------------------------===//
+
+#define ERROR_SUCCESS 0
+#define ERROR_FILE_NOT_FOUND 2
+#define ERROR_PATH_NOT_FOUND 3
+#define ERROR_ACCESS_DENIED 5
+#define ERROR_INVALID_HANDLE 6
+#define ERROR_NOT_ENOUGH_MEMORY 8
+#define ERROR_BAD_LENGTH 24
+#define ERROR_INVALID_PARAMETER 87
+#define ERROR_INSUFFICIENT_BUFFER 122
+#define ERROR_MOD_NOT_FOUND 126
+#define ERROR_PROC_NOT_FOUND 127
+#define ERROR_ALREADY_EXISTS 183
+#define ERROR_BAD_EXE_FORMAT 193
+#define ERROR_EXE_MACHINE_TYPE_MISMATCH 216
+#define ERROR_INVALID_ADDRESS 487
+#define ERROR_NOACCESS 998
+#define ERROR_FILE_INVALID 1006
+#define ERROR_PROCESS_ABORTED 1067
+#define ERROR_ALLOTTED_SPACE_EXCEEDED 1344
+#define ERROR_TIMEOUT 1460
+
+//===-- Security ----------------------------------------------------------===//
+
+typedef struct _SECURITY_ATTRIBUTES {
+  DWORD nLength;
+  LPVOID lpSecurityDescriptor;
+  BOOL bInheritHandle;
+} SECURITY_ATTRIBUTES, *LPSECURITY_ATTRIBUTES;
+
+typedef struct _SID_IDENTIFIER_AUTHORITY {
+  BYTE Value[6];
+} SID_IDENTIFIER_AUTHORITY;
+
+typedef struct _SID {
+  BYTE Revision;
+  BYTE SubAuthorityCount;
+  SID_IDENTIFIER_AUTHORITY IdentifierAuthority;
+  DWORD SubAuthority[1];
+} SID;
+typedef PVOID PSID;
+
+typedef struct _SID_AND_ATTRIBUTES {
+  PSID Sid;
+  DWORD Attributes;
+} SID_AND_ATTRIBUTES;
+
+typedef struct _TOKEN_USER {
+  SID_AND_ATTRIBUTES User;
+} TOKEN_USER;
+
+typedef struct _TOKEN_MANDATORY_LABEL {
+  SID_AND_ATTRIBUTES Label;
+} TOKEN_MANDATORY_LABEL;
+
+typedef struct _ACL {
+  BYTE AclRevision;
+  BYTE Sbz1;
+  WORD AclSize;
+  WORD AceCount;
+  WORD Sbz2;
+} ACL, *PACL;
+
+typedef struct _ACE_HEADER {
+  BYTE AceType;
+  BYTE AceFlags;
+  WORD AceSize;
+} ACE_HEADER;
+
+typedef struct _ACCESS_ALLOWED_ACE {
+  ACE_HEADER Header;
+  DWORD Mask;
+  DWORD SidStart;
+} ACCESS_ALLOWED_ACE;
+
+typedef struct _SYSTEM_MANDATORY_LABEL_ACE {
+  ACE_HEADER Header;
+  DWORD Mask;
+  DWORD SidStart;
+} SYSTEM_MANDATORY_LABEL_ACE;
+
+typedef struct _SECURITY_DESCRIPTOR {
+  BYTE Revision;
+  BYTE Sbz1;
+  WORD Control;
+  PSID Owner;
+  PSID Group;
+  PACL Sacl;
+  PACL Dacl;
+} SECURITY_DESCRIPTOR;
+
+typedef enum _TOKEN_ELEVATION_TYPE {
+  TokenElevationTypeDefault = 1,
+  TokenElevationTypeFull,
+  TokenElevationTypeLimited
+} TOKEN_ELEVATION_TYPE;
+
+typedef enum _TOKEN_INFORMATION_CLASS {
+  TokenUser = 1,
+  TokenElevationType = 18,
+  TokenIntegrityLevel = 25
+} TOKEN_INFORMATION_CLASS;
+
+typedef enum _SECURITY_IMPERSONATION_LEVEL {
+  SecurityImpersonation = 2
+} SECURITY_IMPERSONATION_LEVEL;
+
+typedef enum _TOKEN_TYPE { TokenPrimary = 1 } TOKEN_TYPE;
+
+#define SECURITY_MANDATORY_LABEL_AUTHORITY {0, 0, 0, 0, 0, 16}
+#define SECURITY_MANDATORY_MEDIUM_RID 0x2000
+#define SECURITY_MAX_SID_SIZE 68
+#define SE_GROUP_INTEGRITY 0x20
+#define ACL_REVISION 2
+#define SYSTEM_MANDATORY_LABEL_NO_READ_UP 0x2
+#define SECURITY_DESCRIPTOR_REVISION 1
+#define TOKEN_ASSIGN_PRIMARY 0x0001
+#define TOKEN_DUPLICATE 0x0002
+#define TOKEN_QUERY 0x0008
+#define TOKEN_ADJUST_DEFAULT 0x0080
+#define GENERIC_READ 0x80000000
+#define GENERIC_ALL 0x10000000
+#define SYNCHRONIZE 0x00100000
+#define PROCESS_CREATE_THREAD 0x0002
+#define PROCESS_VM_OPERATION 0x0008
+#define PROCESS_VM_READ 0x0010
+#define PROCESS_VM_WRITE 0x0020
+#define PROCESS_QUERY_INFORMATION 0x0400
+#define EVENT_MODIFY_STATE 0x0002
+#define DUPLICATE_CLOSE_SOURCE 0x1
+#define DUPLICATE_SAME_ACCESS 0x2
+
+//===-- Processes and threads ---------------------------------------------===//
+
+typedef DWORD(WINAPI *LPTHREAD_START_ROUTINE)(LPVOID);
+typedef VOID(NTAPI *PAPCFUNC)(ULONG_PTR);
+
+typedef struct _STARTUPINFOW {
+  DWORD cb;
+  LPWSTR lpReserved;
+  LPWSTR lpDesktop;
+  LPWSTR lpTitle;
+  DWORD dwX;
+  DWORD dwY;
+  DWORD dwXSize;
+  DWORD dwYSize;
+  DWORD dwXCountChars;
+  DWORD dwYCountChars;
+  DWORD dwFillAttribute;
+  DWORD dwFlags;
+  WORD wShowWindow;
+  WORD cbReserved2;
+  BYTE *lpReserved2;
+  HANDLE hStdInput;
+  HANDLE hStdOutput;
+  HANDLE hStdError;
+} STARTUPINFOW, *LPSTARTUPINFOW;
+
+typedef struct _PROC_THREAD_ATTRIBUTE_LIST *LPPROC_THREAD_ATTRIBUTE_LIST;
+
+typedef struct _STARTUPINFOEXW {
+  STARTUPINFOW StartupInfo;
+  LPPROC_THREAD_ATTRIBUTE_LIST lpAttributeList;
+} STARTUPINFOEXW;
+
+typedef struct _PROCESS_INFORMATION {
+  HANDLE hProcess;
+  HANDLE hThread;
+  DWORD dwProcessId;
+  DWORD dwThreadId;
+} PROCESS_INFORMATION, *LPPROCESS_INFORMATION;
+
+typedef struct _GROUP_AFFINITY {
+  KAFFINITY Mask;
+  WORD Group;
+  WORD Reserved[3];
+} GROUP_AFFINITY, *PGROUP_AFFINITY;
+
+typedef struct _MEMORY_PRIORITY_INFORMATION {
+  ULONG MemoryPriority;
+} MEMORY_PRIORITY_INFORMATION;
+
+typedef enum _PROCESS_INFORMATION_CLASS {
+  ProcessMemoryPriority
+} PROCESS_INFORMATION_CLASS;
+
+/// Only the fields used by the library, the real structure is much larger.
+typedef struct _CONTEXT {
+  DWORD ContextFlags;
+  DWORD64 Rcx;
+  DWORD64 Rsp;
+  DWORD64 Rip;
+} CONTEXT;
+
+#define STILL_ACTIVE 259
+#define CREATE_SUSPENDED 0x00000004
+#define HIGH_PRIORITY_CLASS 0x00000080
+#define EXTENDED_STARTUPINFO_PRESENT 0x00080000
+#define PROC_THREAD_ATTRIBUTE_GROUP_AFFINITY 0x00030003
+#define PROC_THREAD_ATTRIBUTE_PREFERRED_NODE 0x00020004
+#define CONTEXT_CONTROL 0x00100001
+#define CONTEXT_INTEGER 0x00100002
+#define MEMORY_PRIORITY_VERY_LOW 1
+#define MEMORY_PRIORITY_LOW 2
+#define MEMORY_PRIORITY_MEDIUM 3
+#define MEMORY_PRIORITY_BELOW_NORMAL 4
+#define MEMORY_PRIORITY_NORMAL 5
+
+//===-- Memory ------------------------------------------------------------===//
+
+typedef struct _WIN32_MEMORY_RANGE_ENTRY {
+  PVOID VirtualAddress;
+  SIZE_T NumberOfBytes;
+} WIN32_MEMORY_RANGE_ENTRY;
+
+#define MEM_COMMIT 0x00001000
+#define MEM_RESERVE 0x00002000
+#define MEM_RELEASE 0x00008000
+#define PAGE_READONLY 0x02
+#define PAGE_READWRITE 0x04
+#define PAGE_EXECUTE_READ 0x20
+#define FILE_MAP_WRITE 0x0002
+#define FILE_MAP_READ 0x0004
+#define FILE_MAP_ALL_ACCESS 0x000F001F
+#define SECTION_QUERY 0x0001
+#define SECTION_MAP_READ 0x0004
+
+//===-- Files -------------------------------------------------------------===//
+
+typedef struct _WIN32_FILE_ATTRIBUTE_DATA {
+  DWORD dwFileAttributes;
+  FILETIME ftCreationTime;
+  FILETIME ftLastAccessTime;
+  FILETIME ftLastWriteTime;
+  DWORD nFileSizeHigh;
+  DWORD nFileSizeLow;
+} WIN32_FILE_ATTRIBUTE_DATA;
+
+typedef enum _GET_FILEEX_INFO_LEVELS {
+  GetFileExInfoStandard
+} GET_FILEEX_INFO_LEVELS;
+
+#define FILE_SHARE_READ 0x1
+#define FILE_SHARE_WRITE 0x2
+#define FILE_SHARE_DELETE 0x4
+#define OPEN_EXISTING 3
+#define FILE_ATTRIBUTE_NORMAL 0x80
+#define FILE_FLAG_SEQUENTIAL_SCAN 0x08000000
+#define CP_UTF8 65001
+
+//===-- Jobs --------------------------------------------------------------===//
+
+typedef struct _IO_COUNTERS {
+  ULONGLONG ReadOperationCount;
+  ULONGLONG WriteOperationCount;
+  ULONGLONG OtherOperationCount;
+  ULONGLONG ReadTransferCount;
+  ULONGLONG WriteTransferCount;
+  ULONGLONG OtherTransferCount;
+} IO_COUNTERS;
+
+typedef struct _JOBOBJECT_BASIC_ACCOUNTING_INFORMATION {
+  LARGE_INTEGER TotalUserTime;
+  LARGE_INTEGER TotalKernelTime;
+  LARGE_INTEGER ThisPeriodTotalUserTime;
+  LARGE_INTEGER ThisPeriodTotalKernelTime;
+  DWORD TotalPageFaultCount;
+  DWORD TotalProcesses;
+  DWORD ActiveProcesses;
+  DWORD TotalTerminatedProcesses;
+} JOBOBJECT_BASIC_ACCOUNTING_INFORMATION;
+
+typedef struct _JOBOBJECT_BASIC_AND_IO_ACCOUNTING_INFORMATION {
+  JOBOBJECT_BASIC_ACCOUNTING_INFORMATION BasicInfo;
+  IO_COUNTERS IoInfo;
+} JOBOBJECT_BASIC_AND_IO_ACCOUNTING_INFORMATION;
+
+typedef struct _JOBOBJECT_BASIC_LIMIT_INFORMATION {
+  LARGE_INTEGER PerProcessUserTimeLimit;
+  LARGE_INTEGER PerJobUserTimeLimit;
+  DWORD LimitFlags;
+  SIZE_T MinimumWorkingSetSize;
+  SIZE_T MaximumWorkingSetSize;
+  DWORD ActiveProcessLimit;
+  ULONG_PTR Affinity;
+  DWORD PriorityClass;
+  DWORD SchedulingClass;
+} JOBOBJECT_BASIC_LIMIT_INFORMATION;
+
+typedef struct _JOBOBJECT_EXTENDED_LIMIT_INFORMATION {
+  JOBOBJECT_BASIC_LIMIT_INFORMATION BasicLimitInformation;
+  IO_COUNTERS IoInfo;
+  SIZE_T ProcessMemoryLimit;
+  SIZE_T JobMemoryLimit;
+  SIZE_T PeakProcessMemoryUsed;
+  SIZE_T PeakJobMemoryUsed;
+} JOBOBJECT_EXTENDED_LIMIT_INFORMATION;
+
+typedef struct _JOBOBJECT_CPU_RATE_CONTROL_INFORMATION {
+  DWORD ControlFlags;
+  union {
+    DWORD CpuRate;
+    DWORD Weight;
+  };
+} JOBOBJECT_CPU_RATE_CONTROL_INFORMATION;
+
+typedef enum _JOBOBJECTINFOCLASS {
+  JobObjectBasicAndIoAccountingInformation = 8,
+  JobObjectExtendedLimitInformation = 9,
+  JobObjectCpuRateControlInformation = 15
+} JOBOBJECTINFOCLASS;
+
+#define JOB_OBJECT_LIMIT_ACTIVE_PROCESS 0x00000008
+#define JOB_OBJECT_LIMIT_JOB_MEMORY 0x00000200
+#define JOB_OBJECT_CPU_RATE_CONTROL_ENABLE 0x1
+#define JOB_OBJECT_CPU_RATE_CONTROL_HARD_CAP 0x4
+
+//===-- Synchronization and thread pool -----------------------------------===//
+
+typedef struct _RTL_SRWLOCK {
+  PVOID Ptr;
+} SRWLOCK, *PSRWLOCK;
+#define SRWLOCK_INIT {0}
+
+typedef struct _RTL_CONDITION_VARIABLE {
+  PVOID Ptr;
+} CONDITION_VARIABLE, *PCONDITION_VARIABLE;
+#define CONDITION_VARIABLE_INIT {0}
+
+typedef VOID(CALLBACK *WAITORTIMERCALLBACK)(PVOID, BOOLEAN);
+typedef struct _TP_CALLBACK_INSTANCE *PTP_CALLBACK_INSTANCE;
+typedef struct _TP_CALLBACK_ENVIRON *PTP_CALLBACK_ENVIRON;
+typedef struct _TP_WORK *PTP_WORK;
+typedef VOID(CALLBACK *PTP_SIMPLE_CALLBACK)(PTP_CALLBACK_INSTANCE, PVOID);
+typedef VOID(CALLBACK *PTP_WORK_CALLBACK)(PTP_CALLBACK_INSTANCE, PVOID,
+                                          PTP_WORK);
+
+#define WAIT_OBJECT_0 0x00000000
+#define WAIT_TIMEOUT 0x00000102
+#define WAIT_FAILED 0xFFFFFFFF
+#define WT_EXECUTEONLYONCE 0x00000008
+#define WT_EXECUTELONGFUNCTION 0x00000010
+
+//===-- Functions ---------------------------------------------------------===//
+
+#ifdef __cplusplus
+extern "C" {
+#endif // def __cplusplus
+
+DWORD GetLastError(void);
+VOID SetLastError(DWORD error);
+BOOL CloseHandle(HANDLE object);
+BOOL DuplicateHandle(HANDLE source_process, HANDLE source,
+                     HANDLE target_process, PHANDLE target, DWORD access,
+                     BOOL inherit, DWORD options);
+
+HANDLE GetCurrentProcess(void);
+HANDLE GetCurrentProcessToken(void);
+DWORD GetCurrentProcessId(void);
+BOOL GetTokenInformation(HANDLE token, TOKEN_INFORMATION_CLASS info_class,
+                         LPVOID info, DWORD info_size, LPDWORD ret_size);
+BOOL SetTokenInformation(HANDLE token, TOKEN_INFORMATION_CLASS info_class,
+                         LPVOID info, DWORD info_size);
+BOOL OpenProcessToken(HANDLE process, DWORD access, PHANDLE token);
+BOOL DuplicateTokenEx(HANDLE token, DWORD access,
+                      LPSECURITY_ATTRIBUTES attrs,
+                      SECURITY_IMPERSONATION_LEVEL level, TOKEN_TYPE type,
+                      PHANDLE new_token);
+DWORD GetLengthSid(PSID sid);
+BOOL InitializeAcl(PACL acl, DWORD acl_size, DWORD revision);
+BOOL AddAccessAllowedAce(PACL acl, DWORD revision, DWORD mask, PSID sid);
+BOOL AddMandatoryAce(PACL acl, DWORD revision, DWORD flags, DWORD policy,
+                     PSID sid);
+BOOL InitializeSecurityDescriptor(SECURITY_DESCRIPTOR *desc, DWORD revision);
+BOOL SetSecurityDescriptorDacl(SECURITY_DESCRIPTOR *desc, BOOL present,
+                               PACL dacl, BOOL defaulted);
+BOOL SetSecurityDescriptorSacl(SECURITY_DESCRIPTOR *desc, BOOL present,
+                               PACL sacl, BOOL defaulted);
+
+BOOL CreateProcessW(LPCWSTR app_name, LPWSTR command_line,
+                    LPSECURITY_ATTRIBUTES process_attrs,
+                    LPSECURITY_ATTRIBUTES thread_attrs, BOOL inherit_handles,
+                    DWORD flags, LPVOID env, LPCWSTR current_dir,
+                    LPSTARTUPINFOW startup_info,
+                    LPPROCESS_INFORMATION proc_info);
+BOOL CreateProcessAsUserW(HANDLE token, LPCWSTR app_name, LPWSTR command_line,
+                          LPSECURITY_ATTRIBUTES process_attrs,
+                          LPSECURITY_ATTRIBUTES thread_attrs,
+                          BOOL inherit_handles, DWORD flags, LPVOID env,
+                          LPCWSTR current_dir, LPSTARTUPINFOW startup_info,
+                          LPPROCESS_INFORMATION proc_info);
+HANDLE OpenProcess(DWORD access, BOOL inherit, DWORD pid);
+BOOL TerminateProcess(HANDLE process, unsigned exit_code);
+BOOL InitializeProcThreadAttributeList(LPPROC_THREAD_ATTRIBUTE_LIST list,
+                                       DWORD count, DWORD flags,
+                                       SIZE_T *size);
+BOOL UpdateProcThreadAttribute(LPPROC_THREAD_ATTRIBUTE_LIST list, DWORD flags,
+                               DWORD_PTR attr, PVOID value, SIZE_T size,
+                               PVOID prev_value, SIZE_T *ret_size);
+VOID DeleteProcThreadAttributeList(LPPROC_THREAD_ATTRIBUTE_LIST list);
+BOOL GetNumaNodeProcessorMaskEx(USHORT node, PGROUP_AFFINITY affinity);
+BOOL SetProcessAffinityMask(HANDLE process, DWORD_PTR mask);
+BOOL SetProcessInformation(HANDLE process,
+                           PROCESS_INFORMATION_CLASS info_class, LPVOID info,
+                           DWORD info_size);
+/// Native API, declared by the library itself for the real windows.h. Only
+///    `ProcessIoPriority` (33) class is supported.
+LONG NtSetInformationProcess(HANDLE process, ULONG info_class, PVOID info,
+                             ULONG info_size);
+ULONG RtlNtStatusToDosError(LONG status);
+
+HANDLE CreateRemoteThread(HANDLE process, LPSECURITY_ATTRIBUTES attrs,
+                          SIZE_T stack_size, LPTHREAD_START_ROUTINE start,
+                          LPVOID param, DWORD flags, LPDWORD tid);
+DWORD ResumeThread(HANDLE thread);
+DWORD SuspendThread(HANDLE thread);
+BOOL TerminateThread(HANDLE thread, DWORD exit_code);
+BOOL GetExitCodeThread(HANDLE thread, LPDWORD exit_code);
+DWORD GetThreadId(HANDLE thread);
+BOOL GetThreadContext(HANDLE thread, CONTEXT *context);
+BOOL SetThreadContext(HANDLE thread, const CONTEXT *context);
+DWORD QueueUserAPC(PAPCFUNC routine, HANDLE thread, ULONG_PTR param);
+
+LPVOID VirtualAllocEx(HANDLE process, LPVOID address, SIZE_T size, DWORD type,
+                      DWORD protect);
+BOOL VirtualFreeEx(HANDLE process, LPVOID address, SIZE_T size, DWORD type);
+BOOL VirtualProtectEx(HANDLE process, LPVOID address, SIZE_T size,
+                      DWORD protect, LPDWORD old_protect);
+BOOL WriteProcessMemory(HANDLE process, LPVOID address, LPCVOID buf,
+                        SIZE_T size, SIZE_T *written);
+BOOL ReadProcessMemory(HANDLE process, LPCVOID address, LPVOID buf,
+                       SIZE_T size, SIZE_T *read);
+
+HMODULE LoadLibraryW(LPCWSTR path);
+
+HANDLE CreateFileMappingW(HANDLE file, LPSECURITY_ATTRIBUTES attrs,
+                          DWORD protect, DWORD size_high, DWORD size_low,
+                          LPCWSTR name);
+HANDLE OpenFileMappingW(DWORD access, BOOL inherit, LPCWSTR name);
+LPVOID MapViewOfFile(HANDLE mapping, DWORD access, DWORD offset_high,
+                     DWORD offset_low, SIZE_T size);
+BOOL UnmapViewOfFile(LPCVOID address);
+BOOL PrefetchVirtualMemory(HANDLE process, ULONG_PTR num_entries,
+                           WIN32_MEMORY_RANGE_ENTRY *entries, ULONG flags);
+
+HANDLE CreateFileW(LPCWSTR path, DWORD access, DWORD share_mode,
+                   LPSECURITY_ATTRIBUTES attrs, DWORD disposition,
+                   DWORD flags, HANDLE template_file);
+BOOL GetFileSizeEx(HANDLE file, LARGE_INTEGER *size);
+BOOL GetFileAttributesExW(LPCWSTR path, GET_FILEEX_INFO_LEVELS level,
+                          LPVOID info);
+int MultiByteToWideChar(unsigned code_page, DWORD flags, LPCSTR str,
+                        int str_len, LPWSTR buf, int buf_len);
+
+HANDLE CreateJobObjectW(LPSECURITY_ATTRIBUTES attrs, LPCWSTR name);
+BOOL SetInformationJobObject(HANDLE job, JOBOBJECTINFOCLASS info_class,
+                             LPVOID info, DWORD info_size);
+BOOL QueryInformationJobObject(HANDLE job, JOBOBJECTINFOCLASS info_class,
+                               LPVOID info, DWORD info_size,
+                               LPDWORD ret_size);
+BOOL AssignProcessToJobObject(HANDLE job, HANDLE process);
+
+HANDLE CreateEventW(LPSECURITY_ATTRIBUTES attrs, BOOL manual_reset,
+                    BOOL initial_state, LPCWSTR name);
+BOOL SetEvent(HANDLE event);
+DWORD WaitForSingleObject(HANDLE handle, DWORD timeout);
+DWORD WaitForMultipleObjects(DWORD count, const HANDLE *handles,
+                             BOOL wait_all, DWORD timeout);
+BOOL SwitchToThread(void);
+ULONGLONG GetTickCount64(void);
+BOOL QueryPerformanceCounter(LARGE_INTEGER *counter);
+BOOL QueryPerformanceFrequency(LARGE_INTEGER *frequency);
+
+VOID AcquireSRWLockExclusive(PSRWLOCK lock);
+VOID ReleaseSRWLockExclusive(PSRWLOCK lock);
+VOID AcquireSRWLockShared(PSRWLOCK lock);
+VOID ReleaseSRWLockShared(PSRWLOCK lock);
+BOOL SleepConditionVariableSRW(PCONDITION_VARIABLE cv, PSRWLOCK lock,
+                               DWORD timeout, ULONG flags);
+VOID WakeAllConditionVariable(PCONDITION_VARIABLE cv);
+
+BOOL RegisterWaitForSingleObject(PHANDLE wait, HANDLE object,
+                                 WAITORTIMERCALLBACK callback, PVOID context,
+                                 ULONG timeout, ULONG flags);
+BOOL UnregisterWaitEx(HANDLE wait, HANDLE completion_event);
+BOOL TrySubmitThreadpoolCallback(PTP_SIMPLE_CALLBACK callback, PVOID context,
+                                 PTP_CALLBACK_ENVIRON environ);
+PTP_WORK CreateThreadpoolWork(PTP_WORK_CALLBACK callback, PVOID context,
+                              PTP_CALLBACK_ENVIRON environ);
+VOID SubmitThreadpoolWork(PTP_WORK work);
+VOID WaitForThreadpoolWorkCallbacks(PTP_WORK work, BOOL cancel_pending);
+VOID CloseThreadpoolWork(PTP_WORK work);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif // def __cplusplus
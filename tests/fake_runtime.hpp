@@ -0,0 +1,164 @@
+//===-- fake_runtime.hpp - TEK Game Runtime emulation for tests -----------===//
+//
+// Copyright (c) 2025 Nuclearist <nuclearist@teknology-hub.com>
+// Part of tek-injector, under the GNU General Public License v3.0 or later
+// See https://github.com/teknology-hub/tek-injector/blob/main/COPYING for
+//    license information.
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+//===----------------------------------------------------------------------===//
+///
+/// @file
+///  Implementation of the part of TEK Game Runtime that talks to the
+///    injector: finding the input file mapping by either its per-process or
+///    legacy name, reading the payload, and
+///    reporting initialization status. It's called from a load hook of the
+///    fake OS layer, so it runs as game process.
+///
+//===----------------------------------------------------------------------===//
+#pragma once
+
+#include "fake_os.hpp"
+#include "payload.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <windows.h>
+
+namespace fake_runtime {
+
+/// How the runtime reports its initialization status.
+enum class mode {
+  /// Report every state up to ready.
+  ready,
+  /// Report a failure.
+  fail,
+  /// Don't report anything.
+  silent
+};
+
+/// Payload as seen by the runtime.
+struct payload {
+  /// Value indicating whether the payload has been read successfully.
+  bool valid;
+  /// Settings loading type.
+  std::int32_t type;
+  /// Settings data.
+  std::string data;
+  /// Value indicating whether the data came from a shared file mapping.
+  bool shared;
+  /// Value indicating whether the runtime could get write access to the
+  ///    shared file mapping by duplicating its handle.
+  bool shared_writable;
+  /// Value indicating whether the payload has a status block.
+  bool status;
+};
+
+/// Message reported by the runtime in @ref mode::fail.
+inline constexpr std::u16string_view fail_message{u"Hook installation failed"};
+/// Error code reported by the runtime in @ref mode::fail.
+inline constexpr DWORD fail_error{ERROR_PROC_NOT_FOUND};
+
+/// Initialize the runtime in the calling game process.
+///
+/// @param pid
+///    ID of the game process.
+/// @param report
+///    How to report the status, if the payload has a status block.
+/// @return The payload that has been read.
+inline payload init(DWORD pid, mode report = mode::ready) {
+  payload res{};
+  std::wstring name{TEK_INJ_MAPPING_NAME_PREFIX};
+  name += std::to_wstring(pid);
+  auto mapping{OpenFileMappingW(FILE_MAP_WRITE, FALSE, name.data())};
+  if (!mapping) {
+    // Runtime versions that don't know per-process names look for this one
+    mapping = OpenFileMappingW(FILE_MAP_WRITE, FALSE,
+                               TEK_INJ_LEGACY_MAPPING_NAME);
+    if (!mapping) {
+      return res;
+    }
+  }
+  const auto view{MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, 0)};
+  if (!view) {
+    CloseHandle(mapping);
+    return res;
+  }
+  using namespace tek_inj::payload;
+  const auto &v2{*static_cast<const data_header_v2 *>(view)};
+  std::uint64_t size;
+  const char *data;
+  tek_inj::payload::status_block *status{};
+  HANDLE shared_mapping{};
+  const void *shared_view{};
+  if (v2.magic == data_header_magic) {
+    res.type = v2.type;
+    size = v2.size;
+    if (v2.flags & flag_status) {
+      status = get_status(view);
+      res.status = true;
+    }
+    if (v2.flags & flag_shared) {
+      res.shared = true;
+      shared_mapping = reinterpret_cast<HANDLE>(
+          static_cast<std::uintptr_t>(get_shared(view)->mapping));
+      shared_view = MapViewOfFile(shared_mapping, FILE_MAP_READ, 0, 0, 0);
+      if (HANDLE writable; DuplicateHandle(
+              GetCurrentProcess(), shared_mapping, GetCurrentProcess(),
+              &writable, FILE_MAP_WRITE, FALSE, 0)) {
+        res.shared_writable = true;
+        CloseHandle(writable);
+      }
+      data = static_cast<const char *>(shared_view);
+      if (data &&
+          get_shared(view)->hash != hash(std::string_view{data, size})) {
+        data = nullptr;
+      }
+    } else {
+      data = static_cast<const char *>(view) + header_size(size, v2.flags);
+    }
+  } else {
+    const auto &v1{*static_cast<const data_header *>(view)};
+    res.type = v1.type;
+    size = v1.size;
+    data = reinterpret_cast<const char *>(&v1 + 1);
+  }
+  if (data) {
+    res.data.assign(data, size);
+    res.valid = true;
+  }
+  if (shared_view) {
+    UnmapViewOfFile(shared_view);
+  }
+  if (status && report != mode::silent) {
+    const auto event{
+        reinterpret_cast<HANDLE>(static_cast<std::uintptr_t>(status->event))};
+    const std::atomic_ref state_ref{status->state};
+    const auto set_state{[&](state new_state) {
+      LARGE_INTEGER time;
+      QueryPerformanceCounter(&time);
+      status->times[static_cast<int>(new_state)] = time.QuadPart;
+      state_ref.store(static_cast<std::uint32_t>(new_state),
+                      std::memory_order::release);
+      SetEvent(event);
+    }};
+    set_state(state::loaded);
+    set_state(state::settings_parsed);
+    if (report == mode::fail || !res.valid) {
+      status->error = fail_error;
+      fail_message.copy(status->message, fail_message.size());
+      set_state(state::failed);
+    } else {
+      set_state(state::hooks_installed);
+      set_state(state::ready);
+    }
+  }
+  UnmapViewOfFile(view);
+  // The runtime keeps the mapping handle, but it's owned by game process, so
+  //    it's not a leak of the injector
+  return res;
+}
+
+} // namespace fake_runtime
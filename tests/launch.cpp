@@ -0,0 +1,946 @@
+//===-- launch.cpp - Launch tests against the fake OS layer ---------------===//
+//
+// Copyright (c) 2025 Nuclearist <nuclearist@teknology-hub.com>
+// Part of tek-injector, under the GNU General Public License v3.0 or later
+// See https://github.com/teknology-hub/tek-injector/blob/main/COPYING for
+//    license information.
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+//===----------------------------------------------------------------------===//
+///
+/// @file
+///  Tests of every public API function, covering every @ref tek_inj_res
+///    value. Each failure is injected into the fake OS layer at the call
+///    that produces it, and every test checks that game process is
+///    terminated when the launch fails and that the library leaves no
+///    handles, views or thread pool objects behind.
+///
+//===----------------------------------------------------------------------===//
+#include "tek-injector.h"
+
+#include "fake_os.hpp"
+#include "fake_runtime.hpp"
+#include "pe_image.hpp"
+#include "test.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <new>
+#include <mutex>
+#include <set>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace {
+
+/// Value indicating whether heap allocations made by the calling thread
+///    outside of the fake OS layer are counted.
+thread_local bool count_allocs;
+/// Number of heap allocations counted on the calling thread.
+thread_local std::size_t num_allocs;
+
+} // namespace
+
+void *operator new(std::size_t size) {
+  if (count_allocs && !fake_os::in_os()) {
+    ++num_allocs;
+  }
+  if (const auto ptr{std::malloc(size ? size : 1)}) {
+    return ptr;
+  }
+  throw std::bad_alloc{};
+}
+
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+
+void operator delete(void *ptr, std::size_t) noexcept { std::free(ptr); }
+
+namespace {
+
+constexpr auto exe_path{L"C:\\game\\game.exe"};
+constexpr auto dll_path{L"C:\\game\\libtek-game-runtime.dll"};
+constexpr auto extra_dll_path{L"C:\\game\\extra.dll"};
+constexpr std::string_view settings{R"({"steam":{"app_id":346110}})"};
+constexpr std::array<LPCWSTR, 1> extra_dlls{extra_dll_path};
+
+/// Mode of the runtime emulated for DLLs loaded from @ref dll_path.
+std::atomic<fake_runtime::mode> runtime_mode;
+/// Path of the DLL that fails to load, if any.
+std::atomic<LPCWSTR> failing_dll;
+/// Value indicating whether loading the runtime DLL blocks until game process
+///    is terminated.
+std::atomic_bool hang;
+/// Lock protecting @ref last_payload.
+std::mutex payload_mtx;
+/// Payload read by the last runtime initialization.
+fake_runtime::payload last_payload;
+/// Settings data read by runtime initializations, keyed on game process ID.
+std::map<DWORD, std::string> payloads;
+/// Result codes produced by the tests so far.
+std::set<tek_inj_res> covered;
+
+/// Load hook emulating TEK Game Runtime.
+bool load_hook(DWORD pid, std::wstring_view path) {
+  if (const auto failing{failing_dll.load()}; failing && path == failing) {
+    return false;
+  }
+  if (path == dll_path) {
+    if (hang) {
+      fake_os::wait_until_terminated();
+      return false;
+    }
+    auto payload{fake_runtime::init(pid, runtime_mode)};
+    const std::lock_guard lock{payload_mtx};
+    if (payload.valid) {
+      payloads.insert_or_assign(pid, payload.data);
+    }
+    last_payload = std::move(payload);
+  }
+  return true;
+}
+
+void setup() {
+  fake_os::reset();
+  fake_os::add_file(exe_path, pe_image::build({}));
+  fake_os::add_file(dll_path, pe_image::dll({"tek_gr_init", "tek_gr_ver"}));
+  fake_os::add_file(extra_dll_path, pe_image::dll());
+  runtime_mode = fake_runtime::mode::ready;
+  failing_dll = nullptr;
+  hang = false;
+  last_payload = {};
+  payloads.clear();
+  fake_os::set_load_hook(load_hook);
+}
+
+tek_inj_game_args make_args() {
+  tek_inj_game_args args{};
+  args.exe_path = exe_path;
+  args.dll_path = dll_path;
+  args.type = TEK_GR_LOAD_TYPE_data;
+  args.data = settings.data();
+  args.data_size = settings.size();
+  args.inject_timeout = 2000;
+  return args;
+}
+
+/// Layout of @ref tek_inj_game_args in version 2, which the beginning of the
+///    current one must keep.
+struct game_args_v2 {
+  LPCWSTR exe_path;
+  LPCWSTR current_dir;
+  LPCWSTR dll_path;
+  tek_gr_load_type type;
+  int argc;
+  const LPCWSTR *argv;
+  tek_inj_flag flags;
+  std::uint32_t data_size;
+  const char *data;
+  tek_inj_res result;
+  DWORD win32_error;
+};
+static_assert(offsetof(tek_inj_game_args, dll_path) ==
+              offsetof(game_args_v2, dll_path));
+static_assert(offsetof(tek_inj_game_args, argv) ==
+              offsetof(game_args_v2, argv));
+static_assert(offsetof(tek_inj_game_args, flags) ==
+              offsetof(game_args_v2, flags));
+static_assert(offsetof(tek_inj_game_args, data) ==
+              offsetof(game_args_v2, data));
+static_assert(offsetof(tek_inj_game_args, result) ==
+              offsetof(game_args_v2, result));
+static_assert(offsetof(tek_inj_game_args, win32_error) ==
+              offsetof(game_args_v2, win32_error));
+
+/// Check that no resources of the calling process have leaked, and print the
+///    ones that have.
+void check_leaks() {
+  const auto leaks{fake_os::leaks()};
+  for (const auto &leak : leaks) {
+    std::fprintf(stderr, "  leaked %s\n", leak.c_str());
+  }
+  CHECK(leaks.empty());
+}
+
+/// Wait until game's main thread reaches the entry point.
+bool wait_entry(DWORD pid) {
+  const auto deadline{std::chrono::steady_clock::now() +
+                      std::chrono::seconds{5}};
+  while (!fake_os::process(pid).entry_reached) {
+    if (std::chrono::steady_clock::now() > deadline) {
+      return false;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds{1});
+  }
+  return true;
+}
+
+/// Check a successful launch.
+void expect_success(const tek_inj_game_args &args) {
+  CHECK(args.result == TEK_INJ_RES_ok);
+  CHECK(args.pid != 0);
+  CHECK(wait_entry(args.pid));
+  const auto proc{fake_os::process(args.pid)};
+  CHECK(!proc.terminated);
+  CHECK(!proc.loaded.empty() && proc.loaded[0] == dll_path);
+  CHECK(proc.remote_allocs == 0);
+  const std::lock_guard lock{payload_mtx};
+  CHECK(last_payload.valid);
+  CHECK(last_payload.type == TEK_GR_LOAD_TYPE_data);
+  CHECK(last_payload.data == settings);
+  covered.emplace(TEK_INJ_RES_ok);
+}
+
+/// Check a failed launch.
+///
+/// @param args
+///    Arguments of the launch.
+/// @param result
+///    Expected result code.
+/// @param win32_error
+///    Expected Win32 error code.
+void expect_failure(const tek_inj_game_args &args, tek_inj_res result,
+                    DWORD win32_error) {
+  CHECK(args.result == result);
+  CHECK(args.win32_error == win32_error);
+  if (args.pid) {
+    const auto proc{fake_os::process(args.pid)};
+    CHECK(proc.terminated);
+    CHECK(!proc.entry_reached);
+  }
+  CHECK(fake_os::running_processes() == 0);
+  check_leaks();
+  covered.emplace(result);
+}
+
+/// Run a launch expected to fail.
+void run_failure(tek_inj_game_args &args, tek_inj_res result,
+                 DWORD win32_error) {
+  tek_inj_run_game(&args);
+  expect_failure(args, result, win32_error);
+}
+
+//===-- Successful launches -----------------------------------------------===//
+
+TEST_CASE(run_game) {
+  const std::array<LPCWSTR, 2> argv{L"-windowed", L"a b"};
+  auto args{make_args()};
+  args.argc = argv.size();
+  args.argv = argv.data();
+  args.current_dir = L"C:\\game";
+  tek_inj_run_game(&args);
+  expect_success(args);
+  const auto proc{fake_os::process(args.pid)};
+  CHECK(proc.command_line == L"C:\\game\\game.exe -windowed \"a b\"");
+  CHECK(proc.current_dir == L"C:\\game");
+  CHECK(proc.remote_threads == 1);
+  CHECK(!proc.elevated);
+  check_leaks();
+}
+
+TEST_CASE(run_game_extra_dlls) {
+  auto args{make_args()};
+  args.extra_dll_paths = extra_dlls.data();
+  args.num_extra_dlls = extra_dlls.size();
+  tek_inj_run_game(&args);
+  expect_success(args);
+  const auto proc{fake_os::process(args.pid)};
+  CHECK(proc.loaded.size() == 2 && proc.loaded[1] == extra_dll_path);
+  check_leaks();
+}
+
+TEST_CASE(run_game_strategies) {
+  for (const auto strategy :
+       {TEK_INJ_STRATEGY_apc, TEK_INJ_STRATEGY_entry_trampoline}) {
+    auto args{make_args()};
+    args.strategy = strategy;
+    args.extra_dll_paths = extra_dlls.data();
+    args.num_extra_dlls = extra_dlls.size();
+    tek_inj_run_game(&args);
+    CHECK(args.result == TEK_INJ_RES_ok);
+    CHECK(wait_entry(args.pid));
+    const auto proc{fake_os::process(args.pid)};
+    CHECK(!proc.crashed);
+    CHECK(proc.loaded.size() == 2);
+    CHECK(proc.remote_threads == 0);
+    CHECK(proc.apcs == (strategy == TEK_INJ_STRATEGY_apc ? 1u : 0u));
+    // The loader stub block is freed after the main thread leaves it
+    CHECK(proc.remote_allocs == 0);
+    check_leaks();
+  }
+}
+
+TEST_CASE(run_game_arena) {
+  // With a caller-supplied arena, the library itself makes no heap
+  //    allocations, whichever strategy and options are used
+  for (const auto strategy :
+       {TEK_INJ_STRATEGY_remote_thread, TEK_INJ_STRATEGY_apc,
+        TEK_INJ_STRATEGY_entry_trampoline}) {
+    auto args{make_args()};
+    args.strategy = strategy;
+    args.flags = TEK_INJ_FLAG_wait_ready;
+    args.extra_dll_paths = extra_dlls.data();
+    args.num_extra_dlls = extra_dlls.size();
+    char probe;
+    args.arena = &probe;
+    args.arena_size = 0;
+    tek_inj_run_game(&args);
+    CHECK(args.result == TEK_INJ_RES_arena_size);
+    std::vector<char> arena(args.arena_size);
+    args.arena = arena.data();
+    num_allocs = 0;
+    count_allocs = true;
+    tek_inj_run_game(&args);
+    count_allocs = false;
+    CHECK(num_allocs == 0);
+    expect_success(args);
+    check_leaks();
+  }
+}
+
+TEST_CASE(run_game_wait_ready) {
+  auto args{make_args()};
+  args.flags = TEK_INJ_FLAG_wait_ready;
+  tek_inj_timings timings;
+  args.timings = &timings;
+  tek_inj_run_game(&args);
+  expect_success(args);
+  CHECK(last_payload.status);
+  CHECK(timings.end[TEK_INJ_PHASE_runtime_init] >=
+        timings.start[TEK_INJ_PHASE_runtime_init]);
+  check_leaks();
+}
+
+TEST_CASE(run_game_shared_payload) {
+  tek_inj_res res;
+  DWORD error;
+  const auto ctx{tek_inj_ctx_create(&res, &error)};
+  CHECK(ctx);
+  for (int i{}; i < 2; ++i) {
+    auto args{make_args()};
+    args.ctx = ctx;
+    args.flags = TEK_INJ_FLAG_shared_payload;
+    tek_inj_run_game(&args);
+    expect_success(args);
+    CHECK(last_payload.shared);
+    CHECK(!last_payload.shared_writable);
+  }
+  tek_inj_ctx_destroy(ctx);
+  auto args{make_args()};
+  args.flags = TEK_INJ_FLAG_shared_payload;
+  tek_inj_run_game(&args);
+  expect_success(args);
+  CHECK(last_payload.shared);
+  CHECK(!last_payload.shared_writable);
+  check_leaks();
+}
+
+TEST_CASE(run_game_elevated) {
+  fake_os::set_elevated(true);
+  auto args{make_args()};
+  args.flags = TEK_INJ_FLAG_wait_ready;
+  tek_inj_run_game(&args);
+  expect_success(args);
+  // The runtime could open the restricted mapping without elevation
+  CHECK(!fake_os::process(args.pid).elevated);
+  auto admin_args{make_args()};
+  admin_args.flags = TEK_INJ_FLAG_run_as_admin;
+  tek_inj_run_game(&admin_args);
+  expect_success(admin_args);
+  CHECK(fake_os::process(admin_args.pid).elevated);
+  check_leaks();
+}
+
+TEST_CASE(run_game_placement_and_job) {
+  auto args{make_args()};
+  args.flags =
+      static_cast<tek_inj_flag>(TEK_INJ_FLAG_numa_node |
+                                TEK_INJ_FLAG_keep_process |
+                                TEK_INJ_FLAG_check_images);
+  args.numa_node = 1;
+  args.memory_priority = MEMORY_PRIORITY_LOW;
+  args.io_priority = TEK_INJ_IO_PRIORITY_very_low;
+  const tek_inj_job_limits limits{
+      .memory_limit = 1 << 30, .cpu_rate = 5000, .max_processes = 4};
+  args.job_limits = &limits;
+  tek_inj_run_game(&args);
+  expect_success(args);
+  const auto proc{fake_os::process(args.pid)};
+  CHECK(proc.affinity == 0xF0);
+  CHECK(proc.numa_node == 1);
+  CHECK(proc.memory_priority == MEMORY_PRIORITY_LOW);
+  CHECK(proc.io_priority == 0);
+  CHECK(proc.in_job);
+  CHECK(proc.job_memory_limit == limits.memory_limit);
+  CHECK(proc.job_cpu_rate == limits.cpu_rate);
+  CHECK(proc.job_max_processes == limits.max_processes);
+  tek_inj_job_stats stats;
+  CHECK(tek_inj_job_query(args.job, &stats));
+  CHECK(stats.active_processes == 1);
+  CHECK(args.process);
+  CloseHandle(args.process);
+  CloseHandle(args.job);
+  check_leaks();
+}
+
+TEST_CASE(begin_commit_abort) {
+  auto args{make_args()};
+  void *data;
+  auto launch{tek_inj_game_begin(&args, settings.size(), &data)};
+  CHECK(launch);
+  settings.copy(static_cast<char *>(data), settings.size());
+  tek_inj_game_commit(launch);
+  expect_success(args);
+  auto abort_args{make_args()};
+  launch = tek_inj_game_begin(&abort_args, settings.size(), &data);
+  CHECK(launch);
+  const auto pid{abort_args.pid};
+  tek_inj_game_abort(launch);
+  CHECK(fake_os::process(pid).terminated);
+  check_leaks();
+}
+
+TEST_CASE(run_game_async) {
+  auto args{make_args()};
+  args.flags = TEK_INJ_FLAG_wait_ready;
+  std::atomic_int calls{};
+  const auto launch{tek_inj_run_game_async(
+      &args,
+      [](tek_inj_launch *, void *user_data) {
+        ++*static_cast<std::atomic_int *>(user_data);
+      },
+      &calls)};
+  CHECK(launch);
+  CHECK(WaitForSingleObject(tek_inj_launch_event(launch), 5000) ==
+        WAIT_OBJECT_0);
+  CHECK(tek_inj_launch_done(launch));
+  CHECK(calls == 1);
+  expect_success(args);
+  tek_inj_launch_free(launch);
+  check_leaks();
+}
+
+TEST_CASE(pool) {
+  auto game_args{make_args()};
+  for (const auto refill :
+       {TEK_INJ_POOL_REFILL_none, TEK_INJ_POOL_REFILL_on_claim,
+        TEK_INJ_POOL_REFILL_background}) {
+    tek_inj_pool_args pool_args{.game_args = &game_args,
+                                .size = 2,
+                                .refill = refill,
+                                .result = {},
+                                .win32_error = 0};
+    const auto pool{tek_inj_pool_create(&pool_args)};
+    CHECK(pool);
+    CHECK(pool_args.result == TEK_INJ_RES_ok);
+    CHECK(tek_inj_pool_available(pool) == 2);
+    for (int i{}; i < 3; ++i) {
+      auto args{make_args()};
+      tek_inj_pool_claim(pool, &args);
+      expect_success(args);
+    }
+    tek_inj_pool_destroy(pool);
+    check_leaks();
+  }
+}
+
+TEST_CASE(attach) {
+  const auto pid{fake_os::spawn()};
+  tek_inj_attach_args args{};
+  args.pid = pid;
+  args.dll_path = dll_path;
+  args.extra_dll_paths = extra_dlls.data();
+  args.num_extra_dlls = extra_dlls.size();
+  args.type = TEK_GR_LOAD_TYPE_data;
+  args.data = settings.data();
+  args.data_size = settings.size();
+  tek_inj_attach(&args);
+  CHECK(args.result == TEK_INJ_RES_ok);
+  CHECK(fake_os::process(pid).loaded.size() == 2);
+  CHECK(last_payload.data == settings);
+  check_leaks();
+}
+
+TEST_CASE(attach_timeout) {
+  hang = true;
+  const auto pid{fake_os::spawn()};
+  tek_inj_attach_args args{};
+  args.pid = pid;
+  args.dll_path = dll_path;
+  args.type = TEK_GR_LOAD_TYPE_data;
+  args.data = settings.data();
+  args.data_size = settings.size();
+  args.inject_timeout = 50;
+  tek_inj_attach(&args);
+  CHECK(args.result == TEK_INJ_RES_thread_wait);
+  CHECK(args.win32_error == ERROR_TIMEOUT);
+  // The injection thread may hold the loader lock of a process that keeps
+  //    running, so it's neither terminated nor deprived of its block
+  const auto proc{fake_os::process(pid)};
+  CHECK(!proc.terminated);
+  CHECK(proc.terminated_threads == 0);
+  CHECK(proc.remote_allocs == 1);
+  check_leaks();
+}
+
+//===-- Concurrent launches -----------------------------------------------===//
+
+/// Run launches with distinct settings from several threads at once, and
+///    check that every game process has received its own settings.
+///
+/// @param flags
+///    Injection flags for the launches.
+void run_parallel(tek_inj_flag flags) {
+  constexpr int num_threads{8};
+  constexpr int launches_per_thread{16};
+  struct launch_result {
+    tek_inj_res result;
+    DWORD pid;
+    std::string settings;
+  };
+  std::vector<launch_result> results(num_threads * launches_per_thread);
+  std::vector<std::thread> threads;
+  threads.reserve(num_threads);
+  for (int i{}; i < num_threads; ++i) {
+    threads.emplace_back([flags, &results, i] {
+      for (int j{}; j < launches_per_thread; ++j) {
+        auto &res{results[i * launches_per_thread + j]};
+        res.settings = R"({"steam":{"app_id":)" +
+                       std::to_string(i * launches_per_thread + j) + "}}";
+        auto args{make_args()};
+        args.flags = flags;
+        args.data = res.settings.data();
+        args.data_size = res.settings.size();
+        tek_inj_run_game(&args);
+        res.result = args.result;
+        res.pid = args.pid;
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  std::set<DWORD> pids;
+  for (const auto &res : results) {
+    CHECK(res.result == TEK_INJ_RES_ok);
+    CHECK(pids.emplace(res.pid).second);
+    const std::lock_guard lock{payload_mtx};
+    const auto it{payloads.find(res.pid)};
+    CHECK(it != payloads.end() && it->second == res.settings);
+  }
+  check_leaks();
+}
+
+TEST_CASE(parallel) { run_parallel(TEK_INJ_FLAG_wait_ready); }
+
+TEST_CASE(parallel_legacy_mapping_name) {
+  run_parallel(TEK_INJ_FLAG_legacy_mapping_name);
+}
+
+TEST_CASE(legacy_mapping_name) {
+  // The mapping is kept open by the runtime of the first game, and reused by
+  //    the next launch
+  for (int i{}; i < 2; ++i) {
+    auto args{make_args()};
+    args.flags = TEK_INJ_FLAG_legacy_mapping_name;
+    tek_inj_run_game(&args);
+    expect_success(args);
+  }
+  check_leaks();
+  // A mapping too small for the payload is rejected
+  setup();
+  const auto stale{CreateFileMappingW(INVALID_HANDLE_VALUE, nullptr,
+                                      PAGE_READWRITE, 0, 4,
+                                      TEK_INJ_LEGACY_MAPPING_NAME)};
+  CHECK(stale);
+  auto args{make_args()};
+  args.flags = TEK_INJ_FLAG_legacy_mapping_name;
+  tek_inj_run_game(&args);
+  CloseHandle(stale);
+  CHECK(args.result == TEK_INJ_RES_map_view);
+  CHECK(fake_os::running_processes() == 0);
+  check_leaks();
+}
+
+//===-- Error paths -------------------------------------------------------===//
+
+TEST_CASE(err_get_token_info) {
+  fake_os::fail_call("GetTokenInformation", ERROR_ACCESS_DENIED);
+  auto args{make_args()};
+  run_failure(args, TEK_INJ_RES_get_token_info, ERROR_ACCESS_DENIED);
+  CHECK(args.pid == 0);
+  // With a context, the failure is reported by its creation
+  fake_os::fail_call("GetTokenInformation", ERROR_ACCESS_DENIED);
+  tek_inj_res res;
+  DWORD error;
+  CHECK(!tek_inj_ctx_create(&res, &error));
+  CHECK(res == TEK_INJ_RES_get_token_info && error == ERROR_ACCESS_DENIED);
+  check_leaks();
+}
+
+TEST_CASE(err_token) {
+  fake_os::set_elevated(true);
+  const std::array<std::pair<const char *, tek_inj_res>, 3> calls{
+      {{"OpenProcessToken", TEK_INJ_RES_open_token},
+       {"DuplicateTokenEx", TEK_INJ_RES_duplicate_token},
+       {"SetTokenInformation", TEK_INJ_RES_set_token_info}}};
+  for (const auto &[name, result] : calls) {
+    fake_os::fail_call(name, ERROR_ACCESS_DENIED);
+    auto args{make_args()};
+    run_failure(args, result, ERROR_ACCESS_DENIED);
+    CHECK(args.pid == 0);
+  }
+}
+
+TEST_CASE(err_create_process) {
+  fake_os::fail_call("CreateProcessW", ERROR_ACCESS_DENIED);
+  auto args{make_args()};
+  run_failure(args, TEK_INJ_RES_create_process, ERROR_ACCESS_DENIED);
+  args = make_args();
+  args.exe_path = L"C:\\game\\missing.exe";
+  run_failure(args, TEK_INJ_RES_create_process, ERROR_FILE_NOT_FOUND);
+  fake_os::set_elevated(true);
+  fake_os::fail_call("CreateProcessAsUserW", ERROR_ACCESS_DENIED);
+  args = make_args();
+  run_failure(args, TEK_INJ_RES_create_process, ERROR_ACCESS_DENIED);
+}
+
+TEST_CASE(err_mem_alloc) {
+  fake_os::fail_call("VirtualAllocEx", ERROR_NOT_ENOUGH_MEMORY);
+  auto args{make_args()};
+  run_failure(args, TEK_INJ_RES_mem_alloc, ERROR_NOT_ENOUGH_MEMORY);
+}
+
+TEST_CASE(err_mem_write) {
+  fake_os::fail_call("WriteProcessMemory", ERROR_NOACCESS);
+  auto args{make_args()};
+  run_failure(args, TEK_INJ_RES_mem_write, ERROR_NOACCESS);
+}
+
+TEST_CASE(err_sec_desc) {
+  fake_os::set_elevated(true);
+  for (const auto name :
+       {"InitializeAcl", "AddAccessAllowedAce", "AddMandatoryAce",
+        "InitializeSecurityDescriptor", "SetSecurityDescriptorDacl",
+        "SetSecurityDescriptorSacl"}) {
+    fake_os::fail_call(name, ERROR_INVALID_PARAMETER);
+    auto args{make_args()};
+    run_failure(args, TEK_INJ_RES_sec_desc, ERROR_INVALID_PARAMETER);
+  }
+}
+
+TEST_CASE(err_create_mapping) {
+  fake_os::fail_call("CreateFileMappingW", ERROR_NOT_ENOUGH_MEMORY);
+  auto args{make_args()};
+  run_failure(args, TEK_INJ_RES_create_mapping, ERROR_NOT_ENOUGH_MEMORY);
+  // A stale mapping with the name of the next game process
+  const auto name{TEK_INJ_MAPPING_NAME_PREFIX +
+                  std::to_wstring(fake_os::next_pid())};
+  const auto stale{CreateFileMappingW(INVALID_HANDLE_VALUE, nullptr,
+                                      PAGE_READWRITE, 0, 64, name.data())};
+  CHECK(stale);
+  args = make_args();
+  tek_inj_run_game(&args);
+  CloseHandle(stale);
+  expect_failure(args, TEK_INJ_RES_create_mapping, ERROR_ALREADY_EXISTS);
+}
+
+TEST_CASE(err_map_view) {
+  fake_os::fail_call("MapViewOfFile", ERROR_NOT_ENOUGH_MEMORY);
+  auto args{make_args()};
+  run_failure(args, TEK_INJ_RES_map_view, ERROR_NOT_ENOUGH_MEMORY);
+}
+
+TEST_CASE(err_create_thread) {
+  fake_os::fail_call("CreateRemoteThread", ERROR_ACCESS_DENIED);
+  auto args{make_args()};
+  run_failure(args, TEK_INJ_RES_create_thread, ERROR_ACCESS_DENIED);
+}
+
+TEST_CASE(err_thread_wait) {
+  hang = true;
+  auto args{make_args()};
+  args.inject_timeout = 50;
+  run_failure(args, TEK_INJ_RES_thread_wait, ERROR_TIMEOUT);
+  // The injection thread is stopped, game's main thread isn't
+  CHECK(fake_os::process(args.pid).terminated_threads == 1);
+  args = make_args();
+  args.strategy = TEK_INJ_STRATEGY_apc;
+  args.inject_timeout = 50;
+  run_failure(args, TEK_INJ_RES_thread_wait, ERROR_TIMEOUT);
+  CHECK(fake_os::process(args.pid).terminated_threads == 0);
+}
+
+TEST_CASE(err_dll_load) {
+  failing_dll = extra_dll_path;
+  auto args{make_args()};
+  args.extra_dll_paths = extra_dlls.data();
+  args.num_extra_dlls = extra_dlls.size();
+  run_failure(args, TEK_INJ_RES_dll_load, 0);
+  CHECK(args.failed_dll == 1);
+  failing_dll = dll_path;
+  args = make_args();
+  run_failure(args, TEK_INJ_RES_dll_load, 0);
+  CHECK(args.failed_dll == 0);
+}
+
+TEST_CASE(err_resume_thread) {
+  fake_os::fail_call("ResumeThread", ERROR_ACCESS_DENIED);
+  auto args{make_args()};
+  run_failure(args, TEK_INJ_RES_resume_thread, ERROR_ACCESS_DENIED);
+}
+
+TEST_CASE(err_open_process) {
+  tek_inj_attach_args args{};
+  args.pid = 4;
+  args.dll_path = dll_path;
+  tek_inj_attach(&args);
+  CHECK(args.result == TEK_INJ_RES_open_process);
+  CHECK(args.win32_error == ERROR_INVALID_PARAMETER);
+  check_leaks();
+  covered.emplace(TEK_INJ_RES_open_process);
+}
+
+TEST_CASE(err_mem_protect) {
+  fake_os::fail_call("VirtualProtectEx", ERROR_ACCESS_DENIED);
+  auto args{make_args()};
+  args.extra_dll_paths = extra_dlls.data();
+  args.num_extra_dlls = extra_dlls.size();
+  run_failure(args, TEK_INJ_RES_mem_protect, ERROR_ACCESS_DENIED);
+}
+
+TEST_CASE(err_arena_size) {
+  auto args{make_args()};
+  args.extra_dll_paths = extra_dlls.data();
+  args.num_extra_dlls = extra_dlls.size();
+  char probe;
+  args.arena = &probe;
+  args.arena_size = 0;
+  run_failure(args, TEK_INJ_RES_arena_size, 0);
+  CHECK(args.pid == 0);
+  CHECK(args.arena_size > 0);
+  // The reported size is sufficient
+  std::vector<char> arena(args.arena_size);
+  args.arena = arena.data();
+  tek_inj_run_game(&args);
+  expect_success(args);
+}
+
+TEST_CASE(err_status_event) {
+  fake_os::fail_call("CreateEventW", ERROR_NOT_ENOUGH_MEMORY);
+  auto args{make_args()};
+  args.flags = TEK_INJ_FLAG_wait_ready;
+  run_failure(args, TEK_INJ_RES_status_event, ERROR_NOT_ENOUGH_MEMORY);
+}
+
+TEST_CASE(err_runtime_init) {
+  runtime_mode = fake_runtime::mode::fail;
+  auto args{make_args()};
+  args.flags = TEK_INJ_FLAG_wait_ready;
+  run_failure(args, TEK_INJ_RES_runtime_init, fake_runtime::fail_error);
+  CHECK(std::wstring_view{args.runtime_message}.length() ==
+        fake_runtime::fail_message.length());
+  CHECK(std::ranges::equal(std::wstring_view{args.runtime_message},
+                           fake_runtime::fail_message));
+  runtime_mode = fake_runtime::mode::silent;
+  args = make_args();
+  args.flags = TEK_INJ_FLAG_wait_ready;
+  args.inject_timeout = 50;
+  run_failure(args, TEK_INJ_RES_runtime_init, ERROR_TIMEOUT);
+}
+
+TEST_CASE(err_placement) {
+  auto args{make_args()};
+  args.flags = TEK_INJ_FLAG_numa_node;
+  args.numa_node = 7;
+  run_failure(args, TEK_INJ_RES_placement, ERROR_INVALID_PARAMETER);
+  CHECK(args.pid == 0);
+  fake_os::fail_call("SetProcessAffinityMask", ERROR_INVALID_PARAMETER);
+  args = make_args();
+  args.affinity_mask = 0x3;
+  run_failure(args, TEK_INJ_RES_placement, ERROR_INVALID_PARAMETER);
+  CHECK(args.pid != 0);
+  args = make_args();
+  args.memory_priority = 42;
+  run_failure(args, TEK_INJ_RES_placement, ERROR_INVALID_PARAMETER);
+  fake_os::fail_call("NtSetInformationProcess", ERROR_ACCESS_DENIED);
+  args = make_args();
+  args.io_priority = TEK_INJ_IO_PRIORITY_low;
+  run_failure(args, TEK_INJ_RES_placement, ERROR_ACCESS_DENIED);
+}
+
+TEST_CASE(err_job) {
+  const tek_inj_job_limits limits{
+      .memory_limit = 1 << 30, .cpu_rate = 0, .max_processes = 0};
+  for (const auto name : {"CreateJobObjectW", "SetInformationJobObject",
+                          "AssignProcessToJobObject"}) {
+    fake_os::fail_call(name, ERROR_ACCESS_DENIED);
+    auto args{make_args()};
+    args.job_limits = &limits;
+    run_failure(args, TEK_INJ_RES_job, ERROR_ACCESS_DENIED);
+  }
+}
+
+TEST_CASE(err_images) {
+  const std::array<const char *, 1> missing_export{"tek_gr_missing"};
+  auto args{make_args()};
+  args.flags = TEK_INJ_FLAG_check_images;
+  args.dll_path = L"C:\\game\\missing.dll";
+  run_failure(args, TEK_INJ_RES_image_open, ERROR_FILE_NOT_FOUND);
+  CHECK(args.failed_dll == 0);
+  fake_os::add_file(exe_path, "not an image");
+  args = make_args();
+  args.flags = TEK_INJ_FLAG_check_images;
+  run_failure(args, TEK_INJ_RES_image_invalid, ERROR_BAD_EXE_FORMAT);
+  CHECK(args.failed_dll == UINT32_MAX);
+  fake_os::add_file(exe_path, pe_image::build({}));
+  fake_os::add_file(extra_dll_path,
+                    pe_image::build({.machine = tek_inj::pe::machine_i386,
+                                     .characteristics =
+                                         tek_inj::pe::characteristic_dll,
+                                     .subsystem = 2,
+                                     .exports = {}}));
+  args = make_args();
+  args.flags = TEK_INJ_FLAG_check_images;
+  args.extra_dll_paths = extra_dlls.data();
+  args.num_extra_dlls = extra_dlls.size();
+  run_failure(args, TEK_INJ_RES_image_machine,
+              ERROR_EXE_MACHINE_TYPE_MISMATCH);
+  CHECK(args.failed_dll == 1);
+  args = make_args();
+  args.flags = TEK_INJ_FLAG_check_images;
+  args.required_exports = missing_export.data();
+  args.num_required_exports = missing_export.size();
+  run_failure(args, TEK_INJ_RES_image_export, ERROR_PROC_NOT_FOUND);
+  CHECK(args.failed_dll == 0);
+}
+
+TEST_CASE(err_shared_payload) {
+  // The second mapping created is the shared one
+  fake_os::fail_call("CreateFileMappingW", ERROR_NOT_ENOUGH_MEMORY, 1);
+  auto args{make_args()};
+  args.flags = TEK_INJ_FLAG_shared_payload;
+  run_failure(args, TEK_INJ_RES_shared_payload, ERROR_NOT_ENOUGH_MEMORY);
+}
+
+TEST_CASE(err_main_thread) {
+  fake_os::fail_call("QueueUserAPC", ERROR_ACCESS_DENIED);
+  auto args{make_args()};
+  args.strategy = TEK_INJ_STRATEGY_apc;
+  run_failure(args, TEK_INJ_RES_main_thread, ERROR_ACCESS_DENIED);
+  for (const auto name : {"GetThreadContext", "SetThreadContext"}) {
+    fake_os::fail_call(name, ERROR_ACCESS_DENIED);
+    args = make_args();
+    args.strategy = TEK_INJ_STRATEGY_entry_trampoline;
+    run_failure(args, TEK_INJ_RES_main_thread, ERROR_ACCESS_DENIED);
+  }
+}
+
+TEST_CASE(err_async) {
+  // Failure before game process is created returns no launch
+  fake_os::fail_call("CreateProcessW", ERROR_ACCESS_DENIED);
+  auto args{make_args()};
+  CHECK(!tek_inj_run_game_async(&args, nullptr, nullptr));
+  expect_failure(args, TEK_INJ_RES_create_process, ERROR_ACCESS_DENIED);
+  // Failures after it are reported via the completion
+  hang = true;
+  args = make_args();
+  args.inject_timeout = 50;
+  const auto launch{tek_inj_run_game_async(&args, nullptr, nullptr)};
+  CHECK(launch);
+  CHECK(WaitForSingleObject(tek_inj_launch_event(launch), 5000) ==
+        WAIT_OBJECT_0);
+  tek_inj_launch_free(launch);
+  expect_failure(args, TEK_INJ_RES_thread_wait, ERROR_TIMEOUT);
+  // Failures before the wait is registered are still reported from a thread
+  //    pool thread, after the launch is returned
+  hang = false;
+  struct completion {
+    std::atomic_int calls;
+    std::thread::id thread;
+  };
+  for (const auto fn : {"CreateEventW", "CreateRemoteThread",
+                        "RegisterWaitForSingleObject"}) {
+    fake_os::fail_call(fn, ERROR_ACCESS_DENIED);
+    args = make_args();
+    completion comp{};
+    const auto early{tek_inj_run_game_async(
+        &args,
+        [](tek_inj_launch *, void *user_data) {
+          auto &comp{*static_cast<completion *>(user_data)};
+          comp.thread = std::this_thread::get_id();
+          ++comp.calls;
+        },
+        &comp)};
+    CHECK(early);
+    const auto deadline{std::chrono::steady_clock::now() +
+                        std::chrono::seconds{5}};
+    while (!tek_inj_launch_done(early) &&
+           std::chrono::steady_clock::now() < deadline) {
+      std::this_thread::sleep_for(std::chrono::milliseconds{1});
+    }
+    CHECK(tek_inj_launch_done(early));
+    tek_inj_launch_free(early);
+    CHECK(comp.calls == 1);
+    CHECK(comp.thread != std::this_thread::get_id());
+    CHECK(args.result != TEK_INJ_RES_ok);
+    CHECK(args.win32_error == ERROR_ACCESS_DENIED);
+    CHECK(fake_os::running_processes() == 0);
+    check_leaks();
+  }
+  // Freeing the launch before deferred completion runs cancels it
+  fake_os::fail_call("CreateRemoteThread", ERROR_ACCESS_DENIED);
+  args = make_args();
+  completion comp{};
+  tek_inj_launch_free(tek_inj_run_game_async(
+      &args,
+      [](tek_inj_launch *, void *user_data) {
+        ++static_cast<completion *>(user_data)->calls;
+      },
+      &comp));
+  CHECK(comp.calls <= 1);
+  CHECK(fake_os::running_processes() == 0);
+  check_leaks();
+}
+
+TEST_CASE(err_pool) {
+  auto game_args{make_args()};
+  fake_os::fail_call("CreateProcessW", ERROR_ACCESS_DENIED, 1);
+  tek_inj_pool_args pool_args{.game_args = &game_args,
+                              .size = 2,
+                              .refill = TEK_INJ_POOL_REFILL_none,
+                              .result = {},
+                              .win32_error = 0};
+  CHECK(!tek_inj_pool_create(&pool_args));
+  CHECK(pool_args.result == TEK_INJ_RES_create_process);
+  CHECK(pool_args.win32_error == ERROR_ACCESS_DENIED);
+  CHECK(fake_os::running_processes() == 0);
+  check_leaks();
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  const auto res{test::run(argc, argv, setup)};
+  fake_os::reset();
+  if (argc > 1) {
+    return res;
+  }
+  // Every result code must be produced by some test
+  for (int i{}; i < TEK_INJ_RES_count; ++i) {
+    if (!covered.contains(static_cast<tek_inj_res>(i))) {
+      std::fprintf(stderr, "result code %d is not covered\n", i);
+      return 1;
+    }
+  }
+  return res;
+}
@@ -0,0 +1,138 @@
+//===-- launch_bench.cpp - Launch benchmark against the fake OS layer -----===//
+//
+// Copyright (c) 2025 Nuclearist <nuclearist@teknology-hub.com>
+// Part of tek-injector, under the GNU General Public License v3.0 or later
+// See https://github.com/teknology-hub/tek-injector/blob/main/COPYING for
+//    license information.
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+//===----------------------------------------------------------------------===//
+///
+/// @file
+///  Benchmark of the library's own overhead per launch with synchronous,
+///    asynchronous and pooled launch functions. OS calls are served by the
+///    fake OS layer, so the numbers don't predict real launch times, but
+///    changes in them show regressions in the library code around the calls.
+///  The number of launches per function may be passed as the only argument.
+///
+//===----------------------------------------------------------------------===//
+#include "tek-injector.h"
+
+#include "fake_os.hpp"
+#include "pe_image.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+constexpr auto exe_path{L"C:\\game\\game.exe"};
+constexpr auto dll_path{L"C:\\game\\libtek-game-runtime.dll"};
+constexpr std::string_view settings{R"({"steam":{"app_id":346110}})"};
+
+tek_inj_game_args make_args() {
+  tek_inj_game_args args{};
+  args.exe_path = exe_path;
+  args.dll_path = dll_path;
+  args.type = TEK_GR_LOAD_TYPE_data;
+  args.data = settings.data();
+  args.data_size = settings.size();
+  return args;
+}
+
+/// Run a benchmark and print its results.
+///
+/// @param name
+///    Name of the benchmark.
+/// @param num_launches
+///    Number of launches to make.
+/// @param fn
+///    Function making a single launch and returning its result.
+/// @return Value indicating whether all launches succeeded.
+template <typename F>
+bool bench(const char *name, int num_launches, F &&fn) {
+  fake_os::reset();
+  fake_os::add_file(exe_path, pe_image::build({}));
+  fake_os::add_file(dll_path, pe_image::dll());
+  const auto start{std::chrono::steady_clock::now()};
+  for (int i{}; i < num_launches; ++i) {
+    if (const auto res{fn()}; res != TEK_INJ_RES_ok) {
+      std::fprintf(stderr, "%s: launch %d failed with result %d\n", name, i,
+                   static_cast<int>(res));
+      return false;
+    }
+  }
+  const std::chrono::duration<double, std::micro> elapsed{
+      std::chrono::steady_clock::now() - start};
+  std::printf("%-12s %8d launches %10.1f us/launch\n", name, num_launches,
+              elapsed.count() / num_launches);
+  return true;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  const int num_launches{argc > 1 ? std::atoi(argv[1]) : 200};
+  if (num_launches <= 0) {
+    return 1;
+  }
+  bool ok{bench("run_game", num_launches, [] {
+    auto args{make_args()};
+    tek_inj_run_game(&args);
+    return args.result;
+  })};
+  tek_inj_ctx *ctx{};
+  ok &= bench("run_game_ctx", num_launches, [&ctx] {
+    if (!ctx) {
+      tek_inj_res res;
+      DWORD error;
+      ctx = tek_inj_ctx_create(&res, &error);
+      if (!ctx) {
+        return res;
+      }
+    }
+    auto args{make_args()};
+    args.ctx = ctx;
+    tek_inj_run_game(&args);
+    return args.result;
+  });
+  if (ctx) {
+    tek_inj_ctx_destroy(ctx);
+  }
+  ok &= bench("async", num_launches, [] {
+    auto args{make_args()};
+    const auto launch{tek_inj_run_game_async(&args, nullptr, nullptr)};
+    if (!launch) {
+      return args.result;
+    }
+    WaitForSingleObject(tek_inj_launch_event(launch), INFINITE);
+    tek_inj_launch_free(launch);
+    return args.result;
+  });
+  auto pool_game_args{make_args()};
+  tek_inj_pool_args pool_args{.game_args = &pool_game_args,
+                              .size = 4,
+                              .refill = TEK_INJ_POOL_REFILL_on_claim,
+                              .result = {},
+                              .win32_error = 0};
+  tek_inj_pool *pool{};
+  ok &= bench("pool_claim", num_launches, [&pool, &pool_args] {
+    if (!pool) {
+      pool = tek_inj_pool_create(&pool_args);
+      if (!pool) {
+        return pool_args.result;
+      }
+    }
+    auto args{make_args()};
+    tek_inj_pool_claim(pool, &args);
+    return args.result;
+  });
+  if (pool) {
+    tek_inj_pool_destroy(pool);
+  }
+  fake_os::reset();
+  return ok ? 0 : 1;
+}
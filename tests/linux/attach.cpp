@@ -0,0 +1,310 @@
+//===-- attach.cpp - Attach tests of the Linux backend --------------------===//
+//
+// Copyright (c) 2025 Nuclearist <nuclearist@teknology-hub.com>
+// Part of tek-injector, under the GNU General Public License v3.0 or later
+// See https://github.com/teknology-hub/tek-injector/blob/main/COPYING for
+//    license information.
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+//===----------------------------------------------------------------------===//
+///
+/// @file
+///  Tests of @ref tek_inj_linux_attach with real processes: the long-running
+///    stub target and the stub runtime, whose paths are passed via
+///    `TEK_STUB_TARGET` and `TEK_STUB_RUNTIME` environment variables. Every
+///    test checks that the target keeps running after injection, whether it
+///    succeeds or not.
+///
+//===----------------------------------------------------------------------===//
+#include "tek-injector.h"
+
+#include "test.hpp"
+
+#include <array>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <fstream>
+#include <iterator>
+#include <spawn.h>
+#include <string>
+#include <string_view>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr std::string_view settings{R"({"steam":{"app_id":346110}})"};
+
+/// Path to the stub target executable.
+const char *stub_target;
+/// Path to the stub runtime shared object.
+const char *stub_runtime;
+/// Path to the file that the stub runtime writes its payload to.
+std::string output_path;
+
+/// Start the stub target and wait until it's running.
+///
+/// @param spin
+///    Value indicating whether the target should spin instead of sleeping.
+/// @param current_dir
+///    Path to the current directory to set for the target, or `nullptr`.
+/// @return ID of the target process, or -1 if it can't be started.
+pid_t spawn_target(bool spin, const char *current_dir = nullptr) {
+  int fds[2];
+  if (pipe(fds) < 0) {
+    return -1;
+  }
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init(&actions);
+  posix_spawn_file_actions_adddup2(&actions, fds[1], STDOUT_FILENO);
+  posix_spawn_file_actions_addclose(&actions, fds[0]);
+  if (current_dir) {
+    posix_spawn_file_actions_addchdir_np(&actions, current_dir);
+  }
+  std::array<char *, 3> argv{const_cast<char *>(stub_target),
+                             spin ? const_cast<char *>("--spin") : nullptr,
+                             nullptr};
+  pid_t pid;
+  const auto res{posix_spawn(&pid, stub_target, &actions, nullptr,
+                             argv.data(), environ)};
+  posix_spawn_file_actions_destroy(&actions);
+  close(fds[1]);
+  char ready;
+  const bool ok{!res && read(fds[0], &ready, 1) == 1};
+  close(fds[0]);
+  if (!ok) {
+    if (!res) {
+      kill(pid, SIGKILL);
+      waitpid(pid, nullptr, 0);
+    }
+    return -1;
+  }
+  return pid;
+}
+
+/// Get arguments for attaching to a process with settings data.
+///
+/// @param pid
+///    ID of the process.
+tek_inj_linux_attach_args make_args(pid_t pid) {
+  return {.pid = pid,
+          .runtime_path = stub_runtime,
+          .extra_paths = nullptr,
+          .num_extra_paths = 0,
+          .type = TEK_GR_LOAD_TYPE_data,
+          .data_size = settings.size(),
+          .data = settings.data(),
+          .inject_timeout = 0,
+          .result = TEK_INJ_RES_ok,
+          .sys_error = 0,
+          .failed_dll = 0};
+}
+
+/// Check whether a process is still running, then stop it with `SIGTERM`.
+///
+/// @param pid
+///    ID of the process.
+/// @return Exit code of the process, or -1 if it has been killed by a signal
+///    or has exited before.
+int stop_target(pid_t pid) {
+  if (waitpid(pid, nullptr, WNOHANG) != 0) {
+    return -1;
+  }
+  kill(pid, SIGTERM);
+  int status;
+  if (waitpid(pid, &status, 0) != pid) {
+    return -1;
+  }
+  return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+/// Check whether a process has a shared object mapped.
+///
+/// @param pid
+///    ID of the process.
+/// @param path
+///    Path to the shared object.
+bool is_mapped(pid_t pid, std::string_view path) {
+  std::ifstream file{"/proc/" + std::to_string(pid) + "/maps"};
+  const std::string maps{std::istreambuf_iterator<char>{file}, {}};
+  return maps.find(path) != std::string::npos;
+}
+
+/// Check whether a process has executable memory that isn't backed by a
+///    file, which the loader routine leaves if it's not freed.
+///
+/// @param pid
+///    ID of the process.
+bool has_anonymous_code(pid_t pid) {
+  std::ifstream file{"/proc/" + std::to_string(pid) + "/maps"};
+  for (std::string line; std::getline(file, line);) {
+    char perms[5];
+    unsigned long long inode;
+    int path_pos{-1};
+    if (std::sscanf(line.c_str(), "%*x-%*x %4s %*x %*x:%*x %llu %n", perms,
+                    &inode, &path_pos) == 2 &&
+        perms[2] == 'x' && !inode &&
+        (path_pos < 0 || static_cast<std::size_t>(path_pos) >= line.size())) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/// Check whether the shared memory object for a process has been removed.
+///
+/// @param pid
+///    ID of the process.
+bool shm_removed(pid_t pid) {
+  const auto name{std::string{TEK_INJ_SHM_NAME_PREFIX}.append(
+      std::to_string(pid))};
+  return shm_open(name.c_str(), O_RDONLY, 0) < 0 && errno == ENOENT;
+}
+
+/// Read the payload written by the stub runtime.
+std::string read_output() {
+  std::ifstream file{output_path, std::ios::binary};
+  return {std::istreambuf_iterator<char>{file}, {}};
+}
+
+/// Reset the environment of the stub runtime.
+void setup() {
+  std::remove(output_path.c_str());
+  unsetenv("TEK_STUB_MODE");
+}
+
+} // namespace
+
+TEST_CASE(attach) {
+  const auto pid{spawn_target(false)};
+  CHECK(pid > 0);
+  auto args{make_args(pid)};
+  tek_inj_linux_attach(&args);
+  CHECK(args.result == TEK_INJ_RES_ok);
+  CHECK(args.sys_error == 0);
+  CHECK(read_output() == "1:" + std::string{settings});
+  CHECK(is_mapped(pid, stub_runtime));
+  CHECK(!has_anonymous_code(pid));
+  CHECK(shm_removed(pid));
+  CHECK(stop_target(pid) == 0);
+}
+
+TEST_CASE(attach_spin) {
+  const auto pid{spawn_target(true)};
+  CHECK(pid > 0);
+  auto args{make_args(pid)};
+  tek_inj_linux_attach(&args);
+  CHECK(args.result == TEK_INJ_RES_ok);
+  CHECK(read_output() == "1:" + std::string{settings});
+  CHECK(stop_target(pid) == 0);
+}
+
+TEST_CASE(attach_twice) {
+  // The first injection must leave nothing behind that makes the second one
+  //    fail, such as the shared memory object or the thread being traced
+  const auto pid{spawn_target(false)};
+  CHECK(pid > 0);
+  for (int i{}; i < 2; ++i) {
+    auto args{make_args(pid)};
+    tek_inj_linux_attach(&args);
+    CHECK(args.result == TEK_INJ_RES_ok);
+  }
+  CHECK(stop_target(pid) == 0);
+}
+
+TEST_CASE(attach_relative) {
+  const std::string_view runtime{stub_runtime};
+  const auto slash{runtime.rfind('/')};
+  const std::string dir{runtime.substr(0, slash)};
+  const auto pid{spawn_target(false, dir.c_str())};
+  CHECK(pid > 0);
+  auto args{make_args(pid)};
+  args.runtime_path = stub_runtime + slash + 1;
+  tek_inj_linux_attach(&args);
+  CHECK(args.result == TEK_INJ_RES_ok);
+  CHECK(is_mapped(pid, stub_runtime));
+  CHECK(stop_target(pid) == 0);
+}
+
+TEST_CASE(attach_timeout) {
+  setenv("TEK_STUB_MODE", "hang", 1);
+  const auto pid{spawn_target(false)};
+  CHECK(pid > 0);
+  auto args{make_args(pid)};
+  args.inject_timeout = 200;
+  tek_inj_linux_attach(&args);
+  CHECK(args.result == TEK_INJ_RES_thread_wait);
+  CHECK(args.sys_error == ETIMEDOUT);
+  // The thread may hold the dynamic linker's lock, so it's left to load, and
+  //    the block that it runs is leaked
+  CHECK(waitpid(pid, nullptr, WNOHANG) == 0);
+  CHECK(has_anonymous_code(pid));
+  CHECK(shm_removed(pid));
+  kill(pid, SIGKILL);
+  waitpid(pid, nullptr, 0);
+}
+
+TEST_CASE(attach_load_failure) {
+  const auto pid{spawn_target(true)};
+  CHECK(pid > 0);
+  // A file that isn't a shared object is readable, but dlopen fails for it
+  const auto invalid_path{output_path + ".txt"};
+  {
+    std::ofstream file{invalid_path};
+    file << "not a shared object";
+  }
+  const std::array extra_paths{invalid_path.c_str()};
+  auto args{make_args(pid)};
+  args.extra_paths = extra_paths.data();
+  args.num_extra_paths = extra_paths.size();
+  tek_inj_linux_attach(&args);
+  CHECK(args.result == TEK_INJ_RES_dll_load);
+  CHECK(args.failed_dll == 1);
+  CHECK(is_mapped(pid, stub_runtime));
+  CHECK(stop_target(pid) == 0);
+  std::remove(invalid_path.c_str());
+}
+
+TEST_CASE(attach_missing_runtime) {
+  const auto pid{spawn_target(false)};
+  CHECK(pid > 0);
+  auto args{make_args(pid)};
+  args.runtime_path = "/nonexistent/libtek-game-runtime.so";
+  tek_inj_linux_attach(&args);
+  CHECK(args.result == TEK_INJ_RES_dll_load);
+  CHECK(args.sys_error == ENOENT);
+  CHECK(args.failed_dll == 0);
+  CHECK(stop_target(pid) == 0);
+}
+
+TEST_CASE(attach_no_process) {
+  // A reaped child's ID is not reused right away
+  const auto pid{fork()};
+  if (!pid) {
+    _exit(0);
+  }
+  CHECK(pid > 0);
+  waitpid(pid, nullptr, 0);
+  auto args{make_args(pid)};
+  tek_inj_linux_attach(&args);
+  CHECK(args.result == TEK_INJ_RES_open_process);
+  CHECK(args.sys_error == ESRCH);
+}
+
+int main(int argc, char **argv) {
+  stub_target = std::getenv("TEK_STUB_TARGET");
+  stub_runtime = std::getenv("TEK_STUB_RUNTIME");
+  if (!stub_target || !stub_runtime) {
+    std::fputs("TEK_STUB_TARGET and TEK_STUB_RUNTIME must be set\n", stderr);
+    return 1;
+  }
+  output_path = "/tmp/tek-injector-stub-" + std::to_string(getpid());
+  setenv("TEK_STUB_OUTPUT", output_path.c_str(), 1);
+  const auto res{test::run(argc, argv, setup)};
+  std::remove(output_path.c_str());
+  return res;
+}
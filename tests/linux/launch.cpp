@@ -0,0 +1,461 @@
+//===-- launch.cpp - Launch tests of the Linux backend --------------------===//
+//
+// Copyright (c) 2025 Nuclearist <nuclearist@teknology-hub.com>
+// Part of tek-injector, under the GNU General Public License v3.0 or later
+// See https://github.com/teknology-hub/tek-injector/blob/main/COPYING for
+//    license information.
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+//===----------------------------------------------------------------------===//
+///
+/// @file
+///  Tests of @ref tek_inj_linux_run_game with real processes: the stub game
+///    and the stub runtime, whose paths are passed via `TEK_STUB_GAME` and
+///    `TEK_STUB_RUNTIME` environment variables. Every test checks that game
+///    process is reaped when the launch fails.
+///
+//===----------------------------------------------------------------------===//
+#include "tek-injector.h"
+
+#include "test.hpp"
+
+#include <array>
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <linux/ioprio.h>
+#include <sched.h>
+#include <string>
+#include <string_view>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr std::string_view settings{R"({"steam":{"app_id":346110}})"};
+constexpr std::array stub_argv{"--stub-arg"};
+
+/// Path to the stub game executable.
+const char *stub_game;
+/// Path to the stub runtime shared object.
+const char *stub_runtime;
+/// Path to the file that the stub runtime writes its payload to.
+std::string output_path;
+
+/// Get arguments for launching the stub game with settings data.
+tek_inj_linux_game_args make_args() {
+  return {.exe_path = stub_game,
+          .current_dir = nullptr,
+          .runtime_path = stub_runtime,
+          .extra_paths = nullptr,
+          .num_extra_paths = 0,
+          .type = TEK_GR_LOAD_TYPE_data,
+          .argc = stub_argv.size(),
+          .argv = stub_argv.data(),
+          .envp = nullptr,
+          .flags = TEK_INJ_FLAG_none,
+          .data_size = settings.size(),
+          .data = settings.data(),
+          .inject_timeout = 0,
+          .affinity_mask = 0,
+          .io_priority = TEK_INJ_IO_PRIORITY_default,
+          .job_limits = nullptr,
+          .cgroup_parent = nullptr,
+          .prefetch_paths = nullptr,
+          .num_prefetch_paths = 0,
+          .timings = nullptr,
+          .result = TEK_INJ_RES_ok,
+          .sys_error = 0,
+          .pid = 0,
+          .failed_dll = 0,
+          .runtime_message = {},
+          .cgroup_fd = -1,
+          .prefetched_bytes = 0};
+}
+
+/// Wait for game process to exit.
+///
+/// @param pid
+///    ID of the process.
+/// @return Exit code of the process, or -1 if it was killed by a signal.
+int wait_exit(int pid) {
+  int status;
+  if (waitpid(pid, &status, 0) != pid) {
+    return -1;
+  }
+  return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+/// Check that game process launched by a failed launch has been reaped.
+///
+/// @param pid
+///    ID of the process.
+bool reaped(int pid) {
+  return waitpid(pid, nullptr, WNOHANG) < 0 && errno == ECHILD;
+}
+
+/// Read the payload written by the stub runtime.
+std::string read_output() {
+  std::ifstream file{output_path, std::ios::binary};
+  return {std::istreambuf_iterator<char>{file}, {}};
+}
+
+/// Read a file.
+///
+/// @param path
+///    Path to the file.
+std::string read_file(const std::string &path) {
+  std::ifstream file{path, std::ios::binary};
+  return {std::istreambuf_iterator<char>{file}, {}};
+}
+
+/// Create a cgroup for the test to create game's cgroup in, as a child of
+///    the cgroup v2 of the calling process.
+///
+/// @return Path to the cgroup directory, or an empty string if cgroup v2
+///    isn't mounted or isn't writable.
+std::string make_cgroup_parent() {
+  std::ifstream mounts{"/proc/self/mounts"};
+  std::string root;
+  for (std::string device, dir, type; mounts >> device >> dir >> type;) {
+    if (type == "cgroup2") {
+      root = dir;
+      break;
+    }
+    mounts.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+  }
+  if (root.empty()) {
+    return {};
+  }
+  std::ifstream cgroups{"/proc/self/cgroup"};
+  for (std::string line; std::getline(cgroups, line);) {
+    if (line.starts_with("0::")) {
+      auto path{root.append(line, 3)};
+      if (!path.ends_with('/')) {
+        path.push_back('/');
+      }
+      path.append("tek-injector-test-").append(std::to_string(getpid()));
+      return mkdir(path.c_str(), 0755) < 0 ? std::string{} : path;
+    }
+  }
+  return {};
+}
+
+/// Reset the environment of the stub runtime.
+void setup() {
+  std::remove(output_path.c_str());
+  unsetenv("TEK_STUB_MODE");
+}
+
+} // namespace
+
+TEST_CASE(run_game) {
+  auto args{make_args()};
+  tek_inj_linux_run_game(&args);
+  CHECK(args.result == TEK_INJ_RES_ok);
+  CHECK(args.pid > 0);
+  CHECK(wait_exit(args.pid) == 0);
+  CHECK(read_output() == "1:" + std::string{settings});
+}
+
+TEST_CASE(status_header) {
+  // The status block makes the versioned header be used even for empty data
+  auto args{make_args()};
+  args.type = TEK_GR_LOAD_TYPE_file_path;
+  args.data_size = 0;
+  args.data = nullptr;
+  args.flags = TEK_INJ_FLAG_wait_ready;
+  tek_inj_linux_run_game(&args);
+  CHECK(args.result == TEK_INJ_RES_ok);
+  CHECK(wait_exit(args.pid) == 0);
+  CHECK(read_output() == "0:");
+}
+
+TEST_CASE(custom_env) {
+  const auto output_var{"TEK_STUB_OUTPUT=" + output_path};
+  // A stale payload descriptor variable must be replaced, and existing
+  //    LD_PRELOAD entries kept
+  const std::array<const char *, 4> envp{
+      output_var.c_str(), TEK_INJ_PAYLOAD_FD_ENV "=1000",
+      "LD_PRELOAD=", nullptr};
+  auto args{make_args()};
+  args.envp = envp.data();
+  tek_inj_linux_run_game(&args);
+  CHECK(args.result == TEK_INJ_RES_ok);
+  CHECK(wait_exit(args.pid) == 0);
+  CHECK(read_output() == "1:" + std::string{settings});
+}
+
+TEST_CASE(relative_runtime) {
+  const std::string_view runtime{stub_runtime};
+  const auto slash{runtime.rfind('/')};
+  const std::string dir{runtime.substr(0, slash)};
+  auto args{make_args()};
+  args.current_dir = dir.c_str();
+  args.runtime_path = stub_runtime + slash + 1;
+  tek_inj_linux_run_game(&args);
+  CHECK(args.result == TEK_INJ_RES_ok);
+  CHECK(wait_exit(args.pid) == 0);
+}
+
+TEST_CASE(wait_ready) {
+  tek_inj_timings timings;
+  auto args{make_args()};
+  args.flags = TEK_INJ_FLAG_wait_ready;
+  args.timings = &timings;
+  tek_inj_linux_run_game(&args);
+  CHECK(args.result == TEK_INJ_RES_ok);
+  CHECK(wait_exit(args.pid) == 0);
+  CHECK(timings.frequency == 1'000'000'000);
+  for (const auto phase :
+       {TEK_INJ_PHASE_mapping, TEK_INJ_PHASE_create_process,
+        TEK_INJ_PHASE_resume, TEK_INJ_PHASE_inject,
+        TEK_INJ_PHASE_runtime_init}) {
+    CHECK(timings.start[phase]);
+    CHECK(timings.end[phase] >= timings.start[phase]);
+  }
+  CHECK(!timings.start[TEK_INJ_PHASE_token]);
+}
+
+TEST_CASE(runtime_failure) {
+  setenv("TEK_STUB_MODE", "fail", 1);
+  auto args{make_args()};
+  args.flags = TEK_INJ_FLAG_wait_ready;
+  tek_inj_linux_run_game(&args);
+  CHECK(args.result == TEK_INJ_RES_runtime_init);
+  CHECK(args.sys_error == 42);
+  CHECK(std::u16string_view{args.runtime_message} == u"stub failure");
+  CHECK(reaped(args.pid));
+}
+
+TEST_CASE(ready_timeout) {
+  setenv("TEK_STUB_MODE", "silent", 1);
+  tek_inj_metrics metrics;
+  tek_inj_metrics_snapshot(&metrics, true);
+  auto args{make_args()};
+  args.flags = TEK_INJ_FLAG_wait_ready;
+  args.inject_timeout = 200;
+  tek_inj_linux_run_game(&args);
+  CHECK(args.result == TEK_INJ_RES_runtime_init);
+  CHECK(args.sys_error == ETIMEDOUT);
+  CHECK(reaped(args.pid));
+  tek_inj_metrics_snapshot(&metrics, false);
+  CHECK(metrics.launches == 1);
+  CHECK(metrics.results[TEK_INJ_RES_runtime_init] == 1);
+  CHECK(metrics.timeouts == 1);
+}
+
+TEST_CASE(placement) {
+  // The runtime never returns from loading, so the process stays alive to be
+  //    inspected
+  setenv("TEK_STUB_MODE", "hang", 1);
+  cpu_set_t allowed;
+  CHECK(sched_getaffinity(0, sizeof allowed, &allowed) == 0);
+  unsigned cpu{};
+  while (cpu < 64 && !CPU_ISSET(cpu, &allowed)) {
+    ++cpu;
+  }
+  CHECK(cpu < 64);
+  auto args{make_args()};
+  args.affinity_mask = std::uint64_t{1} << cpu;
+  args.io_priority = TEK_INJ_IO_PRIORITY_very_low;
+  tek_inj_linux_run_game(&args);
+  CHECK(args.result == TEK_INJ_RES_ok);
+  cpu_set_t set;
+  CHECK(sched_getaffinity(args.pid, sizeof set, &set) == 0);
+  CHECK(CPU_COUNT(&set) == 1 && CPU_ISSET(cpu, &set));
+  CHECK(syscall(SYS_ioprio_get, IOPRIO_WHO_PROCESS, args.pid) ==
+        IOPRIO_PRIO_VALUE(IOPRIO_CLASS_IDLE, 0));
+  kill(args.pid, SIGKILL);
+  CHECK(wait_exit(args.pid) == -1);
+}
+
+TEST_CASE(prefetch) {
+  // A missing file is skipped, and a relative path is resolved against
+  //    game's current directory
+  const std::string_view runtime{stub_runtime};
+  const auto slash{runtime.rfind('/')};
+  const std::string dir{runtime.substr(0, slash)};
+  const std::array prefetch_paths{stub_runtime + slash + 1, "nonexistent"};
+  auto args{make_args()};
+  args.current_dir = dir.c_str();
+  args.flags = TEK_INJ_FLAG_prefetch;
+  args.prefetch_paths = prefetch_paths.data();
+  args.num_prefetch_paths = prefetch_paths.size();
+  tek_inj_timings timings;
+  args.timings = &timings;
+  tek_inj_linux_run_game(&args);
+  CHECK(args.result == TEK_INJ_RES_ok);
+  CHECK(wait_exit(args.pid) == 0);
+  struct stat game_st;
+  struct stat runtime_st;
+  CHECK(stat(stub_game, &game_st) == 0 && stat(stub_runtime, &runtime_st) == 0);
+  CHECK(args.prefetched_bytes ==
+        static_cast<std::uint64_t>(game_st.st_size + 2 * runtime_st.st_size));
+  CHECK(timings.start[TEK_INJ_PHASE_prefetch] > 0);
+  CHECK(timings.end[TEK_INJ_PHASE_prefetch] >=
+        timings.start[TEK_INJ_PHASE_prefetch]);
+  CHECK(timings.end[TEK_INJ_PHASE_prefetch] <=
+        timings.start[TEK_INJ_PHASE_resume]);
+}
+
+TEST_CASE(cgroup) {
+  const auto parent{make_cgroup_parent()};
+  if (parent.empty()) {
+    std::fputs("cgroup v2 is not writable, skipping\n", stderr);
+    return;
+  }
+  setenv("TEK_STUB_MODE", "hang", 1);
+  const tek_inj_job_limits limits{};
+  auto args{make_args()};
+  args.job_limits = &limits;
+  args.cgroup_parent = parent.c_str();
+  tek_inj_linux_run_game(&args);
+  CHECK(args.result == TEK_INJ_RES_ok);
+  CHECK(args.cgroup_fd >= 0);
+  const auto dir{parent + "/" TEK_INJ_CGROUP_NAME_PREFIX +
+                 std::to_string(args.pid)};
+  CHECK(read_file(dir + "/cgroup.procs") == std::to_string(args.pid) + "\n");
+  tek_inj_job_stats stats;
+  CHECK(tek_inj_linux_job_query(args.cgroup_fd, &stats));
+  CHECK(stats.active_processes == 1);
+  CHECK(stats.user_time + stats.kernel_time > 0);
+  kill(args.pid, SIGKILL);
+  CHECK(wait_exit(args.pid) == -1);
+  CHECK(tek_inj_linux_job_query(args.cgroup_fd, &stats));
+  CHECK(stats.active_processes == 0);
+  close(args.cgroup_fd);
+  CHECK(rmdir(dir.c_str()) == 0);
+  rmdir(parent.c_str());
+}
+
+TEST_CASE(cgroup_limits) {
+  const auto parent{make_cgroup_parent()};
+  if (parent.empty()) {
+    std::fputs("cgroup v2 is not writable, skipping\n", stderr);
+    return;
+  }
+  // Controllers are usually bound to cgroup v1 on hybrid hierarchies, in
+  //    which case the limits can't be set
+  bool controllers;
+  {
+    std::ofstream file{parent + "/cgroup.subtree_control"};
+    controllers = static_cast<bool>(file << "+cpu +memory +pids" << std::flush);
+  }
+  setenv("TEK_STUB_MODE", "hang", 1);
+  const tek_inj_job_limits limits{
+      .memory_limit = 256 << 20, .cpu_rate = 5000, .max_processes = 64};
+  auto args{make_args()};
+  args.job_limits = &limits;
+  args.cgroup_parent = parent.c_str();
+  tek_inj_linux_run_game(&args);
+  const auto dir{parent + "/" TEK_INJ_CGROUP_NAME_PREFIX +
+                 std::to_string(args.pid)};
+  if (controllers) {
+    CHECK(args.result == TEK_INJ_RES_ok);
+    CHECK(read_file(dir + "/memory.max") == "268435456\n");
+    CHECK(read_file(dir + "/cpu.max").ends_with(" 100000\n"));
+    CHECK(read_file(dir + "/pids.max") == "64\n");
+    kill(args.pid, SIGKILL);
+    CHECK(wait_exit(args.pid) == -1);
+    close(args.cgroup_fd);
+    CHECK(rmdir(dir.c_str()) == 0);
+  } else {
+    CHECK(args.result == TEK_INJ_RES_job);
+    CHECK(args.sys_error == ENOENT);
+    CHECK(args.cgroup_fd == -1);
+    CHECK(reaped(args.pid));
+    CHECK(access(dir.c_str(), F_OK) < 0 && errno == ENOENT);
+  }
+  rmdir(parent.c_str());
+}
+
+TEST_CASE(cgroup_missing_parent) {
+  const tek_inj_job_limits limits{};
+  auto args{make_args()};
+  args.job_limits = &limits;
+  args.cgroup_parent = "/nonexistent";
+  tek_inj_linux_run_game(&args);
+  CHECK(args.result == TEK_INJ_RES_job);
+  CHECK(args.sys_error == ENOENT);
+  CHECK(args.cgroup_fd == -1);
+  CHECK(reaped(args.pid));
+}
+
+TEST_CASE(missing_runtime) {
+  auto args{make_args()};
+  args.runtime_path = "/nonexistent/libtek-game-runtime.so";
+  tek_inj_linux_run_game(&args);
+  CHECK(args.result == TEK_INJ_RES_dll_load);
+  CHECK(args.sys_error == ENOENT);
+  CHECK(args.failed_dll == 0);
+  CHECK(args.pid == 0);
+}
+
+TEST_CASE(invalid_extra_path) {
+  const std::array extra_paths{"/usr/lib/a.so:/usr/lib/b.so"};
+  auto args{make_args()};
+  args.extra_paths = extra_paths.data();
+  args.num_extra_paths = extra_paths.size();
+  tek_inj_linux_run_game(&args);
+  CHECK(args.result == TEK_INJ_RES_dll_load);
+  CHECK(args.sys_error == EINVAL);
+  CHECK(args.failed_dll == 1);
+  CHECK(args.pid == 0);
+}
+
+TEST_CASE(missing_exe) {
+  auto args{make_args()};
+  args.exe_path = "/nonexistent/game";
+  tek_inj_linux_run_game(&args);
+  CHECK(args.result == TEK_INJ_RES_create_process);
+  CHECK(args.sys_error == ENOENT);
+  CHECK(args.pid > 0);
+  CHECK(reaped(args.pid));
+}
+
+TEST_CASE(missing_current_dir) {
+  auto args{make_args()};
+  args.current_dir = "/nonexistent";
+  tek_inj_linux_run_game(&args);
+  CHECK(args.result == TEK_INJ_RES_create_process);
+  CHECK(args.sys_error == ENOENT);
+  CHECK(reaped(args.pid));
+}
+
+TEST_CASE(metrics) {
+  tek_inj_metrics metrics;
+  tek_inj_metrics_snapshot(&metrics, true);
+  auto args{make_args()};
+  tek_inj_linux_run_game(&args);
+  CHECK(args.result == TEK_INJ_RES_ok);
+  CHECK(wait_exit(args.pid) == 0);
+  tek_inj_metrics_snapshot(&metrics, true);
+  CHECK(metrics.launches == 1);
+  CHECK(metrics.results[TEK_INJ_RES_ok] == 1);
+  CHECK(metrics.timeouts == 0);
+  CHECK(metrics.total.sum > 0 || metrics.total.buckets[0] == 1);
+  tek_inj_metrics_snapshot(&metrics, false);
+  CHECK(metrics.launches == 0);
+}
+
+int main(int argc, char **argv) {
+  stub_game = std::getenv("TEK_STUB_GAME");
+  stub_runtime = std::getenv("TEK_STUB_RUNTIME");
+  if (!stub_game || !stub_runtime) {
+    std::fputs("TEK_STUB_GAME and TEK_STUB_RUNTIME must be set\n", stderr);
+    return 1;
+  }
+  output_path = "/tmp/tek-injector-stub-" + std::to_string(getpid());
+  setenv("TEK_STUB_OUTPUT", output_path.c_str(), 1);
+  const auto res{test::run(argc, argv, setup)};
+  std::remove(output_path.c_str());
+  return res;
+}
@@ -0,0 +1,25 @@
+//===-- stub_game.cpp - Stub game for the Linux backend tests -------------===//
+//
+// Copyright (c) 2025 Nuclearist <nuclearist@teknology-hub.com>
+// Part of tek-injector, under the GNU General Public License v3.0 or later
+// See https://github.com/teknology-hub/tek-injector/blob/main/COPYING for
+//    license information.
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+//===----------------------------------------------------------------------===//
+///
+/// @file
+///  Game executable that checks that the stub runtime has been loaded before
+///    `main` and that command-line arguments have been passed, and exits with
+///    code 0 if so.
+///
+//===----------------------------------------------------------------------===//
+#include <cstdlib>
+#include <cstring>
+
+int main(int argc, char **argv) {
+  return std::getenv("TEK_STUB_LOADED") && argc == 2 &&
+                 !std::strcmp(argv[1], "--stub-arg")
+             ? 0
+             : 1;
+}
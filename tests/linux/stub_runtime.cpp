@@ -0,0 +1,133 @@
+//===-- stub_runtime.cpp - Stub TEK Game Runtime for Linux tests ----------===//
+//
+// Copyright (c) 2025 Nuclearist <nuclearist@teknology-hub.com>
+// Part of tek-injector, under the GNU General Public License v3.0 or later
+// See https://github.com/teknology-hub/tek-injector/blob/main/COPYING for
+//    license information.
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+//===----------------------------------------------------------------------===//
+///
+/// @file
+///  Shared object standing in for TEK Game Runtime: upon loading, it reads
+///    its payload from the descriptor passed by the launch, or from the shared
+///    memory object created when attaching, writes settings loading type and
+///    data to the file named by `TEK_STUB_OUTPUT` as "<type>:<data>", and
+///    reports status according to `TEK_STUB_MODE`: readiness by default, a
+///    failure for "fail", or nothing for "silent". With "hang", it never
+///    returns from loading.
+///
+//===----------------------------------------------------------------------===//
+#include "payload.hpp"
+#include "tek-injector.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <string>
+#include <string_view>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace {
+
+/// Get current `CLOCK_MONOTONIC` value in nanoseconds.
+std::int64_t now() {
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<std::int64_t>(ts.tv_sec) * 1'000'000'000 + ts.tv_nsec;
+}
+
+/// Set status block state and wake the injector.
+void set_state(tek_inj::payload::status_block &status,
+               tek_inj::payload::state state) {
+  status.times[static_cast<int>(state)] = now();
+  std::atomic_ref{status.state}.store(static_cast<std::uint32_t>(state),
+                                      std::memory_order::release);
+  syscall(SYS_futex, &status.state, FUTEX_WAKE, 1, nullptr, nullptr, 0);
+}
+
+/// Read the payload and report status.
+[[gnu::constructor]] void init() {
+  int fd;
+  // The object created when attaching is read-only for the runtime
+  int prot{PROT_READ | PROT_WRITE};
+  if (const auto fd_str{std::getenv(TEK_INJ_PAYLOAD_FD_ENV)}; fd_str) {
+    fd = std::atoi(fd_str);
+    unsetenv(TEK_INJ_PAYLOAD_FD_ENV);
+    unsetenv("LD_PRELOAD");
+    setenv("TEK_STUB_LOADED", "1", 1);
+  } else {
+    const auto name{std::string{TEK_INJ_SHM_NAME_PREFIX}.append(
+        std::to_string(getpid()))};
+    fd = shm_open(name.c_str(), O_RDONLY | O_CLOEXEC, 0);
+    if (fd < 0) {
+      return;
+    }
+    prot = PROT_READ;
+  }
+  struct stat st;
+  if (fstat(fd, &st) < 0) {
+    return;
+  }
+  const auto size{static_cast<std::size_t>(st.st_size)};
+  const auto view{mmap(nullptr, size, prot, MAP_SHARED, fd, 0)};
+  close(fd);
+  if (view == MAP_FAILED) {
+    return;
+  }
+  using namespace tek_inj::payload;
+  std::int32_t type;
+  std::string_view data;
+  status_block *status{};
+  if (const auto &hdr{*static_cast<const data_header_v2 *>(view)};
+      hdr.magic == data_header_magic) {
+    type = hdr.type;
+    if (hdr.flags & flag_status) {
+      status = get_status(view);
+    }
+    data = {static_cast<const char *>(view) + header_size(hdr.size, hdr.flags),
+            hdr.size};
+  } else {
+    const auto &hdr_v1{*static_cast<const data_header *>(view)};
+    type = hdr_v1.type;
+    data = {reinterpret_cast<const char *>(&hdr_v1 + 1), hdr_v1.size};
+  }
+  if (status) {
+    set_state(*status, state::loaded);
+  }
+  if (const auto path{std::getenv("TEK_STUB_OUTPUT")}; path) {
+    if (const auto file{std::fopen(path, "wb")}; file) {
+      std::fprintf(file, "%d:%.*s", static_cast<int>(type),
+                   static_cast<int>(data.size()), data.data());
+      std::fclose(file);
+    }
+  }
+  const std::string_view mode{std::getenv("TEK_STUB_MODE")
+                                  ? std::getenv("TEK_STUB_MODE")
+                                  : ""};
+  if (mode == "hang") {
+    for (;;) {
+      pause();
+    }
+  }
+  if (status) {
+    if (mode == "fail") {
+      status->error = 42;
+      std::u16string_view{u"stub failure"}.copy(status->message,
+                                                max_message_len - 1);
+      set_state(*status, state::failed);
+    } else if (mode != "silent") {
+      set_state(*status, state::ready);
+    }
+  }
+  munmap(view, size);
+}
+
+} // namespace
@@ -0,0 +1,59 @@
+//===-- stub_target.cpp - Stub running game for the Linux attach tests ----===//
+//
+// Copyright (c) 2025 Nuclearist <nuclearist@teknology-hub.com>
+// Part of tek-injector, under the GNU General Public License v3.0 or later
+// See https://github.com/teknology-hub/tek-injector/blob/main/COPYING for
+//    license information.
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+//===----------------------------------------------------------------------===//
+///
+/// @file
+///  Long-running game executable to attach to. It writes a byte to standard
+///    output once it's running, then runs until it receives `SIGTERM`:
+///    sleeping by default, so it's interrupted in a system call, or with
+///    "--spin", computing in registers, so it's interrupted in its own code.
+///    It exits with code 0, or 2 if it finds its registers changed.
+///
+//===----------------------------------------------------------------------===//
+#include <csignal>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <unistd.h>
+
+namespace {
+
+/// Set by the `SIGTERM` handler.
+volatile std::sig_atomic_t stop;
+
+} // namespace
+
+int main(int argc, char **argv) {
+  struct sigaction action{};
+  action.sa_handler = [](int) { stop = 1; };
+  sigaction(SIGTERM, &action, nullptr);
+  const bool spin{argc == 2 && !std::strcmp(argv[1], "--spin")};
+  if (write(STDOUT_FILENO, "r", 1) != 1) {
+    return 1;
+  }
+  if (!spin) {
+    while (!stop) {
+      constexpr timespec interval{.tv_sec = 0, .tv_nsec = 10'000'000};
+      nanosleep(&interval, nullptr);
+    }
+    return 0;
+  }
+  // The loader routine must restore both general-purpose and SSE registers
+  //    that the loop keeps its values in
+  double sum{};
+  std::uint64_t count{};
+  while (!stop) {
+    sum += 1.0;
+    ++count;
+    if (sum != static_cast<double>(count)) {
+      return 2;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,253 @@
+//===-- pe.cpp - PE image parsing tests -----------------------------------===//
+//
+// Copyright (c) 2025 Nuclearist <nuclearist@teknology-hub.com>
+// Part of tek-injector, under the GNU General Public License v3.0 or later
+// See https://github.com/teknology-hub/tek-injector/blob/main/COPYING for
+//    license information.
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+//===----------------------------------------------------------------------===//
+///
+/// @file
+///  Tests of PE image parsing: images built by @ref pe_image::build are
+///    parsed back, and truncated and randomly corrupted copies of them are
+///    parsed to check that every result stays within the content, and that
+///    the work done for crafted images is bounded.
+///
+//===----------------------------------------------------------------------===//
+#include "pe.hpp"
+
+#include "pe_image.hpp"
+#include "test.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+/// Offset of `IMAGE_FILE_HEADER::NumberOfSections` in images built by
+///    @ref pe_image::build.
+constexpr std::size_t num_sections_offset{0x86};
+
+/// Parse an image and its export names.
+///
+/// @param content
+///    Content of the image file.
+/// @param [out] info
+///    Variable that receives information about the image.
+/// @param [out] names
+///    Vector that receives the export names, if the image has been parsed.
+/// @return Error of the first failed step, @ref tek_inj::pe::error::none if
+///    both succeeded.
+tek_inj::pe::error parse_all(std::span<const char> content,
+                             tek_inj::pe::image_info &info,
+                             std::vector<std::string_view> &names) {
+  names.clear();
+  if (const auto error{tek_inj::pe::parse(content, info)};
+      error != tek_inj::pe::error::none) {
+    return error;
+  }
+  return tek_inj::pe::export_names(content, info, names);
+}
+
+/// Check that export names point into the content and are bounded.
+///
+/// @param content
+///    Content of the image file.
+/// @param names
+///    Names returned by @ref tek_inj::pe::export_names.
+/// @return Value indicating whether all names are valid.
+bool names_within(std::span<const char> content,
+                  const std::vector<std::string_view> &names) {
+  if (names.size() > tek_inj::pe::max_export_names) {
+    return false;
+  }
+  for (const auto name : names) {
+    if (name.data() < content.data() ||
+        name.data() + name.size() >= content.data() + content.size() ||
+        name.data()[name.size()] != '\0' || name.size() >= 4096) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/// Generate lexically ordered export names.
+///
+/// @param count
+///    Number of names.
+/// @return The names.
+std::vector<std::string> make_names(std::size_t count) {
+  std::vector<std::string> names;
+  names.reserve(count);
+  for (std::size_t i{}; i < count; ++i) {
+    char buf[32];
+    std::snprintf(buf, sizeof buf, "fn_%08zu", i);
+    names.emplace_back(buf);
+  }
+  return names;
+}
+
+//===-- Test cases --------------------------------------------------------===//
+
+TEST_CASE(exe) {
+  const auto content{pe_image::build({})};
+  tek_inj::pe::image_info info;
+  std::vector<std::string_view> names;
+  CHECK(parse_all(content, info, names) == tek_inj::pe::error::none);
+  CHECK(info.machine == tek_inj::pe::machine_amd64);
+  CHECK(info.characteristics == tek_inj::pe::characteristic_executable);
+  CHECK(info.subsystem == tek_inj::pe::subsystem_windows_gui);
+  CHECK(info.num_sections == 1);
+  CHECK(info.exports_rva == 0);
+  CHECK(names.empty());
+}
+
+TEST_CASE(dll_exports) {
+  const auto content{pe_image::dll({"tek_gr_init", "tek_gr_ver", "z"})};
+  tek_inj::pe::image_info info;
+  std::vector<std::string_view> names;
+  CHECK(parse_all(content, info, names) == tek_inj::pe::error::none);
+  CHECK(info.characteristics & tek_inj::pe::characteristic_dll);
+  CHECK((names == std::vector<std::string_view>{"tek_gr_init", "tek_gr_ver",
+                                                "z"}));
+  CHECK(names_within(content, names));
+}
+
+TEST_CASE(not_pe) {
+  auto content{pe_image::dll()};
+  content[0] = 'X';
+  tek_inj::pe::image_info info;
+  CHECK(tek_inj::pe::parse(content, info) == tek_inj::pe::error::not_pe);
+  content = pe_image::dll();
+  content[0x80] = 'X';
+  CHECK(tek_inj::pe::parse(content, info) == tek_inj::pe::error::not_pe);
+  content = pe_image::dll();
+  content[0x98] = 0;
+  CHECK(tek_inj::pe::parse(content, info) ==
+        tek_inj::pe::error::bad_optional_header);
+}
+
+TEST_CASE(truncated) {
+  // Every prefix of a valid image either fails or yields the same names
+  const auto content{pe_image::dll({"a", "bc", "def"})};
+  int failures{};
+  for (std::size_t size{}; size < content.size(); ++size) {
+    const std::span prefix{content.data(), size};
+    tek_inj::pe::image_info info;
+    std::vector<std::string_view> names;
+    const auto error{parse_all(prefix, info, names)};
+    if (error == tek_inj::pe::error::none || !names_within(prefix, names)) {
+      ++failures;
+    }
+  }
+  CHECK(failures == 0);
+}
+
+TEST_CASE(section_limit) {
+  const auto storage{make_names(16)};
+  const std::vector<std::string_view> exports(storage.begin(), storage.end());
+  auto content{pe_image::build({.characteristics =
+                                    tek_inj::pe::characteristic_executable |
+                                    tek_inj::pe::characteristic_dll,
+                                .exports = exports,
+                                .empty_sections =
+                                    tek_inj::pe::max_sections - 1})};
+  tek_inj::pe::image_info info;
+  std::vector<std::string_view> names;
+  CHECK(parse_all(content, info, names) == tek_inj::pe::error::none);
+  CHECK(info.num_sections == tek_inj::pe::max_sections);
+  CHECK(names == exports);
+  auto unchecked{info};
+  const std::uint16_t too_many{tek_inj::pe::max_sections + 1};
+  std::memcpy(content.data() + num_sections_offset, &too_many,
+              sizeof too_many);
+  CHECK(tek_inj::pe::parse(content, info) ==
+        tek_inj::pe::error::too_many_sections);
+  // export_names itself never looks past the limit, even if called with
+  //    unchecked information
+  unchecked.num_sections = UINT16_MAX;
+  CHECK(tek_inj::pe::export_names(content, unchecked, names) ==
+        tek_inj::pe::error::none);
+  CHECK(names == exports);
+}
+
+TEST_CASE(export_name_limit) {
+  auto content{pe_image::dll({"a"})};
+  tek_inj::pe::image_info info;
+  CHECK(tek_inj::pe::parse(content, info) == tek_inj::pe::error::none);
+  // NumberOfNames of the export directory at the start of the section
+  const std::uint32_t too_many{tek_inj::pe::max_export_names + 1};
+  std::memcpy(content.data() + 0x200 + 24, &too_many, sizeof too_many);
+  std::vector<std::string_view> names;
+  CHECK(tek_inj::pe::export_names(content, info, names) ==
+        tek_inj::pe::error::bad_exports);
+}
+
+TEST_CASE(worst_case_work) {
+  // The most sections, with the exports in the last one, and the most names
+  const auto storage{make_names(tek_inj::pe::max_export_names)};
+  const std::vector<std::string_view> exports(storage.begin(), storage.end());
+  const auto content{pe_image::build(
+      {.characteristics = tek_inj::pe::characteristic_executable |
+                          tek_inj::pe::characteristic_dll,
+       .exports = exports,
+       .empty_sections = tek_inj::pe::max_sections - 1})};
+  tek_inj::pe::image_info info;
+  std::vector<std::string_view> names;
+  const auto start{std::chrono::steady_clock::now()};
+  CHECK(parse_all(content, info, names) == tek_inj::pe::error::none);
+  const auto elapsed{std::chrono::steady_clock::now() - start};
+  CHECK(names.size() == exports.size());
+  // Generous even for sanitized builds, an unbounded scan takes far longer
+  CHECK(elapsed < std::chrono::seconds{2});
+}
+
+TEST_CASE(fuzz) {
+  // Corrupt random bytes of valid images, mostly in headers and the export
+  //    directory, and check that parsing never reads or returns anything
+  //    outside of the content
+  const std::vector<std::string> seeds{
+      pe_image::build({}), pe_image::dll({"tek_gr_init", "tek_gr_ver"}),
+      pe_image::build({.characteristics =
+                           tek_inj::pe::characteristic_executable |
+                           tek_inj::pe::characteristic_dll,
+                       .exports = {"a", "b", "c"},
+                       .empty_sections = 3})};
+  std::mt19937 rng{0x7E4};
+  int failures{};
+  for (int i{}; i < 200000; ++i) {
+    auto content{seeds[i % seeds.size()]};
+    const auto num_flips{1 + rng() % 8};
+    for (std::uint32_t j{}; j < num_flips; ++j) {
+      const auto hot{std::min<std::size_t>(content.size(), 0x300)};
+      const auto pos{rng() % 4 ? rng() % hot : rng() % content.size()};
+      content[pos] = static_cast<char>(rng() % 4 ? rng() : content[pos] ^ 0x80);
+    }
+    if (rng() % 8 == 0) {
+      content.resize(rng() % (content.size() + 1));
+    }
+    tek_inj::pe::image_info info;
+    std::vector<std::string_view> names;
+    if (parse_all(content, info, names) == tek_inj::pe::error::none &&
+        (info.num_sections > tek_inj::pe::max_sections ||
+         info.sections_offset + info.num_sections * 40 > content.size() ||
+         !names_within(content, names))) {
+      ++failures;
+    }
+  }
+  CHECK(failures == 0);
+}
+
+} // namespace
+
+int main(int argc, char **argv) { return test::run(argc, argv); }
@@ -0,0 +1,128 @@
+//===-- pe_image.hpp - PE image builder for tests -------------------------===//
+//
+// Copyright (c) 2025 Nuclearist <nuclearist@teknology-hub.com>
+// Part of tek-injector, under the GNU General Public License v3.0 or later
+// See https://github.com/teknology-hub/tek-injector/blob/main/COPYING for
+//    license information.
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+//===----------------------------------------------------------------------===//
+///
+/// @file
+///  Builder of minimal PE32+ image files with a single section holding the
+///    export directory, for testing image validation.
+///
+//===----------------------------------------------------------------------===//
+#pragma once
+
+#include "pe.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace pe_image {
+
+/// Parameters of an image to build.
+struct params {
+  /// Target architecture of the image.
+  std::uint16_t machine{tek_inj::pe::machine_amd64};
+  /// Image characteristic flags.
+  std::uint16_t characteristics{tek_inj::pe::characteristic_executable};
+  /// Subsystem required to run the image.
+  std::uint16_t subsystem{tek_inj::pe::subsystem_windows_gui};
+  /// Names of exported functions, in lexical order.
+  std::vector<std::string_view> exports;
+  /// Number of sections without raw data to put in the section table before
+  ///    the one holding the export directory.
+  std::uint16_t empty_sections{};
+};
+
+/// Build an image file.
+///
+/// @param p
+///    Parameters of the image.
+/// @return Content of the image file.
+inline std::string build(const params &p) {
+  constexpr std::size_t nt_offset{0x80};
+  constexpr std::size_t optional_header_size{112 + 16 * 8};
+  constexpr std::size_t sections_offset{nt_offset + 4 + 20 +
+                                        optional_header_size};
+  const std::uint16_t num_sections{
+      static_cast<std::uint16_t>(p.empty_sections + 1)};
+  // Raw data follows the section table, aligned to 512 bytes
+  const std::size_t section_offset{
+      (sections_offset + num_sections * 40 + 0x1FF) & ~std::size_t{0x1FF}};
+  constexpr std::uint32_t section_rva{0x1000};
+  std::string res(section_offset, '\0');
+  const auto put{[&res](std::size_t offset, auto value) {
+    if (res.size() < offset + sizeof value) {
+      res.resize(offset + sizeof value);
+    }
+    std::memcpy(res.data() + offset, &value, sizeof value);
+  }};
+  put(0, std::uint16_t{0x5A4D});
+  put(0x3C, std::uint32_t{nt_offset});
+  put(nt_offset, std::uint32_t{0x00004550});
+  const auto file_header{nt_offset + 4};
+  put(file_header, p.machine);
+  put(file_header + 2, num_sections);
+  put(file_header + 16, std::uint16_t{optional_header_size});
+  put(file_header + 18, p.characteristics);
+  const auto optional_header{file_header + 20};
+  put(optional_header, std::uint16_t{0x20B});
+  put(optional_header + 68, p.subsystem);
+  put(optional_header + 108, std::uint32_t{16});
+  // Section data: export directory, name pointer table, then names
+  std::string section(40, '\0');
+  const auto names_table{section.size()};
+  section.resize(names_table + p.exports.size() * 4);
+  for (std::size_t i{}; i < p.exports.size(); ++i) {
+    const auto name_rva{
+        static_cast<std::uint32_t>(section_rva + section.size())};
+    std::memcpy(section.data() + names_table + i * 4, &name_rva,
+                sizeof name_rva);
+    section += p.exports[i];
+    section += '\0';
+  }
+  const auto num_names{static_cast<std::uint32_t>(p.exports.size())};
+  const auto names_rva{static_cast<std::uint32_t>(section_rva + names_table)};
+  std::memcpy(section.data() + 24, &num_names, sizeof num_names);
+  std::memcpy(section.data() + 32, &names_rva, sizeof names_rva);
+  if (!p.exports.empty()) {
+    put(optional_header + 112, section_rva);
+    put(optional_header + 116, static_cast<std::uint32_t>(section.size()));
+  }
+  for (std::uint16_t i{}; i < p.empty_sections; ++i) {
+    // Empty sections are placed after the one with data in address space
+    put(sections_offset + i * 40 + 12,
+        static_cast<std::uint32_t>(section_rva + 0x100000 + i * 0x1000));
+  }
+  const auto section_header{sections_offset + p.empty_sections * 40};
+  const auto section_size{static_cast<std::uint32_t>(section.size())};
+  put(section_header + 8, section_size);
+  put(section_header + 12, section_rva);
+  put(section_header + 16, section_size);
+  put(section_header + 20, static_cast<std::uint32_t>(section_offset));
+  res += section;
+  return res;
+}
+
+/// Build a DLL image file for the native architecture.
+///
+/// @param exports
+///    Names of exported functions, in lexical order.
+/// @return Content of the image file.
+inline std::string dll(std::vector<std::string_view> exports = {}) {
+  return build({.machine = tek_inj::pe::machine_amd64,
+                .characteristics = tek_inj::pe::characteristic_executable |
+                                   tek_inj::pe::characteristic_dll,
+                .subsystem = tek_inj::pe::subsystem_windows_gui,
+                .exports = std::move(exports)});
+}
+
+} // namespace pe_image
@@ -0,0 +1,185 @@
+//===-- prefetch_bench.cpp - File read-ahead benchmark --------------------===//
+//
+// Copyright (c) 2025 Nuclearist <nuclearist@teknology-hub.com>
+// Part of tek-injector, under the GNU General Public License v3.0 or later
+// See https://github.com/teknology-hub/tek-injector/blob/main/COPYING for
+//    license information.
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+//===----------------------------------------------------------------------===//
+///
+/// @file
+///  Benchmark of the POSIX read-ahead on cold starts. Files standing in for
+///    game executable, TEK Game Runtime, the settings file and a large asset
+///    are created in current directory, evicted from the page cache before
+///    every round, and read sequentially on a single thread, the way the
+///    dynamic linker and the game read them:
+///  - "cold": without read-ahead.
+///  - "prefetch": after read-ahead by @ref tek_inj::prefetch workers started
+///    when a launch would start, and waited for when game process would be
+///    released, with a fixed delay standing in for process creation in
+///    between.
+///  - "warm": without evicting the files, the lower bound.
+///  Eviction has no effect on file systems without a page cache, such as
+///    tmpfs, where all cases are warm.
+///  Size of the asset in MiB and the number of rounds may be passed as
+///    arguments.
+///
+//===----------------------------------------------------------------------===//
+#include "prefetch.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+namespace {
+
+/// Names and sizes of the files, in KiB, except for the asset.
+constexpr std::array<std::pair<const char *, std::size_t>, 4> files{
+    {{"prefetch-bench-game", 64 * 1024},
+     {"prefetch-bench-runtime.so", 8 * 1024},
+     {"prefetch-bench-settings.json", 4},
+     {"prefetch-bench-asset.pak", 0}}};
+
+/// Delay standing in for game process creation.
+constexpr std::chrono::milliseconds create_delay{20};
+
+/// Value that the read data is folded into, so reading isn't optimized out.
+volatile unsigned char sink;
+
+/// Create a file filled with non-zero data.
+///
+/// @param name
+///    Name of the file.
+/// @param size
+///    Size of the file, in KiB.
+/// @return Value indicating whether the file has been created.
+bool create_file(const char *name, std::size_t size) {
+  const int fd{open(name, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644)};
+  if (fd < 0) {
+    return false;
+  }
+  std::vector<unsigned char> buf(1024);
+  bool ok{true};
+  for (std::size_t i{}; ok && i < size; ++i) {
+    std::ranges::fill(buf, static_cast<unsigned char>(i | 1));
+    ok = write(fd, buf.data(), buf.size()) ==
+         static_cast<ssize_t>(buf.size());
+  }
+  // Dirty pages can't be evicted
+  ok = ok && !fdatasync(fd);
+  close(fd);
+  return ok;
+}
+
+/// Evict all files from the page cache.
+void evict() {
+  for (const auto &[name, size] : files) {
+    const int fd{open(name, O_RDONLY | O_CLOEXEC)};
+    if (fd >= 0) {
+      posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+      close(fd);
+    }
+  }
+}
+
+/// Read all files sequentially.
+void read_all() {
+  std::vector<unsigned char> buf(1024 * 1024);
+  for (const auto &[name, size] : files) {
+    const int fd{open(name, O_RDONLY | O_CLOEXEC)};
+    if (fd < 0) {
+      continue;
+    }
+    for (ssize_t res; (res = read(fd, buf.data(), buf.size())) > 0;) {
+      sink = buf[static_cast<std::size_t>(res) - 1];
+    }
+    close(fd);
+  }
+}
+
+/// Run a benchmark and print its results.
+///
+/// @param name
+///    Name of the benchmark.
+/// @param num_rounds
+///    Number of rounds to run.
+/// @param cold
+///    Value indicating whether the files should be evicted before every
+///    round.
+/// @param prefetch
+///    Value indicating whether read-ahead should be started before reading.
+void bench(const char *name, int num_rounds, bool cold, bool prefetch) {
+  std::chrono::duration<double, std::milli> total{};
+  std::uint64_t bytes{};
+  for (int i{}; i < num_rounds; ++i) {
+    if (cold) {
+      evict();
+    }
+    const auto start{std::chrono::steady_clock::now()};
+    if (prefetch) {
+      tek_inj::prefetch::batch<std::string> batch;
+      for (const auto &[file_name, size] : files) {
+        batch.paths.emplace_back(file_name);
+      }
+      std::vector<std::thread> threads;
+      for (auto n{batch.start()}; n; --n) {
+        threads.emplace_back([&batch] {
+          batch.work([](const std::string &path) {
+            return tek_inj::prefetch::read_ahead(AT_FDCWD, path.c_str());
+          });
+        });
+      }
+      std::this_thread::sleep_for(create_delay);
+      for (auto &thread : threads) {
+        thread.join();
+      }
+      bytes = batch.bytes.load(std::memory_order::relaxed);
+    } else {
+      std::this_thread::sleep_for(create_delay);
+    }
+    read_all();
+    total += std::chrono::steady_clock::now() - start;
+  }
+  std::printf("%-10s %10.2f ms/round %12llu bytes prefetched\n", name,
+              total.count() / num_rounds,
+              static_cast<unsigned long long>(bytes));
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  const int asset_size{argc > 1 ? std::atoi(argv[1]) : 256};
+  const int num_rounds{argc > 2 ? std::atoi(argv[2]) : 5};
+  if (asset_size <= 0 || num_rounds <= 0) {
+    return 1;
+  }
+  int res{};
+  for (const auto &[name, size] : files) {
+    const auto kib{size ? size : static_cast<std::size_t>(asset_size) * 1024};
+    if (!create_file(name, kib)) {
+      std::perror(name);
+      res = 1;
+      break;
+    }
+  }
+  if (!res) {
+    bench("cold", num_rounds, true, false);
+    bench("prefetch", num_rounds, true, true);
+    bench("warm", num_rounds, false, false);
+  }
+  for (const auto &[name, size] : files) {
+    unlink(name);
+  }
+  return res;
+}
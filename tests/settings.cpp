@@ -0,0 +1,354 @@
+//===-- settings.cpp - Binary settings encoding tests ---------------------===//
+//
+// Copyright (c) 2025 Nuclearist <nuclearist@teknology-hub.com>
+// Part of tek-injector, under the GNU General Public License v3.0 or later
+// See https://github.com/teknology-hub/tek-injector/blob/main/COPYING for
+//    license information.
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+//===----------------------------------------------------------------------===//
+///
+/// @file
+///  Tests of binary settings encoding: JSON is encoded, decoded back into
+///    JSON and encoded again, and both encodings must be identical. Values
+///    are checked via the reader, compression is round-tripped, and every
+///    truncated or corrupted input must be rejected without reading out of
+///    bounds.
+///
+//===----------------------------------------------------------------------===//
+#include "settings.hpp"
+
+#include "settings_sample.hpp"
+#include "test.hpp"
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace {
+
+using namespace tek_inj::settings;
+
+/// Encode JSON.
+///
+/// @param json
+///    The JSON to encode.
+/// @return The encoding, or `std::nullopt` if @p json is invalid.
+std::optional<std::string> encode_json(std::string_view json) {
+  const auto res{encode(json, nullptr, 0)};
+  if (!res.valid) {
+    return std::nullopt;
+  }
+  std::string enc(res.size, '\0');
+  // Partial writes must match the full encoding
+  const auto half{res.size / 2};
+  if (encode(json, enc.data(), half).size != res.size) {
+    return std::nullopt;
+  }
+  const auto head{enc.substr(0, half)};
+  if (encode(json, enc.data(), enc.size()).size != res.size ||
+      enc.compare(0, half, head) != 0) {
+    return std::nullopt;
+  }
+  return enc;
+}
+
+/// Decode binary encoding into JSON.
+///
+/// @param enc
+///    The encoding to decode.
+/// @return The JSON, or `std::nullopt` if @p enc is invalid.
+std::optional<std::string> decode_json(std::string_view enc) {
+  const auto res{decode(enc, nullptr, 0)};
+  if (!res.valid) {
+    return std::nullopt;
+  }
+  std::string json(res.size, '\0');
+  if (decode(enc, json.data(), json.size()).size != res.size) {
+    return std::nullopt;
+  }
+  return json;
+}
+
+/// Check that JSON survives encoding, decoding and encoding again.
+///
+/// @param json
+///    The JSON to check.
+/// @return The JSON produced by the decoder, or `std::nullopt` if the check
+///    has failed.
+std::optional<std::string> round_trip(std::string_view json) {
+  const auto enc{encode_json(json)};
+  if (!enc) {
+    return std::nullopt;
+  }
+  auto decoded{decode_json(*enc)};
+  if (!decoded) {
+    return std::nullopt;
+  }
+  const auto reencoded{encode_json(*decoded)};
+  if (!reencoded || *reencoded != *enc) {
+    return std::nullopt;
+  }
+  // Decoder output is canonical
+  if (decode_json(*reencoded) != decoded) {
+    return std::nullopt;
+  }
+  return decoded;
+}
+
+/// Encode a single JSON value and read it back.
+///
+/// @param json
+///    The JSON value.
+/// @param [out] enc_storage
+///    Variable that receives the encoding, which string values refer to.
+/// @return The value read, or `std::nullopt` if encoding or reading has
+///    failed.
+std::optional<value> read_one(std::string_view json,
+                              std::string &enc_storage) {
+  const auto enc{encode_json(json)};
+  if (!enc) {
+    return std::nullopt;
+  }
+  enc_storage = *enc;
+  reader rd{enc_storage};
+  value val;
+  if (!rd.read(val) || !rd.at_end()) {
+    return std::nullopt;
+  }
+  return val;
+}
+
+//===-- Test cases --------------------------------------------------------===//
+
+TEST_CASE(literals) {
+  CHECK(round_trip("null") == "null");
+  CHECK(round_trip(" true ") == "true");
+  CHECK(round_trip("false") == "false");
+  CHECK(round_trip(R"([ null , true,false ])") == "[null,true,false]");
+}
+
+TEST_CASE(integers) {
+  CHECK(round_trip("0") == "0");
+  CHECK(round_trip("-1") == "-1");
+  CHECK(round_trip("346110") == "346110");
+  CHECK(round_trip("9223372036854775807") == "9223372036854775807");
+  CHECK(round_trip("-9223372036854775808") == "-9223372036854775808");
+  std::string enc;
+  const auto val{read_one("-9223372036854775808", enc)};
+  CHECK(val && val->type == tag::integer &&
+        val->integer == std::numeric_limits<std::int64_t>::min());
+  // Too large for 64 bits, becomes a floating-point number
+  const auto big{read_one("9223372036854775808", enc)};
+  CHECK(big && big->type == tag::number && big->number == 0x1p63);
+}
+
+TEST_CASE(numbers) {
+  CHECK(round_trip("1.5") == "1.5");
+  CHECK(round_trip("1.0") == "1.0");
+  CHECK(round_trip("1E5") == "1e+05");
+  CHECK(round_trip("123456.0") == "123456.0");
+  CHECK(round_trip("0.1") == "0.1");
+  CHECK(round_trip("2.5e-308") == "2.5e-308");
+  CHECK(round_trip("4.9e-324") == "5e-324");
+  CHECK(round_trip("1.7976931348623157e308") == "1.7976931348623157e+308");
+  std::string enc;
+  const auto val{read_one("-12.25", enc)};
+  CHECK(val && val->type == tag::number && val->number == -12.25);
+}
+
+TEST_CASE(negative_zero) {
+  for (const auto json : {"-0", "-0.0", "-0e10"}) {
+    std::string enc;
+    const auto val{read_one(json, enc)};
+    CHECK(val && val->type == tag::number && val->number == 0 &&
+          std::signbit(val->number));
+    CHECK(round_trip(json) == "-0.0");
+  }
+  std::string enc;
+  const auto zero{read_one("0", enc)};
+  CHECK(zero && zero->type == tag::integer && zero->integer == 0);
+}
+
+TEST_CASE(out_of_range_numbers) {
+  // Valid JSON numbers outside of binary64 range are kept as text
+  for (const auto json :
+       {"1e400", "-1e400", "1E+999999", "2.5e-400", "-1e-99999"}) {
+    std::string enc;
+    const auto val{read_one(json, enc)};
+    CHECK(val && val->type == tag::decimal && val->string == json);
+    CHECK(round_trip(json) == json);
+  }
+  CHECK(round_trip(R"({"a":[1e400,0]})") == R"({"a":[1e400,0]})");
+}
+
+TEST_CASE(strings) {
+  CHECK(round_trip(R"("")") == R"("")");
+  CHECK(round_trip(R"("plain")") == R"("plain")");
+  CHECK(round_trip(R"("\"\\\/\b\f\n\r\t")") == R"("\"\\/\b\f\n\r\t")");
+  CHECK(round_trip(R"("\u0001\u001F")") == R"("\u0001\u001f")");
+  // Non-ASCII characters are stored as UTF-8
+  std::string enc;
+  const auto val{read_one(R"("\u00e9\u20AC\ud83d\ude00")", enc)};
+  CHECK(val && val->type == tag::string &&
+        val->string == "\xC3\xA9\xE2\x82\xAC\xF0\x9F\x98\x80");
+  CHECK(round_trip(R"("\u00e9")") == "\"\xC3\xA9\"");
+}
+
+TEST_CASE(containers) {
+  CHECK(round_trip("[]") == "[]");
+  CHECK(round_trip("{}") == "{}");
+  CHECK(round_trip(R"({ "a" : [ 1, { "b" : [] } ], "" : {} })") ==
+        R"({"a":[1,{"b":[]}],"":{}})");
+  std::string deep(256, '[');
+  deep.append(256, ']');
+  CHECK(round_trip(deep) == deep);
+  deep.insert(0, "[");
+  deep += ']';
+  CHECK(!encode(deep, nullptr, 0).valid);
+}
+
+TEST_CASE(reader_walk) {
+  const auto enc{encode_json(R"({"steam":{"app_id":346110},"mods":[1,2,3],)"
+                             R"("name":"x"})")};
+  CHECK(enc);
+  if (!enc) {
+    return;
+  }
+  reader rd{*enc};
+  value val;
+  CHECK(rd.read(val) && val.type == tag::object && val.count == 3);
+  std::string_view key;
+  CHECK(rd.read_key(key) && key == "steam");
+  CHECK(rd.skip());
+  CHECK(rd.read_key(key) && key == "mods");
+  CHECK(rd.read(val) && val.type == tag::array && val.count == 3);
+  for (std::int64_t i{1}; i <= 3; ++i) {
+    CHECK(rd.read(val) && val.type == tag::integer && val.integer == i);
+  }
+  CHECK(rd.read_key(key) && key == "name");
+  CHECK(rd.read(val) && val.type == tag::string && val.string == "x");
+  CHECK(rd.at_end());
+  CHECK(!rd.read(val));
+}
+
+TEST_CASE(invalid_json) {
+  const struct {
+    std::string_view json;
+    std::size_t offset;
+  } cases[]{{"", 0},           {"nul", 0},       {"[1,]", 3},
+            {"{\"a\" 1}", 5},  {"01", 1},        {"1.", 2},
+            {"1e", 2},         {"-", 1},         {"\"a", 2},
+            {"\"\\x\"", 2},    {"\"\\ud800\"", 7}, {"[1] 2", 4},
+            {"\"\x01\"", 1}};
+  for (const auto &c : cases) {
+    const auto res{encode(c.json, nullptr, 0)};
+    CHECK(!res.valid);
+    CHECK(res.size == c.offset);
+  }
+}
+
+TEST_CASE(sample) {
+  const auto json{sample::settings(64)};
+  const auto enc{encode_json(json)};
+  CHECK(enc && enc->size() < json.size());
+  CHECK(round_trip(json));
+}
+
+TEST_CASE(malformed_encoding) {
+  const auto enc{encode_json(sample::settings(4))};
+  CHECK(enc);
+  if (!enc) {
+    return;
+  }
+  // Every proper prefix is rejected
+  for (std::size_t len{}; len < enc->size(); ++len) {
+    if (decode({enc->data(), len}, nullptr, 0).valid) {
+      CHECK(!"prefix accepted");
+      break;
+    }
+  }
+  // Trailing data is rejected
+  CHECK(!decode(*enc + '\0', nullptr, 0).valid);
+  // Corrupted bytes may produce other valid encodings, but never crash
+  for (std::size_t i{}; i < enc->size(); ++i) {
+    for (const auto byte : {0x00, 0x08, 0x09, 0x7F, 0xFF}) {
+      auto corrupted{*enc};
+      corrupted[i] = static_cast<char>(byte);
+      static_cast<void>(decode(corrupted, nullptr, 0));
+      reader rd{corrupted};
+      static_cast<void>(rd.skip());
+    }
+  }
+  // Counts larger than the remaining data are rejected before use
+  const std::string huge{"\x06\xFF\xFF\xFF\xFF\x00", 6};
+  reader rd{huge};
+  value val;
+  CHECK(!rd.read(val));
+}
+
+TEST_CASE(compression) {
+  const auto enc{encode_json(sample::settings(64))};
+  CHECK(enc);
+  if (!enc) {
+    return;
+  }
+  std::string compressed(enc->size(), '\0');
+  compressed.resize(compress(*enc, compressed.data(), compressed.size()));
+  CHECK(!compressed.empty() && compressed.size() < enc->size() / 2);
+  CHECK(is_compressed(compressed));
+  CHECK(!is_compressed(*enc));
+  CHECK(decompressed_size(compressed) == enc->size());
+  std::string decompressed(decompressed_size(compressed), '\0');
+  CHECK(decompress(compressed, decompressed.data()));
+  CHECK(decompressed == *enc);
+  // Too small output buffer
+  std::string small(compressed.size() - 1, '\0');
+  CHECK(!compress(*enc, small.data(), small.size()));
+  // Inputs shorter than a match, and runs that overlap their output
+  using namespace std::string_view_literals;
+  for (const auto data :
+       {""sv, "\0"sv, "abcdabcdabcd"sv,
+        "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa"sv}) {
+    std::string out(data.size() + 16, '\0');
+    out.resize(compress(data, out.data(), out.size()));
+    CHECK(!out.empty());
+    std::string back(decompressed_size(out), '\0');
+    CHECK(decompress(out, back.data()) && back == data);
+  }
+}
+
+TEST_CASE(malformed_compression) {
+  const auto enc{encode_json(sample::settings(4))};
+  CHECK(enc);
+  if (!enc) {
+    return;
+  }
+  std::string compressed(enc->size(), '\0');
+  compressed.resize(compress(*enc, compressed.data(), compressed.size()));
+  CHECK(!compressed.empty());
+  std::string out(enc->size(), '\0');
+  for (std::size_t len{compressed_header_size}; len < compressed.size();
+       ++len) {
+    if (decompress({compressed.data(), len}, out.data())) {
+      CHECK(!"truncated block accepted");
+      break;
+    }
+  }
+  // Corrupted blocks never write past the declared size
+  for (std::size_t i{compressed_header_size}; i < compressed.size(); ++i) {
+    for (const auto byte : {0x00, 0x0F, 0xF0, 0xFF}) {
+      auto corrupted{compressed};
+      corrupted[i] = static_cast<char>(byte);
+      std::string buf(decompressed_size(corrupted), '\0');
+      static_cast<void>(decompress(corrupted, buf.data()));
+    }
+  }
+}
+
+} // namespace
+
+int main(int argc, char **argv) { return test::run(argc, argv); }
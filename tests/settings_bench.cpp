@@ -0,0 +1,148 @@
+//===-- settings_bench.cpp - Binary settings encoding benchmark -----------===//
+//
+// Copyright (c) 2025 Nuclearist <nuclearist@teknology-hub.com>
+// Part of tek-injector, under the GNU General Public License v3.0 or later
+// See https://github.com/teknology-hub/tek-injector/blob/main/COPYING for
+//    license information.
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+//===----------------------------------------------------------------------===//
+///
+/// @file
+///  Benchmark of sizes and speeds of settings formats on generated settings
+///    files of typical and large sizes. JSON validation by the encoder stands
+///    in for runtime's JSON parsing, which it's at least as fast as, and is
+///    compared with walking binary encoding by the reader, decompression and
+///    decoding back into JSON.
+///  The number of iterations per case may be passed as the only argument.
+///
+//===----------------------------------------------------------------------===//
+#include "settings.hpp"
+
+#include "settings_sample.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <string_view>
+
+namespace {
+
+using namespace tek_inj::settings;
+
+/// Value that results are folded into, so computing them isn't optimized out.
+volatile std::size_t sink;
+
+/// Measure average duration of a function call.
+///
+/// @param iterations
+///    Number of calls to make.
+/// @param fn
+///    The function to call.
+/// @return Average duration of a call, in microseconds.
+template <typename F> double measure(int iterations, F &&fn) {
+  const auto start{std::chrono::steady_clock::now()};
+  for (int i{}; i < iterations; ++i) {
+    sink = sink + fn();
+  }
+  const std::chrono::duration<double, std::micro> elapsed{
+      std::chrono::steady_clock::now() - start};
+  return elapsed.count() / iterations;
+}
+
+/// Read a value of binary encoding along with its elements or members, as a
+///    runtime loading settings would.
+///
+/// @param rd
+///    Reader of the encoding.
+/// @return Number of values read, or 0 if the encoding is invalid.
+std::size_t walk_value(reader &rd) {
+  value val;
+  if (!rd.read(val)) {
+    return 0;
+  }
+  std::size_t num_values{1};
+  if (val.type == tag::array || val.type == tag::object) {
+    for (std::uint32_t i{}; i < val.count; ++i) {
+      std::string_view key;
+      if (val.type == tag::object && !rd.read_key(key)) {
+        return 0;
+      }
+      const auto num{walk_value(rd)};
+      if (!num) {
+        return 0;
+      }
+      num_values += num;
+    }
+  }
+  return num_values;
+}
+
+/// Read all values of binary encoding.
+///
+/// @param enc
+///    The encoding.
+/// @return Number of values read, or 0 if the encoding is invalid.
+std::size_t walk(std::string_view enc) {
+  reader rd{enc};
+  const auto num_values{walk_value(rd)};
+  return rd.at_end() ? num_values : 0;
+}
+
+/// Run benchmarks on a settings file and print their results.
+///
+/// @param name
+///    Name of the file.
+/// @param num_mods
+///    Number of mods in the file.
+/// @param iterations
+///    Number of iterations per case.
+void bench(const char *name, int num_mods, int iterations) {
+  const auto json{sample::settings(num_mods)};
+  std::string enc(encode(json, nullptr, 0).size, '\0');
+  encode(json, enc.data(), enc.size());
+  std::string compressed(enc.size(), '\0');
+  compressed.resize(compress(enc, compressed.data(), compressed.size()));
+  std::string buf(enc.size(), '\0');
+  std::string decoded(decode(enc, nullptr, 0).size, '\0');
+  std::printf("%s: JSON %zu bytes, binary %zu bytes, compressed %zu bytes, "
+              "%zu values\n",
+              name, json.size(), enc.size(), compressed.size(), walk(enc));
+  const auto print{[](const char *op, double us) {
+    std::printf("  %-20s %10.2f us\n", op, us);
+  }};
+  print("validate JSON", measure(iterations, [&] {
+          return encode(json, nullptr, 0).size;
+        }));
+  print("encode", measure(iterations, [&] {
+          return encode(json, enc.data(), enc.size()).size;
+        }));
+  print("compress", measure(iterations, [&] {
+          return compress(enc, buf.data(), buf.size());
+        }));
+  print("walk binary", measure(iterations, [&] { return walk(enc); }));
+  print("decompress", measure(iterations, [&] {
+          return std::size_t{decompress(compressed, buf.data())};
+        }));
+  print("decompress + walk", measure(iterations, [&] {
+          decompress(compressed, buf.data());
+          return walk(buf);
+        }));
+  print("decode to JSON", measure(iterations, [&] {
+          return decode(enc, decoded.data(), decoded.size()).size;
+        }));
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  const int iterations{argc > 1 ? std::atoi(argv[1]) : 200};
+  if (iterations <= 0) {
+    return 1;
+  }
+  bench("typical (40 mods)", 40, iterations * 10);
+  bench("large (2000 mods)", 2000, iterations);
+  return 0;
+}
@@ -0,0 +1,61 @@
+//===-- settings_sample.hpp - Sample settings for tests -------------------===//
+//
+// Copyright (c) 2025 Nuclearist <nuclearist@teknology-hub.com>
+// Part of tek-injector, under the GNU General Public License v3.0 or later
+// See https://github.com/teknology-hub/tek-injector/blob/main/COPYING for
+//    license information.
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+//===----------------------------------------------------------------------===//
+///
+/// @file
+///  Generator of TEK Game Runtime settings JSON resembling real files: Steam
+///    app and DLC IDs, and a list of Steam Workshop mods with their names,
+///    paths and metadata, which is what makes real files large.
+///
+//===----------------------------------------------------------------------===//
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace sample {
+
+/// Generate settings JSON.
+///
+/// @param num_mods
+///    Number of mods to list.
+/// @return The JSON, pretty-printed with 2-space indentation.
+inline std::string settings(int num_mods) {
+  std::string json{R"({
+  "steam": {
+    "app_id": 346110,
+    "spoof_app_id": 480,
+    "dlcs": [473850, 512540, 642250, 708770, 887380, 1113410, 1270830],
+    "language": "english",
+    "user": {"steam_id": "76561198000000000", "name": "Survivor"}
+  },
+  "mods": [)"};
+  std::uint64_t id{731604991};
+  for (int i{}; i < num_mods; ++i) {
+    id = id * 6364136223846793005 + 1442695040888963407;
+    const auto mod_id{std::to_string(1000000000 + id % 2000000000)};
+    json += i ? ",\n    {" : "\n    {";
+    json += R"("id": )" + mod_id;
+    json += R"(, "name": "Mod number )" + std::to_string(i) +
+            R"( \u2013 structures & \"tweaks\"")";
+    json += R"(, "path": "C:\\Program Files (x86)\\Steam\\steamapps\\)"
+            R"(workshop\\content\\346110\\)" +
+            mod_id + R"(")";
+    json += R"(, "enabled": )";
+    json += i % 7 ? "true" : "false";
+    json += R"(, "priority": )" + std::to_string(num_mods - i);
+    json += R"(, "size": )" + std::to_string(id % 5000000000);
+    json += R"(, "rating": )" + std::to_string(id % 100) + ".25";
+    json += R"(, "tags": ["structures", "qol", null]})";
+  }
+  json += "\n  ],\n  \"log_level\": 2\n}\n";
+  return json;
+}
+
+} // namespace sample
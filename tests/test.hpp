@@ -0,0 +1,107 @@
+//===-- test.hpp - Minimal test harness -----------------------------------===//
+//
+// Copyright (c) 2025 Nuclearist <nuclearist@teknology-hub.com>
+// Part of tek-injector, under the GNU General Public License v3.0 or later
+// See https://github.com/teknology-hub/tek-injector/blob/main/COPYING for
+//    license information.
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+//===----------------------------------------------------------------------===//
+///
+/// @file
+///  Registration and running of test cases, shared by all test programs.
+///  A program defines cases with @ref TEST_CASE and calls @ref test::run from
+///    `main`. Failed checks are reported and counted, but don't stop the
+///    case, so a single run shows every broken expectation.
+///
+//===----------------------------------------------------------------------===//
+#pragma once
+
+#include <cstdio>
+#include <string_view>
+#include <vector>
+
+namespace test {
+
+/// Registered test case.
+struct test_case {
+  /// Name of the case, which may be passed on the command line to run only
+  ///    that case.
+  std::string_view name;
+  /// Function implementing the case.
+  void (*fn)();
+};
+
+/// Get the list of registered test cases.
+inline std::vector<test_case> &cases() {
+  static std::vector<test_case> list;
+  return list;
+}
+
+/// Number of checks that have failed so far.
+inline int num_failures;
+
+/// Report a failed check.
+inline void fail(const char *expr, const char *file, int line) {
+  std::fprintf(stderr, "%s:%d: check failed: %s\n", file, line, expr);
+  ++num_failures;
+}
+
+/// Registers a test case upon construction.
+struct registrar {
+  registrar(std::string_view name, void (*fn)()) {
+    cases().emplace_back(name, fn);
+  }
+};
+
+/// Run registered test cases.
+///
+/// @param argc
+///    Number of command-line arguments.
+/// @param argv
+///    Command-line arguments, names of the cases to run. If there are none,
+///    all cases are run.
+/// @param setup
+///    Optional function to call before every case.
+/// @return Exit code for the program.
+inline int run(int argc, char **argv, void (*setup)() = nullptr) {
+  for (const auto &tc : cases()) {
+    if (argc > 1) {
+      bool selected{};
+      for (int i{1}; i < argc; ++i) {
+        if (tc.name == argv[i]) {
+          selected = true;
+          break;
+        }
+      }
+      if (!selected) {
+        continue;
+      }
+    }
+    const auto failures_before{num_failures};
+    if (setup) {
+      setup();
+    }
+    tc.fn();
+    std::fprintf(stderr, "%s %.*s\n",
+                 num_failures == failures_before ? "PASS" : "FAIL",
+                 static_cast<int>(tc.name.size()), tc.name.data());
+  }
+  return num_failures ? 1 : 0;
+}
+
+} // namespace test
+
+/// Check that a condition holds, and report it otherwise.
+#define CHECK(expr)                                                            \
+  do {                                                                         \
+    if (!(expr)) {                                                             \
+      ::test::fail(#expr, __FILE__, __LINE__);                                 \
+    }                                                                          \
+  } while (false)
+
+/// Define a test case.
+#define TEST_CASE(name)                                                        \
+  static void name();                                                          \
+  static const ::test::registrar name##_registrar{#name, name};                \
+  static void name()
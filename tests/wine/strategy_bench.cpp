@@ -0,0 +1,134 @@
+//===-- strategy_bench.cpp - Injection strategy benchmark -----------------===//
+//
+// Copyright (c) 2025 Nuclearist <nuclearist@teknology-hub.com>
+// Part of tek-injector, under the GNU General Public License v3.0 or later
+// See https://github.com/teknology-hub/tek-injector/blob/main/COPYING for
+//    license information.
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+//===----------------------------------------------------------------------===//
+///
+/// @file
+///  Benchmark of launch-to-ready latency of every injection strategy: the
+///    stub game is launched with the stub runtime injected, and the time from
+///    the call of @ref tek_inj_run_game to the runtime reporting readiness is
+///    measured for each launch. Unlike the benchmark against the fake OS
+///    layer, it uses real processes, so it's meant to be run under Wine when
+///    cross-compiling from Linux, or natively on Windows.
+///  Arguments are paths to the stub game executable and the stub runtime DLL,
+///    optionally followed by the number of launches per strategy. Unix paths,
+///    as passed by meson to programs run under Wine, are mapped to Wine's Z:
+///    drive.
+///
+//===----------------------------------------------------------------------===//
+#include "tek-injector.h"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <utility>
+#include <vector>
+#include <windows.h>
+
+namespace {
+
+/// Convert a path passed on the command line to a Windows one.
+///
+/// @param path
+///    The path.
+/// @return The Windows path.
+std::wstring windows_path(const wchar_t *path) {
+  std::wstring res{path};
+  if (res.starts_with(L'/')) {
+    res.insert(0, L"Z:");
+  }
+  std::ranges::replace(res, L'/', L'\\');
+  return res;
+}
+
+/// Run launches with a strategy and print latency statistics.
+///
+/// @param name
+///    Name of the strategy.
+/// @param strategy
+///    The strategy.
+/// @param base
+///    Arguments for the launches.
+/// @param num_launches
+///    Number of launches to make.
+/// @return Value indicating whether all launches succeeded.
+bool bench(const char *name, tek_inj_strategy strategy,
+           const tek_inj_game_args &base, int num_launches) {
+  LARGE_INTEGER freq;
+  QueryPerformanceFrequency(&freq);
+  std::vector<double> latencies;
+  latencies.reserve(num_launches);
+  for (int i{}; i < num_launches; ++i) {
+    auto args{base};
+    args.strategy = strategy;
+    tek_inj_timings timings{};
+    args.timings = &timings;
+    LARGE_INTEGER start;
+    QueryPerformanceCounter(&start);
+    tek_inj_run_game(&args);
+    if (args.result != TEK_INJ_RES_ok) {
+      std::fprintf(stderr, "%s: launch %d failed with result %d, error %lu\n",
+                   name, i, static_cast<int>(args.result), args.win32_error);
+      return false;
+    }
+    latencies.emplace_back(
+        static_cast<double>(timings.end[TEK_INJ_PHASE_runtime_init] -
+                            start.QuadPart) *
+        1e6 / static_cast<double>(freq.QuadPart));
+    TerminateProcess(args.process, 0);
+    WaitForSingleObject(args.process, INFINITE);
+    CloseHandle(args.process);
+  }
+  std::ranges::sort(latencies);
+  const auto percentile{[&latencies](double p) {
+    return latencies[static_cast<std::size_t>(p * (latencies.size() - 1))];
+  }};
+  std::printf("%-8s %6d launches  min %9.1f us  median %9.1f us  "
+              "p95 %9.1f us\n",
+              name, num_launches, latencies.front(), percentile(0.5),
+              percentile(0.95));
+  return true;
+}
+
+} // namespace
+
+int wmain(int argc, wchar_t *argv[]) {
+  if (argc < 3) {
+    std::fputs("Usage: strategy_bench <stub game> <stub runtime> "
+               "[launches per strategy]\n",
+               stderr);
+    return EXIT_FAILURE;
+  }
+  const auto exe_path{windows_path(argv[1])};
+  const auto dll_path{windows_path(argv[2])};
+  const int num_launches{argc > 3 ? std::wcstol(argv[3], nullptr, 10) : 50};
+  if (num_launches <= 0) {
+    return EXIT_FAILURE;
+  }
+  tek_inj_game_args args{};
+  args.exe_path = exe_path.data();
+  args.dll_path = dll_path.data();
+  args.type = TEK_GR_LOAD_TYPE_data;
+  static constexpr char settings[]{"{}"};
+  args.data = settings;
+  args.data_size = sizeof settings - 1;
+  args.flags = static_cast<tek_inj_flag>(TEK_INJ_FLAG_wait_ready |
+                                         TEK_INJ_FLAG_keep_process);
+  constexpr std::array strategies{
+      std::pair{"thread", TEK_INJ_STRATEGY_remote_thread},
+      std::pair{"apc", TEK_INJ_STRATEGY_apc},
+      std::pair{"entry", TEK_INJ_STRATEGY_entry_trampoline}};
+  bool ok{true};
+  for (const auto &[name, strategy] : strategies) {
+    ok &= bench(name, strategy, args, num_launches);
+  }
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,22 @@
+//===-- stub_game.cpp - Stub game for the injection strategy benchmark ----===//
+//
+// Copyright (c) 2025 Nuclearist <nuclearist@teknology-hub.com>
+// Part of tek-injector, under the GNU General Public License v3.0 or later
+// See https://github.com/teknology-hub/tek-injector/blob/main/COPYING for
+//    license information.
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+//===----------------------------------------------------------------------===//
+///
+/// @file
+///  Game executable that does nothing but wait to be terminated, so launch
+///    latency measured by the benchmark is that of the injector and the
+///    loader alone.
+///
+//===----------------------------------------------------------------------===//
+#include <windows.h>
+
+int wmain() {
+  Sleep(INFINITE);
+  return 0;
+}
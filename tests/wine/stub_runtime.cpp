@@ -0,0 +1,66 @@
+//===-- stub_runtime.cpp - Stub TEK Game Runtime for the benchmark --------===//
+//
+// Copyright (c) 2025 Nuclearist <nuclearist@teknology-hub.com>
+// Part of tek-injector, under the GNU General Public License v3.0 or later
+// See https://github.com/teknology-hub/tek-injector/blob/main/COPYING for
+//    license information.
+// SPDX-License-Identifier: GPL-3.0-or-later
+//
+//===----------------------------------------------------------------------===//
+///
+/// @file
+///  DLL standing in for TEK Game Runtime: upon loading, it finds the input
+///    file mapping of its process and reports readiness via the status block
+///    right away, without reading settings or installing hooks.
+///
+//===----------------------------------------------------------------------===//
+#include "payload.hpp"
+#include "tek-injector.h"
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <windows.h>
+
+namespace {
+
+/// Report readiness to the injector.
+void report_ready() {
+  std::wstring name{TEK_INJ_MAPPING_NAME_PREFIX};
+  name += std::to_wstring(GetCurrentProcessId());
+  const auto mapping{OpenFileMappingW(FILE_MAP_WRITE, FALSE, name.data())};
+  if (!mapping) {
+    return;
+  }
+  const auto view{MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, 0)};
+  if (!view) {
+    CloseHandle(mapping);
+    return;
+  }
+  using namespace tek_inj::payload;
+  const auto &header{*static_cast<const data_header_v2 *>(view)};
+  if (header.magic == data_header_magic && (header.flags & flag_status)) {
+    auto &status{*get_status(view)};
+    LARGE_INTEGER time;
+    QueryPerformanceCounter(&time);
+    for (const auto s : {state::loaded, state::settings_parsed,
+                         state::hooks_installed, state::ready}) {
+      status.times[static_cast<int>(s)] = time.QuadPart;
+    }
+    std::atomic_ref{status.state}.store(static_cast<std::uint32_t>(state::ready),
+                                        std::memory_order::release);
+    SetEvent(reinterpret_cast<HANDLE>(
+        static_cast<std::uintptr_t>(status.event)));
+  }
+  UnmapViewOfFile(view);
+  CloseHandle(mapping);
+}
+
+} // namespace
+
+extern "C" BOOL WINAPI DllMain(HINSTANCE, DWORD reason, LPVOID) {
+  if (reason == DLL_PROCESS_ATTACH) {
+    report_ready();
+  }
+  return TRUE;
+}